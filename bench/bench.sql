@@ -0,0 +1,61 @@
+--
+-- Render benchmark for pg_plan_tree_dot, run by "make bench".
+--
+-- Builds synthetic plans that stress the renderer and prints, for each case
+-- and phase, one line of
+--     case|phase|avg_ms|nodes|nodes_per_sec|bytes
+--
+SET client_min_messages TO 'warning';
+
+CREATE EXTENSION IF NOT EXISTS pg_plan_tree_dot;
+
+DROP SCHEMA IF EXISTS plan_tree_bench CASCADE;
+CREATE SCHEMA plan_tree_bench;
+SET search_path TO plan_tree_bench, public;
+
+-- Tables for a 16-way join
+DO $$
+BEGIN
+	FOR i IN 1..16 LOOP
+		EXECUTE format('CREATE TABLE t%s (id int PRIMARY KEY, ref int, val text)', i);
+	END LOOP;
+END
+$$;
+
+-- A parent table with 2000 children
+CREATE TABLE part (id int, val text);
+
+DO $$
+BEGIN
+	FOR i IN 0..1999 LOOP
+		EXECUTE format('CREATE TABLE part_%s (CHECK (id >= %s AND id < %s)) INHERITS (part)',
+					   i, i * 100, (i + 1) * 100);
+	END LOOP;
+END
+$$;
+
+CREATE TABLE bench_case (name text, sql text);
+
+INSERT INTO bench_case
+	SELECT 'join_16way',
+		   'SELECT * FROM t1' ||
+		   string_agg(format(' JOIN t%s ON t%s.id = t%s.ref', i, i, i - 1), '' ORDER BY i)
+	  FROM generate_series(2, 16) i;
+
+INSERT INTO bench_case
+	VALUES ('partitions_2000', 'SELECT * FROM part WHERE val = ''x''');
+
+INSERT INTO bench_case
+	SELECT 'in_list_100k',
+		   'SELECT * FROM t1 WHERE id IN (' || string_agg(i::text, ',' ORDER BY i) || ')'
+	  FROM generate_series(1, 100000) i;
+
+INSERT INTO bench_case
+	VALUES ('case_depth_300',
+			'SELECT ' || repeat('CASE WHEN ref > 0 THEN ', 300) || '0' ||
+			repeat(' ELSE 1 END', 300) || ' FROM t1');
+
+SELECT c.name, b.phase, round(b.avg_ms::numeric, 3), b.nodes, round(b.nodes_per_sec::numeric), b.bytes
+  FROM bench_case c, plan_tree_dot_benchmark(c.sql, :iterations) b;
+
+DROP SCHEMA plan_tree_bench CASCADE;
@@ -0,0 +1,33 @@
+#!/bin/sh
+#
+# Compares a benchmark run with the stored baseline, and fails if the
+# nodes/sec of any case and phase dropped by more than the tolerance.
+#
+# usage: compare.sh baseline results tolerance_percent
+#
+baseline=$1
+results=$2
+tolerance=$3
+
+if [ ! -f "$baseline" ]; then
+	echo "no baseline in $baseline; run \"make bench-baseline\" to store this run"
+	cat "$results"
+	exit 0
+fi
+
+awk -F'|' -v tol="$tolerance" '
+NR == FNR { base[$1 "|" $2] = $5; next }
+{
+	key = $1 "|" $2
+	if ((key in base) && base[key] > 0 && $5 != "") {
+		change = 100.0 * ($5 - base[key]) / base[key]
+		status = ""
+		if (change < -tol) {
+			status = "REGRESSION"
+			failed = 1
+		}
+		printf "%-20s %-6s %12s nodes/s %+7.1f%% %s\n", $1, $2, $5, change, status
+	} else
+		printf "%-20s %-6s %12s nodes/s (no baseline)\n", $1, $2, $5
+}
+END { exit failed }' "$baseline" "$results"
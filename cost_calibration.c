@@ -0,0 +1,470 @@
+/*-------------------------------------------------------------------------
+ *
+ * cost_calibration.c
+ *
+ * Calibration of the planner cost constants.  plan_tree_calibration_sample()
+ * runs queries with instrumentation and adds one sample per plan node: the
+ * pages it fetched sequentially and randomly, the tuples it processed, the
+ * operators it evaluated and its exclusive time.  plan_tree_calibrate()
+ * fits
+ *
+ *     time = a * seq_pages + b * random_pages + c * tuples + d * operators
+ *
+ * by least squares over the samples of the session, and returns a, b, c
+ * and d rescaled to the units of the current cost constants, with the fit
+ * quality for each node type.  Components that would get a negative weight
+ * are left out of the fit.
+ *
+ * Copyright (c) 2014-2017 Minoru NAKAMURA <nminoru@nminoru.jp>
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <math.h>
+
+#include "fmgr.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "nodes/nodeFuncs.h"
+#include "nodes/plannodes.h"
+#include "optimizer/cost.h"
+#include "utils/builtins.h"
+#include "utils/memutils.h"
+#include "utils/tuplestore.h"
+
+#include "pg_plan_tree_dot.h"
+
+
+#define NUM_COST_COMPONENTS		4
+
+/* Samples of this session, in TopMemoryContext */
+static CalibrationSample *samples = NULL;
+static int	num_samples = 0;
+static int	max_samples = 0;
+
+static bool count_operators_walker(Node *node, double *count);
+static void sample_components(const CalibrationSample *sample, double *x);
+static bool fit_cost_model(double *coef, bool *active);
+static bool solve_normal_equations(double xtx[NUM_COST_COMPONENTS][NUM_COST_COMPONENTS], double *xty, const bool *active, double *coef);
+static double fit_r_squared(const double *coef, const char *node_type);
+
+/*
+ * Adds a sample to the session's collection.
+ */
+void
+add_calibration_sample(const CalibrationSample *sample)
+{
+	if (num_samples >= max_samples)
+	{
+		max_samples = (max_samples > 0) ? max_samples * 2 : 256;
+
+		if (samples == NULL)
+			samples = (CalibrationSample *) MemoryContextAlloc(TopMemoryContext,
+															   sizeof(CalibrationSample) * max_samples);
+		else
+			samples = (CalibrationSample *) repalloc(samples, sizeof(CalibrationSample) * max_samples);
+	}
+
+	samples[num_samples++] = *sample;
+}
+
+/*
+ * Returns the number of operators and functions a plan node evaluates per
+ * tuple, counting its target list and all of its quals.
+ */
+double
+count_plan_operators(const struct Plan *plan)
+{
+	double count = 0.0;
+
+	count_operators_walker((Node *) plan->targetlist, &count);
+	count_operators_walker((Node *) plan->qual, &count);
+
+	switch (nodeTag(plan))
+	{
+		case T_IndexScan:
+			count_operators_walker((Node *) ((const IndexScan *) plan)->indexqual, &count);
+			break;
+#if PG_VERSION_NUM >= 90200
+		case T_IndexOnlyScan:
+			count_operators_walker((Node *) ((const IndexOnlyScan *) plan)->indexqual, &count);
+			break;
+#endif
+		case T_BitmapIndexScan:
+			count_operators_walker((Node *) ((const BitmapIndexScan *) plan)->indexqual, &count);
+			break;
+		case T_NestLoop:
+			count_operators_walker((Node *) ((const Join *) plan)->joinqual, &count);
+			break;
+		case T_MergeJoin:
+			count_operators_walker((Node *) ((const Join *) plan)->joinqual, &count);
+			count_operators_walker((Node *) ((const MergeJoin *) plan)->mergeclauses, &count);
+			break;
+		case T_HashJoin:
+			count_operators_walker((Node *) ((const Join *) plan)->joinqual, &count);
+			count_operators_walker((Node *) ((const HashJoin *) plan)->hashclauses, &count);
+			break;
+		default:
+			break;
+	}
+
+	return count;
+}
+
+static bool
+count_operators_walker(Node *node, double *count)
+{
+	if (node == NULL)
+		return false;
+
+	switch (nodeTag(node))
+	{
+		case T_FuncExpr:
+		case T_OpExpr:
+		case T_DistinctExpr:
+		case T_NullIfExpr:
+		case T_ScalarArrayOpExpr:
+		case T_Aggref:
+		case T_WindowFunc:
+			*count += 1.0;
+			break;
+		default:
+			break;
+	}
+
+	return expression_tree_walker(node, count_operators_walker, (void *) count);
+}
+
+/*
+ * plan_tree_calibrate()
+ *
+ * Fits the cost model to the samples.  The first row, whose node_type is
+ * NULL, has the recommended constants and the overall fit; the others have
+ * the fit of the same model to the samples of each node type.
+ */
+PG_FUNCTION_INFO_V1(plan_tree_calibrate);
+Datum
+plan_tree_calibrate(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo	   *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc			tupdesc;
+	Tuplestorestate	   *tupstore;
+	MemoryContext		oldcontext;
+	double				coef[NUM_COST_COMPONENTS];
+	bool				active[NUM_COST_COMPONENTS];
+	double				current[NUM_COST_COMPONENTS];
+	double				scale = 0.0;
+	Datum				values[8];
+	bool				nulls[8];
+	const char		  **node_types;
+	int					num_types = 0;
+	int					i, j;
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		elog(ERROR, "set-valued function called in context that cannot accept a set");
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		elog(ERROR, "materialize mode required, but it is not allowed in this context");
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	if (num_samples < NUM_COST_COMPONENTS)
+		elog(ERROR, "at least %d calibration samples are needed, but there are %d",
+			 NUM_COST_COMPONENTS, num_samples);
+
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+	tupdesc = CreateTupleDescCopy(tupdesc);
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	if (!fit_cost_model(coef, active))
+		elog(ERROR, "the calibration samples do not determine the cost model");
+
+	current[0] = seq_page_cost;
+	current[1] = random_page_cost;
+	current[2] = cpu_tuple_cost;
+	current[3] = cpu_operator_cost;
+
+	/*
+	 * The weights are in milliseconds.  They are rescaled so that the first
+	 * component in the fit keeps its current cost; normally that makes
+	 * seq_page_cost the unit, as the defaults do.
+	 */
+	for (i = 0 ; i < NUM_COST_COMPONENTS ; i++)
+	{
+		if (active[i] && current[i] > 0.0)
+		{
+			scale = coef[i] / current[i];
+			break;
+		}
+	}
+
+	memset(nulls, 0, sizeof(nulls));
+
+	nulls[0] = true;
+	values[1] = Int64GetDatum((int64) num_samples);
+	for (i = 0 ; i < NUM_COST_COMPONENTS ; i++)
+	{
+		if (active[i] && scale > 0.0)
+			values[2 + i] = Float8GetDatum(coef[i] / scale);
+		else
+			nulls[2 + i] = true;
+	}
+	if (scale > 0.0)
+		values[6] = Float8GetDatum(scale);
+	else
+		nulls[6] = true;
+	values[7] = Float8GetDatum(fit_r_squared(coef, NULL));
+
+	tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+
+	/* One row per node type, in the order they were first sampled */
+	node_types = (const char **) palloc(sizeof(char *) * num_samples);
+
+	for (i = 0 ; i < num_samples ; i++)
+	{
+		for (j = 0 ; j < num_types ; j++)
+			if (strcmp(node_types[j], samples[i].node_type) == 0)
+				break;
+
+		if (j == num_types)
+			node_types[num_types++] = samples[i].node_type;
+	}
+
+	for (j = 0 ; j < num_types ; j++)
+	{
+		int64	count = 0;
+		double	r_squared;
+
+		for (i = 0 ; i < num_samples ; i++)
+			if (strcmp(node_types[j], samples[i].node_type) == 0)
+				count++;
+
+		memset(nulls, 0, sizeof(nulls));
+
+		values[0] = CStringGetTextDatum(node_types[j]);
+		values[1] = Int64GetDatum(count);
+		for (i = 2 ; i <= 6 ; i++)
+			nulls[i] = true;
+
+		r_squared = fit_r_squared(coef, node_types[j]);
+		if (count > 1 && !isnan(r_squared))
+			values[7] = Float8GetDatum(r_squared);
+		else
+			nulls[7] = true;
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * plan_tree_calibration_reset()
+ */
+PG_FUNCTION_INFO_V1(plan_tree_calibration_reset);
+Datum
+plan_tree_calibration_reset(PG_FUNCTION_ARGS)
+{
+	if (samples)
+		pfree(samples);
+
+	samples		= NULL;
+	num_samples	= 0;
+	max_samples	= 0;
+
+	PG_RETURN_VOID();
+}
+
+static void
+sample_components(const CalibrationSample *sample, double *x)
+{
+	x[0] = sample->seq_pages;
+	x[1] = sample->random_pages;
+	x[2] = sample->tuples;
+	x[3] = sample->operators;
+}
+
+/*
+ * Least squares without an intercept.  A component whose weight comes out
+ * negative, or that the samples do not determine, is dropped and the rest
+ * are fitted again.  Returns false if no component is left.
+ */
+static bool
+fit_cost_model(double *coef, bool *active)
+{
+	double	xtx[NUM_COST_COMPONENTS][NUM_COST_COMPONENTS];
+	double	xty[NUM_COST_COMPONENTS];
+	int		i, j, k;
+
+	memset(xtx, 0, sizeof(xtx));
+	memset(xty, 0, sizeof(xty));
+
+	for (k = 0 ; k < num_samples ; k++)
+	{
+		double x[NUM_COST_COMPONENTS];
+
+		sample_components(&samples[k], x);
+
+		for (i = 0 ; i < NUM_COST_COMPONENTS ; i++)
+		{
+			for (j = 0 ; j < NUM_COST_COMPONENTS ; j++)
+				xtx[i][j] += x[i] * x[j];
+			xty[i] += x[i] * samples[k].exclusive_ms;
+		}
+	}
+
+	for (i = 0 ; i < NUM_COST_COMPONENTS ; i++)
+		active[i] = (xtx[i][i] > 0.0);
+
+	for (;;)
+	{
+		int		worst = -1;
+		bool	any = false;
+
+		for (i = 0 ; i < NUM_COST_COMPONENTS ; i++)
+			any |= active[i];
+		if (!any)
+			return false;
+
+		if (!solve_normal_equations(xtx, xty, active, coef))
+		{
+			/* The components are dependent; drop the last one */
+			for (i = NUM_COST_COMPONENTS - 1 ; !active[i] ; i--)
+				;
+			active[i] = false;
+			continue;
+		}
+
+		for (i = 0 ; i < NUM_COST_COMPONENTS ; i++)
+			if (active[i] && coef[i] <= 0.0 && (worst < 0 || coef[i] < coef[worst]))
+				worst = i;
+
+		if (worst < 0)
+			return true;
+
+		active[worst] = false;
+	}
+}
+
+/*
+ * Gaussian elimination with partial pivoting over the active components.
+ * Returns false if they are linearly dependent over the samples.
+ */
+static bool
+solve_normal_equations(double xtx[NUM_COST_COMPONENTS][NUM_COST_COMPONENTS], double *xty, const bool *active, double *coef)
+{
+	double	a[NUM_COST_COMPONENTS][NUM_COST_COMPONENTS + 1];
+	int		index[NUM_COST_COMPONENTS];
+	int		n = 0;
+	int		i, j, k;
+
+	for (i = 0 ; i < NUM_COST_COMPONENTS ; i++)
+	{
+		coef[i] = 0.0;
+		if (active[i])
+			index[n++] = i;
+	}
+
+	for (i = 0 ; i < n ; i++)
+	{
+		for (j = 0 ; j < n ; j++)
+			a[i][j] = xtx[index[i]][index[j]];
+		a[i][n] = xty[index[i]];
+	}
+
+	for (k = 0 ; k < n ; k++)
+	{
+		int		pivot = k;
+		double	scale;
+
+		for (i = k + 1 ; i < n ; i++)
+			if (fabs(a[i][k]) > fabs(a[pivot][k]))
+				pivot = i;
+
+		if (fabs(a[pivot][k]) < 1e-12 * Max(fabs(xtx[index[k]][index[k]]), 1.0))
+			return false;
+
+		if (pivot != k)
+		{
+			for (j = 0 ; j <= n ; j++)
+			{
+				double tmp = a[k][j];
+
+				a[k][j] = a[pivot][j];
+				a[pivot][j] = tmp;
+			}
+		}
+
+		for (i = k + 1 ; i < n ; i++)
+		{
+			scale = a[i][k] / a[k][k];
+			for (j = k ; j <= n ; j++)
+				a[i][j] -= scale * a[k][j];
+		}
+	}
+
+	for (k = n - 1 ; k >= 0 ; k--)
+	{
+		double sum = a[k][n];
+
+		for (j = k + 1 ; j < n ; j++)
+			sum -= a[k][j] * coef[index[j]];
+
+		coef[index[k]] = sum / a[k][k];
+	}
+
+	return true;
+}
+
+/*
+ * Coefficient of determination of the model over the samples of a node
+ * type, or over all samples if node_type is NULL.
+ */
+static double
+fit_r_squared(const double *coef, const char *node_type)
+{
+	double	sum = 0.0, sse = 0.0, sst = 0.0;
+	int		n = 0;
+	int		i, k;
+
+	for (k = 0 ; k < num_samples ; k++)
+	{
+		if (node_type == NULL || strcmp(node_type, samples[k].node_type) == 0)
+		{
+			sum += samples[k].exclusive_ms;
+			n++;
+		}
+	}
+
+	if (n == 0)
+		return NAN;
+
+	for (k = 0 ; k < num_samples ; k++)
+	{
+		double	x[NUM_COST_COMPONENTS];
+		double	predicted = 0.0;
+		double	y = samples[k].exclusive_ms;
+
+		if (node_type != NULL && strcmp(node_type, samples[k].node_type) != 0)
+			continue;
+
+		sample_components(&samples[k], x);
+		for (i = 0 ; i < NUM_COST_COMPONENTS ; i++)
+			predicted += coef[i] * x[i];
+
+		sse += (y - predicted) * (y - predicted);
+		sst += (y - sum / n) * (y - sum / n);
+	}
+
+	if (sst <= 0.0)
+		return NAN;
+
+	return 1.0 - sse / sst;
+}
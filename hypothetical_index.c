@@ -0,0 +1,452 @@
+/*-------------------------------------------------------------------------
+ *
+ * hypothetical_index.c
+ *
+ * Hypothetical btree indexes for what-if planning.  While they are active,
+ * get_relation_info_hook adds an IndexOptInfo for each of them to the table
+ * it is defined on, so the planner costs it as if it existed.  The index
+ * size is estimated from the table's row count and column widths.
+ *
+ * Copyright (c) 2014-2017 Minoru NAKAMURA <nminoru@nminoru.jp>
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <math.h>
+
+#if PG_VERSION_NUM >= 90600
+#include "access/amapi.h"
+#endif
+#include "access/itup.h"
+#include "access/nbtree.h"
+#include "access/transam.h"
+#include "catalog/namespace.h"
+#include "catalog/pg_am.h"
+#include "catalog/pg_class.h"
+#include "commands/defrem.h"
+#include "lib/stringinfo.h"
+#include "nodes/makefuncs.h"
+#include "nodes/parsenodes.h"
+#include "nodes/pg_list.h"
+#if PG_VERSION_NUM >= 120000
+#include "nodes/pathnodes.h"
+#else
+#include "nodes/relation.h"
+#endif
+#include "optimizer/plancat.h"
+#include "parser/parser.h"
+#include "storage/bufpage.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+#include "utils/syscache.h"
+
+#include "pg_plan_tree_dot.h"
+
+
+/* Active hypothetical indexes, as HypotheticalIndex */
+static List *hypothetical_indexes = NIL;
+
+#if PG_VERSION_NUM >= 90600
+
+/* A hypothetical index given to begin_hypothetical_indexes() */
+typedef struct HypotheticalIndex
+{
+	Oid			oid;			/* made-up OID that is not in pg_class */
+	char	   *name;
+	Oid			relid;
+	bool		unique;
+	int			ncolumns;
+	AttrNumber *indexkeys;
+	Oid		   *atttypes;
+	int32	   *atttypmods;
+	Oid		   *collations;
+	Oid		   *opfamily;
+	Oid		   *opcintype;
+	bool	   *reverse_sort;
+	bool	   *nulls_first;
+} HypotheticalIndex;
+
+static bool hypothetical_hook_installed = false;
+static get_relation_info_hook_type prev_get_relation_info_hook = NULL;
+
+static HypotheticalIndex *parse_hypothetical_index(const char *def, int index_no);
+static Oid	new_hypothetical_oid(void);
+static void hypothetical_get_relation_info(PlannerInfo *root, Oid relationObjectId, bool inhparent, RelOptInfo *rel);
+static IndexOptInfo *make_hypothetical_index_info(HypotheticalIndex *hypo, RelOptInfo *rel);
+static void estimate_hypothetical_index_size(HypotheticalIndex *hypo, IndexOptInfo *index);
+
+#endif
+
+/*
+ * Defines hypothetical indexes from CREATE INDEX statements and makes the
+ * planner see them until end_hypothetical_indexes().  Only btree indexes on
+ * plain columns are supported.  The definitions are kept in the current
+ * memory context.
+ */
+void
+begin_hypothetical_indexes(int num_defs, char **defs)
+{
+#if PG_VERSION_NUM >= 90600
+	int i;
+
+	if (hypothetical_hook_installed)
+		elog(ERROR, "hypothetical indexes are already active");
+
+	hypothetical_indexes = NIL;
+
+	for (i = 0 ; i < num_defs ; i++)
+		hypothetical_indexes = lappend(hypothetical_indexes,
+									   parse_hypothetical_index(defs[i], i + 1));
+
+	prev_get_relation_info_hook = get_relation_info_hook;
+	get_relation_info_hook = hypothetical_get_relation_info;
+	hypothetical_hook_installed = true;
+#else
+	elog(ERROR, "hypothetical indexes require PostgreSQL 9.6 or later");
+#endif
+}
+
+/*
+ * Removes the hypothetical indexes.  Safe to call when none are active, so
+ * it can be used in error cleanup.
+ */
+void
+end_hypothetical_indexes(void)
+{
+#if PG_VERSION_NUM >= 90600
+	if (hypothetical_hook_installed)
+	{
+		get_relation_info_hook = prev_get_relation_info_hook;
+		hypothetical_hook_installed = false;
+	}
+
+	hypothetical_indexes = NIL;
+#endif
+}
+
+/*
+ * Returns the names of the active hypothetical indexes by their made-up
+ * OIDs, for drawing plans that use them.
+ */
+PlanTreeDotOidName *
+get_hypothetical_index_names(int *num_names)
+{
+	PlanTreeDotOidName *result;
+	int			n = 0;
+#if PG_VERSION_NUM >= 90600
+	ListCell   *lc;
+#endif
+
+	result = (PlanTreeDotOidName *) palloc0(sizeof(PlanTreeDotOidName) *
+											(list_length(hypothetical_indexes) + 1));
+
+#if PG_VERSION_NUM >= 90600
+	foreach(lc, hypothetical_indexes)
+	{
+		HypotheticalIndex *hypo = (HypotheticalIndex *) lfirst(lc);
+
+		result[n].oid	= hypo->oid;
+		result[n].name	= hypo->name;
+		n++;
+	}
+#endif
+
+	*num_names = n;
+
+	return result;
+}
+
+#if PG_VERSION_NUM >= 90600
+
+static HypotheticalIndex *
+parse_hypothetical_index(const char *def, int index_no)
+{
+	List			   *parsetree_list;
+	Node			   *parsetree;
+	IndexStmt		   *stmt;
+	HypotheticalIndex  *hypo;
+	ListCell		   *lc;
+	StringInfoData		name;
+	char				relkind;
+	int					i;
+
+	parsetree_list = raw_parser(def);
+
+	if (list_length(parsetree_list) != 1)
+		elog(ERROR, "hypothetical index definition must be a single CREATE INDEX statement");
+
+#if PG_VERSION_NUM >= 100000
+	parsetree = linitial_node(RawStmt, parsetree_list)->stmt;
+#else
+	parsetree = (Node *) linitial(parsetree_list);
+#endif
+
+	if (!IsA(parsetree, IndexStmt))
+		elog(ERROR, "hypothetical index definition must be a CREATE INDEX statement: %s", def);
+
+	stmt = (IndexStmt *) parsetree;
+
+	if (strcmp(stmt->accessMethod, "btree") != 0)
+		elog(ERROR, "hypothetical indexes must use btree, not \"%s\"", stmt->accessMethod);
+	if (stmt->whereClause != NULL)
+		elog(ERROR, "hypothetical indexes cannot be partial");
+#if PG_VERSION_NUM >= 110000
+	if (stmt->indexIncludingParams != NIL)
+		elog(ERROR, "hypothetical indexes cannot have INCLUDE columns");
+#endif
+
+	hypo = (HypotheticalIndex *) palloc0(sizeof(HypotheticalIndex));
+
+	hypo->relid = RangeVarGetRelid(stmt->relation, AccessShareLock, false);
+
+	relkind = get_rel_relkind(hypo->relid);
+	if (relkind != RELKIND_RELATION && relkind != RELKIND_MATVIEW)
+		elog(ERROR, "\"%s\" is not a table or materialized view", get_rel_name(hypo->relid));
+
+	hypo->oid		= new_hypothetical_oid();
+	hypo->unique	= stmt->unique;
+	hypo->ncolumns	= list_length(stmt->indexParams);
+
+	hypo->indexkeys		= (AttrNumber *) palloc(sizeof(AttrNumber) * hypo->ncolumns);
+	hypo->atttypes		= (Oid *) palloc(sizeof(Oid) * hypo->ncolumns);
+	hypo->atttypmods	= (int32 *) palloc(sizeof(int32) * hypo->ncolumns);
+	hypo->collations	= (Oid *) palloc(sizeof(Oid) * hypo->ncolumns);
+	hypo->opfamily		= (Oid *) palloc(sizeof(Oid) * hypo->ncolumns);
+	hypo->opcintype		= (Oid *) palloc(sizeof(Oid) * hypo->ncolumns);
+	hypo->reverse_sort	= (bool *) palloc(sizeof(bool) * hypo->ncolumns);
+	hypo->nulls_first	= (bool *) palloc(sizeof(bool) * hypo->ncolumns);
+
+	i = 0;
+	foreach(lc, stmt->indexParams)
+	{
+		IndexElem  *elem = (IndexElem *) lfirst(lc);
+		AttrNumber	attnum;
+		Oid			opclass;
+
+		if (elem->name == NULL)
+			elog(ERROR, "hypothetical indexes support only plain columns");
+		if (elem->collation != NIL || elem->opclass != NIL)
+			elog(ERROR, "hypothetical indexes do not support explicit collations or operator classes");
+
+		attnum = get_attnum(hypo->relid, elem->name);
+		if (attnum == InvalidAttrNumber)
+			elog(ERROR, "column \"%s\" of \"%s\" does not exist",
+				 elem->name, get_rel_name(hypo->relid));
+
+		get_atttypetypmodcoll(hypo->relid, attnum,
+							  &hypo->atttypes[i], &hypo->atttypmods[i], &hypo->collations[i]);
+
+		opclass = GetDefaultOpClass(hypo->atttypes[i], BTREE_AM_OID);
+		if (!OidIsValid(opclass))
+			elog(ERROR, "data type %s has no default btree operator class",
+				 format_type_be(hypo->atttypes[i]));
+
+		hypo->indexkeys[i]		= attnum;
+		hypo->opfamily[i]		= get_opclass_family(opclass);
+		hypo->opcintype[i]		= get_opclass_input_type(opclass);
+		hypo->reverse_sort[i]	= (elem->ordering == SORTBY_DESC);
+
+		if (elem->nulls_ordering == SORTBY_NULLS_DEFAULT)
+			hypo->nulls_first[i] = hypo->reverse_sort[i];
+		else
+			hypo->nulls_first[i] = (elem->nulls_ordering == SORTBY_NULLS_FIRST);
+
+		i++;
+	}
+
+	initStringInfo(&name);
+	if (stmt->idxname)
+		appendStringInfo(&name, "%s (hypothetical)", stmt->idxname);
+	else
+		appendStringInfo(&name, "hypothetical index %d on %s", index_no, get_rel_name(hypo->relid));
+	hypo->name = name.data;
+
+	return hypo;
+}
+
+/*
+ * Picks an OID below FirstNormalObjectId that no relation and no other
+ * hypothetical index uses.  Nothing looks these up except the renderer.
+ */
+static Oid
+new_hypothetical_oid(void)
+{
+	Oid			oid;
+
+	for (oid = FirstNormalObjectId - 1 ; oid > FirstBootstrapObjectId ; oid--)
+	{
+		ListCell   *lc;
+		bool		used = false;
+
+		if (SearchSysCacheExists1(RELOID, ObjectIdGetDatum(oid)))
+			continue;
+
+		foreach(lc, hypothetical_indexes)
+		{
+			if (((HypotheticalIndex *) lfirst(lc))->oid == oid)
+			{
+				used = true;
+				break;
+			}
+		}
+
+		if (!used)
+			return oid;
+	}
+
+	elog(ERROR, "no OID is free for a hypothetical index");
+
+	return InvalidOid;			/* keep compiler quiet */
+}
+
+static void
+hypothetical_get_relation_info(PlannerInfo *root, Oid relationObjectId, bool inhparent, RelOptInfo *rel)
+{
+	ListCell *lc;
+
+	if (prev_get_relation_info_hook)
+		prev_get_relation_info_hook(root, relationObjectId, inhparent, rel);
+
+	/* The planner does not use indexes of an inheritance parent as such */
+	if (inhparent)
+		return;
+
+	foreach(lc, hypothetical_indexes)
+	{
+		HypotheticalIndex *hypo = (HypotheticalIndex *) lfirst(lc);
+
+		if (hypo->relid == relationObjectId)
+			rel->indexlist = lcons(make_hypothetical_index_info(hypo, rel), rel->indexlist);
+	}
+}
+
+/*
+ * Builds the IndexOptInfo that get_relation_info() would have built had the
+ * index existed.  It is marked hypothetical, so the planner does not try to
+ * read it, e.g. for the actual range of a column.
+ */
+static IndexOptInfo *
+make_hypothetical_index_info(HypotheticalIndex *hypo, RelOptInfo *rel)
+{
+	IndexOptInfo   *index = makeNode(IndexOptInfo);
+	IndexAmRoutine *amroutine;
+	int				ncolumns = hypo->ncolumns;
+	int				i;
+
+	index->indexoid			= hypo->oid;
+	index->reltablespace	= rel->reltablespace;
+	index->rel				= rel;
+	index->ncolumns			= ncolumns;
+#if PG_VERSION_NUM >= 110000
+	index->nkeycolumns		= ncolumns;
+#endif
+
+	index->indexkeys		= (int *) palloc(sizeof(int) * ncolumns);
+	index->indexcollations	= (Oid *) palloc(sizeof(Oid) * ncolumns);
+	index->opfamily			= (Oid *) palloc(sizeof(Oid) * ncolumns);
+	index->opcintype		= (Oid *) palloc(sizeof(Oid) * ncolumns);
+	index->canreturn		= (bool *) palloc(sizeof(bool) * ncolumns);
+	index->reverse_sort		= (bool *) palloc(sizeof(bool) * ncolumns);
+	index->nulls_first		= (bool *) palloc(sizeof(bool) * ncolumns);
+
+	/* btree sorts by its own operator family */
+	index->sortopfamily		= index->opfamily;
+
+	for (i = 0 ; i < ncolumns ; i++)
+	{
+		Var *var;
+
+		index->indexkeys[i]			= hypo->indexkeys[i];
+		index->indexcollations[i]	= hypo->collations[i];
+		index->opfamily[i]			= hypo->opfamily[i];
+		index->opcintype[i]			= hypo->opcintype[i];
+		index->canreturn[i]			= true;
+		index->reverse_sort[i]		= hypo->reverse_sort[i];
+		index->nulls_first[i]		= hypo->nulls_first[i];
+
+		var = makeVar(rel->relid, hypo->indexkeys[i], hypo->atttypes[i],
+					  hypo->atttypmods[i], hypo->collations[i], 0);
+		index->indextlist = lappend(index->indextlist,
+									makeTargetEntry((Expr *) var, i + 1, NULL, false));
+	}
+
+	index->relam = BTREE_AM_OID;
+
+	amroutine = GetIndexAmRoutineByAmId(BTREE_AM_OID, false);
+
+	index->amcostestimate	= amroutine->amcostestimate;
+	index->amcanorderbyop	= amroutine->amcanorderbyop;
+	index->amoptionalkey	= amroutine->amoptionalkey;
+	index->amsearcharray	= amroutine->amsearcharray;
+	index->amsearchnulls	= amroutine->amsearchnulls;
+	index->amhasgettuple	= (amroutine->amgettuple != NULL);
+	index->amhasgetbitmap	= (amroutine->amgetbitmap != NULL);
+#if PG_VERSION_NUM >= 100000
+	index->amcanparallel	= amroutine->amcanparallel;
+#endif
+#if PG_VERSION_NUM >= 110000
+	index->amcanmarkpos		= (amroutine->ammarkpos != NULL);
+#endif
+
+	index->indexprs		= NIL;
+	index->indpred		= NIL;
+	index->predOK		= false;
+	index->unique		= hypo->unique;
+	index->immediate	= true;
+	index->hypothetical	= true;
+
+	estimate_hypothetical_index_size(hypo, index);
+
+	return index;
+}
+
+/*
+ * Estimates the pages and height of a freshly built btree from the table's
+ * estimated row count, which get_relation_info() has already taken from
+ * pg_class, and the average widths of the indexed columns.
+ */
+static void
+estimate_hypothetical_index_size(HypotheticalIndex *hypo, IndexOptInfo *index)
+{
+	double		tuples = index->rel->tuples;
+	double		usable;
+	double		per_page;
+	double		level_pages;
+	double		pages;
+	int32		width = 0;
+	int			height = 0;
+	int			i;
+
+	for (i = 0 ; i < hypo->ncolumns ; i++)
+	{
+		int32 attwidth = get_attavgwidth(hypo->relid, hypo->indexkeys[i]);
+
+		if (attwidth <= 0)
+			attwidth = get_typavgwidth(hypo->atttypes[i], hypo->atttypmods[i]);
+		width += attwidth;
+	}
+
+	usable = (BLCKSZ - SizeOfPageHeaderData - sizeof(BTPageOpaqueData)) *
+		BTREE_DEFAULT_FILLFACTOR / 100.0;
+	per_page = floor(usable / (MAXALIGN(sizeof(IndexTupleData) + width) + sizeof(ItemIdData)));
+	if (per_page < 2.0)
+		per_page = 2.0;
+
+	/* Leaf pages, then each level of internal pages up to the root */
+	level_pages = Max(ceil(tuples / per_page), 1.0);
+	pages = level_pages;
+	while (level_pages > 1.0)
+	{
+		level_pages = ceil(level_pages / per_page);
+		pages += level_pages;
+		height++;
+	}
+
+	/* and the metapage */
+	index->pages		= (BlockNumber) (pages + 1.0);
+	index->tuples		= tuples;
+	index->tree_height	= height;
+}
+
+#endif
@@ -0,0 +1,700 @@
+/*-------------------------------------------------------------------------
+ *
+ * live_progress.c
+ *
+ * Snapshots of the plan a backend is running, taken on request of another
+ * backend.  When pg_plan_tree_dot.live_progress is on, the top-level query
+ * of each backend runs with row instrumentation, and the ExecProcNode of
+ * each of its nodes is wrapped to remember the node executing and to poll
+ * the request flag in the backend's slot in shared memory.  A requester
+ * sets the flag and waits on its latch; at the next node call the target
+ * serializes the plan, the query text and the rows and loops of each node
+ * into a DSM segment, and hands its handle back through the slot.
+ *
+ * Extensions cannot add procsignal reasons, so the request is a flag that
+ * the node wrapper reads, which is a single load per call.  A backend
+ * blocked outside the plan, in a lock wait or inside a function called by
+ * a node, answers when the plan resumes.
+ *
+ * The library must be in shared_preload_libraries.  PostgreSQL 10 or later
+ * is required.
+ *
+ * Copyright (c) 2014-2017 Minoru NAKAMURA <nminoru@nminoru.jp>
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#if PG_VERSION_NUM >= 100000
+#include "access/parallel.h"
+#include "catalog/pg_authid.h"
+#endif
+#include "executor/executor.h"
+#include "executor/instrument.h"
+#include "miscadmin.h"
+#include "nodes/execnodes.h"
+#include "nodes/plannodes.h"
+#if PG_VERSION_NUM >= 100000
+#include "pgstat.h"
+#include "postmaster/autovacuum.h"
+#include "replication/walsender.h"
+#include "storage/dsm.h"
+#endif
+#include "storage/backendid.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/proc.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#include "utils/acl.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+
+#include "pg_plan_tree_dot.h"
+
+
+#if PG_VERSION_NUM >= 100000
+
+/* The request and answer of one backend */
+typedef struct LiveSlot
+{
+	slock_t		mutex;
+	int			pid;			/* running a live query, or 0 */
+	Oid			userid;
+	Oid			dbid;
+	bool		requested;		/* a snapshot is wanted */
+	bool		published;		/* handle holds the snapshot */
+	PGPROC	   *requester;
+	dsm_handle	handle;			/* pinned until the requester reads it */
+} LiveSlot;
+
+typedef struct LiveSlotArray
+{
+	int			num_slots;
+	LiveSlot	slots[FLEXIBLE_ARRAY_MEMBER];
+} LiveSlotArray;
+
+/* Layout of a snapshot segment */
+typedef struct LiveSnapshotHeader
+{
+	TimestampTz	taken_at;
+	int			num_nodes;
+	Size		query_len;
+	Size		plan_len;
+	/* LivePlanNode[num_nodes], the query text and the plan text follow */
+} LiveSnapshotHeader;
+
+/* pg_plan_tree_dot.live_progress */
+static bool live_progress_enabled = false;
+
+static LiveSlotArray *live_slots = NULL;
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+static ExecutorStart_hook_type prev_ExecutorStart = NULL;
+
+/* The live query of this backend */
+static QueryDesc *live_query = NULL;
+static ExecProcNodeMtd *live_real_procs = NULL;	/* per plan_node_id */
+static int	live_num_procs = 0;
+static PlanStateNodeInfo *live_nodes = NULL;
+static LivePlanNode *live_node_data = NULL;	/* filled by each snapshot */
+static int	live_num_nodes = 0;
+static int	live_current_node = -1;
+static volatile LiveSlot *my_live_slot = NULL;
+static MemoryContextCallback live_query_callback;
+
+/* The request of this backend, and the snapshot it has taken but not read */
+static volatile LiveSlot *live_request_slot = NULL;
+static dsm_handle live_request_handle = 0;
+static bool live_request_holds_handle = false;
+static bool live_request_exit_registered = false;
+
+static Size live_shmem_size(void);
+static void live_shmem_startup(void);
+static void live_ExecutorStart(QueryDesc *queryDesc, int eflags);
+static void end_live_query(void *arg);
+static TupleTableSlot *live_exec_proc_node(PlanState *node);
+static void reset_live_slot(volatile LiveSlot *slot, int pid, Oid userid, Oid dbid);
+static void publish_live_snapshot(void);
+static void cancel_live_request(volatile LiveSlot *slot);
+static void release_live_request(void);
+static void live_request_shmem_exit(int code, Datum arg);
+
+#endif
+
+/*
+ * Called from _PG_init().
+ */
+void
+init_live_progress(void)
+{
+#if PG_VERSION_NUM >= 100000
+	DefineCustomBoolVariable("pg_plan_tree_dot.live_progress",
+							 "Lets plan_tree_dot_live() take snapshots of the queries of this backend.",
+							 "Requires pg_plan_tree_dot in shared_preload_libraries.",
+							 &live_progress_enabled,
+							 false,
+							 PGC_SUSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	if (!process_shared_preload_libraries_in_progress)
+		return;
+
+	RequestAddinShmemSpace(live_shmem_size());
+
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = live_shmem_startup;
+
+	prev_ExecutorStart = ExecutorStart_hook;
+	ExecutorStart_hook = live_ExecutorStart;
+#endif
+}
+
+#if PG_VERSION_NUM >= 100000
+
+/*
+ * MaxBackends is not known yet while the libraries are preloaded, so the
+ * array is sized as InitializeMaxBackends() will size it.
+ */
+static Size
+live_shmem_size(void)
+{
+	int num_slots = MaxConnections + autovacuum_max_workers + 1 + max_worker_processes;
+
+#if PG_VERSION_NUM >= 120000
+	num_slots += max_wal_senders;
+#endif
+
+	return add_size(offsetof(LiveSlotArray, slots), mul_size(num_slots, sizeof(LiveSlot)));
+}
+
+static void
+live_shmem_startup(void)
+{
+	bool found;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	live_slots = (LiveSlotArray *) ShmemInitStruct("pg_plan_tree_dot live progress",
+												   live_shmem_size(),
+												   &found);
+	if (!found)
+	{
+		int i;
+
+		live_slots->num_slots = MaxBackends;
+		for (i = 0 ; i < live_slots->num_slots ; i++)
+		{
+			memset(&live_slots->slots[i], 0, sizeof(LiveSlot));
+			SpinLockInit(&live_slots->slots[i].mutex);
+		}
+	}
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * Makes the top-level query of the backend live: row instrumentation is
+ * requested, and once the nodes exist they are wrapped.
+ */
+static void
+live_ExecutorStart(QueryDesc *queryDesc, int eflags)
+{
+	bool live = (live_progress_enabled && live_slots != NULL && live_query == NULL &&
+				 !IsParallelWorker() &&
+				 MyBackendId > 0 && MyBackendId <= live_slots->num_slots &&
+				 queryDesc->plannedstmt->utilityStmt == NULL &&
+				 (eflags & EXEC_FLAG_EXPLAIN_ONLY) == 0);
+	PlanStateNodeInfo  *nodes;
+	int					num_nodes;
+	int					i;
+	MemoryContext		oldcontext;
+	volatile LiveSlot  *slot;
+
+	if (live)
+		queryDesc->instrument_options |= INSTRUMENT_ROWS;
+
+	if (prev_ExecutorStart)
+		prev_ExecutorStart(queryDesc, eflags);
+	else
+		standard_ExecutorStart(queryDesc, eflags);
+
+	if (!live)
+		return;
+
+	oldcontext = MemoryContextSwitchTo(queryDesc->estate->es_query_cxt);
+
+	nodes = get_plan_state_nodes(queryDesc->planstate, &num_nodes);
+
+	live_num_procs = 0;
+	for (i = 0 ; i < num_nodes ; i++)
+		live_num_procs = Max(live_num_procs, ((PlanState *) nodes[i].planstate)->plan->plan_node_id + 1);
+
+	live_real_procs = (ExecProcNodeMtd *) palloc0(sizeof(ExecProcNodeMtd) * (live_num_procs + 1));
+
+	/* ExecProcNodeFirst installs ExecProcNodeReal on the first call */
+	for (i = 0 ; i < num_nodes ; i++)
+	{
+		PlanState *ps = (PlanState *) nodes[i].planstate;
+
+		live_real_procs[ps->plan->plan_node_id] = ps->ExecProcNodeReal;
+		ps->ExecProcNodeReal = live_exec_proc_node;
+	}
+
+	/* Kept for the snapshots, which must not fail inside the plan */
+	live_nodes		= nodes;
+	live_num_nodes	= num_nodes;
+	live_node_data	= (LivePlanNode *) palloc0(sizeof(LivePlanNode) * (num_nodes + 1));
+
+	live_query_callback.func	= end_live_query;
+	live_query_callback.arg		= NULL;
+	MemoryContextRegisterResetCallback(queryDesc->estate->es_query_cxt, &live_query_callback);
+
+	MemoryContextSwitchTo(oldcontext);
+
+	live_query			= queryDesc;
+	live_current_node	= -1;
+
+	slot = &live_slots->slots[MyBackendId - 1];
+
+	/* A previous holder of the slot may have left a request behind */
+	reset_live_slot(slot, MyProcPid, GetUserId(), MyDatabaseId);
+
+	my_live_slot = slot;
+}
+
+/*
+ * Runs when the memory of the live query is released, at ExecutorEnd() or
+ * on abort.  A pending request is refused.
+ */
+static void
+end_live_query(void *arg)
+{
+	volatile LiveSlot  *slot = my_live_slot;
+
+	live_query		= NULL;
+	live_real_procs	= NULL;
+	live_num_procs	= 0;
+	live_nodes		= NULL;
+	live_node_data	= NULL;
+	live_num_nodes	= 0;
+	my_live_slot	= NULL;
+
+	if (slot == NULL)
+		return;
+
+	reset_live_slot(slot, 0, InvalidOid, InvalidOid);
+}
+
+/*
+ * Assigns a slot to the backend with the given PID, or frees it with 0.  A
+ * pending request is refused, and a snapshot that its requester has not
+ * taken yet is released.
+ */
+static void
+reset_live_slot(volatile LiveSlot *slot, int pid, Oid userid, Oid dbid)
+{
+	PGPROC	   *requester = NULL;
+	bool		release = false;
+	dsm_handle	handle = 0;
+
+	SpinLockAcquire(&slot->mutex);
+	if (slot->requested)
+		requester = slot->requester;
+	if (slot->published)
+	{
+		handle	= slot->handle;
+		release	= true;
+	}
+	slot->pid		= pid;
+	slot->userid	= userid;
+	slot->dbid		= dbid;
+	slot->requested	= false;
+	slot->published	= false;
+	slot->requester	= NULL;
+	slot->handle	= 0;
+	SpinLockRelease(&slot->mutex);
+
+	if (release)
+		dsm_unpin_segment(handle);
+
+	if (requester)
+		SetLatch(&requester->procLatch);
+}
+
+static TupleTableSlot *
+live_exec_proc_node(PlanState *node)
+{
+	int					saved = live_current_node;
+	int					id = node->plan->plan_node_id;
+	TupleTableSlot	   *slot;
+
+	live_current_node = id;
+
+	if (my_live_slot->requested)
+		publish_live_snapshot();
+
+	slot = live_real_procs[id](node);
+	live_current_node = saved;
+
+	return slot;
+}
+
+/*
+ * Writes a snapshot of the live query into a new DSM segment and hands it
+ * to the requester.  The segment is pinned, so it outlives this backend's
+ * mapping until the requester unpins it.  This runs inside the user's
+ * query, so it must not fail: the nodes and the buffer for their counters
+ * were set up by live_ExecutorStart(), running out of memory while the
+ * plan is serialized only refuses the request, and so does running out of
+ * DSM segments.  Any other error is raised.  Interrupts are held off
+ * meanwhile, so that the handshake with the requester is not cut short.
+ */
+static void
+publish_live_snapshot(void)
+{
+	volatile LiveSlot  *slot = my_live_slot;
+	MemoryContext		tempcontext, oldcontext;
+	char			   *volatile plan_str = NULL;
+	const char		   *query_str;
+	LiveSnapshotHeader	header;
+	dsm_segment		   *seg = NULL;
+	dsm_handle			handle = 0;
+	bool				delivered = false;
+	PGPROC			   *requester = NULL;
+	char			   *p;
+	Size				size;
+	int					i;
+
+	/* Freed with the query if an error is raised */
+	tempcontext = AllocSetContextCreate(live_query->estate->es_query_cxt,
+										"pg_plan_tree_dot live snapshot",
+										ALLOCSET_DEFAULT_MINSIZE,
+										ALLOCSET_DEFAULT_INITSIZE,
+										ALLOCSET_DEFAULT_MAXSIZE);
+	oldcontext = MemoryContextSwitchTo(tempcontext);
+
+	HOLD_INTERRUPTS();
+
+	for (i = 0 ; i < live_num_nodes ; i++)
+	{
+		PlanState	   *ps = (PlanState *) live_nodes[i].planstate;
+		Instrumentation *instr = ps->instrument;
+
+		live_node_data[i].plan_node_id	= ps->plan->plan_node_id;
+		live_node_data[i].parent		= live_nodes[i].parent;
+		live_node_data[i].executing		= (ps->plan->plan_node_id == live_current_node);
+
+		/* The current loop is not added to the totals until it ends */
+		if (instr)
+		{
+			live_node_data[i].tuples	= instr->ntuples + instr->tuplecount;
+			live_node_data[i].loops		= instr->nloops + (instr->running ? 1 : 0);
+		}
+	}
+
+	/* A failed allocation leaves nothing behind but the context's memory */
+	PG_TRY();
+	{
+		plan_str = nodeToString(live_query->plannedstmt);
+	}
+	PG_CATCH();
+	{
+		ErrorData  *edata;
+
+		MemoryContextSwitchTo(oldcontext);
+		edata = CopyErrorData();
+
+		if (edata->sqlerrcode != ERRCODE_OUT_OF_MEMORY)
+			PG_RE_THROW();
+
+		FlushErrorState();
+		FreeErrorData(edata);
+		plan_str = NULL;
+	}
+	PG_END_TRY();
+
+	if (plan_str != NULL)
+	{
+		query_str = live_query->sourceText ? live_query->sourceText : "";
+
+		header.taken_at		= GetCurrentTimestamp();
+		header.num_nodes	= live_num_nodes;
+		header.query_len	= strlen(query_str);
+		header.plan_len		= strlen(plan_str);
+
+		size = MAXALIGN(sizeof(LiveSnapshotHeader)) + sizeof(LivePlanNode) * live_num_nodes +
+			header.query_len + 1 + header.plan_len + 1;
+
+		seg = dsm_create(size, DSM_CREATE_NULL_IF_MAXSEGMENTS);
+
+		if (seg != NULL)
+		{
+			p = (char *) dsm_segment_address(seg);
+			memcpy(p, &header, sizeof(LiveSnapshotHeader));
+			p += MAXALIGN(sizeof(LiveSnapshotHeader));
+			memcpy(p, live_node_data, sizeof(LivePlanNode) * live_num_nodes);
+			p += sizeof(LivePlanNode) * live_num_nodes;
+			memcpy(p, query_str, header.query_len + 1);
+			p += header.query_len + 1;
+			memcpy(p, plan_str, header.plan_len + 1);
+
+			handle = dsm_segment_handle(seg);
+			dsm_pin_segment(seg);
+		}
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextDelete(tempcontext);
+
+	/* Without a segment the request is refused */
+	SpinLockAcquire(&slot->mutex);
+	if (slot->requested)
+	{
+		if (seg != NULL)
+		{
+			slot->handle	= handle;
+			slot->published	= true;
+			delivered		= true;
+		}
+		slot->requested	= false;
+		requester		= slot->requester;
+	}
+	SpinLockRelease(&slot->mutex);
+
+	if (seg != NULL)
+	{
+		if (!delivered)
+			dsm_unpin_segment(handle);
+		dsm_detach(seg);
+	}
+
+	if (requester)
+		SetLatch(&requester->procLatch);
+
+	RESUME_INTERRUPTS();
+}
+
+/*
+ * Withdraws a request of this backend, releasing a snapshot that was
+ * published but not read.
+ */
+static void
+cancel_live_request(volatile LiveSlot *slot)
+{
+	bool		release = false;
+	dsm_handle	handle = 0;
+
+	SpinLockAcquire(&slot->mutex);
+	if (slot->requester == MyProc)
+	{
+		if (slot->published)
+		{
+			handle	= slot->handle;
+			release	= true;
+		}
+		slot->requested	= false;
+		slot->published	= false;
+		slot->requester	= NULL;
+		slot->handle	= 0;
+	}
+	SpinLockRelease(&slot->mutex);
+
+	if (release)
+		dsm_unpin_segment(handle);
+}
+
+/*
+ * Withdraws the request of this backend, if any, and releases the snapshot
+ * it has taken from the slot but not mapped yet.
+ */
+static void
+release_live_request(void)
+{
+	volatile LiveSlot *slot = live_request_slot;
+
+	live_request_slot = NULL;
+	if (slot != NULL)
+		cancel_live_request(slot);
+
+	if (live_request_holds_handle)
+	{
+		live_request_holds_handle = false;
+		dsm_unpin_segment(live_request_handle);
+	}
+}
+
+/*
+ * Covers a requester that exits while waiting, on FATAL or termination.
+ */
+static void
+live_request_shmem_exit(int code, Datum arg)
+{
+	release_live_request();
+}
+
+#endif
+
+/*
+ * Asks the backend with the given PID for a snapshot of its live query and
+ * waits up to timeout_ms for it.  The plan is read back into the current
+ * memory context.
+ */
+LivePlanSnapshot *
+get_live_plan_snapshot(int pid, int timeout_ms)
+{
+#if PG_VERSION_NUM >= 100000
+	volatile LiveSlot  *slot = NULL;
+	LivePlanSnapshot   *snapshot;
+	dsm_handle			handle = 0;
+	bool				published = false;
+	TimestampTz			start = GetCurrentTimestamp();
+	dsm_segment		   *seg;
+	LiveSnapshotHeader	header;
+	const char		   *p;
+	int					i;
+
+	if (live_slots == NULL)
+		elog(ERROR, "pg_plan_tree_dot must be loaded via shared_preload_libraries");
+
+	if (pid == MyProcPid)
+		elog(ERROR, "cannot take a live snapshot of the current backend");
+
+	for (i = 0 ; i < live_slots->num_slots ; i++)
+	{
+		volatile LiveSlot *s = &live_slots->slots[i];
+		Oid			userid = InvalidOid;
+		Oid			dbid = InvalidOid;
+		bool		busy = false;
+
+		SpinLockAcquire(&s->mutex);
+		if (s->pid == pid)
+		{
+			userid	= s->userid;
+			dbid	= s->dbid;
+			busy	= s->requested || s->published;
+		}
+		SpinLockRelease(&s->mutex);
+
+		if (!OidIsValid(userid))
+			continue;
+
+		if (!superuser() && !has_privs_of_role(GetUserId(), userid) &&
+			!is_member_of_role(GetUserId(), DEFAULT_ROLE_READ_ALL_STATS))
+			elog(ERROR, "permission denied to take a live snapshot of backend %d", pid);
+		if (dbid != MyDatabaseId)
+			elog(ERROR, "backend %d is connected to another database", pid);
+		if (busy)
+			elog(ERROR, "another live snapshot of backend %d is in progress", pid);
+
+		SpinLockAcquire(&s->mutex);
+		if (s->pid == pid && !s->requested && !s->published)
+		{
+			s->requested	= true;
+			s->requester	= MyProc;
+			slot = s;
+		}
+		SpinLockRelease(&s->mutex);
+		break;
+	}
+
+	if (slot == NULL)
+		elog(ERROR, "backend %d is not running a query with pg_plan_tree_dot.live_progress on", pid);
+
+	if (!live_request_exit_registered)
+	{
+		before_shmem_exit(live_request_shmem_exit, (Datum) 0);
+		live_request_exit_registered = true;
+	}
+
+	live_request_slot = slot;
+
+	PG_TRY();
+	{
+		for (;;)
+		{
+			bool	pending;
+			long	secs;
+			int		usecs;
+			long	remaining_ms;
+
+			SpinLockAcquire(&slot->mutex);
+			published	= slot->published;
+			pending		= slot->requested;
+			if (published)
+			{
+				handle				= slot->handle;
+				slot->published		= false;
+				slot->requester		= NULL;
+				slot->handle		= 0;
+			}
+			SpinLockRelease(&slot->mutex);
+
+			if (published)
+			{
+				/* The segment is ours to unpin from now on */
+				live_request_handle			= handle;
+				live_request_holds_handle	= true;
+				live_request_slot			= NULL;
+				break;
+			}
+			if (!pending)
+				elog(ERROR, "backend %d finished its query or failed to take a snapshot", pid);
+
+			TimestampDifference(start, GetCurrentTimestamp(), &secs, &usecs);
+			remaining_ms = timeout_ms - (secs * 1000L + usecs / 1000);
+			if (remaining_ms <= 0)
+				elog(ERROR, "backend %d did not take a snapshot within %d ms", pid, timeout_ms);
+
+			WaitLatch(MyLatch,
+					  WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+					  Min(remaining_ms, 100L),
+					  PG_WAIT_EXTENSION);
+			ResetLatch(MyLatch);
+
+			CHECK_FOR_INTERRUPTS();
+		}
+
+		seg = dsm_attach(handle);
+	}
+	PG_CATCH();
+	{
+		release_live_request();
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	live_request_holds_handle = false;
+	dsm_unpin_segment(handle);
+	if (seg == NULL)
+		elog(ERROR, "could not map the live snapshot of backend %d", pid);
+
+	p = (const char *) dsm_segment_address(seg);
+	memcpy(&header, p, sizeof(LiveSnapshotHeader));
+	p += MAXALIGN(sizeof(LiveSnapshotHeader));
+
+	snapshot = (LivePlanSnapshot *) palloc0(sizeof(LivePlanSnapshot));
+	snapshot->pid		= pid;
+	snapshot->taken_at	= header.taken_at;
+	snapshot->num_nodes	= header.num_nodes;
+	snapshot->nodes		= (LivePlanNode *) palloc(sizeof(LivePlanNode) * (header.num_nodes + 1));
+	memcpy(snapshot->nodes, p, sizeof(LivePlanNode) * header.num_nodes);
+	p += sizeof(LivePlanNode) * header.num_nodes;
+	snapshot->query = pnstrdup(p, header.query_len);
+	p += header.query_len + 1;
+	snapshot->stmt = (struct PlannedStmt *) stringToNode(pnstrdup(p, header.plan_len));
+
+	dsm_detach(seg);
+
+	return snapshot;
+#else
+	elog(ERROR, "live snapshots require PostgreSQL 10 or later");
+	return NULL;
+#endif
+}
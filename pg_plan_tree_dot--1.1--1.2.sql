@@ -0,0 +1,294 @@
+\echo Use "ALTER EXTENSION pg_plan_tree_dot UPDATE TO '1.2'" to load this file. \quit
+
+DROP FUNCTION public.generate_plan_tree_dot(text, text, bool);
+
+CREATE FUNCTION public.generate_plan_tree_dot(
+       IN sql      text,
+       IN filename text,
+       IN simplify bool DEFAULT false,
+       IN raw_oids bool DEFAULT false)
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+CREATE FUNCTION public.plan_tree_dot_prepared(
+       IN stmt_name text,
+       IN filename  text,
+       IN params    text[] DEFAULT NULL,
+       IN simplify  bool DEFAULT false,
+       IN raw_oids  bool DEFAULT false)
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE;
+
+CREATE FUNCTION public.generate_plan_tree_dot(
+       IN sql          text,
+       IN filename     text,
+       IN param_types  regtype[],
+       IN param_values text[] DEFAULT NULL,
+       IN simplify     bool DEFAULT false,
+       IN raw_oids     bool DEFAULT false)
+RETURNS void
+AS 'MODULE_PATHNAME', 'generate_plan_tree_dot_with_params'
+LANGUAGE C VOLATILE;
+
+CREATE FUNCTION public.generate_plan_state_tree_dot(
+       IN sql        text,
+       IN filename   text,
+       IN do_analyze bool DEFAULT false,
+       IN simplify   bool DEFAULT false,
+       IN raw_oids   bool DEFAULT false)
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+CREATE FUNCTION public.plan_tree_misestimates(
+       IN  sql          text,
+       OUT node_id      int,
+       OUT node_type    text,
+       OUT relation     text,
+       OUT plan_rows    float8,
+       OUT actual_rows  float8,
+       OUT loops        float8,
+       OUT q_error      float8,
+       OUT exclusive_ms float8,
+       OUT time_share   float8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+CREATE FUNCTION public.plan_tree_sweep(
+       IN  sql        text,
+       IN  guc        text,
+       IN  from_value float8,
+       IN  to_value   float8,
+       IN  steps      int,
+       IN  filename   text DEFAULT NULL,
+       OUT plan_no    int,
+       OUT range_from float8,
+       OUT range_to   float8,
+       OUT fingerprint text,
+       OUT cost_from  float8,
+       OUT cost_to    float8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE;
+
+CREATE FUNCTION public.plan_tree_alternatives(
+       IN  sql            text,
+       IN  switches       text[] DEFAULT NULL,
+       IN  do_execute     bool DEFAULT false,
+       IN  timeout_ms     int DEFAULT 0,
+       IN  filename       text DEFAULT NULL,
+       OUT rank           int,
+       OUT plan_no        int,
+       OUT disabled       text[],
+       OUT estimated_cost float8,
+       OUT actual_ms      float8,
+       OUT timed_out      bool,
+       OUT cost_ratio     float8,
+       OUT time_ratio     float8,
+       OUT fingerprint    text)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE;
+
+CREATE FUNCTION public.plan_tree_dot_whatif(
+       IN sql        text,
+       IN index_defs text[],
+       IN filename   text,
+       IN simplify   bool DEFAULT false,
+       IN raw_oids   bool DEFAULT false)
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+CREATE FUNCTION public.plan_tree_dot_benchmark(
+       IN  sql           text,
+       IN  iterations    int DEFAULT 1,
+       IN  filename      text DEFAULT '/dev/null',
+       OUT phase         text,
+       OUT avg_ms        float8,
+       OUT nodes         int,
+       OUT nodes_per_sec float8,
+       OUT bytes         int8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+CREATE FUNCTION public.plan_tree_dot_last_stats(
+       OUT calls      int8,
+       OUT graphs     int8,
+       OUT nodes      int8,
+       OUT edges      int8,
+       OUT parse_ms   float8,
+       OUT plan_ms    float8,
+       OUT walk_ms    float8,
+       OUT label_ms   float8,
+       OUT write_ms   float8,
+       OUT peak_bytes int8)
+RETURNS record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE;
+
+CREATE FUNCTION public.pg_plan_tree_dot_stats(
+       OUT calls      int8,
+       OUT graphs     int8,
+       OUT nodes      int8,
+       OUT edges      int8,
+       OUT parse_ms   float8,
+       OUT plan_ms    float8,
+       OUT walk_ms    float8,
+       OUT label_ms   float8,
+       OUT write_ms   float8,
+       OUT peak_bytes int8)
+RETURNS record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE;
+
+CREATE VIEW public.pg_plan_tree_dot_stats AS
+       SELECT * FROM public.pg_plan_tree_dot_stats();
+
+CREATE FUNCTION public.pg_plan_tree_dot_stats_reset()
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE;
+
+CREATE FUNCTION public.plan_tree_open(
+       IN sql      text,
+       IN simplify bool DEFAULT false,
+       IN raw_oids bool DEFAULT false)
+RETURNS int
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+CREATE FUNCTION public.plan_tree_node(
+       IN handle int,
+       IN node   int)
+RETURNS text
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+CREATE FUNCTION public.plan_tree_children(
+       IN  handle int,
+       IN  node   int,
+       OUT field  text,
+       OUT child  int)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+CREATE FUNCTION public.plan_tree_close(
+       IN handle int)
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+CREATE FUNCTION public.generate_plan_tree_html(
+       IN sql      text,
+       IN filename text,
+       IN simplify bool DEFAULT false,
+       IN raw_oids bool DEFAULT false)
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+CREATE FUNCTION public.pg_plan_tree_dot_history(
+       OUT queryid     int8,
+       OUT fingerprint text,
+       OUT first_seen  timestamptz,
+       OUT last_seen   timestamptz,
+       OUT calls       int8,
+       OUT total_ms    float8,
+       OUT mean_ms     float8,
+       OUT rows        int8,
+       OUT graph       text)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE;
+
+CREATE VIEW public.pg_plan_tree_dot_history AS
+       SELECT * FROM public.pg_plan_tree_dot_history();
+
+CREATE FUNCTION public.pg_plan_tree_dot_history_reset()
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE;
+
+CREATE FUNCTION public.plan_tree_calibration_sample(
+       IN sql        text,
+       IN iterations int DEFAULT 1)
+RETURNS int
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+CREATE FUNCTION public.plan_tree_calibrate(
+       OUT node_type         text,
+       OUT samples           int8,
+       OUT seq_page_cost     float8,
+       OUT random_page_cost  float8,
+       OUT cpu_tuple_cost    float8,
+       OUT cpu_operator_cost float8,
+       OUT ms_per_cost_unit  float8,
+       OUT r_squared         float8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE;
+
+CREATE FUNCTION public.plan_tree_calibration_reset()
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE;
+
+CREATE FUNCTION public.plan_tree_statistics_advice(
+       IN  sql                 text,
+       IN  min_q_error         float8 DEFAULT 10.0,
+       OUT relation            text,
+       OUT columns             text[],
+       OUT nodes               int,
+       OUT node_id             int,
+       OUT node_type           text,
+       OUT plan_rows           float8,
+       OUT actual_rows         float8,
+       OUT q_error             float8,
+       OUT impact              float8,
+       OUT existing_statistics text,
+       OUT statement           text)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+CREATE FUNCTION public.plan_tree_profile(
+       IN  sql        text,
+       IN  iterations int DEFAULT 1,
+       IN  filename   text DEFAULT NULL,
+       IN  simplify   bool DEFAULT false,
+       IN  raw_oids   bool DEFAULT false,
+       OUT node_id    int,
+       OUT node_type  text,
+       OUT relation   text,
+       OUT samples    int8,
+       OUT share      float8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE;
+
+CREATE FUNCTION public.plan_tree_dot_live(
+       IN pid        int,
+       IN filename   text,
+       IN simplify   bool DEFAULT false,
+       IN raw_oids   bool DEFAULT false,
+       IN timeout_ms int DEFAULT 5000)
+RETURNS void
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE STRICT;
+
+CREATE FUNCTION public.plan_tree_folded(
+       IN  sql       text,
+       IN  weight_by text DEFAULT 'time',
+       IN  filename  text DEFAULT NULL,
+       OUT stack     text,
+       OUT weight    int8)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C VOLATILE;
@@ -8,31 +8,222 @@
  */
 #include "postgres.h"
 
+#include <math.h>
+#include <signal.h>
 #include <stdio.h>
 
+#if PG_VERSION_NUM >= 120000
+#include "access/relation.h"
+#elif PG_VERSION_NUM >= 100000
+#include "access/heapam.h"
+#endif
+#include "access/xact.h"
+#if PG_VERSION_NUM >= 100000
+#include "catalog/pg_statistic_ext.h"
+#endif
+#include "catalog/pg_type.h"
+#include "commands/defrem.h"
+#include "commands/prepare.h"
 #include "executor/execdesc.h"
 #include "executor/executor.h"
+#include "executor/instrument.h"
 #include "fmgr.h"
+#include "funcapi.h"
+#include "lib/stringinfo.h"
 #include "miscadmin.h"
+#include "nodes/bitmapset.h"
+#include "nodes/nodeFuncs.h"
 #include "nodes/nodes.h"
+#include "nodes/params.h"
 #include "nodes/pg_list.h"
 #include "nodes/plannodes.h"
 #include "optimizer/planner.h"
+#include "parser/parsetree.h"
+#include "storage/latch.h"
+#include "storage/proc.h"
 #include "tcop/dest.h"
 #include "tcop/tcopprot.h"
+#include "utils/array.h"
 #include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/lsyscache.h"
 #include "utils/memutils.h"
+#if PG_VERSION_NUM >= 90200
+#include "utils/plancache.h"
+#endif
+#include "utils/rel.h"
 #include "utils/snapmgr.h"
+#include "utils/syscache.h"
+#if PG_VERSION_NUM >= 90300
+#include "utils/timeout.h"
+#endif
+#include "utils/tuplestore.h"
 
 #include "pg_plan_tree_dot.h"
 
 
 PG_MODULE_MAGIC;
 
+/* Upper bound on the steps of plan_tree_sweep() */
+#define PLAN_SWEEP_MAX_STEPS	10000
+
+/* Upper bound on the switches plan_tree_alternatives() combines */
+#define PLAN_ALTERNATIVES_MAX_SWITCHES	10
+
+/* Switches plan_tree_alternatives() combines by default */
+static const char *const default_plan_switches[] = {
+	"enable_nestloop",
+	"enable_hashjoin",
+	"enable_mergejoin",
+	"enable_seqscan",
+	"enable_indexscan",
+	"enable_bitmapscan",
+};
+
+#if PG_VERSION_NUM >= 90300
+static TimeoutId alternative_timeout_id = MAX_TIMEOUTS;
+#endif
+static volatile sig_atomic_t alternative_timed_out = false;
+
+/* plan_tree_alternatives() draws its graphs with the default options */
+static const PlanTreeDotOptions alternative_options = {false, false};
+
+typedef struct AlternativePlan AlternativePlan;
+
+#if PG_VERSION_NUM >= 100000
+/* A CREATE STATISTICS suggestion of plan_tree_statistics_advice() */
+typedef struct StatisticsAdvice
+{
+	Oid			relid;
+	Bitmapset  *columns;		/* attribute numbers */
+	int			num_nodes;		/* misestimated nodes that qualify them */
+	int			node_id;		/* the worst of them */
+	const char *node_type;
+	double		plan_rows;
+	double		actual_rows;
+	double		q_error;
+	double		impact;			/* summed over the nodes */
+} StatisticsAdvice;
+
+/* State of collect_qual_columns_walker() */
+typedef struct QualColumnsContext
+{
+	Plan	   *plan;			/* the node whose quals are walked */
+	Bitmapset **columns;		/* attribute numbers per range table index */
+	int			num_rels;
+} QualColumnsContext;
+#endif
+
+/* Weights of plan_tree_folded() */
+typedef enum FoldedWeight
+{
+	FOLDED_WEIGHT_TIME,			/* exclusive time in microseconds */
+	FOLDED_WEIGHT_COST,			/* exclusive estimated cost */
+	FOLDED_WEIGHT_SAMPLES		/* profile samples */
+} FoldedWeight;
+
+/* A plan kept by plan_tree_open() until plan_tree_close() */
+typedef struct PlanTreeHandle
+{
+	int				id;
+	MemoryContext	context;	/* holds the plan and its index */
+	PlannedStmt	   *stmt;
+	PlanTreeIndex  *index;
+} PlanTreeHandle;
+
+/* Open PlanTreeHandles, in TopMemoryContext */
+static List *plan_tree_handles = NIL;
+static int	next_plan_tree_handle = 1;
+
+/* Fill colors for the cost change of a node against the baseline plan */
+#define WHATIF_MUCH_CHEAPER_COLOR	"palegreen"
+#define WHATIF_CHEAPER_COLOR		"honeydew"
+#define WHATIF_COSTLIER_COLOR		"mistyrose"
+#define WHATIF_MUCH_COSTLIER_COLOR	"lightpink"
+#define WHATIF_UNMATCHED_COLOR		"lightcyan"
+
+/* Fill colors for the share of profile samples taken in a node */
+#define PROFILE_HOTTEST_COLOR		"orangered"
+#define PROFILE_HOT_COLOR			"orange"
+#define PROFILE_WARM_COLOR			"gold"
+#define PROFILE_SAMPLED_COLOR		"lightyellow"
+
+/* Fill colors for the nodes running at a live snapshot */
+#define LIVE_EXECUTING_COLOR		"tomato"
+#define LIVE_ACTIVE_COLOR			"lightsalmon"
+
 extern void _PG_init(void);
 
-static void output_sql_query(const char *sql, const char *filename, bool simplify);
-static void output_plan_tree(const char *title, const char *sql, const void *obj, FILE *file,  bool simplify);
+static void output_sql_query(const char *sql, const char *filename, Oid *param_types, int num_params, ParamListInfo params, const PlanTreeDotOptions *options);
+static void output_plan_state_query(const char *sql, const char *filename, bool analyze, const PlanTreeDotOptions *options);
+#if PG_VERSION_NUM >= 90200
+static void output_prepared_statement(const char *stmt_name, const char *filename, ArrayType *values, const PlanTreeDotOptions *options);
+static CachedPlan *get_forced_cached_plan(CachedPlanSource *plansource, ParamListInfo params, int cursor_option);
+#endif
+static void collect_misestimates(const char *sql, Tuplestorestate *tupstore, TupleDesc tupdesc);
+static int compare_misestimate_rows(const void *a, const void *b);
+static int collect_calibration_samples(const char *sql);
+static void collect_folded_stacks(const char *sql, FoldedWeight weight, const char *filename, Tuplestorestate *tupstore, TupleDesc tupdesc);
+static char *folded_frame_name(PlannedStmt *stmt, Plan *plan, const char *node_type);
+#if PG_VERSION_NUM >= 100000
+static void profile_plan_tree(const char *sql, int iterations, const char *filename, const PlanTreeDotOptions *options, Tuplestorestate *tupstore, TupleDesc tupdesc);
+#endif
+#if PG_VERSION_NUM >= 100000
+static void collect_statistics_advice(const char *sql, double min_q_error, Tuplestorestate *tupstore, TupleDesc tupdesc);
+static void collect_qual_columns(Plan *plan, Bitmapset **columns, int num_rels);
+static bool collect_qual_columns_walker(Node *node, QualColumnsContext *context);
+static Var *resolve_plan_var(Plan *plan, Var *var);
+static char *find_covering_statistics(Oid relid, Bitmapset *columns);
+static int compare_statistics_advice(const void *a, const void *b);
+#endif
+static void sweep_plans(const char *sql, const char *guc, double from_value, double to_value, int steps, const char *filename, Tuplestorestate *tupstore, TupleDesc tupdesc);
+static void format_guc_value(double value, char *buf, size_t len);
+static PlannedStmt *plan_query_with_settings(Query *query, int num_settings, const char **names, const char **values);
+static Query *first_optimizable_query(List *query_list);
+static void explore_alternatives(const char *sql, const char **switches, int num_switches, bool execute, int timeout_ms, const char *filename, Tuplestorestate *tupstore, TupleDesc tupdesc);
+static int compare_alternative_plans(const void *a, const void *b);
+static void run_alternative_plan(AlternativePlan *alt, const char *sql, int timeout_ms, bool render);
+#if PG_VERSION_NUM >= 90300
+static void alternative_timeout_handler(void);
+#endif
+static void benchmark_plan_tree(const char *sql, int iterations, const char *filename, Tuplestorestate *tupstore, TupleDesc tupdesc);
+static void output_whatif_query(const char *sql, char **index_defs, int num_defs, const char *filename, const PlanTreeDotOptions *options);
+static PlanTreeDotNodeMark *mark_cost_deltas(PlannedStmt *baseline, PlannedStmt *whatif, int *num_marks);
+static List *collect_cost_nodes(PlannedStmt *stmt);
+static Bitmapset *collect_cost_nodes_walker(Plan *plan, List **nodes);
+static Index plan_scanrelid(Plan *plan);
+static void output_live_plan(int pid, int timeout_ms, const char *filename, const PlanTreeDotOptions *options);
+static void collect_plans_by_id(Plan *plan, Plan **plans, int num_slots);
+static PlanTreeHandle *open_plan_tree_handle(const char *sql, const PlanTreeDotOptions *options);
+static PlanTreeHandle *find_plan_tree_handle(int id);
+static Tuplestorestate *begin_materialized_srf(FunctionCallInfo fcinfo, TupleDesc *tupdesc);
+static List *analyze_query_string(const char *sql, Oid *param_types, int num_params);
+static List *plan_query_string(const char *sql, Oid *param_types, int num_params, ParamListInfo params);
+static QueryDesc *begin_query(PlannedStmt *stmt, const char *sql, int instrument_options, int eflags);
+static void run_query(QueryDesc *qdesc);
+static QueryDesc *start_query(PlannedStmt *stmt, const char *sql, int instrument_options, bool run);
+static void end_query(QueryDesc *qdesc, bool run);
+static char *plan_relation_name(PlannedStmt *stmt, Plan *plan);
+static ParamListInfo make_param_list(int num_params, const Oid *param_types, ArrayType *values);
+static double plan_list_cost(List *stmt_list);
+static void output_plan_list(const char *title, const char *sql, List *stmt_list, FILE *file, const PlanTreeDotOptions *options);
+static double elapsed_ms(instr_time starttime);
+static void output_plan_tree(const char *title, const char *sql, const void *obj, FILE *file, const PlanTreeDotOptions *options);
+static char *render_plan_tree(const char *title, const char *sql, const void *obj, const PlanTreeDotOptions *options);
+
+/*
+ * Module load callback
+ */
+void
+_PG_init(void)
+{
+	init_render_stats();
+	init_render_cache();
+	init_plan_capture();
+	init_plan_history();
+	init_plan_profiler();
+	init_live_progress();
+}
 
 /*
  *
@@ -43,12 +234,18 @@ generate_plan_tree_dot(PG_FUNCTION_ARGS)
 {
 	text *sql, *filename;
 	char *sql_str, *filename_str;
-	bool  simplify;
+	PlanTreeDotOptions options;
 	MemoryContext tempcontext, oldcontext;
 
+	memset(&options, 0, sizeof(options));
+
 	sql			= PG_GETARG_TEXT_P(0);
 	filename	= PG_GETARG_TEXT_P(1);
-	simplify	= PG_GETARG_BOOL(2);
+	options.simplify = PG_GETARG_BOOL(2);
+
+	/* raw_oids was added in 1.2; the 1.1 SQL definition has no such argument */
+	if (PG_NARGS() > 3)
+		options.raw_oids = PG_GETARG_BOOL(3);
 
 	tempcontext = AllocSetContextCreate(CurrentMemoryContext,
 										"print_plan_tree temporary context",
@@ -58,14 +255,18 @@ generate_plan_tree_dot(PG_FUNCTION_ARGS)
 
 	oldcontext = MemoryContextSwitchTo(tempcontext);
 
+	render_stats_begin(tempcontext);
+
 	sql_str			= TextDatumGetCString(sql);
 	filename_str	= TextDatumGetCString(filename);
 
-	output_sql_query(sql_str, filename_str, simplify);
+	output_sql_query(sql_str, filename_str, NULL, 0, NULL, &options);
 
 	pfree(filename_str);
 	pfree(sql_str);
 
+	render_stats_end();
+
 	MemoryContextSwitchTo(oldcontext);
 	MemoryContextDelete(tempcontext);
 
@@ -73,112 +274,3609 @@ generate_plan_tree_dot(PG_FUNCTION_ARGS)
 }
 
 /*
+ * generate_plan_tree_html(sql, filename, simplify, raw_oids)
  *
+ * Like generate_plan_tree_dot(), but writes a self-contained HTML page in
+ * which the target lists and expression trees are expanded on demand.
  */
-static void
-output_sql_query(const char *sql, const char *filename, bool simplify)
+PG_FUNCTION_INFO_V1(generate_plan_tree_html);
+Datum
+generate_plan_tree_html(PG_FUNCTION_ARGS)
 {
-	List		   *raw_parsetree_list;
-	DestReceiver   *dest;
-	ListCell	   *lc1;
-	FILE		   *file;
+	char *sql_str, *filename_str;
+	PlanTreeDotOptions options;
+	MemoryContext tempcontext, oldcontext;
 
-	file = fopen(filename, "w");
-	if (file == NULL)
-		elog(ERROR, "cannot create \"%s\"", filename);
+	memset(&options, 0, sizeof(options));
 
-	raw_parsetree_list = pg_parse_query(sql);
+	options.simplify	= PG_GETARG_BOOL(2);
+	options.raw_oids	= PG_GETARG_BOOL(3);
+	options.format		= PLAN_TREE_FORMAT_HTML;
 
-	dest = CreateDestReceiver(DestNone);
+	tempcontext = AllocSetContextCreate(CurrentMemoryContext,
+										"print_plan_tree temporary context",
+										ALLOCSET_DEFAULT_MINSIZE,
+										ALLOCSET_DEFAULT_INITSIZE,
+										ALLOCSET_DEFAULT_MAXSIZE);
 
-	foreach(lc1, raw_parsetree_list)
-	{
-#if PG_VERSION_NUM >= 100000
-		RawStmt	   *parsetree = lfirst_node(RawStmt, lc1);
-#else
-		Node	   *parsetree = (Node *) lfirst(lc1);
-#endif
-		List	   *stmt_list;
-		ListCell   *lc2;
+	oldcontext = MemoryContextSwitchTo(tempcontext);
 
-#if PG_VERSION_NUM >= 100000
-		stmt_list = pg_analyze_and_rewrite(parsetree, sql, NULL, 0, NULL);
-#else
-		stmt_list = pg_analyze_and_rewrite(parsetree, sql, NULL, 0);
-#endif
-		stmt_list = pg_plan_queries(stmt_list, 0, NULL);
+	render_stats_begin(tempcontext);
 
-		foreach(lc2, stmt_list)
-		{
-			Node	   *stmt = (Node *) lfirst(lc2);
+	sql_str			= TextDatumGetCString(PG_GETARG_DATUM(0));
+	filename_str	= TextDatumGetCString(PG_GETARG_DATUM(1));
 
-			if (IsA(stmt, PlannedStmt) &&
-				((PlannedStmt *) stmt)->utilityStmt == NULL)
-			{
-				QueryDesc  *qdesc;
+	output_sql_query(sql_str, filename_str, NULL, 0, NULL, &options);
 
-				qdesc = CreateQueryDesc((PlannedStmt *) stmt,
-										sql,
-										GetActiveSnapshot(), NULL,
-										dest, NULL,
-#if PG_VERSION_NUM >= 100000
-										NULL,
-#endif
-										0);
+	pfree(filename_str);
+	pfree(sql_str);
 
-				output_plan_tree("Plan Tree", sql, qdesc->plannedstmt, file, simplify);
+	render_stats_end();
 
-				FreeQueryDesc(qdesc);
-			}
-		}
-	}
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextDelete(tempcontext);
 
-	fclose(file);
+	PG_RETURN_VOID();
 }
 
 /*
+ * generate_plan_tree_dot(sql, filename, param_types, param_values, simplify, raw_oids)
  *
+ * Variant for queries with $n parameters, such as the normalized texts in
+ * pg_stat_statements.  Without param_values the generic plan is rendered.
  */
-static void
-output_plan_tree(const char *title, const char *sql, const void *obj, FILE *file, bool simplify)
+PG_FUNCTION_INFO_V1(generate_plan_tree_dot_with_params);
+Datum
+generate_plan_tree_dot_with_params(PG_FUNCTION_ARGS)
 {
-	char *p, *buffer, *result;
+	char *sql_str, *filename_str;
+	ArrayType *types;
+	Datum *type_datums;
+	bool *type_nulls;
+	Oid *param_types;
+	int num_params;
+	ParamListInfo params = NULL;
+	PlanTreeDotOptions options;
+	MemoryContext tempcontext, oldcontext;
+	int i;
 
-	/* buffer = (char *) palloc(strlen(title) + strlen(debug_query_string) + 3); */
-	buffer = (char *) palloc(strlen(title) + strlen(sql) + 3);
+	if (PG_ARGISNULL(0) || PG_ARGISNULL(1) || PG_ARGISNULL(2))
+		elog(ERROR, "query, file name and parameter types must not be NULL");
 
-	sprintf(buffer, "%s: %s", title, sql);
-	
-	for (p = buffer; *p ; p++)
+	memset(&options, 0, sizeof(options));
+
+	types = PG_GETARG_ARRAYTYPE_P(2);
+	options.simplify = !PG_ARGISNULL(4) && PG_GETARG_BOOL(4);
+	options.raw_oids = !PG_ARGISNULL(5) && PG_GETARG_BOOL(5);
+
+	tempcontext = AllocSetContextCreate(CurrentMemoryContext,
+										"print_plan_tree temporary context",
+										ALLOCSET_DEFAULT_MINSIZE,
+										ALLOCSET_DEFAULT_INITSIZE,
+										ALLOCSET_DEFAULT_MAXSIZE);
+
+	oldcontext = MemoryContextSwitchTo(tempcontext);
+
+	render_stats_begin(tempcontext);
+
+	sql_str			= TextDatumGetCString(PG_GETARG_DATUM(0));
+	filename_str	= TextDatumGetCString(PG_GETARG_DATUM(1));
+
+	if (ARR_NDIM(types) > 1)
+		elog(ERROR, "parameter types must be a one-dimensional array");
+
+	deconstruct_array(types, REGTYPEOID, sizeof(Oid), true, 'i',
+					  &type_datums, &type_nulls, &num_params);
+
+	param_types = (Oid *) palloc((num_params + 1) * sizeof(Oid));
+	for (i = 0 ; i < num_params ; i++)
 	{
-		switch (*p)
-		{
-			case '\t':
-				*p = ' ';
-				break;
-			case '\n':
-				*p = ' ';
-				break;
-			case '"':
-				*p = '\'';
-				break;
-			default:
-				break;
-		}
+		if (type_nulls[i])
+			elog(ERROR, "parameter types must not contain NULL");
+		param_types[i] = DatumGetObjectId(type_datums[i]);
 	}
 
-	result = get_plan_tree_dot_string(buffer, obj, simplify);
+	if (!PG_ARGISNULL(3))
+		params = make_param_list(num_params, param_types, PG_GETARG_ARRAYTYPE_P(3));
 
-	if (result)
+	output_sql_query(sql_str, filename_str, param_types, num_params, params, &options);
+
+	pfree(filename_str);
+	pfree(sql_str);
+
+	render_stats_end();
+
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextDelete(tempcontext);
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * generate_plan_state_tree_dot(sql, filename, do_analyze, simplify, raw_oids)
+ *
+ * Renders the PlanState tree the executor builds for the query.  With
+ * do_analyze the query is also run, so the graph shows the instrumentation and
+ * the hash tables, sorts and tuplestores the nodes actually used.
+ */
+PG_FUNCTION_INFO_V1(generate_plan_state_tree_dot);
+Datum
+generate_plan_state_tree_dot(PG_FUNCTION_ARGS)
+{
+	char *sql_str, *filename_str;
+	bool analyze;
+	PlanTreeDotOptions options;
+	MemoryContext tempcontext, oldcontext;
+
+	memset(&options, 0, sizeof(options));
+
+	analyze = PG_GETARG_BOOL(2);
+	options.simplify = PG_GETARG_BOOL(3);
+	options.raw_oids = PG_GETARG_BOOL(4);
+
+	tempcontext = AllocSetContextCreate(CurrentMemoryContext,
+										"print_plan_tree temporary context",
+										ALLOCSET_DEFAULT_MINSIZE,
+										ALLOCSET_DEFAULT_INITSIZE,
+										ALLOCSET_DEFAULT_MAXSIZE);
+
+	oldcontext = MemoryContextSwitchTo(tempcontext);
+
+	render_stats_begin(tempcontext);
+
+	sql_str			= TextDatumGetCString(PG_GETARG_DATUM(0));
+	filename_str	= TextDatumGetCString(PG_GETARG_DATUM(1));
+
+	output_plan_state_query(sql_str, filename_str, analyze, &options);
+
+	pfree(filename_str);
+	pfree(sql_str);
+
+	render_stats_end();
+
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextDelete(tempcontext);
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * plan_tree_misestimates(sql)
+ *
+ * Runs the query with instrumentation and returns, for every plan node, the
+ * estimated and actual rows, the q-error and its exclusive time.
+ */
+PG_FUNCTION_INFO_V1(plan_tree_misestimates);
+Datum
+plan_tree_misestimates(PG_FUNCTION_ARGS)
+{
+	TupleDesc tupdesc;
+	Tuplestorestate *tupstore;
+	char *sql_str;
+	MemoryContext tempcontext, oldcontext;
+
+	tupstore = begin_materialized_srf(fcinfo, &tupdesc);
+
+	tempcontext = AllocSetContextCreate(CurrentMemoryContext,
+										"print_plan_tree temporary context",
+										ALLOCSET_DEFAULT_MINSIZE,
+										ALLOCSET_DEFAULT_INITSIZE,
+										ALLOCSET_DEFAULT_MAXSIZE);
+
+	oldcontext = MemoryContextSwitchTo(tempcontext);
+
+	sql_str = TextDatumGetCString(PG_GETARG_DATUM(0));
+
+	collect_misestimates(sql_str, tupstore, tupdesc);
+
+	pfree(sql_str);
+
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextDelete(tempcontext);
+
+	return (Datum) 0;
+}
+
+/*
+ * plan_tree_calibration_sample(sql, iterations)
+ *
+ * Runs the query iterations times with instrumentation and adds one
+ * calibration sample per executed plan node for plan_tree_calibrate().
+ * Returns the number of samples added.
+ */
+PG_FUNCTION_INFO_V1(plan_tree_calibration_sample);
+Datum
+plan_tree_calibration_sample(PG_FUNCTION_ARGS)
+{
+	char *sql_str;
+	int iterations;
+	int i, count = 0;
+	MemoryContext tempcontext, oldcontext;
+
+	iterations = PG_GETARG_INT32(1);
+	if (iterations < 1)
+		elog(ERROR, "iterations must be at least 1");
+
+	tempcontext = AllocSetContextCreate(CurrentMemoryContext,
+										"print_plan_tree temporary context",
+										ALLOCSET_DEFAULT_MINSIZE,
+										ALLOCSET_DEFAULT_INITSIZE,
+										ALLOCSET_DEFAULT_MAXSIZE);
+
+	oldcontext = MemoryContextSwitchTo(tempcontext);
+
+	sql_str = TextDatumGetCString(PG_GETARG_DATUM(0));
+
+	for (i = 0 ; i < iterations ; i++)
 	{
-		fputs(result, file);
-		fputs("\n", file);
-		fflush(file);
+		CHECK_FOR_INTERRUPTS();
+		count += collect_calibration_samples(sql_str);
 	}
 
-	if (result)
-		pfree(result);
+	pfree(sql_str);
+
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextDelete(tempcontext);
+
+	PG_RETURN_INT32(count);
+}
+
+/*
+ * plan_tree_profile(sql, iterations, filename, simplify, raw_oids)
+ *
+ * Runs the query iterations times under the sampling profiler and returns
+ * the CPU time samples taken in each plan node.  If filename is given, the
+ * plan is written to it as a heat map of the samples.
+ */
+PG_FUNCTION_INFO_V1(plan_tree_profile);
+Datum
+plan_tree_profile(PG_FUNCTION_ARGS)
+{
+#if PG_VERSION_NUM >= 100000
+	TupleDesc tupdesc;
+	Tuplestorestate *tupstore;
+	char *sql_str, *filename_str = NULL;
+	int iterations;
+	PlanTreeDotOptions options;
+	MemoryContext tempcontext, oldcontext;
+
+	if (PG_ARGISNULL(0))
+		elog(ERROR, "query must not be NULL");
+
+	iterations = PG_ARGISNULL(1) ? 1 : PG_GETARG_INT32(1);
+	if (iterations < 1)
+		elog(ERROR, "iterations must be positive");
+
+	memset(&options, 0, sizeof(options));
+	options.simplify = !PG_ARGISNULL(3) && PG_GETARG_BOOL(3);
+	options.raw_oids = !PG_ARGISNULL(4) && PG_GETARG_BOOL(4);
+
+	tupstore = begin_materialized_srf(fcinfo, &tupdesc);
+
+	tempcontext = AllocSetContextCreate(CurrentMemoryContext,
+										"print_plan_tree temporary context",
+										ALLOCSET_DEFAULT_MINSIZE,
+										ALLOCSET_DEFAULT_INITSIZE,
+										ALLOCSET_DEFAULT_MAXSIZE);
+
+	oldcontext = MemoryContextSwitchTo(tempcontext);
+
+	render_stats_begin(tempcontext);
+
+	sql_str = TextDatumGetCString(PG_GETARG_DATUM(0));
+	if (!PG_ARGISNULL(2))
+		filename_str = TextDatumGetCString(PG_GETARG_DATUM(2));
+
+	profile_plan_tree(sql_str, iterations, filename_str, &options, tupstore, tupdesc);
+
+	render_stats_end();
+
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextDelete(tempcontext);
+#else
+	elog(ERROR, "plan_tree_profile requires PostgreSQL 10 or later");
+#endif
+
+	return (Datum) 0;
+}
+
+/*
+ * plan_tree_statistics_advice(sql, min_q_error)
+ *
+ * Runs the query with instrumentation and suggests extended statistics for
+ * the column groups that the quals of misestimated nodes combine.
+ */
+PG_FUNCTION_INFO_V1(plan_tree_statistics_advice);
+Datum
+plan_tree_statistics_advice(PG_FUNCTION_ARGS)
+{
+#if PG_VERSION_NUM >= 100000
+	TupleDesc tupdesc;
+	Tuplestorestate *tupstore;
+	char *sql_str;
+	double min_q_error;
+	MemoryContext tempcontext, oldcontext;
+
+	min_q_error = PG_GETARG_FLOAT8(1);
+	if (min_q_error < 1.0)
+		elog(ERROR, "min_q_error must be at least 1");
+
+	tupstore = begin_materialized_srf(fcinfo, &tupdesc);
+
+	tempcontext = AllocSetContextCreate(CurrentMemoryContext,
+										"print_plan_tree temporary context",
+										ALLOCSET_DEFAULT_MINSIZE,
+										ALLOCSET_DEFAULT_INITSIZE,
+										ALLOCSET_DEFAULT_MAXSIZE);
+
+	oldcontext = MemoryContextSwitchTo(tempcontext);
+
+	sql_str = TextDatumGetCString(PG_GETARG_DATUM(0));
+
+	collect_statistics_advice(sql_str, min_q_error, tupstore, tupdesc);
+
+	pfree(sql_str);
+
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextDelete(tempcontext);
+#else
+	elog(ERROR, "plan_tree_statistics_advice requires PostgreSQL 10 or later");
+#endif
+
+	return (Datum) 0;
+}
+
+/*
+ * plan_tree_folded(sql, weight_by, filename)
+ *
+ * Returns one folded stack per plan node, the path from the root to the
+ * node, weighted by the node's exclusive time, estimated cost or profile
+ * samples.  If filename is given, the stacks are also written to it in
+ * the format flame graph tools read.
+ */
+PG_FUNCTION_INFO_V1(plan_tree_folded);
+Datum
+plan_tree_folded(PG_FUNCTION_ARGS)
+{
+	TupleDesc tupdesc;
+	Tuplestorestate *tupstore;
+	char *sql_str, *weight_str, *filename_str = NULL;
+	FoldedWeight weight;
+	MemoryContext tempcontext, oldcontext;
+
+	if (PG_ARGISNULL(0) || PG_ARGISNULL(1))
+		elog(ERROR, "query and weight_by must not be NULL");
+
+	tupstore = begin_materialized_srf(fcinfo, &tupdesc);
+
+	tempcontext = AllocSetContextCreate(CurrentMemoryContext,
+										"print_plan_tree temporary context",
+										ALLOCSET_DEFAULT_MINSIZE,
+										ALLOCSET_DEFAULT_INITSIZE,
+										ALLOCSET_DEFAULT_MAXSIZE);
+
+	oldcontext = MemoryContextSwitchTo(tempcontext);
+
+	sql_str		= TextDatumGetCString(PG_GETARG_DATUM(0));
+	weight_str	= TextDatumGetCString(PG_GETARG_DATUM(1));
+	if (!PG_ARGISNULL(2))
+		filename_str = TextDatumGetCString(PG_GETARG_DATUM(2));
+
+	if (pg_strcasecmp(weight_str, "time") == 0)
+		weight = FOLDED_WEIGHT_TIME;
+	else if (pg_strcasecmp(weight_str, "cost") == 0)
+		weight = FOLDED_WEIGHT_COST;
+	else if (pg_strcasecmp(weight_str, "samples") == 0)
+		weight = FOLDED_WEIGHT_SAMPLES;
+	else
+		elog(ERROR, "weight_by must be \"time\", \"cost\" or \"samples\"");
+
+	collect_folded_stacks(sql_str, weight, filename_str, tupstore, tupdesc);
+
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextDelete(tempcontext);
+
+	return (Datum) 0;
+}
+
+/*
+ * plan_tree_sweep(sql, guc, from_value, to_value, steps, filename)
+ *
+ * Plans the query with the configuration parameter set to each of steps
+ * evenly spaced values between from_value and to_value, and returns the
+ * ranges over which the plan stays the same.  If filename is given, the
+ * graph of every distinct plan is written to it.
+ */
+PG_FUNCTION_INFO_V1(plan_tree_sweep);
+Datum
+plan_tree_sweep(PG_FUNCTION_ARGS)
+{
+	TupleDesc tupdesc;
+	Tuplestorestate *tupstore;
+	char *sql_str, *guc_str, *filename_str = NULL;
+	double from_value, to_value;
+	int steps;
+	MemoryContext tempcontext, oldcontext;
+
+	if (PG_ARGISNULL(0) || PG_ARGISNULL(1) || PG_ARGISNULL(2) ||
+		PG_ARGISNULL(3) || PG_ARGISNULL(4))
+		elog(ERROR, "query, parameter name, range and steps must not be NULL");
+
+	from_value	= PG_GETARG_FLOAT8(2);
+	to_value	= PG_GETARG_FLOAT8(3);
+	steps		= PG_GETARG_INT32(4);
+
+	if (steps < 1 || steps > PLAN_SWEEP_MAX_STEPS)
+		elog(ERROR, "steps must be between 1 and %d", PLAN_SWEEP_MAX_STEPS);
+
+	tupstore = begin_materialized_srf(fcinfo, &tupdesc);
+
+	tempcontext = AllocSetContextCreate(CurrentMemoryContext,
+										"print_plan_tree temporary context",
+										ALLOCSET_DEFAULT_MINSIZE,
+										ALLOCSET_DEFAULT_INITSIZE,
+										ALLOCSET_DEFAULT_MAXSIZE);
+
+	oldcontext = MemoryContextSwitchTo(tempcontext);
+
+	render_stats_begin(tempcontext);
+
+	sql_str = TextDatumGetCString(PG_GETARG_DATUM(0));
+	guc_str = TextDatumGetCString(PG_GETARG_DATUM(1));
+	if (!PG_ARGISNULL(5))
+		filename_str = TextDatumGetCString(PG_GETARG_DATUM(5));
+
+	sweep_plans(sql_str, guc_str, from_value, to_value, steps, filename_str, tupstore, tupdesc);
+
+	render_stats_end();
+
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextDelete(tempcontext);
+
+	return (Datum) 0;
+}
+
+/*
+ * plan_tree_alternatives(sql, switches, do_execute, timeout_ms, filename)
+ *
+ * Plans the query under every combination of the given planner method
+ * switches turned off, and returns one row per distinct plan, best first.
+ * With do_execute each plan is also run, under timeout_ms if it is positive,
+ * and ranked by its actual time.  If filename is given, the graph of every
+ * plan is written to it in the same order.
+ */
+PG_FUNCTION_INFO_V1(plan_tree_alternatives);
+Datum
+plan_tree_alternatives(PG_FUNCTION_ARGS)
+{
+	TupleDesc tupdesc;
+	Tuplestorestate *tupstore;
+	char *sql_str, *filename_str = NULL;
+	const char **switches;
+	int num_switches;
+	bool execute;
+	int timeout_ms;
+	MemoryContext tempcontext, oldcontext;
+	int i;
+
+	if (PG_ARGISNULL(0))
+		elog(ERROR, "query must not be NULL");
+
+	execute		= !PG_ARGISNULL(2) && PG_GETARG_BOOL(2);
+	timeout_ms	= PG_ARGISNULL(3) ? 0 : PG_GETARG_INT32(3);
+
+#if PG_VERSION_NUM < 90300
+	if (timeout_ms > 0)
+		elog(ERROR, "timeout_ms requires PostgreSQL 9.3 or later");
+#endif
+
+	tupstore = begin_materialized_srf(fcinfo, &tupdesc);
+
+	tempcontext = AllocSetContextCreate(CurrentMemoryContext,
+										"print_plan_tree temporary context",
+										ALLOCSET_DEFAULT_MINSIZE,
+										ALLOCSET_DEFAULT_INITSIZE,
+										ALLOCSET_DEFAULT_MAXSIZE);
+
+	oldcontext = MemoryContextSwitchTo(tempcontext);
+
+	render_stats_begin(tempcontext);
+
+	sql_str = TextDatumGetCString(PG_GETARG_DATUM(0));
+	if (!PG_ARGISNULL(4))
+		filename_str = TextDatumGetCString(PG_GETARG_DATUM(4));
+
+	if (PG_ARGISNULL(1))
+	{
+		num_switches = lengthof(default_plan_switches);
+		switches = (const char **) palloc(sizeof(char *) * num_switches);
+		for (i = 0 ; i < num_switches ; i++)
+			switches[i] = default_plan_switches[i];
+	}
+	else
+	{
+		ArrayType  *array = PG_GETARG_ARRAYTYPE_P(1);
+		Datum	   *elems;
+		bool	   *nulls;
+
+		if (ARR_NDIM(array) > 1)
+			elog(ERROR, "switches must be a one-dimensional array");
+
+		deconstruct_array(array, TEXTOID, -1, false, 'i', &elems, &nulls, &num_switches);
+
+		switches = (const char **) palloc(sizeof(char *) * (num_switches + 1));
+		for (i = 0 ; i < num_switches ; i++)
+		{
+			if (nulls[i])
+				elog(ERROR, "switches must not contain NULL");
+			switches[i] = TextDatumGetCString(elems[i]);
+		}
+	}
+
+	if (num_switches > PLAN_ALTERNATIVES_MAX_SWITCHES)
+		elog(ERROR, "at most %d switches can be combined", PLAN_ALTERNATIVES_MAX_SWITCHES);
+
+	explore_alternatives(sql_str, switches, num_switches, execute, timeout_ms, filename_str, tupstore, tupdesc);
+
+	render_stats_end();
+
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextDelete(tempcontext);
+
+	return (Datum) 0;
+}
+
+/*
+ * plan_tree_dot_whatif(sql, index_defs, filename, simplify, raw_oids)
+ *
+ * Renders the plan of the query as it is, and as it would be if the indexes
+ * given as CREATE INDEX statements existed.  Nodes of the second plan are
+ * colored by how their cost compares with the baseline.
+ */
+PG_FUNCTION_INFO_V1(plan_tree_dot_whatif);
+Datum
+plan_tree_dot_whatif(PG_FUNCTION_ARGS)
+{
+	char *sql_str, *filename_str;
+	ArrayType *defs;
+	Datum *elems;
+	bool *nulls;
+	char **index_defs;
+	int num_defs;
+	PlanTreeDotOptions options;
+	MemoryContext tempcontext, oldcontext;
+	int i;
+
+	memset(&options, 0, sizeof(options));
+
+	defs = PG_GETARG_ARRAYTYPE_P(1);
+	options.simplify = PG_GETARG_BOOL(3);
+	options.raw_oids = PG_GETARG_BOOL(4);
+
+	tempcontext = AllocSetContextCreate(CurrentMemoryContext,
+										"print_plan_tree temporary context",
+										ALLOCSET_DEFAULT_MINSIZE,
+										ALLOCSET_DEFAULT_INITSIZE,
+										ALLOCSET_DEFAULT_MAXSIZE);
+
+	oldcontext = MemoryContextSwitchTo(tempcontext);
+
+	render_stats_begin(tempcontext);
+
+	sql_str			= TextDatumGetCString(PG_GETARG_DATUM(0));
+	filename_str	= TextDatumGetCString(PG_GETARG_DATUM(2));
+
+	if (ARR_NDIM(defs) > 1)
+		elog(ERROR, "index definitions must be a one-dimensional array");
+
+	deconstruct_array(defs, TEXTOID, -1, false, 'i', &elems, &nulls, &num_defs);
+
+	index_defs = (char **) palloc(sizeof(char *) * (num_defs + 1));
+	for (i = 0 ; i < num_defs ; i++)
+	{
+		if (nulls[i])
+			elog(ERROR, "index definitions must not contain NULL");
+		index_defs[i] = TextDatumGetCString(elems[i]);
+	}
+
+	output_whatif_query(sql_str, index_defs, num_defs, filename_str, &options);
+
+	render_stats_end();
+
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextDelete(tempcontext);
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * plan_tree_dot_benchmark(sql, iterations, filename)
+ *
+ * Renders the plans of the query iterations times and returns one row per
+ * phase with its average time, the graph nodes it handled per second and
+ * the memory it took.
+ */
+PG_FUNCTION_INFO_V1(plan_tree_dot_benchmark);
+Datum
+plan_tree_dot_benchmark(PG_FUNCTION_ARGS)
+{
+	TupleDesc tupdesc;
+	Tuplestorestate *tupstore;
+	char *sql_str, *filename_str;
+	int iterations;
+	MemoryContext tempcontext, oldcontext;
+
+	iterations = PG_GETARG_INT32(1);
+	if (iterations < 1)
+		elog(ERROR, "iterations must be positive");
+
+	tupstore = begin_materialized_srf(fcinfo, &tupdesc);
+
+	tempcontext = AllocSetContextCreate(CurrentMemoryContext,
+										"print_plan_tree temporary context",
+										ALLOCSET_DEFAULT_MINSIZE,
+										ALLOCSET_DEFAULT_INITSIZE,
+										ALLOCSET_DEFAULT_MAXSIZE);
+
+	oldcontext = MemoryContextSwitchTo(tempcontext);
+
+	sql_str			= TextDatumGetCString(PG_GETARG_DATUM(0));
+	filename_str	= TextDatumGetCString(PG_GETARG_DATUM(2));
+
+	benchmark_plan_tree(sql_str, iterations, filename_str, tupstore, tupdesc);
+
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextDelete(tempcontext);
+
+	return (Datum) 0;
+}
+
+/*
+ * plan_tree_open(sql, simplify, raw_oids)
+ *
+ * Plans the query and walks its plan once, and returns a handle through
+ * which the labels and edges of single nodes can be read.  The root is node
+ * 1.  The handle lasts until plan_tree_close() or the end of the session.
+ */
+PG_FUNCTION_INFO_V1(plan_tree_open);
+Datum
+plan_tree_open(PG_FUNCTION_ARGS)
+{
+	PlanTreeDotOptions options;
+	PlanTreeHandle *handle;
+	char *sql_str;
+
+	memset(&options, 0, sizeof(options));
+	options.simplify = PG_GETARG_BOOL(1);
+	options.raw_oids = PG_GETARG_BOOL(2);
+
+	sql_str = TextDatumGetCString(PG_GETARG_DATUM(0));
+
+	handle = open_plan_tree_handle(sql_str, &options);
+
+	pfree(sql_str);
+
+	PG_RETURN_INT32(handle->id);
+}
+
+/*
+ * plan_tree_node(handle, node)
+ *
+ * Returns the record label of one node of an open plan.
+ */
+PG_FUNCTION_INFO_V1(plan_tree_node);
+Datum
+plan_tree_node(PG_FUNCTION_ARGS)
+{
+	PlanTreeHandle *handle;
+	int node_id;
+	char *label;
+
+	handle	= find_plan_tree_handle(PG_GETARG_INT32(0));
+	node_id	= PG_GETARG_INT32(1);
+
+	label = get_plan_tree_node_label(handle->index, node_id);
+	if (label == NULL)
+		elog(ERROR, "plan tree handle %d has no node %d", handle->id, node_id);
+
+	PG_RETURN_TEXT_P(cstring_to_text(label));
+}
+
+/*
+ * plan_tree_children(handle, node)
+ *
+ * Returns the edges leaving one node of an open plan: the field of the
+ * node and the node it points to.
+ */
+PG_FUNCTION_INFO_V1(plan_tree_children);
+Datum
+plan_tree_children(PG_FUNCTION_ARGS)
+{
+	TupleDesc tupdesc;
+	Tuplestorestate *tupstore;
+	PlanTreeHandle *handle;
+	PlanTreeDotEdge *edges;
+	int node_id, num_edges, i;
+
+	handle	= find_plan_tree_handle(PG_GETARG_INT32(0));
+	node_id	= PG_GETARG_INT32(1);
+
+	edges = get_plan_tree_node_edges(handle->index, node_id, &num_edges);
+	if (edges == NULL)
+		elog(ERROR, "plan tree handle %d has no node %d", handle->id, node_id);
+
+	tupstore = begin_materialized_srf(fcinfo, &tupdesc);
+
+	for (i = 0 ; i < num_edges ; i++)
+	{
+		Datum	values[2];
+		bool	nulls[2] = {false, false};
+
+		values[0] = CStringGetTextDatum(edges[i].field);
+		values[1] = Int32GetDatum(edges[i].to);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * plan_tree_close(handle)
+ */
+PG_FUNCTION_INFO_V1(plan_tree_close);
+Datum
+plan_tree_close(PG_FUNCTION_ARGS)
+{
+	PlanTreeHandle *handle;
+	MemoryContext oldcontext;
+
+	handle = find_plan_tree_handle(PG_GETARG_INT32(0));
+
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+	plan_tree_handles = list_delete_ptr(plan_tree_handles, handle);
+	MemoryContextSwitchTo(oldcontext);
+
+	MemoryContextDelete(handle->context);
+	pfree(handle);
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * plan_tree_dot_live(pid, filename, simplify, raw_oids, timeout_ms)
+ *
+ * Renders the plan another backend is running, with the rows and loops of
+ * each node so far.  The node executing and those above it are colored.
+ */
+PG_FUNCTION_INFO_V1(plan_tree_dot_live);
+Datum
+plan_tree_dot_live(PG_FUNCTION_ARGS)
+{
+	char *filename_str;
+	int pid, timeout_ms;
+	PlanTreeDotOptions options;
+	MemoryContext tempcontext, oldcontext;
+
+	memset(&options, 0, sizeof(options));
+
+	pid = PG_GETARG_INT32(0);
+	options.simplify = PG_GETARG_BOOL(2);
+	options.raw_oids = PG_GETARG_BOOL(3);
+	timeout_ms = PG_GETARG_INT32(4);
+
+	if (timeout_ms < 1)
+		elog(ERROR, "timeout_ms must be positive");
+
+	tempcontext = AllocSetContextCreate(CurrentMemoryContext,
+										"print_plan_tree temporary context",
+										ALLOCSET_DEFAULT_MINSIZE,
+										ALLOCSET_DEFAULT_INITSIZE,
+										ALLOCSET_DEFAULT_MAXSIZE);
+
+	oldcontext = MemoryContextSwitchTo(tempcontext);
+
+	render_stats_begin(tempcontext);
+
+	filename_str = TextDatumGetCString(PG_GETARG_DATUM(1));
+
+	output_live_plan(pid, timeout_ms, filename_str, &options);
+
+	pfree(filename_str);
+
+	render_stats_end();
+
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextDelete(tempcontext);
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * plan_tree_dot_prepared(stmt_name, filename, params, simplify, raw_oids)
+ *
+ * Renders the plans the plancache holds for a prepared statement: the
+ * generic plan, and the custom plan for the given parameter values if any.
+ */
+PG_FUNCTION_INFO_V1(plan_tree_dot_prepared);
+Datum
+plan_tree_dot_prepared(PG_FUNCTION_ARGS)
+{
+#if PG_VERSION_NUM >= 90200
+	char *stmt_name, *filename_str;
+	ArrayType *values = NULL;
+	PlanTreeDotOptions options;
+	MemoryContext tempcontext, oldcontext;
+
+	if (PG_ARGISNULL(0) || PG_ARGISNULL(1))
+		elog(ERROR, "statement name and file name must not be NULL");
+
+	memset(&options, 0, sizeof(options));
+
+	if (!PG_ARGISNULL(2))
+		values = PG_GETARG_ARRAYTYPE_P(2);
+	options.simplify = !PG_ARGISNULL(3) && PG_GETARG_BOOL(3);
+	options.raw_oids = !PG_ARGISNULL(4) && PG_GETARG_BOOL(4);
+
+	tempcontext = AllocSetContextCreate(CurrentMemoryContext,
+										"print_plan_tree temporary context",
+										ALLOCSET_DEFAULT_MINSIZE,
+										ALLOCSET_DEFAULT_INITSIZE,
+										ALLOCSET_DEFAULT_MAXSIZE);
+
+	oldcontext = MemoryContextSwitchTo(tempcontext);
+
+	render_stats_begin(tempcontext);
+
+	stmt_name		= TextDatumGetCString(PG_GETARG_DATUM(0));
+	filename_str	= TextDatumGetCString(PG_GETARG_DATUM(1));
+
+	output_prepared_statement(stmt_name, filename_str, values, &options);
+
+	pfree(filename_str);
+	pfree(stmt_name);
+
+	render_stats_end();
+
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextDelete(tempcontext);
+#else
+	elog(ERROR, "plan_tree_dot_prepared requires PostgreSQL 9.2 or later");
+#endif
+
+	PG_RETURN_VOID();
+}
+
+/*
+ * Takes a snapshot of the live query of the backend and renders its plan
+ * through the usual path, with a note of the rows and loops on each node.
+ */
+static void
+output_live_plan(int pid, int timeout_ms, const char *filename, const PlanTreeDotOptions *options)
+{
+	LivePlanSnapshot	   *snapshot;
+	PlanTreeDotOptions		live_options = *options;
+	PlanTreeDotNodeMark	   *marks;
+	Plan				  **plans;
+	bool				   *active;
+	int						num_slots = 0;
+	int						n = 0;
+	int						i;
+	ListCell			   *lc;
+	FILE				   *file;
+	char					title[256];
+
+	snapshot = get_live_plan_snapshot(pid, timeout_ms);
+
+	for (i = 0 ; i < snapshot->num_nodes ; i++)
+		num_slots = Max(num_slots, snapshot->nodes[i].plan_node_id + 1);
+
+	plans = (Plan **) palloc0(sizeof(Plan *) * (num_slots + 1));
+	collect_plans_by_id(snapshot->stmt->planTree, plans, num_slots);
+	foreach(lc, snapshot->stmt->subplans)
+		collect_plans_by_id((Plan *) lfirst(lc), plans, num_slots);
+
+	/* The executing node and the nodes that called it */
+	active = (bool *) palloc0(sizeof(bool) * (snapshot->num_nodes + 1));
+	for (i = 0 ; i < snapshot->num_nodes ; i++)
+	{
+		int j;
+
+		if (!snapshot->nodes[i].executing)
+			continue;
+
+		for (j = i ; j >= 0 ; j = snapshot->nodes[j].parent)
+			active[j] = true;
+	}
+
+	marks = (PlanTreeDotNodeMark *) palloc0(sizeof(PlanTreeDotNodeMark) * (snapshot->num_nodes + 1));
+
+	for (i = 0 ; i < snapshot->num_nodes ; i++)
+	{
+		LivePlanNode   *node = &snapshot->nodes[i];
+		StringInfoData	note;
+
+		if (plans[node->plan_node_id] == NULL)
+			continue;
+
+		if (node->executing)
+			marks[n].color = LIVE_EXECUTING_COLOR;
+		else if (active[i])
+			marks[n].color = LIVE_ACTIVE_COLOR;
+
+		initStringInfo(&note);
+		appendStringInfo(&note, "rows so far: %.0f, loops: %.0f", node->tuples, node->loops);
+
+		marks[n].node = plans[node->plan_node_id];
+		marks[n].note = note.data;
+		n++;
+	}
+
+	live_options.node_marks		= marks;
+	live_options.num_node_marks	= n;
+
+	file = fopen(filename, "w");
+	if (file == NULL)
+		elog(ERROR, "cannot create \"%s\"", filename);
+
+	snprintf(title, sizeof(title), "Live Plan of PID %d at %s", pid, timestamptz_to_str(snapshot->taken_at));
+	output_plan_tree(title, snapshot->query, snapshot->stmt, file, &live_options);
+
+	fclose(file);
+}
+
+/*
+ * Fills plans[plan_node_id] for the plan and the plans below it.
+ */
+static void
+collect_plans_by_id(Plan *plan, Plan **plans, int num_slots)
+{
+	List	   *children;
+	ListCell   *lc;
+
+	if (plan == NULL)
+		return;
+
+#if PG_VERSION_NUM >= 90600
+	if (plan->plan_node_id >= 0 && plan->plan_node_id < num_slots)
+		plans[plan->plan_node_id] = plan;
+#endif
+
+	children = plan_child_plans(plan);
+	foreach(lc, children)
+		collect_plans_by_id((Plan *) lfirst(lc), plans, num_slots);
+	list_free(children);
+}
+
+/*
+ * Plans the query with the given parameter types.  If params is NULL a
+ * generic plan is made, otherwise a custom plan for the bound values.
+ */
+static void
+output_sql_query(const char *sql, const char *filename, Oid *param_types, int num_params, ParamListInfo params, const PlanTreeDotOptions *options)
+{
+	List		   *raw_parsetree_list;
+	DestReceiver   *dest;
+	ListCell	   *lc1;
+	FILE		   *file;
+	const char	   *title;
+	instr_time		starttime;
+
+	if (num_params == 0)
+		title = "Plan Tree";
+	else if (params == NULL)
+		title = "Generic Plan";
+	else
+		title = "Custom Plan";
+
+	file = fopen(filename, "w");
+	if (file == NULL)
+		elog(ERROR, "cannot create \"%s\"", filename);
+
+	INSTR_TIME_SET_CURRENT(starttime);
+	raw_parsetree_list = pg_parse_query(sql);
+	render_stats_add(RENDER_PARSE, elapsed_ms(starttime));
+
+	dest = CreateDestReceiver(DestNone);
+
+	foreach(lc1, raw_parsetree_list)
+	{
+#if PG_VERSION_NUM >= 100000
+		RawStmt	   *parsetree = lfirst_node(RawStmt, lc1);
+#else
+		Node	   *parsetree = (Node *) lfirst(lc1);
+#endif
+		List	   *stmt_list;
+		ListCell   *lc2;
+
+		INSTR_TIME_SET_CURRENT(starttime);
+#if PG_VERSION_NUM >= 100000
+		stmt_list = pg_analyze_and_rewrite(parsetree, sql, param_types, num_params, NULL);
+#else
+		stmt_list = pg_analyze_and_rewrite(parsetree, sql, param_types, num_params);
+#endif
+		render_stats_add(RENDER_PARSE, elapsed_ms(starttime));
+
+		INSTR_TIME_SET_CURRENT(starttime);
+		stmt_list = pg_plan_queries(stmt_list, 0, params);
+		render_stats_add(RENDER_PLAN, elapsed_ms(starttime));
+
+		foreach(lc2, stmt_list)
+		{
+			Node	   *stmt = (Node *) lfirst(lc2);
+
+			if (IsA(stmt, PlannedStmt) &&
+				((PlannedStmt *) stmt)->utilityStmt == NULL)
+			{
+				QueryDesc  *qdesc;
+
+				qdesc = CreateQueryDesc((PlannedStmt *) stmt,
+										sql,
+										GetActiveSnapshot(), NULL,
+										dest, NULL,
+#if PG_VERSION_NUM >= 100000
+										NULL,
+#endif
+										0);
+
+				output_plan_tree(title, sql, qdesc->plannedstmt, file, options);
+
+				FreeQueryDesc(qdesc);
+			}
+		}
+	}
+
+	fclose(file);
+}
+
+/*
+ * Starts the executor on each planned statement, as EXPLAIN does, and
+ * writes the PlanState tree before ExecutorEnd() tears it down.
+ */
+static void
+output_plan_state_query(const char *sql, const char *filename, bool analyze, const PlanTreeDotOptions *options)
+{
+	List		   *stmt_list;
+	ListCell	   *lc;
+	FILE		   *file;
+
+	file = fopen(filename, "w");
+	if (file == NULL)
+		elog(ERROR, "cannot create \"%s\"", filename);
+
+	stmt_list = plan_query_string(sql, NULL, 0, NULL);
+
+	foreach(lc, stmt_list)
+	{
+		QueryDesc  *qdesc;
+
+		qdesc = start_query((PlannedStmt *) lfirst(lc), sql,
+							analyze ? INSTRUMENT_ALL : 0, analyze);
+
+		output_plan_tree(analyze ? "PlanState Tree (analyzed)" : "PlanState Tree",
+						 sql, qdesc->planstate, file, options);
+
+		end_query(qdesc, analyze);
+	}
+
+	fclose(file);
+}
+
+/*
+ * Per-node row of plan_tree_misestimates()
+ */
+typedef struct MisestimateRow
+{
+	int			node_id;
+	const char *node_type;
+	char	   *relation;
+	double		plan_rows;
+	double		actual_rows;
+	double		loops;
+	double		q_error;
+	double		exclusive_ms;
+	double		impact;
+} MisestimateRow;
+
+/*
+ * Runs each statement with row and timer instrumentation and puts one row
+ * per plan node into tupstore, the worst first.  A node's impact is its
+ * log q-error weighted by its exclusive time, so a large misestimate on a
+ * node that costs nothing ranks below a moderate one on the hot path.
+ */
+static void
+collect_misestimates(const char *sql, Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	List		   *stmt_list;
+	ListCell	   *lc;
+
+	stmt_list = plan_query_string(sql, NULL, 0, NULL);
+
+	foreach(lc, stmt_list)
+	{
+		PlannedStmt		   *stmt = (PlannedStmt *) lfirst(lc);
+		QueryDesc		   *qdesc;
+		PlanStateNodeInfo  *nodes;
+		MisestimateRow	   *rows;
+		double			   *total_ms;
+		double				sum_exclusive = 0.0;
+		int					num_nodes;
+		int					i;
+
+		qdesc = start_query(stmt, sql, INSTRUMENT_ROWS | INSTRUMENT_TIMER, true);
+
+		nodes = get_plan_state_nodes(qdesc->planstate, &num_nodes);
+
+		rows = (MisestimateRow *) palloc0(sizeof(MisestimateRow) * (num_nodes + 1));
+		total_ms = (double *) palloc0(sizeof(double) * (num_nodes + 1));
+
+		for (i = 0 ; i < num_nodes ; i++)
+		{
+			PlanState	   *ps = (PlanState *) nodes[i].planstate;
+			Instrumentation *instr = ps->instrument;
+
+#if PG_VERSION_NUM >= 90600
+			rows[i].node_id		= ps->plan->plan_node_id;
+#else
+			rows[i].node_id		= i;
+#endif
+			rows[i].node_type	= nodes[i].node_type;
+			rows[i].relation	= plan_relation_name(stmt, ps->plan);
+			rows[i].plan_rows	= ps->plan->plan_rows;
+			rows[i].q_error		= -1.0;
+
+			if (instr == NULL)
+				continue;
+
+			InstrEndLoop(instr);
+
+			rows[i].loops = instr->nloops;
+			total_ms[i] = 1000.0 * instr->total;
+
+			if (instr->nloops > 0)
+			{
+				double	est = Max(rows[i].plan_rows, 1.0);
+				double	act;
+
+				rows[i].actual_rows = instr->ntuples / instr->nloops;
+				act = Max(rows[i].actual_rows, 1.0);
+				rows[i].q_error = (est > act) ? est / act : act / est;
+			}
+		}
+
+		/* Exclusive time is a node's time less that of its direct children */
+		for (i = 0 ; i < num_nodes ; i++)
+			rows[i].exclusive_ms = total_ms[i];
+		for (i = 0 ; i < num_nodes ; i++)
+			if (nodes[i].parent >= 0)
+				rows[nodes[i].parent].exclusive_ms -= total_ms[i];
+
+		for (i = 0 ; i < num_nodes ; i++)
+		{
+			if (rows[i].exclusive_ms < 0.0)
+				rows[i].exclusive_ms = 0.0;
+			sum_exclusive += rows[i].exclusive_ms;
+		}
+
+		for (i = 0 ; i < num_nodes ; i++)
+			if (rows[i].q_error > 0.0)
+				rows[i].impact = log(rows[i].q_error) * rows[i].exclusive_ms;
+
+		end_query(qdesc, true);
+
+		qsort(rows, num_nodes, sizeof(MisestimateRow), compare_misestimate_rows);
+
+		for (i = 0 ; i < num_nodes ; i++)
+		{
+			Datum	values[9];
+			bool	nulls[9];
+
+			memset(nulls, 0, sizeof(nulls));
+
+			values[0] = Int32GetDatum(rows[i].node_id);
+			values[1] = CStringGetTextDatum(rows[i].node_type);
+			if (rows[i].relation)
+				values[2] = CStringGetTextDatum(rows[i].relation);
+			else
+				nulls[2] = true;
+			values[3] = Float8GetDatum(rows[i].plan_rows);
+			if (rows[i].q_error > 0.0)
+			{
+				values[4] = Float8GetDatum(rows[i].actual_rows);
+				values[6] = Float8GetDatum(rows[i].q_error);
+			}
+			else
+			{
+				/* never executed */
+				nulls[4] = true;
+				nulls[6] = true;
+			}
+			values[5] = Float8GetDatum(rows[i].loops);
+			values[7] = Float8GetDatum(rows[i].exclusive_ms);
+			if (sum_exclusive > 0.0)
+				values[8] = Float8GetDatum(rows[i].exclusive_ms / sum_exclusive);
+			else
+				nulls[8] = true;
+
+			tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+		}
+	}
+}
+
+/*
+ * Runs each statement with timer, buffer and row instrumentation and adds
+ * one calibration sample per node that was executed.  Buffer accesses of
+ * index scans count as random page fetches and all others as sequential
+ * ones; hits are included, so the fit reflects the cache state the
+ * queries ran in.
+ */
+static int
+collect_calibration_samples(const char *sql)
+{
+	List		   *stmt_list;
+	ListCell	   *lc;
+	int				count = 0;
+
+	stmt_list = plan_query_string(sql, NULL, 0, NULL);
+
+	foreach(lc, stmt_list)
+	{
+		PlannedStmt		   *stmt = (PlannedStmt *) lfirst(lc);
+		QueryDesc		   *qdesc;
+		PlanStateNodeInfo  *nodes;
+		CalibrationSample  *samples;
+		double			   *total_ms;
+		double			   *pages;
+		int					num_nodes;
+		int					i;
+
+		qdesc = start_query(stmt, sql, INSTRUMENT_ROWS | INSTRUMENT_TIMER | INSTRUMENT_BUFFERS, true);
+
+		nodes = get_plan_state_nodes(qdesc->planstate, &num_nodes);
+
+		samples = (CalibrationSample *) palloc0(sizeof(CalibrationSample) * (num_nodes + 1));
+		total_ms = (double *) palloc0(sizeof(double) * (num_nodes + 1));
+		pages = (double *) palloc0(sizeof(double) * (num_nodes + 1));
+
+		for (i = 0 ; i < num_nodes ; i++)
+		{
+			PlanState	   *ps = (PlanState *) nodes[i].planstate;
+			Instrumentation *instr = ps->instrument;
+
+			samples[i].node_type = nodes[i].node_type;
+
+			if (instr == NULL)
+				continue;
+
+			InstrEndLoop(instr);
+
+			total_ms[i] = 1000.0 * instr->total;
+			pages[i] = (double) (instr->bufusage.shared_blks_hit + instr->bufusage.shared_blks_read +
+								 instr->bufusage.local_blks_hit + instr->bufusage.local_blks_read);
+
+			samples[i].tuples = instr->ntuples;
+#if PG_VERSION_NUM >= 90200
+			samples[i].tuples += instr->nfiltered1 + instr->nfiltered2;
+#endif
+			samples[i].operators = samples[i].tuples * count_plan_operators(ps->plan);
+		}
+
+		/* Time and pages are exclusive of the direct children */
+		for (i = 0 ; i < num_nodes ; i++)
+		{
+			samples[i].exclusive_ms = total_ms[i];
+			samples[i].seq_pages = pages[i];
+		}
+		for (i = 0 ; i < num_nodes ; i++)
+		{
+			if (nodes[i].parent >= 0)
+			{
+				samples[nodes[i].parent].exclusive_ms -= total_ms[i];
+				samples[nodes[i].parent].seq_pages -= pages[i];
+			}
+		}
+
+		for (i = 0 ; i < num_nodes ; i++)
+		{
+			PlanState *ps = (PlanState *) nodes[i].planstate;
+
+			if (ps->instrument == NULL || ps->instrument->nloops == 0)
+				continue;
+
+			samples[i].exclusive_ms	= Max(samples[i].exclusive_ms, 0.0);
+			samples[i].seq_pages	= Max(samples[i].seq_pages, 0.0);
+
+			switch (nodeTag(ps->plan))
+			{
+				case T_IndexScan:
+#if PG_VERSION_NUM >= 90200
+				case T_IndexOnlyScan:
+#endif
+				case T_BitmapIndexScan:
+					samples[i].random_pages = samples[i].seq_pages;
+					samples[i].seq_pages = 0.0;
+					break;
+				default:
+					break;
+			}
+
+			add_calibration_sample(&samples[i]);
+			count++;
+		}
+
+		end_query(qdesc, true);
+	}
+
+	return count;
+}
+
+#if PG_VERSION_NUM >= 100000
+/*
+ * Runs each statement with row and timer instrumentation, and for every
+ * node whose q-error is at least min_q_error collects the columns of each
+ * relation its quals reference.  Two or more columns of one relation make
+ * a CREATE STATISTICS suggestion, since the planner treats them as
+ * independent.  A node's impact is its log q-error weighted by the time of
+ * the node that consumed the estimate, its parent; suggestions are ranked
+ * by the impact summed over the nodes they would address.
+ */
+static void
+collect_statistics_advice(const char *sql, double min_q_error, Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	List			   *stmt_list;
+	ListCell		   *lc;
+	StatisticsAdvice   *advice = NULL;
+	int					num_advice = 0;
+	int					max_advice = 0;
+	int					i;
+
+	stmt_list = plan_query_string(sql, NULL, 0, NULL);
+
+	foreach(lc, stmt_list)
+	{
+		PlannedStmt		   *stmt = (PlannedStmt *) lfirst(lc);
+		QueryDesc		   *qdesc;
+		PlanStateNodeInfo  *nodes;
+		int					num_nodes;
+		int					num_rels = list_length(stmt->rtable);
+		Bitmapset		  **columns;
+
+		qdesc = start_query(stmt, sql, INSTRUMENT_ROWS | INSTRUMENT_TIMER, true);
+
+		nodes = get_plan_state_nodes(qdesc->planstate, &num_nodes);
+
+		for (i = 0 ; i < num_nodes ; i++)
+		{
+			PlanState	   *ps = (PlanState *) nodes[i].planstate;
+
+			if (ps->instrument)
+				InstrEndLoop(ps->instrument);
+		}
+
+		columns = (Bitmapset **) palloc(sizeof(Bitmapset *) * (num_rels + 1));
+
+		for (i = 0 ; i < num_nodes ; i++)
+		{
+			PlanState	   *ps = (PlanState *) nodes[i].planstate;
+			Instrumentation *instr = ps->instrument;
+			PlanState	   *consumer;
+			double			est, act, q_error, impact;
+			Index			rti;
+
+			if (instr == NULL || instr->nloops <= 0)
+				continue;
+
+			est = Max(ps->plan->plan_rows, 1.0);
+			act = Max(instr->ntuples / instr->nloops, 1.0);
+			q_error = (est > act) ? est / act : act / est;
+
+			if (q_error < min_q_error)
+				continue;
+
+			consumer = (nodes[i].parent >= 0) ? (PlanState *) nodes[nodes[i].parent].planstate : ps;
+			impact = log(q_error) * 1000.0 * (consumer->instrument ? consumer->instrument->total : instr->total);
+
+			memset(columns, 0, sizeof(Bitmapset *) * (num_rels + 1));
+			collect_qual_columns(ps->plan, columns, num_rels);
+
+			for (rti = 1 ; rti <= (Index) num_rels ; rti++)
+			{
+				RangeTblEntry  *rte;
+				int				j;
+
+				if (bms_num_members(columns[rti]) < 2)
+					continue;
+
+				rte = rt_fetch(rti, stmt->rtable);
+				if (rte->rtekind != RTE_RELATION)
+					continue;
+
+				for (j = 0 ; j < num_advice ; j++)
+					if (advice[j].relid == rte->relid && bms_equal(advice[j].columns, columns[rti]))
+						break;
+
+				if (j == num_advice)
+				{
+					if (num_advice >= max_advice)
+					{
+						max_advice = (max_advice > 0) ? max_advice * 2 : 8;
+						if (advice == NULL)
+							advice = (StatisticsAdvice *) palloc(sizeof(StatisticsAdvice) * max_advice);
+						else
+							advice = (StatisticsAdvice *) repalloc(advice, sizeof(StatisticsAdvice) * max_advice);
+					}
+
+					memset(&advice[j], 0, sizeof(StatisticsAdvice));
+					advice[j].relid		= rte->relid;
+					advice[j].columns	= bms_copy(columns[rti]);
+					num_advice++;
+				}
+
+				advice[j].num_nodes++;
+				advice[j].impact += impact;
+
+				if (advice[j].num_nodes == 1 || q_error > advice[j].q_error)
+				{
+					advice[j].node_id		= ps->plan->plan_node_id;
+					advice[j].node_type		= nodes[i].node_type;
+					advice[j].plan_rows		= ps->plan->plan_rows;
+					advice[j].actual_rows	= instr->ntuples / instr->nloops;
+					advice[j].q_error		= q_error;
+				}
+			}
+		}
+
+		end_query(qdesc, true);
+	}
+
+	if (num_advice > 1)
+		qsort(advice, num_advice, sizeof(StatisticsAdvice), compare_statistics_advice);
+
+	for (i = 0 ; i < num_advice ; i++)
+	{
+		Datum			values[11];
+		bool			nulls[11];
+		Datum		   *names;
+		StringInfoData	name_columns, column_list, buf;
+		char		   *relname = get_rel_name(advice[i].relid);
+		char		   *stat_name;
+		char		   *existing;
+		int				num_columns = bms_num_members(advice[i].columns);
+		int				attno = -1;
+		int				n = 0;
+
+		memset(nulls, 0, sizeof(nulls));
+
+		names = (Datum *) palloc(sizeof(Datum) * num_columns);
+
+		initStringInfo(&name_columns);
+		initStringInfo(&column_list);
+
+		while ((attno = bms_next_member(advice[i].columns, attno)) >= 0)
+		{
+#if PG_VERSION_NUM >= 110000
+			char *attname = get_attname(advice[i].relid, (AttrNumber) attno, false);
+#else
+			char *attname = get_relid_attribute_name(advice[i].relid, (AttrNumber) attno);
+#endif
+
+			names[n++] = CStringGetTextDatum(attname);
+			appendStringInfo(&name_columns, "%s%s", (n > 1) ? "_" : "", attname);
+			appendStringInfo(&column_list, "%s%s", (n > 1) ? ", " : "", quote_identifier(attname));
+		}
+
+		/* Named as CREATE STATISTICS would, clipped to NAMEDATALEN */
+		stat_name = makeObjectName(relname, name_columns.data, "stat");
+
+		values[0] = CStringGetTextDatum(quote_qualified_identifier(get_namespace_name(get_rel_namespace(advice[i].relid)), relname));
+		values[1] = PointerGetDatum(construct_array(names, num_columns, TEXTOID, -1, false, 'i'));
+		values[2] = Int32GetDatum(advice[i].num_nodes);
+		values[3] = Int32GetDatum(advice[i].node_id);
+		values[4] = CStringGetTextDatum(advice[i].node_type);
+		values[5] = Float8GetDatum(advice[i].plan_rows);
+		values[6] = Float8GetDatum(advice[i].actual_rows);
+		values[7] = Float8GetDatum(advice[i].q_error);
+		values[8] = Float8GetDatum(advice[i].impact);
+
+		existing = find_covering_statistics(advice[i].relid, advice[i].columns);
+		if (existing)
+		{
+			/* The statistics exist; the estimate is off for another reason */
+			values[9] = CStringGetTextDatum(existing);
+			nulls[10] = true;
+		}
+		else
+		{
+			initStringInfo(&buf);
+			appendStringInfo(&buf, "CREATE STATISTICS %s (dependencies, ndistinct%s) ON %s FROM %s",
+							 quote_identifier(stat_name),
+#if PG_VERSION_NUM >= 120000
+							 ", mcv",
+#else
+							 "",
+#endif
+							 column_list.data,
+							 TextDatumGetCString(values[0]));
+
+			nulls[9] = true;
+			values[10] = CStringGetTextDatum(buf.data);
+		}
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+}
+
+/*
+ * Collects into columns[rti] the attribute numbers of the Vars that the
+ * quals of plan reference.  Vars of joins and of index-only scans refer to
+ * the target lists below them; they are followed down to the scans.
+ */
+static void
+collect_qual_columns(Plan *plan, Bitmapset **columns, int num_rels)
+{
+	QualColumnsContext context;
+
+	context.plan		= plan;
+	context.columns		= columns;
+	context.num_rels	= num_rels;
+
+	collect_qual_columns_walker((Node *) plan->qual, &context);
+
+	switch (nodeTag(plan))
+	{
+		case T_IndexScan:
+			collect_qual_columns_walker((Node *) ((IndexScan *) plan)->indexqualorig, &context);
+			break;
+		case T_IndexOnlyScan:
+			collect_qual_columns_walker((Node *) ((IndexOnlyScan *) plan)->indexqual, &context);
+			break;
+		case T_BitmapHeapScan:
+			collect_qual_columns_walker((Node *) ((BitmapHeapScan *) plan)->bitmapqualorig, &context);
+			break;
+		case T_NestLoop:
+			collect_qual_columns_walker((Node *) ((Join *) plan)->joinqual, &context);
+			break;
+		case T_MergeJoin:
+			collect_qual_columns_walker((Node *) ((Join *) plan)->joinqual, &context);
+			collect_qual_columns_walker((Node *) ((MergeJoin *) plan)->mergeclauses, &context);
+			break;
+		case T_HashJoin:
+			collect_qual_columns_walker((Node *) ((Join *) plan)->joinqual, &context);
+			collect_qual_columns_walker((Node *) ((HashJoin *) plan)->hashclauses, &context);
+			break;
+		default:
+			break;
+	}
+}
+
+static bool
+collect_qual_columns_walker(Node *node, QualColumnsContext *context)
+{
+	if (node == NULL)
+		return false;
+
+	if (IsA(node, Var))
+	{
+		Var *var = resolve_plan_var(context->plan, (Var *) node);
+
+		if (var != NULL && var->varlevelsup == 0 && var->varattno > 0 &&
+			var->varno > 0 && var->varno <= (Index) context->num_rels)
+			context->columns[var->varno] = bms_add_member(context->columns[var->varno], var->varattno);
+
+		return false;
+	}
+
+	return expression_tree_walker(node, collect_qual_columns_walker, (void *) context);
+}
+
+/*
+ * Follows a Var that refers to the output of a child node, or to the index
+ * of an index-only scan, down to the Var of the scanned relation.  Returns
+ * NULL if the column is computed on the way.
+ */
+static Var *
+resolve_plan_var(Plan *plan, Var *var)
+{
+	for (;;)
+	{
+		List		   *tlist;
+		TargetEntry	   *tle;
+
+		if (var->varno == OUTER_VAR && outerPlan(plan))
+		{
+			plan = outerPlan(plan);
+			tlist = plan->targetlist;
+		}
+		else if (var->varno == INNER_VAR && innerPlan(plan))
+		{
+			plan = innerPlan(plan);
+			tlist = plan->targetlist;
+		}
+		else if (var->varno == INDEX_VAR && IsA(plan, IndexOnlyScan))
+			tlist = ((IndexOnlyScan *) plan)->indextlist;
+		else
+			return var;
+
+		tle = get_tle_by_resno(tlist, var->varattno);
+		if (tle == NULL || !IsA(tle->expr, Var))
+			return NULL;
+
+		var = (Var *) tle->expr;
+	}
+}
+
+/*
+ * Returns the name of an extended statistics object of the relation that
+ * covers all of columns, or NULL.
+ */
+static char *
+find_covering_statistics(Oid relid, Bitmapset *columns)
+{
+	Relation	rel;
+	List	   *stat_oids;
+	ListCell   *lc;
+	char	   *result = NULL;
+
+	rel = relation_open(relid, AccessShareLock);
+	stat_oids = RelationGetStatExtList(rel);
+
+	foreach(lc, stat_oids)
+	{
+		HeapTuple	tuple;
+		Form_pg_statistic_ext form;
+		Bitmapset  *keys = NULL;
+		int			i;
+
+		tuple = SearchSysCache1(STATEXTOID, ObjectIdGetDatum(lfirst_oid(lc)));
+		if (!HeapTupleIsValid(tuple))
+			continue;
+
+		form = (Form_pg_statistic_ext) GETSTRUCT(tuple);
+		for (i = 0 ; i < form->stxkeys.dim1 ; i++)
+			keys = bms_add_member(keys, form->stxkeys.values[i]);
+
+		if (bms_is_subset(columns, keys))
+			result = pstrdup(NameStr(form->stxname));
+
+		bms_free(keys);
+		ReleaseSysCache(tuple);
+
+		if (result)
+			break;
+	}
+
+	list_free(stat_oids);
+	relation_close(rel, AccessShareLock);
+
+	return result;
+}
+
+static int
+compare_statistics_advice(const void *a, const void *b)
+{
+	const StatisticsAdvice *x = (const StatisticsAdvice *) a;
+	const StatisticsAdvice *y = (const StatisticsAdvice *) b;
+
+	if (x->impact != y->impact)
+		return (x->impact > y->impact) ? -1 : 1;
+	if (x->q_error != y->q_error)
+		return (x->q_error > y->q_error) ? -1 : 1;
+	return 0;
+}
+#endif
+
+#if PG_VERSION_NUM >= 100000
+/*
+ * Runs each statement iterations times under the sampling profiler and
+ * puts one row per plan node into tupstore, in plan order, followed by a
+ * row with a NULL node for the samples taken in the executor outside any
+ * node.  With filename, each plan is written with its nodes colored by
+ * their share of the samples.
+ */
+static void
+profile_plan_tree(const char *sql, int iterations, const char *filename, const PlanTreeDotOptions *options, Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	List		   *stmt_list;
+	ListCell	   *lc;
+	FILE		   *file = NULL;
+
+	stmt_list = plan_query_string(sql, NULL, 0, NULL);
+
+	if (filename)
+	{
+		file = fopen(filename, "w");
+		if (file == NULL)
+			elog(ERROR, "cannot create \"%s\"", filename);
+	}
+
+	foreach(lc, stmt_list)
+	{
+		PlannedStmt		   *stmt = (PlannedStmt *) lfirst(lc);
+		PlanProfile		   *profile = NULL;
+		PlanStateNodeInfo  *nodes = NULL;
+		Plan			  **plans = NULL;
+		int					num_nodes = 0;
+		uint64				total = 0;
+		int					iter;
+		int					i;
+
+		for (iter = 0 ; iter < iterations ; iter++)
+		{
+			QueryDesc  *qdesc;
+
+			CHECK_FOR_INTERRUPTS();
+
+			qdesc = begin_query(stmt, sql, 0, 0);
+
+			if (profile == NULL)
+			{
+				int num_slots = 0;
+
+				/* The nodes and their ids are the same in every execution */
+				nodes = get_plan_state_nodes(qdesc->planstate, &num_nodes);
+				plans = (Plan **) palloc(sizeof(Plan *) * (num_nodes + 1));
+				for (i = 0 ; i < num_nodes ; i++)
+				{
+					plans[i] = ((PlanState *) nodes[i].planstate)->plan;
+					num_slots = Max(num_slots, plans[i]->plan_node_id + 1);
+				}
+
+				profile = create_plan_profile(num_slots);
+			}
+
+			start_plan_profile(profile, qdesc->planstate);
+
+			PG_TRY();
+			{
+				run_query(qdesc);
+			}
+			PG_CATCH();
+			{
+				stop_plan_profile(profile);
+				PG_RE_THROW();
+			}
+			PG_END_TRY();
+
+			stop_plan_profile(profile);
+
+			end_query(qdesc, true);
+		}
+
+		total = get_plan_profile_samples(profile, -1);
+		for (i = 0 ; i < num_nodes ; i++)
+			total += get_plan_profile_samples(profile, plans[i]->plan_node_id);
+
+		for (i = 0 ; i <= num_nodes ; i++)
+		{
+			Datum	values[5];
+			bool	nulls[5];
+			char   *relation = NULL;
+			uint64	samples;
+
+			memset(nulls, 0, sizeof(nulls));
+
+			if (i < num_nodes)
+			{
+				samples = get_plan_profile_samples(profile, plans[i]->plan_node_id);
+				relation = plan_relation_name(stmt, plans[i]);
+
+				values[0] = Int32GetDatum(plans[i]->plan_node_id);
+				values[1] = CStringGetTextDatum(nodes[i].node_type);
+			}
+			else
+			{
+				samples = get_plan_profile_samples(profile, -1);
+
+				nulls[0] = true;
+				nulls[1] = true;
+			}
+
+			if (relation)
+				values[2] = CStringGetTextDatum(relation);
+			else
+				nulls[2] = true;
+			values[3] = Int64GetDatum((int64) samples);
+			if (total > 0)
+				values[4] = Float8GetDatum((double) samples / total);
+			else
+				nulls[4] = true;
+
+			tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+		}
+
+		if (file)
+		{
+			PlanTreeDotOptions	profile_options = *options;
+			PlanTreeDotNodeMark *marks;
+			char				title[256];
+			int					n = 0;
+
+			marks = (PlanTreeDotNodeMark *) palloc0(sizeof(PlanTreeDotNodeMark) * (num_nodes + 1));
+
+			for (i = 0 ; i < num_nodes ; i++)
+			{
+				uint64			samples = get_plan_profile_samples(profile, plans[i]->plan_node_id);
+				double			share;
+				StringInfoData	note;
+
+				if (samples == 0)
+					continue;
+
+				share = (double) samples / total;
+
+				if (share >= 0.5)
+					marks[n].color = PROFILE_HOTTEST_COLOR;
+				else if (share >= 0.2)
+					marks[n].color = PROFILE_HOT_COLOR;
+				else if (share >= 0.05)
+					marks[n].color = PROFILE_WARM_COLOR;
+				else
+					marks[n].color = PROFILE_SAMPLED_COLOR;
+
+				initStringInfo(&note);
+				appendStringInfo(&note, "samples: " UINT64_FORMAT " (%.1f%%)", samples, share * 100.0);
+
+				marks[n].node = plans[i];
+				marks[n].note = note.data;
+				n++;
+			}
+
+			profile_options.node_marks		= marks;
+			profile_options.num_node_marks	= n;
+
+			snprintf(title, sizeof(title), "Profile (" UINT64_FORMAT " samples, %d executions)", total, iterations);
+			output_plan_tree(title, sql, stmt, file, &profile_options);
+		}
+	}
+
+	if (file)
+		fclose(file);
+}
+#endif
+
+/*
+ * Puts one row per plan node into tupstore: the frames from the root to the
+ * node joined by semicolons, and the node's weight.  The plan is walked
+ * through get_plan_state_nodes(), so init plans and subplans hang below the
+ * node that runs them.  Time and cost are made exclusive by subtracting
+ * the direct children; profile samples already are.  Nodes with no weight
+ * are left out, as flame graph tools ignore them.
+ */
+static void
+collect_folded_stacks(const char *sql, FoldedWeight weight, const char *filename, Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	List		   *stmt_list;
+	ListCell	   *lc;
+	FILE		   *file = NULL;
+
+	stmt_list = plan_query_string(sql, NULL, 0, NULL);
+
+	if (filename)
+	{
+		file = fopen(filename, "w");
+		if (file == NULL)
+			elog(ERROR, "cannot create \"%s\"", filename);
+	}
+
+	foreach(lc, stmt_list)
+	{
+		PlannedStmt		   *stmt = (PlannedStmt *) lfirst(lc);
+		QueryDesc		   *qdesc;
+		PlanStateNodeInfo  *nodes;
+		char			  **stacks;
+		double			   *weights;
+		int					num_nodes;
+		bool				run = (weight != FOLDED_WEIGHT_COST);
+		int					i;
+#if PG_VERSION_NUM >= 100000
+		PlanProfile		   *profile = NULL;
+#endif
+
+		if (weight == FOLDED_WEIGHT_SAMPLES)
+		{
+#if PG_VERSION_NUM >= 100000
+			int num_slots = 0;
+
+			qdesc = begin_query(stmt, sql, 0, 0);
+
+			nodes = get_plan_state_nodes(qdesc->planstate, &num_nodes);
+			for (i = 0 ; i < num_nodes ; i++)
+				num_slots = Max(num_slots, ((PlanState *) nodes[i].planstate)->plan->plan_node_id + 1);
+
+			profile = create_plan_profile(num_slots);
+			start_plan_profile(profile, qdesc->planstate);
+
+			PG_TRY();
+			{
+				run_query(qdesc);
+			}
+			PG_CATCH();
+			{
+				stop_plan_profile(profile);
+				PG_RE_THROW();
+			}
+			PG_END_TRY();
+
+			stop_plan_profile(profile);
+#else
+			qdesc = NULL;
+			elog(ERROR, "weight_by \"samples\" requires PostgreSQL 10 or later");
+#endif
+		}
+		else
+			qdesc = start_query(stmt, sql, run ? INSTRUMENT_TIMER : 0, run);
+
+		nodes = get_plan_state_nodes(qdesc->planstate, &num_nodes);
+
+		stacks = (char **) palloc(sizeof(char *) * (num_nodes + 1));
+		weights = (double *) palloc0(sizeof(double) * (num_nodes + 1));
+
+		for (i = 0 ; i < num_nodes ; i++)
+		{
+			PlanState  *ps = (PlanState *) nodes[i].planstate;
+			char	   *frame = folded_frame_name(stmt, ps->plan, nodes[i].node_type);
+
+			/* The walker visits a node's parent before the node */
+			if (nodes[i].parent >= 0)
+			{
+				StringInfoData stack;
+
+				initStringInfo(&stack);
+				appendStringInfo(&stack, "%s;%s", stacks[nodes[i].parent], frame);
+				stacks[i] = stack.data;
+			}
+			else
+				stacks[i] = frame;
+
+			switch (weight)
+			{
+				case FOLDED_WEIGHT_TIME:
+					if (ps->instrument)
+					{
+						InstrEndLoop(ps->instrument);
+						weights[i] = 1000000.0 * ps->instrument->total;
+					}
+					break;
+				case FOLDED_WEIGHT_COST:
+					weights[i] = ps->plan->total_cost;
+					break;
+				case FOLDED_WEIGHT_SAMPLES:
+#if PG_VERSION_NUM >= 100000
+					weights[i] = (double) get_plan_profile_samples(profile, ps->plan->plan_node_id);
+#endif
+					break;
+			}
+		}
+
+		if (weight != FOLDED_WEIGHT_SAMPLES)
+		{
+			double *inclusive = (double *) palloc(sizeof(double) * (num_nodes + 1));
+
+			memcpy(inclusive, weights, sizeof(double) * num_nodes);
+			for (i = 0 ; i < num_nodes ; i++)
+				if (nodes[i].parent >= 0)
+					weights[nodes[i].parent] -= inclusive[i];
+		}
+
+		end_query(qdesc, run);
+
+		for (i = 0 ; i < num_nodes ; i++)
+		{
+			Datum	values[2];
+			bool	nulls[2];
+			int64	w = (int64) rint(weights[i]);
+
+			if (w <= 0)
+				continue;
+
+			memset(nulls, 0, sizeof(nulls));
+
+			values[0] = CStringGetTextDatum(stacks[i]);
+			values[1] = Int64GetDatum(w);
+
+			tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+
+			if (file)
+				fprintf(file, "%s " INT64_FORMAT "\n", stacks[i], w);
+		}
+	}
+
+	if (file)
+		fclose(file);
+}
+
+/*
+ * Returns the frame of a plan node in a folded stack: its type, and the
+ * relation it scans.  Semicolons separate frames and the last space
+ * separates the weight, so semicolons and line breaks are replaced.
+ */
+static char *
+folded_frame_name(PlannedStmt *stmt, Plan *plan, const char *node_type)
+{
+	char		   *relation = plan_relation_name(stmt, plan);
+	StringInfoData	frame;
+	char		   *p;
+
+	initStringInfo(&frame);
+	appendStringInfoString(&frame, node_type);
+	if (relation)
+		appendStringInfo(&frame, " %s", relation);
+
+	for (p = frame.data ; *p ; p++)
+	{
+		if (*p == ';')
+			*p = ':';
+		else if (*p == '\n' || *p == '\r')
+			*p = ' ';
+	}
+
+	return frame.data;
+}
+
+static int
+compare_misestimate_rows(const void *a, const void *b)
+{
+	const MisestimateRow *ra = (const MisestimateRow *) a;
+	const MisestimateRow *rb = (const MisestimateRow *) b;
+
+	if (ra->impact != rb->impact)
+		return (ra->impact > rb->impact) ? -1 : 1;
+
+	return ra->node_id - rb->node_id;
+}
+
+/*
+ * A distinct plan found by plan_tree_sweep()
+ */
+typedef struct SweepPlan
+{
+	char		   *shape;			/* plan_shape_string() of the plan */
+	uint64			fingerprint;
+	PlannedStmt	   *stmt;
+	StringInfoData	ranges;			/* the ranges it was chosen for, as text */
+} SweepPlan;
+
+/*
+ * Plans the first optimizable statement of the string once per step and puts
+ * one row per run of steps with the same plan into tupstore.
+ *
+ * Parse analysis and rewriting do not depend on the planner settings, so they
+ * are done once and each step plans a fresh copy of the rewritten Query.  The
+ * planner's working memory is thrown away after every step; only the first
+ * PlannedStmt of each distinct plan is kept for drawing.
+ */
+static void
+sweep_plans(const char *sql, const char *guc, double from_value, double to_value, int steps, const char *filename, Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	MemoryContext	sweepcontext = CurrentMemoryContext;
+	MemoryContext	stepcontext;
+	Query		   *query;
+	SweepPlan	   *plans;
+	int				num_plans = 0;
+	int			   *step_plan;
+	double		   *step_value;
+	double		   *step_cost;
+	int				i, j;
+
+	query = first_optimizable_query(analyze_query_string(sql, NULL, 0));
+
+	plans		= (SweepPlan *) palloc0(sizeof(SweepPlan) * steps);
+	step_plan	= (int *) palloc(sizeof(int) * steps);
+	step_value	= (double *) palloc(sizeof(double) * steps);
+	step_cost	= (double *) palloc(sizeof(double) * steps);
+
+	stepcontext = AllocSetContextCreate(sweepcontext,
+										"plan_tree_sweep step context",
+										ALLOCSET_DEFAULT_MINSIZE,
+										ALLOCSET_DEFAULT_INITSIZE,
+										ALLOCSET_DEFAULT_MAXSIZE);
+
+	for (i = 0 ; i < steps ; i++)
+	{
+		PlannedStmt	   *stmt;
+		char		   *shape;
+		char			value_str[64];
+		const char	   *value = value_str;
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (steps == 1)
+			step_value[i] = from_value;
+		else
+			step_value[i] = from_value + (to_value - from_value) * i / (steps - 1);
+
+		format_guc_value(step_value[i], value_str, sizeof(value_str));
+
+		MemoryContextSwitchTo(stepcontext);
+
+		stmt = plan_query_with_settings(query, 1, &guc, &value);
+
+		step_cost[i] = stmt->planTree->total_cost;
+		shape = plan_shape_string(stmt, false);
+
+		for (j = 0 ; j < num_plans ; j++)
+			if (strcmp(plans[j].shape, shape) == 0)
+				break;
+
+		MemoryContextSwitchTo(sweepcontext);
+
+		if (j == num_plans)
+		{
+			plans[j].shape			= pstrdup(shape);
+			plans[j].fingerprint	= plan_fingerprint(stmt, false);
+			plans[j].stmt			= (PlannedStmt *) copyObject(stmt);
+			initStringInfo(&plans[j].ranges);
+			num_plans++;
+		}
+
+		step_plan[i] = j;
+
+		MemoryContextReset(stepcontext);
+	}
+
+	MemoryContextDelete(stepcontext);
+
+	for (i = 0 ; i < steps ; i = j)
+	{
+		SweepPlan  *plan = &plans[step_plan[i]];
+		Datum		values[6];
+		bool		nulls[6];
+		char		fingerprint[17];
+
+		for (j = i + 1 ; j < steps && step_plan[j] == step_plan[i] ; j++)
+			;
+
+		memset(nulls, 0, sizeof(nulls));
+
+		snprintf(fingerprint, sizeof(fingerprint), "%08x%08x",
+				 (uint32) (plan->fingerprint >> 32), (uint32) plan->fingerprint);
+
+		values[0] = Int32GetDatum(step_plan[i] + 1);
+		values[1] = Float8GetDatum(step_value[i]);
+		values[2] = Float8GetDatum(step_value[j - 1]);
+		values[3] = CStringGetTextDatum(fingerprint);
+		values[4] = Float8GetDatum(step_cost[i]);
+		values[5] = Float8GetDatum(step_cost[j - 1]);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+
+		appendStringInfo(&plan->ranges, "%s[%g, %g]",
+						 plan->ranges.len > 0 ? ", " : "",
+						 step_value[i], step_value[j - 1]);
+	}
+
+	if (filename != NULL)
+	{
+		PlanTreeDotOptions	options;
+		FILE			   *file;
+
+		memset(&options, 0, sizeof(options));
+
+		file = fopen(filename, "w");
+		if (file == NULL)
+			elog(ERROR, "cannot create \"%s\"", filename);
+
+		for (i = 0 ; i < num_plans ; i++)
+		{
+			StringInfoData title;
+
+			initStringInfo(&title);
+			appendStringInfo(&title, "Plan %d (%s in %s)", i + 1, guc, plans[i].ranges.data);
+			output_plan_tree(title.data, sql, plans[i].stmt, file, &options);
+			pfree(title.data);
+		}
+
+		fclose(file);
+	}
+}
+
+/*
+ * Formats a sweep value for set_config_option().  Whole numbers are printed
+ * without a fraction or exponent, so that integer parameters accept them.
+ */
+static void
+format_guc_value(double value, char *buf, size_t len)
+{
+	if (value == rint(value) && fabs(value) < 1e15)
+		snprintf(buf, len, "%.0f", value);
+	else
+		snprintf(buf, len, "%.17g", value);
+}
+
+/*
+ * A distinct plan found by plan_tree_alternatives()
+ */
+struct AlternativePlan
+{
+	int				plan_no;		/* in the order found; 1 is the default plan */
+	int				mask;			/* switches turned off to get it */
+	char		   *shape;			/* plan_shape_string() of the plan */
+	uint64			fingerprint;
+	PlannedStmt	   *stmt;
+	double			cost;			/* estimated total cost */
+	bool			executed;
+	bool			timed_out;
+	double			actual_ms;
+	char		   *graph;			/* graph of the executed PlanState tree */
+};
+
+/*
+ * Plans the first optimizable statement under every combination of switches
+ * turned off, fewest first, and keeps the first combination that yields each
+ * distinct plan.  With execute, every plan is run in a subtransaction that is
+ * rolled back, so data-modifying statements leave no trace.  Plans that use a
+ * method which was switched off carry the planner's disable_cost in their
+ * estimate and so rank last on cost.
+ */
+static void
+explore_alternatives(const char *sql, const char **switches, int num_switches, bool execute, int timeout_ms, const char *filename, Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	MemoryContext		outercontext = CurrentMemoryContext;
+	MemoryContext		stepcontext;
+	Query			   *query;
+	AlternativePlan	   *plans;
+	const char		  **off_names;
+	const char		  **off_values;
+	int					num_masks = 1 << num_switches;
+	int					num_plans = 0;
+	int					num_off;
+	int					mask, i, j;
+	double				default_cost;
+	double				default_ms = -1.0;
+	FILE			   *file = NULL;
+
+	query = first_optimizable_query(analyze_query_string(sql, NULL, 0));
+
+	plans	= (AlternativePlan *) palloc0(sizeof(AlternativePlan) * num_masks);
+	off_names	= (const char **) palloc(sizeof(char *) * (num_switches + 1));
+	off_values	= (const char **) palloc(sizeof(char *) * (num_switches + 1));
+
+	stepcontext = AllocSetContextCreate(outercontext,
+										"plan_tree_alternatives step context",
+										ALLOCSET_DEFAULT_MINSIZE,
+										ALLOCSET_DEFAULT_INITSIZE,
+										ALLOCSET_DEFAULT_MAXSIZE);
+
+	for (num_off = 0 ; num_off <= num_switches ; num_off++)
+	{
+		for (mask = 0 ; mask < num_masks ; mask++)
+		{
+			PlannedStmt	   *stmt;
+			char		   *shape;
+			int				n = 0;
+
+			for (i = 0 ; i < num_switches ; i++)
+			{
+				if (mask & (1 << i))
+				{
+					off_names[n]	= switches[i];
+					off_values[n]	= "off";
+					n++;
+				}
+			}
+
+			if (n != num_off)
+				continue;
+
+			CHECK_FOR_INTERRUPTS();
+
+			MemoryContextSwitchTo(stepcontext);
+
+			stmt = plan_query_with_settings(query, n, off_names, off_values);
+			shape = plan_shape_string(stmt, false);
+
+			for (j = 0 ; j < num_plans ; j++)
+				if (strcmp(plans[j].shape, shape) == 0)
+					break;
+
+			MemoryContextSwitchTo(outercontext);
+
+			if (j == num_plans)
+			{
+				plans[j].plan_no		= j + 1;
+				plans[j].mask			= mask;
+				plans[j].shape			= pstrdup(shape);
+				plans[j].fingerprint	= plan_fingerprint(stmt, false);
+				plans[j].stmt			= (PlannedStmt *) copyObject(stmt);
+				plans[j].cost			= stmt->planTree->total_cost;
+				num_plans++;
+			}
+
+			MemoryContextReset(stepcontext);
+		}
+	}
+
+	MemoryContextDelete(stepcontext);
+
+	default_cost = plans[0].cost;
+
+	if (execute)
+	{
+		for (i = 0 ; i < num_plans ; i++)
+			run_alternative_plan(&plans[i], sql, timeout_ms, filename != NULL);
+
+		if (plans[0].executed)
+			default_ms = plans[0].actual_ms;
+	}
+
+	qsort(plans, num_plans, sizeof(AlternativePlan), compare_alternative_plans);
+
+	if (filename != NULL)
+	{
+		file = fopen(filename, "w");
+		if (file == NULL)
+			elog(ERROR, "cannot create \"%s\"", filename);
+	}
+
+	for (i = 0 ; i < num_plans ; i++)
+	{
+		AlternativePlan *alt = &plans[i];
+		Datum		values[9];
+		bool		nulls[9];
+		Datum	   *elems;
+		int			num_elems = 0;
+		char		fingerprint[17];
+
+		memset(nulls, 0, sizeof(nulls));
+
+		elems = (Datum *) palloc(sizeof(Datum) * (num_switches + 1));
+		for (j = 0 ; j < num_switches ; j++)
+			if (alt->mask & (1 << j))
+				elems[num_elems++] = CStringGetTextDatum(switches[j]);
+
+		snprintf(fingerprint, sizeof(fingerprint), "%08x%08x",
+				 (uint32) (alt->fingerprint >> 32), (uint32) alt->fingerprint);
+
+		values[0] = Int32GetDatum(i + 1);
+		values[1] = Int32GetDatum(alt->plan_no);
+		if (num_elems > 0)
+			values[2] = PointerGetDatum(construct_array(elems, num_elems, TEXTOID, -1, false, 'i'));
+		else
+			values[2] = PointerGetDatum(construct_empty_array(TEXTOID));
+		values[3] = Float8GetDatum(alt->cost);
+		if (alt->executed)
+			values[4] = Float8GetDatum(alt->actual_ms);
+		else
+			nulls[4] = true;
+		values[5] = BoolGetDatum(alt->timed_out);
+		if (default_cost > 0.0)
+			values[6] = Float8GetDatum(alt->cost / default_cost);
+		else
+			nulls[6] = true;
+		if (alt->executed && default_ms > 0.0)
+			values[7] = Float8GetDatum(alt->actual_ms / default_ms);
+		else
+			nulls[7] = true;
+		values[8] = CStringGetTextDatum(fingerprint);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+
+		if (file != NULL)
+		{
+			if (alt->graph != NULL)
+			{
+				fputs(alt->graph, file);
+				fputs("\n", file);
+			}
+			else
+			{
+				StringInfoData title;
+
+				initStringInfo(&title);
+				appendStringInfo(&title, "Plan %d (rank %d, cost=%.2f%s)",
+								 alt->plan_no, i + 1, alt->cost,
+								 alt->timed_out ? ", timed out" : "");
+				output_plan_tree(title.data, sql, alt->stmt, file, &alternative_options);
+				pfree(title.data);
+			}
+		}
+	}
+
+	if (file != NULL)
+		fclose(file);
+}
+
+/*
+ * Orders alternatives by actual time if they were run, then by estimated
+ * cost.  Plans that timed out follow those that finished.
+ */
+static int
+compare_alternative_plans(const void *a, const void *b)
+{
+	const AlternativePlan *pa = (const AlternativePlan *) a;
+	const AlternativePlan *pb = (const AlternativePlan *) b;
+
+	if (pa->executed != pb->executed)
+		return pa->executed ? -1 : 1;
+
+	if (pa->executed && pa->actual_ms != pb->actual_ms)
+		return (pa->actual_ms < pb->actual_ms) ? -1 : 1;
+
+	if (pa->cost != pb->cost)
+		return (pa->cost < pb->cost) ? -1 : 1;
+
+	return pa->plan_no - pb->plan_no;
+}
+
+/*
+ * Runs one alternative with row and timer instrumentation inside a
+ * subtransaction, which is always rolled back.  If the timeout fires, the
+ * cancel error it raises is caught and the plan is marked as timed out; any
+ * other error is rethrown.  With render, the graph of the PlanState tree is
+ * kept before the executor shuts down.
+ */
+static void
+run_alternative_plan(AlternativePlan *alt, const char *sql, int timeout_ms, bool render)
+{
+	MemoryContext	oldcontext = CurrentMemoryContext;
+	ResourceOwner	oldowner = CurrentResourceOwner;
+
+	BeginInternalSubTransaction(NULL);
+	MemoryContextSwitchTo(oldcontext);
+
+	alternative_timed_out = false;
+
+	PG_TRY();
+	{
+		QueryDesc  *qdesc;
+		instr_time	starttime;
+		instr_time	duration;
+
+#if PG_VERSION_NUM >= 90300
+		if (timeout_ms > 0)
+		{
+			if (alternative_timeout_id == MAX_TIMEOUTS)
+				alternative_timeout_id = RegisterTimeout(USER_TIMEOUT, alternative_timeout_handler);
+			enable_timeout_after(alternative_timeout_id, timeout_ms);
+		}
+#endif
+
+		INSTR_TIME_SET_CURRENT(starttime);
+
+		qdesc = start_query((PlannedStmt *) copyObject(alt->stmt), sql,
+							INSTRUMENT_ROWS | INSTRUMENT_TIMER, true);
+
+		INSTR_TIME_SET_CURRENT(duration);
+		INSTR_TIME_SUBTRACT(duration, starttime);
+
+#if PG_VERSION_NUM >= 90300
+		if (timeout_ms > 0)
+			disable_timeout(alternative_timeout_id, false);
+
+		/* The query finished before the pending cancel was noticed */
+		if (alternative_timed_out)
+			QueryCancelPending = false;
+#endif
+
+		alt->executed	= true;
+		alt->actual_ms	= INSTR_TIME_GET_MILLISEC(duration);
+
+		if (render)
+		{
+			char title[128];
+
+			snprintf(title, sizeof(title), "Plan %d (cost=%.2f, actual=%.3f ms)",
+					 alt->plan_no, alt->cost, alt->actual_ms);
+			alt->graph = render_plan_tree(title, sql, qdesc->planstate, &alternative_options);
+		}
+
+		end_query(qdesc, true);
+
+		RollbackAndReleaseCurrentSubTransaction();
+		MemoryContextSwitchTo(oldcontext);
+		CurrentResourceOwner = oldowner;
+	}
+	PG_CATCH();
+	{
+		ErrorData  *edata;
+
+#if PG_VERSION_NUM >= 90300
+		if (timeout_ms > 0)
+			disable_timeout(alternative_timeout_id, false);
+#endif
+
+		MemoryContextSwitchTo(oldcontext);
+		edata = CopyErrorData();
+		FlushErrorState();
+
+		RollbackAndReleaseCurrentSubTransaction();
+		MemoryContextSwitchTo(oldcontext);
+		CurrentResourceOwner = oldowner;
+
+		if (!alternative_timed_out || edata->sqlerrcode != ERRCODE_QUERY_CANCELED)
+			ReThrowError(edata);
+
+		alt->timed_out = true;
+		FreeErrorData(edata);
+	}
+	PG_END_TRY();
+}
+
+#if PG_VERSION_NUM >= 90300
+/*
+ * Cancels the running alternative the same way statement_timeout would.
+ */
+static void
+alternative_timeout_handler(void)
+{
+	alternative_timed_out = true;
+	QueryCancelPending = true;
+	InterruptPending = true;
+#if PG_VERSION_NUM >= 90500
+	SetLatch(MyLatch);
+#else
+	SetLatch(&MyProc->procLatch);
+#endif
+}
+#endif
+
+/*
+ * Times each phase of rendering.  Every iteration parses and plans from
+ * scratch in a context of its own, whose growth is the memory reported for
+ * parse and plan; walk and label report the renderer's own context.  The
+ * graphs are written to the file, normally /dev/null, to time the writes.
+ */
+static void
+benchmark_plan_tree(const char *sql, int iterations, const char *filename, Tuplestorestate *tupstore, TupleDesc tupdesc)
+{
+	MemoryContext		outercontext = CurrentMemoryContext;
+	PlanTreeDotOptions	options;
+	PlanTreeDotStats	stats;
+	double				total_ms[NUM_RENDER_PHASES];
+	Size				peak_bytes[NUM_RENDER_PHASES];
+	int					num_nodes = 0;
+	FILE			   *file;
+	int					i;
+
+	memset(&options, 0, sizeof(options));
+	memset(total_ms, 0, sizeof(total_ms));
+	memset(peak_bytes, 0, sizeof(peak_bytes));
+
+	options.stats = &stats;
+
+	file = fopen(filename, "w");
+	if (file == NULL)
+		elog(ERROR, "cannot create \"%s\"", filename);
+
+	for (i = 0 ; i < iterations ; i++)
+	{
+		MemoryContext	itercontext;
+		List		   *query_list;
+		List		   *stmt_list;
+		ListCell	   *lc;
+		instr_time		starttime;
+		instr_time		duration;
+		Size			parse_bytes;
+		Size			plan_bytes;
+
+		CHECK_FOR_INTERRUPTS();
+
+		itercontext = AllocSetContextCreate(outercontext,
+											"plan_tree_dot_benchmark iteration context",
+											ALLOCSET_DEFAULT_MINSIZE,
+											ALLOCSET_DEFAULT_INITSIZE,
+											ALLOCSET_DEFAULT_MAXSIZE);
+		MemoryContextSwitchTo(itercontext);
+
+		INSTR_TIME_SET_CURRENT(starttime);
+		query_list = analyze_query_string(sql, NULL, 0);
+		INSTR_TIME_SET_CURRENT(duration);
+		INSTR_TIME_SUBTRACT(duration, starttime);
+		total_ms[RENDER_PARSE] += INSTR_TIME_GET_MILLISEC(duration);
+
+		parse_bytes = memory_context_total_space(itercontext);
+		peak_bytes[RENDER_PARSE] = Max(peak_bytes[RENDER_PARSE], parse_bytes);
+
+		INSTR_TIME_SET_CURRENT(starttime);
+		stmt_list = pg_plan_queries(query_list, 0, NULL);
+		INSTR_TIME_SET_CURRENT(duration);
+		INSTR_TIME_SUBTRACT(duration, starttime);
+		total_ms[RENDER_PLAN] += INSTR_TIME_GET_MILLISEC(duration);
+
+		plan_bytes = memory_context_total_space(itercontext) - parse_bytes;
+		peak_bytes[RENDER_PLAN] = Max(peak_bytes[RENDER_PLAN], plan_bytes);
+
+		foreach(lc, stmt_list)
+		{
+			Node   *stmt = (Node *) lfirst(lc);
+			char   *result;
+
+			if (!IsA(stmt, PlannedStmt) ||
+				((PlannedStmt *) stmt)->utilityStmt != NULL)
+				continue;
+
+			memset(&stats, 0, sizeof(stats));
+
+			result = render_plan_tree("Plan Tree", sql, stmt, &options);
+
+			total_ms[RENDER_WALK]	+= stats.walk_ms;
+			total_ms[RENDER_LABEL]	+= stats.label_ms;
+			peak_bytes[RENDER_WALK]	= Max(peak_bytes[RENDER_WALK], stats.walk_bytes);
+			peak_bytes[RENDER_LABEL]	= Max(peak_bytes[RENDER_LABEL], stats.peak_bytes);
+			peak_bytes[RENDER_WRITE]	= Max(peak_bytes[RENDER_WRITE], stats.output_bytes);
+
+			if (i == 0)
+				num_nodes += stats.num_nodes;
+
+			INSTR_TIME_SET_CURRENT(starttime);
+			fputs(result, file);
+			fputs("\n", file);
+			fflush(file);
+			INSTR_TIME_SET_CURRENT(duration);
+			INSTR_TIME_SUBTRACT(duration, starttime);
+			total_ms[RENDER_WRITE] += INSTR_TIME_GET_MILLISEC(duration);
+
+			pfree(result);
+		}
+
+		MemoryContextSwitchTo(outercontext);
+		MemoryContextDelete(itercontext);
+	}
+
+	fclose(file);
+
+	for (i = 0 ; i < NUM_RENDER_PHASES ; i++)
+	{
+		Datum	values[5];
+		bool	nulls[5];
+
+		memset(nulls, 0, sizeof(nulls));
+
+		values[0] = CStringGetTextDatum(render_phase_names[i]);
+		values[1] = Float8GetDatum(total_ms[i] / iterations);
+		values[2] = Int32GetDatum(num_nodes);
+		if (total_ms[i] > 0.0)
+			values[3] = Float8GetDatum(1000.0 * num_nodes * iterations / total_ms[i]);
+		else
+			nulls[3] = true;
+		values[4] = Int64GetDatum((int64) peak_bytes[i]);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+}
+
+/*
+ * Plans the first optimizable statement without and with the hypothetical
+ * indexes, reusing one parse/rewrite result, and writes both graphs.
+ */
+static void
+output_whatif_query(const char *sql, char **index_defs, int num_defs, const char *filename, const PlanTreeDotOptions *options)
+{
+	Query			   *query;
+	PlannedStmt		   *baseline;
+	PlannedStmt		   *whatif = NULL;
+	PlanTreeDotOptions	whatif_options = *options;
+	FILE			   *file;
+	char				title[256];
+	instr_time			starttime;
+
+	query = first_optimizable_query(analyze_query_string(sql, NULL, 0));
+
+	INSTR_TIME_SET_CURRENT(starttime);
+	baseline = pg_plan_query((Query *) copyObject(query), 0, NULL);
+	render_stats_add(RENDER_PLAN, elapsed_ms(starttime));
+
+	begin_hypothetical_indexes(num_defs, index_defs);
+
+	PG_TRY();
+	{
+		INSTR_TIME_SET_CURRENT(starttime);
+		whatif = pg_plan_query((Query *) copyObject(query), 0, NULL);
+		render_stats_add(RENDER_PLAN, elapsed_ms(starttime));
+
+		whatif_options.relation_names =
+			get_hypothetical_index_names(&whatif_options.num_relation_names);
+	}
+	PG_CATCH();
+	{
+		end_hypothetical_indexes();
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	end_hypothetical_indexes();
+
+	whatif_options.node_marks = mark_cost_deltas(baseline, whatif, &whatif_options.num_node_marks);
+
+	file = fopen(filename, "w");
+	if (file == NULL)
+		elog(ERROR, "cannot create \"%s\"", filename);
+
+	snprintf(title, sizeof(title), "Baseline Plan (cost=%.2f)", baseline->planTree->total_cost);
+	output_plan_tree(title, sql, baseline, file, options);
+
+	snprintf(title, sizeof(title), "What-if Plan (cost=%.2f, %+.2f vs baseline)",
+			 whatif->planTree->total_cost,
+			 whatif->planTree->total_cost - baseline->planTree->total_cost);
+	output_plan_tree(title, sql, whatif, file, &whatif_options);
+
+	fclose(file);
+}
+
+/*
+ * A plan node with the range table entries scanned below it
+ */
+typedef struct CostNode
+{
+	Plan	   *plan;
+	Bitmapset  *relids;
+	int			occurrence;		/* earlier nodes with the same relids */
+} CostNode;
+
+/*
+ * Colors every node of the what-if plan by its cost change.  A node is
+ * compared with the baseline node that scans the same relations and is as
+ * many nodes down from the topmost such node, so a new index scan is
+ * compared with whatever produced that table's rows before, e.g. a Sort
+ * over a SeqScan.  Both plans come from the same Query, so their range
+ * table indexes agree.
+ */
+static PlanTreeDotNodeMark *
+mark_cost_deltas(PlannedStmt *baseline, PlannedStmt *whatif, int *num_marks)
+{
+	List			   *base_nodes = collect_cost_nodes(baseline);
+	List			   *whatif_nodes = collect_cost_nodes(whatif);
+	PlanTreeDotNodeMark *marks;
+	ListCell		   *lc1;
+	int					n = 0;
+
+	marks = (PlanTreeDotNodeMark *) palloc0(sizeof(PlanTreeDotNodeMark) *
+											(list_length(whatif_nodes) + 1));
+
+	foreach(lc1, whatif_nodes)
+	{
+		CostNode   *node = (CostNode *) lfirst(lc1);
+		CostNode   *match = NULL;
+		ListCell   *lc2;
+		StringInfoData note;
+		double		delta;
+		double		ratio;
+
+		foreach(lc2, base_nodes)
+		{
+			CostNode *base = (CostNode *) lfirst(lc2);
+
+			if (base->occurrence == node->occurrence && bms_equal(base->relids, node->relids))
+			{
+				match = base;
+				break;
+			}
+		}
+
+		marks[n].node = node->plan;
+
+		if (match == NULL)
+		{
+			marks[n].color	= WHATIF_UNMATCHED_COLOR;
+			marks[n].note	= "cost delta: no baseline node";
+			n++;
+			continue;
+		}
+
+		delta = node->plan->total_cost - match->plan->total_cost;
+		ratio = (match->plan->total_cost > 0.0) ? delta / match->plan->total_cost : 0.0;
+
+		if (ratio <= -0.5)
+			marks[n].color = WHATIF_MUCH_CHEAPER_COLOR;
+		else if (ratio <= -0.01)
+			marks[n].color = WHATIF_CHEAPER_COLOR;
+		else if (ratio >= 0.5)
+			marks[n].color = WHATIF_MUCH_COSTLIER_COLOR;
+		else if (ratio >= 0.01)
+			marks[n].color = WHATIF_COSTLIER_COLOR;
+
+		initStringInfo(&note);
+		appendStringInfo(&note, "cost delta: %+.2f (%+.1f%%)", delta, ratio * 100.0);
+		marks[n].note = note.data;
+		n++;
+	}
+
+	*num_marks = n;
+
+	return marks;
+}
+
+/*
+ * Lists the nodes of the plan tree and its subplans, each parent before its
+ * children.
+ */
+static List *
+collect_cost_nodes(PlannedStmt *stmt)
+{
+	List	   *nodes = NIL;
+	ListCell   *lc1;
+	ListCell   *lc2;
+
+	(void) collect_cost_nodes_walker(stmt->planTree, &nodes);
+
+	foreach(lc1, stmt->subplans)
+		(void) collect_cost_nodes_walker((Plan *) lfirst(lc1), &nodes);
+
+	foreach(lc1, nodes)
+	{
+		CostNode *node = (CostNode *) lfirst(lc1);
+
+		foreach(lc2, nodes)
+		{
+			CostNode *earlier = (CostNode *) lfirst(lc2);
+
+			if (earlier == node)
+				break;
+			if (bms_equal(earlier->relids, node->relids))
+				node->occurrence++;
+		}
+	}
+
+	return nodes;
+}
+
+static Bitmapset *
+collect_cost_nodes_walker(Plan *plan, List **nodes)
+{
+	CostNode   *node;
+	Bitmapset  *relids = NULL;
+	Index		scanrelid;
+	ListCell   *lc;
+
+	if (plan == NULL)
+		return NULL;
+
+	node = (CostNode *) palloc0(sizeof(CostNode));
+	node->plan = plan;
+	*nodes = lappend(*nodes, node);
+
+	scanrelid = plan_scanrelid(plan);
+	if (scanrelid > 0)
+		relids = bms_add_member(relids, (int) scanrelid);
+
+	foreach(lc, plan_child_plans(plan))
+		relids = bms_add_members(relids, collect_cost_nodes_walker((Plan *) lfirst(lc), nodes));
+
+	node->relids = relids;
+
+	return relids;
+}
+
+/*
+ * Returns the range table index a scan node reads, or 0 for other nodes.
+ */
+static Index
+plan_scanrelid(Plan *plan)
+{
+	switch (nodeTag(plan))
+	{
+		case T_SeqScan:
+#if PG_VERSION_NUM >= 90500
+		case T_SampleScan:
+		case T_CustomScan:
+#endif
+		case T_IndexScan:
+#if PG_VERSION_NUM >= 90200
+		case T_IndexOnlyScan:
+#endif
+		case T_BitmapIndexScan:
+		case T_BitmapHeapScan:
+		case T_TidScan:
+		case T_SubqueryScan:
+		case T_FunctionScan:
+		case T_ValuesScan:
+		case T_CteScan:
+		case T_WorkTableScan:
+#if PG_VERSION_NUM >= 90100
+		case T_ForeignScan:
+#endif
+#if PG_VERSION_NUM >= 100000
+		case T_TableFuncScan:
+		case T_NamedTuplestoreScan:
+#endif
+			return ((Scan *) plan)->scanrelid;
+		default:
+			return 0;
+	}
+}
+
+/*
+ * Plans a copy of the query with the given configuration parameters set.
+ * They are set at a new GUC nesting level and restored before returning;
+ * on an error they are undone with the rest of the transaction.
+ */
+static PlannedStmt *
+plan_query_with_settings(Query *query, int num_settings, const char **names, const char **values)
+{
+	PlannedStmt	   *stmt;
+	int				nestlevel;
+	int				i;
+	instr_time		starttime;
+
+	INSTR_TIME_SET_CURRENT(starttime);
+
+	nestlevel = NewGUCNestLevel();
+
+	for (i = 0 ; i < num_settings ; i++)
+	{
+#if PG_VERSION_NUM >= 90500
+		(void) set_config_option(names[i], values[i],
+								 superuser() ? PGC_SUSET : PGC_USERSET,
+								 PGC_S_SESSION, GUC_ACTION_SAVE, true, ERROR, false);
+#elif PG_VERSION_NUM >= 90200
+		(void) set_config_option(names[i], values[i],
+								 superuser() ? PGC_SUSET : PGC_USERSET,
+								 PGC_S_SESSION, GUC_ACTION_SAVE, true, ERROR);
+#else
+		(void) set_config_option(names[i], values[i],
+								 superuser() ? PGC_SUSET : PGC_USERSET,
+								 PGC_S_SESSION, GUC_ACTION_SAVE, true);
+#endif
+	}
+
+	stmt = pg_plan_query((Query *) copyObject(query), 0, NULL);
+
+	AtEOXact_GUC(true, nestlevel);
+
+	render_stats_add(RENDER_PLAN, elapsed_ms(starttime));
+
+	return stmt;
+}
+
+/*
+ * Returns the first Query of the list that is not a utility statement.
+ */
+static Query *
+first_optimizable_query(List *query_list)
+{
+	ListCell *lc;
+
+	foreach(lc, query_list)
+	{
+		Query *query = (Query *) lfirst(lc);
+
+		if (query->commandType != CMD_UTILITY)
+			return query;
+	}
+
+	elog(ERROR, "query string contains no optimizable statement");
+
+	return NULL;				/* keep compiler quiet */
+}
+
+/*
+ * Sets up a set-returning function to return its rows in materialize mode,
+ * and returns the tuplestore to put them into.
+ */
+static Tuplestorestate *
+begin_materialized_srf(FunctionCallInfo fcinfo, TupleDesc *tupdesc)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Tuplestorestate *tupstore;
+	TupleDesc	desc;
+	MemoryContext oldcontext;
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		elog(ERROR, "set-valued function called in context that cannot accept a set");
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		elog(ERROR, "materialize mode required, but it is not allowed in this context");
+
+	if (get_call_result_type(fcinfo, NULL, &desc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+	desc = CreateTupleDescCopy(desc);
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = desc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	*tupdesc = desc;
+
+	return tupstore;
+}
+
+/*
+ * Plans the first optimizable statement of the string into a context of its
+ * own and walks it.  The context goes away with the caller's if anything
+ * fails, and is moved under TopMemoryContext once the handle is complete.
+ */
+static PlanTreeHandle *
+open_plan_tree_handle(const char *sql, const PlanTreeDotOptions *options)
+{
+	MemoryContext	handlecontext, oldcontext;
+	PlanTreeHandle *handle;
+	PlannedStmt	   *stmt = NULL;
+	PlanTreeIndex  *index;
+	ListCell	   *lc;
+
+	/* Before 9.2 a context cannot be moved, so a failure leaks it */
+#if PG_VERSION_NUM >= 90200
+	handlecontext = AllocSetContextCreate(CurrentMemoryContext,
+#else
+	handlecontext = AllocSetContextCreate(TopMemoryContext,
+#endif
+										  "plan tree handle context",
+										  ALLOCSET_DEFAULT_MINSIZE,
+										  ALLOCSET_DEFAULT_INITSIZE,
+										  ALLOCSET_DEFAULT_MAXSIZE);
+
+	oldcontext = MemoryContextSwitchTo(handlecontext);
+
+	foreach(lc, plan_query_string(sql, NULL, 0, NULL))
+	{
+		Node *node = (Node *) lfirst(lc);
+
+		if (IsA(node, PlannedStmt) && ((PlannedStmt *) node)->utilityStmt == NULL)
+		{
+			stmt = (PlannedStmt *) node;
+			break;
+		}
+	}
+
+	if (stmt == NULL)
+		elog(ERROR, "query has no plan");
+
+	index = open_plan_tree_index(stmt, options);
+
+	MemoryContextSwitchTo(TopMemoryContext);
+
+	handle = (PlanTreeHandle *) palloc(sizeof(PlanTreeHandle));
+	handle->id		= next_plan_tree_handle++;
+	handle->context	= handlecontext;
+	handle->stmt	= stmt;
+	handle->index	= index;
+
+	plan_tree_handles = lappend(plan_tree_handles, handle);
+
+#if PG_VERSION_NUM >= 90200
+	MemoryContextSetParent(handlecontext, TopMemoryContext);
+#endif
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return handle;
+}
+
+static PlanTreeHandle *
+find_plan_tree_handle(int id)
+{
+	ListCell *lc;
+
+	foreach(lc, plan_tree_handles)
+	{
+		PlanTreeHandle *handle = (PlanTreeHandle *) lfirst(lc);
+
+		if (handle->id == id)
+			return handle;
+	}
+
+	elog(ERROR, "plan tree handle %d does not exist", id);
+
+	return NULL;				/* keep compiler quiet */
+}
+
+/*
+ * Parses, analyzes and rewrites every statement in the string, and returns
+ * the resulting Query list.
+ */
+static List *
+analyze_query_string(const char *sql, Oid *param_types, int num_params)
+{
+	List		   *raw_parsetree_list;
+	List		   *result = NIL;
+	ListCell	   *lc;
+	instr_time		starttime;
+
+	INSTR_TIME_SET_CURRENT(starttime);
+
+	raw_parsetree_list = pg_parse_query(sql);
+
+	foreach(lc, raw_parsetree_list)
+	{
+#if PG_VERSION_NUM >= 100000
+		RawStmt	   *parsetree = lfirst_node(RawStmt, lc);
+
+		result = list_concat(result,
+							 pg_analyze_and_rewrite(parsetree, sql, param_types, num_params, NULL));
+#else
+		Node	   *parsetree = (Node *) lfirst(lc);
+
+		result = list_concat(result,
+							 pg_analyze_and_rewrite(parsetree, sql, param_types, num_params));
+#endif
+	}
+
+	render_stats_add(RENDER_PARSE, elapsed_ms(starttime));
+
+	return result;
+}
+
+/*
+ * Parses, analyzes and plans every statement in the string, and returns the
+ * PlannedStmts of those that the executor can run.
+ */
+static List *
+plan_query_string(const char *sql, Oid *param_types, int num_params, ParamListInfo params)
+{
+	List		   *stmt_list;
+	List		   *result = NIL;
+	ListCell	   *lc;
+	instr_time		starttime;
+
+	stmt_list = analyze_query_string(sql, param_types, num_params);
+
+	INSTR_TIME_SET_CURRENT(starttime);
+	stmt_list = pg_plan_queries(stmt_list, 0, params);
+	render_stats_add(RENDER_PLAN, elapsed_ms(starttime));
+
+	foreach(lc, stmt_list)
+	{
+		Node	   *stmt = (Node *) lfirst(lc);
+
+		if (IsA(stmt, PlannedStmt) &&
+			((PlannedStmt *) stmt)->utilityStmt == NULL)
+			result = lappend(result, stmt);
+	}
+
+	return result;
+}
+
+/*
+ * Starts the executor on a planned statement, and with run also runs it to
+ * completion, discarding the result.  end_query() must follow.
+ */
+static QueryDesc *
+start_query(PlannedStmt *stmt, const char *sql, int instrument_options, bool run)
+{
+	QueryDesc  *qdesc;
+
+	qdesc = begin_query(stmt, sql, instrument_options, run ? 0 : EXEC_FLAG_EXPLAIN_ONLY);
+
+	if (run)
+		run_query(qdesc);
+
+	return qdesc;
+}
+
+/*
+ * Starts the executor on a planned statement with the given flags, without
+ * running it.  end_query() must follow.
+ */
+static QueryDesc *
+begin_query(PlannedStmt *stmt, const char *sql, int instrument_options, int eflags)
+{
+	QueryDesc  *qdesc;
+
+	/* Let the query see the effects of earlier statements */
+	PushCopiedSnapshot(GetActiveSnapshot());
+	UpdateActiveSnapshotCommandId();
+
+	qdesc = CreateQueryDesc(stmt,
+							sql,
+							GetActiveSnapshot(), InvalidSnapshot,
+							CreateDestReceiver(DestNone), NULL,
+#if PG_VERSION_NUM >= 100000
+							NULL,
+#endif
+							instrument_options);
+
+	ExecutorStart(qdesc, eflags);
+
+	return qdesc;
+}
+
+/*
+ * Runs a query started by begin_query() to completion, discarding the
+ * result.
+ */
+static void
+run_query(QueryDesc *qdesc)
+{
+#if PG_VERSION_NUM >= 100000
+	ExecutorRun(qdesc, ForwardScanDirection, 0L, true);
+#else
+	ExecutorRun(qdesc, ForwardScanDirection, 0L);
+#endif
+	ExecutorFinish(qdesc);
+}
+
+static void
+end_query(QueryDesc *qdesc, bool run)
+{
+	ExecutorEnd(qdesc);
+	FreeQueryDesc(qdesc);
+
+	PopActiveSnapshot();
+
+	if (run)
+		CommandCounterIncrement();
+}
+
+/*
+ * Returns the name of the relation or index a scan node reads, or NULL.
+ */
+static char *
+plan_relation_name(PlannedStmt *stmt, Plan *plan)
+{
+	Index			scanrelid;
+	RangeTblEntry  *rte;
+
+	switch (nodeTag(plan))
+	{
+		case T_SeqScan:
+#if PG_VERSION_NUM >= 90500
+		case T_SampleScan:
+		case T_CustomScan:
+#endif
+		case T_IndexScan:
+#if PG_VERSION_NUM >= 90200
+		case T_IndexOnlyScan:
+#endif
+		case T_BitmapHeapScan:
+		case T_TidScan:
+#if PG_VERSION_NUM >= 90100
+		case T_ForeignScan:
+#endif
+			scanrelid = ((Scan *) plan)->scanrelid;
+			break;
+		case T_BitmapIndexScan:
+			return get_rel_name(((BitmapIndexScan *) plan)->indexid);
+		default:
+			return NULL;
+	}
+
+	if (scanrelid == 0 || scanrelid > (Index) list_length(stmt->rtable))
+		return NULL;
+
+	rte = rt_fetch(scanrelid, stmt->rtable);
+	if (rte->rtekind != RTE_RELATION)
+		return NULL;
+
+	return get_rel_name(rte->relid);
+}
+
+#if PG_VERSION_NUM >= 90200
+/*
+ * Writes the generic plan of the prepared statement and, if parameter values
+ * are given, the custom plan for them.  The titles carry the plan costs and
+ * the plancache's custom plan statistics, which are what choose_custom_plan()
+ * bases the generic-vs-custom decision on.
+ */
+static void
+output_prepared_statement(const char *stmt_name, const char *filename, ArrayType *values, const PlanTreeDotOptions *options)
+{
+	PreparedStatement  *entry;
+	CachedPlanSource   *plansource;
+	CachedPlan		   *cplan;
+	const char		   *sql;
+	FILE			   *file;
+	int					num_custom_plans;
+	double				total_custom_cost;
+	double				generic_cost;
+	char				title[256];
+
+	entry = FetchPreparedStatement(stmt_name, true);
+	plansource = entry->plansource;
+	sql = plansource->query_string ? plansource->query_string : "";
+
+	file = fopen(filename, "w");
+	if (file == NULL)
+		elog(ERROR, "cannot create \"%s\"", filename);
+
+	/*
+	 * Building plans for display must not count as executions, or it would
+	 * shift the point at which the plancache switches to the generic plan.
+	 */
+	num_custom_plans	= plansource->num_custom_plans;
+	total_custom_cost	= plansource->total_custom_cost;
+
+	cplan = get_forced_cached_plan(plansource, NULL, CURSOR_OPT_GENERIC_PLAN);
+	generic_cost = plan_list_cost(cplan->stmt_list);
+
+	if (num_custom_plans > 0)
+		snprintf(title, sizeof(title),
+				 "Generic Plan (cost=%.2f, custom plans=%d, avg custom cost=%.2f)",
+				 generic_cost, num_custom_plans, total_custom_cost / num_custom_plans);
+	else
+		snprintf(title, sizeof(title),
+				 "Generic Plan (cost=%.2f, custom plans=0)", generic_cost);
+
+	output_plan_list(title, sql, cplan->stmt_list, file, options);
+
+	ReleaseCachedPlan(cplan, true);
+
+	if (values != NULL)
+	{
+		ParamListInfo params;
+		double custom_cost;
+
+		params = make_param_list(plansource->num_params, plansource->param_types, values);
+
+		cplan = get_forced_cached_plan(plansource, params, CURSOR_OPT_CUSTOM_PLAN);
+		custom_cost = plan_list_cost(cplan->stmt_list);
+
+		plansource->num_custom_plans	= num_custom_plans;
+		plansource->total_custom_cost	= total_custom_cost;
+
+		/* Transaction control statements never get a custom plan */
+		snprintf(title, sizeof(title),
+				 "%s Plan (cost=%.2f, %+.2f vs generic)",
+				 (cplan == plansource->gplan) ? "Generic" : "Custom",
+				 custom_cost, custom_cost - generic_cost);
+
+		output_plan_list(title, sql, cplan->stmt_list, file, options);
+
+		ReleaseCachedPlan(cplan, true);
+	}
+
+	fclose(file);
+}
+
+/*
+ * Gets a plan from the plancache with the generic-vs-custom choice forced by
+ * cursor_option.  The plans are tracked by the resource owner, so they are
+ * released if an error occurs before ReleaseCachedPlan().
+ */
+static CachedPlan *
+get_forced_cached_plan(CachedPlanSource *plansource, ParamListInfo params, int cursor_option)
+{
+	CachedPlan *cplan;
+	int			cursor_options = plansource->cursor_options;
+	instr_time	starttime;
+
+	INSTR_TIME_SET_CURRENT(starttime);
+
+	plansource->cursor_options &= ~(CURSOR_OPT_GENERIC_PLAN | CURSOR_OPT_CUSTOM_PLAN);
+	plansource->cursor_options |= cursor_option;
+
+	PG_TRY();
+	{
+#if PG_VERSION_NUM >= 100000
+		cplan = GetCachedPlan(plansource, params, true, NULL);
+#else
+		cplan = GetCachedPlan(plansource, params, true);
+#endif
+	}
+	PG_CATCH();
+	{
+		plansource->cursor_options = cursor_options;
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	plansource->cursor_options = cursor_options;
+
+	render_stats_add(RENDER_PLAN, elapsed_ms(starttime));
+
+	return cplan;
+}
+#endif
+
+/*
+ * Builds a ParamListInfo from an array of parameter values in text form.
+ * A NULL element gives an SQL NULL.  The values are marked PARAM_FLAG_CONST
+ * so that the planner can use them to build a custom plan.
+ */
+static ParamListInfo
+make_param_list(int num_params, const Oid *param_types, ArrayType *values)
+{
+	ParamListInfo	params;
+	Datum		   *elems;
+	bool		   *nulls;
+	int				nelems;
+	int				i;
+
+	if (ARR_NDIM(values) > 1)
+		elog(ERROR, "parameter values must be a one-dimensional array");
+
+	deconstruct_array(values, TEXTOID, -1, false, 'i', &elems, &nulls, &nelems);
+
+	if (nelems != num_params)
+		elog(ERROR, "wrong number of parameter values: %d given, %d expected",
+			 nelems, num_params);
+
+#if PG_VERSION_NUM >= 110000
+	params = makeParamList(num_params);
+#else
+	params = (ParamListInfo) palloc0(offsetof(ParamListInfoData, params) +
+									 num_params * sizeof(ParamExternData));
+	params->numParams = num_params;
+#endif
+
+	for (i = 0 ; i < num_params ; i++)
+	{
+		ParamExternData *prm = &params->params[i];
+		Oid		ptype = param_types[i];
+
+		/* Untyped parameters are taken as text */
+		if (!OidIsValid(ptype) || ptype == UNKNOWNOID)
+			ptype = TEXTOID;
+
+		prm->ptype	= ptype;
+		prm->pflags	= PARAM_FLAG_CONST;
+
+		if (nulls[i])
+		{
+			prm->value	= (Datum) 0;
+			prm->isnull	= true;
+		}
+		else
+		{
+			Oid		typinput, typioparam;
+			char   *str;
+
+			getTypeInputInfo(ptype, &typinput, &typioparam);
+
+			str = TextDatumGetCString(elems[i]);
+			prm->value	= OidInputFunctionCall(typinput, str, typioparam, -1);
+			prm->isnull	= false;
+		}
+	}
+
+	return params;
+}
+
+/*
+ * Returns the total cost of the first optimizable statement in the list.
+ */
+static double
+plan_list_cost(List *stmt_list)
+{
+	ListCell *lc;
+
+	foreach(lc, stmt_list)
+	{
+		Node *stmt = (Node *) lfirst(lc);
+
+		if (IsA(stmt, PlannedStmt) &&
+			((PlannedStmt *) stmt)->utilityStmt == NULL)
+			return ((PlannedStmt *) stmt)->planTree->total_cost;
+	}
+
+	return 0.0;
+}
+
+/*
+ * Writes every optimizable statement of a plan list.
+ */
+static void
+output_plan_list(const char *title, const char *sql, List *stmt_list, FILE *file, const PlanTreeDotOptions *options)
+{
+	ListCell *lc;
+
+	foreach(lc, stmt_list)
+	{
+		Node *stmt = (Node *) lfirst(lc);
+
+		if (IsA(stmt, PlannedStmt) &&
+			((PlannedStmt *) stmt)->utilityStmt == NULL)
+			output_plan_tree(title, sql, stmt, file, options);
+	}
+}
+
+/*
+ *
+ */
+static void
+output_plan_tree(const char *title, const char *sql, const void *obj, FILE *file, const PlanTreeDotOptions *options)
+{
+	PlanTreeDotOptions	graph_options = *options;
+	PlanTreeDotStats	stats;
+	uint64				cache_key = 0;
+	bool				cacheable;
+	char			   *result = NULL;
+	instr_time			starttime;
+	double				write_ms;
+
+	memset(&stats, 0, sizeof(stats));
+	graph_options.stats = &stats;
+
+	cacheable = render_cache_key(title, sql, obj, options, &cache_key);
+	if (cacheable)
+		result = render_cache_lookup(cache_key, &stats);
+
+	if (result == NULL)
+	{
+		result = render_plan_tree(title, sql, obj, &graph_options);
+
+		if (cacheable && result)
+			render_cache_store(cache_key, (const PlannedStmt *) obj, result, &stats);
+	}
+
+	INSTR_TIME_SET_CURRENT(starttime);
+
+	if (result)
+	{
+		fputs(result, file);
+		fputs("\n", file);
+		fflush(file);
+	}
+
+	write_ms = elapsed_ms(starttime);
+
+	render_stats_add_graph(&stats);
+	render_stats_add(RENDER_WRITE, write_ms);
+
+	if (result && options->format == PLAN_TREE_FORMAT_DOT && render_stats_comment_enabled())
+	{
+		const RenderStats *call = render_stats_last();
+
+		fprintf(file,
+				"// parse %.3f ms, plan %.3f ms, walk %.3f ms, label %.3f ms, write %.3f ms, "
+				"%d nodes, %d edges, peak %ld kB\n",
+				call->phase_ms[RENDER_PARSE], call->phase_ms[RENDER_PLAN],
+				stats.walk_ms, stats.label_ms, write_ms,
+				stats.num_nodes, stats.num_edges,
+				(long) ((call->peak_bytes + 1023) / 1024));
+		fflush(file);
+	}
+
+	if (result)
+		pfree(result);
+	if (cache_key)
+		pfree(cache_key);
+}
+
+/*
+ * Returns the graph of a Plan or PlanState tree, titled with the title and
+ * the query text.  Unless the caller collects the statistics itself, the
+ * graph is counted in the current call's.
+ */
+static char *
+render_plan_tree(const char *title, const char *sql, const void *obj, const PlanTreeDotOptions *options)
+{
+	PlanTreeDotOptions	graph_options = *options;
+	PlanTreeDotStats	stats;
+	char *p, *buffer, *result;
+
+	if (graph_options.stats == NULL)
+	{
+		memset(&stats, 0, sizeof(stats));
+		graph_options.stats = &stats;
+	}
+
+	/* buffer = (char *) palloc(strlen(title) + strlen(debug_query_string) + 3); */
+	buffer = (char *) palloc(strlen(title) + strlen(sql) + 3);
+
+	sprintf(buffer, "%s: %s", title, sql);
+	
+	for (p = buffer; *p ; p++)
+	{
+		switch (*p)
+		{
+			case '\t':
+				*p = ' ';
+				break;
+			case '\n':
+				*p = ' ';
+				break;
+			case '"':
+				*p = '\'';
+				break;
+			default:
+				break;
+		}
+	}
+
+	result = get_plan_tree_dot_string_ext(buffer, obj, &graph_options);
+
+	if (options->stats == NULL)
+		render_stats_add_graph(&stats);
+
+	pfree(buffer);
+
+	return result;
+}
+
+/*
+ * Milliseconds since starttime.
+ */
+static double
+elapsed_ms(instr_time starttime)
+{
+	instr_time duration;
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, starttime);
 
-	if (buffer)
-		pfree(buffer);
+	return INSTR_TIME_GET_MILLISEC(duration);
 }
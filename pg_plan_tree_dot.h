@@ -9,11 +9,196 @@
 #ifndef PG_PLAN_TREE_DOT_H
 #define PG_PLAN_TREE_DOT_H
 
+#include "utils/timestamp.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* Phases of a rendering call */
+typedef enum RenderPhase
+{
+	RENDER_PARSE,				/* parse analysis and rewriting */
+	RENDER_PLAN,
+	RENDER_WALK,				/* finding the graph nodes and edges */
+	RENDER_LABEL,				/* writing the DOT text */
+	RENDER_WRITE,				/* writing the file */
+	NUM_RENDER_PHASES
+} RenderPhase;
+
+/* Statistics of rendering calls, kept by render_stats.c */
+typedef struct RenderStats
+{
+	int64		calls;
+	int64		graphs;
+	int64		nodes;
+	int64		edges;
+	double		phase_ms[NUM_RENDER_PHASES];
+	Size		peak_bytes;		/* largest temporary context of a call */
+} RenderStats;
+
+/* A name for a relation OID that is not in pg_class, such as a hypothetical index */
+typedef struct PlanTreeDotOidName
+{
+	Oid			oid;
+	const char *name;
+} PlanTreeDotOidName;
+
+/* A fill color and an extra label line for one node */
+typedef struct PlanTreeDotNodeMark
+{
+	const void *node;
+	const char *color;			/* fill color, or NULL */
+	const char *note;			/* appended to the label, or NULL */
+} PlanTreeDotNodeMark;
+
+/* Work done by one call of get_plan_tree_dot_string_ext() */
+typedef struct PlanTreeDotStats
+{
+	int			num_nodes;		/* nodes in the graph */
+	int			num_edges;		/* edges in the graph */
+	double		walk_ms;		/* time to find the nodes and edges */
+	double		label_ms;		/* time to write the DOT text */
+	Size		walk_bytes;		/* renderer memory after finding the nodes */
+	Size		peak_bytes;		/* renderer memory after writing the text */
+	Size		output_bytes;	/* length of the DOT text */
+} PlanTreeDotStats;
+
+/* Output formats of get_plan_tree_dot_string_ext() */
+typedef enum PlanTreeFormat
+{
+	PLAN_TREE_FORMAT_DOT,
+	PLAN_TREE_FORMAT_HTML		/* self-contained page, clusters expanded on demand */
+} PlanTreeFormat;
+
+typedef struct PlanTreeDotOptions
+{
+	bool		simplify;		/* collapse pass-through target lists */
+	bool		raw_oids;		/* print OIDs instead of catalog names */
+
+	const PlanTreeDotOidName *relation_names;
+	int			num_relation_names;
+
+	const PlanTreeDotNodeMark *node_marks;
+	int			num_node_marks;
+
+	PlanTreeDotStats *stats;	/* filled in if not NULL */
+
+	PlanTreeFormat format;
+} PlanTreeDotOptions;
+
+/* A PlanState found by get_plan_state_nodes() */
+typedef struct PlanStateNodeInfo
+{
+	const void *planstate;		/* the PlanState */
+	const char *node_type;		/* type name of its Plan node */
+	int			parent;			/* index of the enclosing PlanState, or -1 */
+} PlanStateNodeInfo;
+
+/* An edge returned by get_plan_tree_node_edges() */
+typedef struct PlanTreeDotEdge
+{
+	int			from;			/* node ids */
+	int			to;
+	const char *field;			/* field of from that points to to */
+} PlanTreeDotEdge;
+
+/* A walked plan tree, see open_plan_tree_index() */
+typedef struct PlanTreeIndex PlanTreeIndex;
+
 extern char *get_plan_tree_dot_string(const char *title, const void *obj, bool simplify);
+extern char *get_plan_tree_dot_string_ext(const char *title, const void *obj, const PlanTreeDotOptions *options);
+extern PlanStateNodeInfo *get_plan_state_nodes(const void *planstate, int *num_nodes);
+extern const char *get_plan_node_type_name(const void *node);
+extern Size memory_context_total_space(MemoryContext context);
+extern PlanTreeIndex *open_plan_tree_index(const void *obj, const PlanTreeDotOptions *options);
+extern int get_plan_tree_index_size(const PlanTreeIndex *index);
+extern char *get_plan_tree_node_label(PlanTreeIndex *index, int node_id);
+extern PlanTreeDotEdge *get_plan_tree_node_edges(PlanTreeIndex *index, int node_id, int *num_edges);
+
+/* plan_fingerprint.c */
+struct PlannedStmt;
+struct Plan;
+struct List;
+extern struct List *plan_child_plans(const struct Plan *plan);
+extern char *plan_shape_string(const struct PlannedStmt *stmt, bool with_costs);
+extern uint64 plan_fingerprint(const struct PlannedStmt *stmt, bool with_costs);
+extern uint64 plan_expr_fingerprint(const struct PlannedStmt *stmt, uint64 hash);
+extern uint64 fingerprint_bytes(uint64 hash, const void *data, Size len);
+extern char *plan_outline_string(const struct PlannedStmt *stmt);
+
+/* render_stats.c */
+extern const char *const render_phase_names[NUM_RENDER_PHASES];
+extern void init_render_stats(void);
+extern void render_stats_begin(MemoryContext context);
+extern void render_stats_add(RenderPhase phase, double ms);
+extern void render_stats_add_graph(const PlanTreeDotStats *stats);
+extern void render_stats_end(void);
+extern bool render_stats_comment_enabled(void);
+extern const RenderStats *render_stats_last(void);
+
+/* render_cache.c */
+extern void init_render_cache(void);
+extern bool render_cache_key(const char *title, const char *sql, const void *obj, const PlanTreeDotOptions *options, uint64 *key);
+extern char *render_cache_lookup(uint64 key, PlanTreeDotStats *stats);
+extern void render_cache_store(uint64 key, const struct PlannedStmt *stmt, const char *graph, const PlanTreeDotStats *stats);
+
+/* plan_capture.c */
+extern void init_plan_capture(void);
+
+/* plan_history.c */
+extern void init_plan_history(void);
+
+/* plan_profiler.c */
+typedef struct PlanProfile PlanProfile;
+
+extern void init_plan_profiler(void);
+extern PlanProfile *create_plan_profile(int num_slots);
+extern void start_plan_profile(PlanProfile *profile, const void *planstate);
+extern void stop_plan_profile(PlanProfile *profile);
+extern uint64 get_plan_profile_samples(const PlanProfile *profile, int plan_node_id);
+
+/* live_progress.c */
+typedef struct LivePlanNode
+{
+	int			plan_node_id;
+	int			parent;			/* index of the enclosing node, or -1 */
+	double		tuples;			/* rows returned so far */
+	double		loops;			/* loops started so far */
+	bool		executing;		/* the node running at the snapshot */
+} LivePlanNode;
+
+typedef struct LivePlanSnapshot
+{
+	int			pid;
+	TimestampTz	taken_at;
+	char	   *query;
+	struct PlannedStmt *stmt;
+	int			num_nodes;
+	LivePlanNode *nodes;
+} LivePlanSnapshot;
+
+extern void init_live_progress(void);
+extern LivePlanSnapshot *get_live_plan_snapshot(int pid, int timeout_ms);
+
+/* cost_calibration.c */
+typedef struct CalibrationSample
+{
+	const char *node_type;		/* static type name */
+	double		seq_pages;		/* pages read by sequential access */
+	double		random_pages;	/* pages read by index access */
+	double		tuples;			/* tuples processed */
+	double		operators;		/* operator and function evaluations */
+	double		exclusive_ms;	/* measured time less that of the children */
+} CalibrationSample;
+
+extern void add_calibration_sample(const CalibrationSample *sample);
+extern double count_plan_operators(const struct Plan *plan);
+
+/* hypothetical_index.c */
+extern void begin_hypothetical_indexes(int num_defs, char **defs);
+extern void end_hypothetical_indexes(void);
+extern PlanTreeDotOidName *get_hypothetical_index_names(int *num_names);
 
 #ifdef __cplusplus
 };
@@ -0,0 +1,627 @@
+/*-------------------------------------------------------------------------
+ *
+ * plan_capture.c
+ *
+ * Detection of plan changes.  When pg_plan_tree_dot.capture_plan_changes is
+ * on, every executed plan is fingerprinted and looked up in a shared hash
+ * table keyed by query ID.  A known query with the same fingerprint costs
+ * one probe under a shared lock.  When the fingerprint differs, the graph
+ * and an outline of the new plan are written to
+ * pg_plan_tree_dot.capture_directory, and the nodes added, removed or
+ * changed since the previous plan are written to the server log.
+ *
+ * The table lives in shared memory, so the library must be in
+ * shared_preload_libraries.  PostgreSQL 9.4 or later is required for the
+ * query IDs, which pg_stat_statements computes; queries without one are not
+ * captured.
+ *
+ * Copyright (c) 2014-2017 Minoru NAKAMURA <nminoru@nminoru.jp>
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <sys/stat.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+
+#if PG_VERSION_NUM >= 90600
+#include "access/parallel.h"
+#endif
+#include "access/xact.h"
+#include "executor/executor.h"
+#include "lib/stringinfo.h"
+#include "miscadmin.h"
+#include "nodes/plannodes.h"
+#include "storage/fd.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+#include "utils/resowner.h"
+
+#include "pg_plan_tree_dot.h"
+
+
+/* The last plan seen for a query */
+typedef struct CapturedPlan
+{
+	uint64		queryid;		/* hash table key */
+	uint64		fingerprint;
+} CapturedPlan;
+
+/* A line of plan_outline_string() */
+typedef struct OutlineNode
+{
+	char	   *path;
+	char	   *node_type;
+	char	   *relname;
+	double		total_cost;
+	double		rows;
+	bool		matched;
+} OutlineNode;
+
+/* pg_plan_tree_dot.capture_plan_changes */
+static bool capture_plan_changes = false;
+
+/* pg_plan_tree_dot.capture_directory */
+static char *capture_directory = NULL;
+
+/* pg_plan_tree_dot.capture_max_queries */
+static int	capture_max_queries = 1000;
+
+#if PG_VERSION_NUM >= 90400
+
+static HTAB *captured_plans = NULL;
+static LWLock *capture_lock = NULL;
+
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+static ExecutorStart_hook_type prev_ExecutorStart = NULL;
+
+static void plan_capture_shmem_startup(void);
+static void capture_ExecutorStart(QueryDesc *queryDesc, int eflags);
+static void capture_plan(QueryDesc *queryDesc);
+static uint64 capture_query_id(QueryDesc *queryDesc);
+static bool write_captured_plan(uint64 queryid, PlannedStmt *stmt, bool known, uint64 prev_fingerprint, uint64 fingerprint);
+static char *capture_file_path(uint64 queryid, uint64 fingerprint, const char *suffix);
+static bool write_capture_file(const char *path, const char *data);
+static char *read_capture_file(const char *path);
+static OutlineNode *parse_outline(char *outline, int *num_nodes);
+static void append_outline_diff(StringInfo buf, OutlineNode *old_nodes, int num_old, OutlineNode *new_nodes, int num_new);
+static void append_outline_node(StringInfo buf, const OutlineNode *node);
+
+#endif
+
+/*
+ * Called from _PG_init().  Nothing is captured unless the library is in
+ * shared_preload_libraries.
+ */
+void
+init_plan_capture(void)
+{
+#if PG_VERSION_NUM >= 90100
+	DefineCustomBoolVariable("pg_plan_tree_dot.capture_plan_changes",
+							 "Logs the queries whose plans change.",
+							 "Requires pg_plan_tree_dot in shared_preload_libraries.",
+							 &capture_plan_changes,
+							 false,
+							 PGC_SUSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomStringVariable("pg_plan_tree_dot.capture_directory",
+							   "Sets the directory the changed plans are written to.",
+							   "Relative paths are relative to the data directory.",
+							   &capture_directory,
+							   "pg_plan_tree_dot",
+							   PGC_SUSET,
+							   0,
+							   NULL,
+							   NULL,
+							   NULL);
+
+	DefineCustomIntVariable("pg_plan_tree_dot.capture_max_queries",
+							"Sets the number of queries whose plans are remembered.",
+							NULL,
+							&capture_max_queries,
+							1000,
+							1,
+							INT_MAX / 2,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+#else
+	DefineCustomBoolVariable("pg_plan_tree_dot.capture_plan_changes",
+							 "Logs the queries whose plans change.",
+							 "Requires pg_plan_tree_dot in shared_preload_libraries.",
+							 &capture_plan_changes,
+							 false,
+							 PGC_SUSET,
+							 0,
+							 NULL,
+							 NULL);
+
+	DefineCustomStringVariable("pg_plan_tree_dot.capture_directory",
+							   "Sets the directory the changed plans are written to.",
+							   "Relative paths are relative to the data directory.",
+							   &capture_directory,
+							   "pg_plan_tree_dot",
+							   PGC_SUSET,
+							   0,
+							   NULL,
+							   NULL);
+
+	DefineCustomIntVariable("pg_plan_tree_dot.capture_max_queries",
+							"Sets the number of queries whose plans are remembered.",
+							NULL,
+							&capture_max_queries,
+							1000,
+							1,
+							INT_MAX / 2,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL);
+#endif
+
+#if PG_VERSION_NUM >= 90400
+	if (!process_shared_preload_libraries_in_progress)
+		return;
+
+	RequestAddinShmemSpace(hash_estimate_size(capture_max_queries, sizeof(CapturedPlan)));
+#if PG_VERSION_NUM >= 90600
+	RequestNamedLWLockTranche("pg_plan_tree_dot capture", 1);
+#else
+	RequestAddinLWLocks(1);
+#endif
+
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = plan_capture_shmem_startup;
+
+	prev_ExecutorStart = ExecutorStart_hook;
+	ExecutorStart_hook = capture_ExecutorStart;
+#endif
+}
+
+#if PG_VERSION_NUM >= 90400
+
+static void
+plan_capture_shmem_startup(void)
+{
+	HASHCTL		info;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	memset(&info, 0, sizeof(info));
+	info.keysize	= sizeof(uint64);
+	info.entrysize	= sizeof(CapturedPlan);
+	info.hash		= tag_hash;
+
+	captured_plans = ShmemInitHash("pg_plan_tree_dot captured plans",
+								   capture_max_queries, capture_max_queries,
+								   &info,
+								   HASH_ELEM | HASH_FUNCTION);
+
+#if PG_VERSION_NUM >= 90600
+	capture_lock = &(GetNamedLWLockTranche("pg_plan_tree_dot capture"))->lock;
+#else
+	capture_lock = LWLockAssign();
+#endif
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+static void
+capture_ExecutorStart(QueryDesc *queryDesc, int eflags)
+{
+	if (prev_ExecutorStart)
+		prev_ExecutorStart(queryDesc, eflags);
+	else
+		standard_ExecutorStart(queryDesc, eflags);
+
+	/*
+	 * The leader captures the plan that parallel workers run parts of.  No
+	 * subtransaction can be started in parallel mode, which a query run by
+	 * a function of a parallel query is in.
+	 */
+#if PG_VERSION_NUM >= 90600
+	if (IsParallelWorker() || IsInParallelMode())
+		return;
+#endif
+
+	if (capture_plan_changes && captured_plans != NULL &&
+		queryDesc->plannedstmt->utilityStmt == NULL &&
+		(eflags & EXEC_FLAG_EXPLAIN_ONLY) == 0)
+		capture_plan(queryDesc);
+}
+
+/*
+ * Compares the plan with the last one seen for the query.  The common case,
+ * an unchanged plan, only takes the shared lock.  The new fingerprint is
+ * stored once the plan has been written, so a plan that failed to be
+ * captured is tried again by its next execution.
+ */
+static void
+capture_plan(QueryDesc *queryDesc)
+{
+	PlannedStmt	   *stmt = queryDesc->plannedstmt;
+	CapturedPlan   *entry;
+	uint64			queryid;
+	uint64			fingerprint;
+	uint64			prev_fingerprint = 0;
+	bool			found;
+
+	queryid		= capture_query_id(queryDesc);
+	if (queryid == 0)
+		return;
+
+	fingerprint	= plan_fingerprint(stmt, false);
+
+	LWLockAcquire(capture_lock, LW_SHARED);
+	entry = (CapturedPlan *) hash_search(captured_plans, &queryid, HASH_FIND, NULL);
+	found = (entry != NULL && entry->fingerprint == fingerprint);
+	LWLockRelease(capture_lock);
+
+	if (found)
+		return;
+
+	LWLockAcquire(capture_lock, LW_EXCLUSIVE);
+
+	/*
+	 * When the table is full, new queries are not tracked.  The hash table
+	 * does not stop at its maximum size by itself.
+	 */
+	entry = (CapturedPlan *) hash_search(captured_plans, &queryid, HASH_FIND, NULL);
+	found = (entry != NULL);
+	if (!found && hash_get_num_entries(captured_plans) < capture_max_queries)
+		entry = (CapturedPlan *) hash_search(captured_plans, &queryid, HASH_ENTER_NULL, NULL);
+	if (entry == NULL || (found && entry->fingerprint == fingerprint))
+	{
+		LWLockRelease(capture_lock);
+		return;
+	}
+
+	/* 0 stands for a query none of whose plans has been captured */
+	if (!found)
+		entry->fingerprint = 0;
+	prev_fingerprint = entry->fingerprint;
+
+	LWLockRelease(capture_lock);
+
+	if (!write_captured_plan(queryid, stmt, prev_fingerprint != 0, prev_fingerprint, fingerprint))
+		return;
+
+	LWLockAcquire(capture_lock, LW_EXCLUSIVE);
+	entry = (CapturedPlan *) hash_search(captured_plans, &queryid, HASH_FIND, NULL);
+	if (entry != NULL)
+		entry->fingerprint = fingerprint;
+	LWLockRelease(capture_lock);
+}
+
+/*
+ * The query ID computed by pg_stat_statements or the server, or 0 if there
+ * is none.  The query text is no substitute: it holds all the statements of
+ * a multi-statement string, and the constants differ between executions.
+ */
+static uint64
+capture_query_id(QueryDesc *queryDesc)
+{
+	return (uint64) queryDesc->plannedstmt->queryId;
+}
+
+/*
+ * Writes the graph and the outline of a new plan, and returns whether both
+ * were written.  If the query had another plan, its outline is read back
+ * and the differences are logged.  Failures are reported as warnings; the
+ * query itself must not fail.  Rendering runs in a subtransaction, as
+ * run_alternative_plan() does, so an error raised there releases its locks
+ * and buffers before the query goes on.  A query cancel is still let
+ * through.
+ */
+static bool
+write_captured_plan(uint64 queryid, PlannedStmt *stmt, bool known, uint64 prev_fingerprint, uint64 fingerprint)
+{
+	MemoryContext	tempcontext, oldcontext;
+	ResourceOwner	oldowner = CurrentResourceOwner;
+	volatile bool	written = false;
+
+	tempcontext = AllocSetContextCreate(CurrentMemoryContext,
+										"plan capture temporary context",
+										ALLOCSET_DEFAULT_MINSIZE,
+										ALLOCSET_DEFAULT_INITSIZE,
+										ALLOCSET_DEFAULT_MAXSIZE);
+
+	oldcontext = MemoryContextSwitchTo(tempcontext);
+
+	if (mkdir(capture_directory, S_IRWXU) != 0 && errno != EEXIST)
+		ereport(WARNING,
+				(errcode_for_file_access(),
+				 errmsg("could not create directory \"%s\": %m", capture_directory)));
+
+	BeginInternalSubTransaction(NULL);
+	MemoryContextSwitchTo(tempcontext);
+
+	PG_TRY();
+	{
+		PlanTreeDotOptions options;
+		char		   *outline;
+		char		   *graph;
+		char		   *dot_path;
+		char			title[128];
+
+		memset(&options, 0, sizeof(options));
+
+		snprintf(title, sizeof(title), "Query " UINT64_FORMAT ", plan %08x%08x",
+				 queryid, (uint32) (fingerprint >> 32), (uint32) fingerprint);
+
+		graph		= get_plan_tree_dot_string_ext(title, stmt, &options);
+		outline		= plan_outline_string(stmt);
+		dot_path	= capture_file_path(queryid, fingerprint, "dot");
+
+		written = write_capture_file(dot_path, graph);
+		written = write_capture_file(capture_file_path(queryid, fingerprint, "outline"), outline) && written;
+
+		if (known)
+		{
+			StringInfoData	diff;
+			char		   *prev_outline;
+
+			initStringInfo(&diff);
+
+			prev_outline = read_capture_file(capture_file_path(queryid, prev_fingerprint, "outline"));
+			if (prev_outline != NULL)
+			{
+				OutlineNode	   *old_nodes, *new_nodes;
+				int				num_old, num_new;
+
+				old_nodes = parse_outline(prev_outline, &num_old);
+				new_nodes = parse_outline(pstrdup(outline), &num_new);
+
+				append_outline_diff(&diff, old_nodes, num_old, new_nodes, num_new);
+			}
+			else
+				appendStringInfoString(&diff, "The previous plan was not captured.\n");
+
+			ereport(LOG,
+					(errmsg("plan of query " UINT64_FORMAT " changed from %08x%08x to %08x%08x",
+							queryid,
+							(uint32) (prev_fingerprint >> 32), (uint32) prev_fingerprint,
+							(uint32) (fingerprint >> 32), (uint32) fingerprint),
+					 errdetail_internal("%s", diff.data),
+					 errhint("The graphs are in \"%s\" and \"%s\".",
+							 capture_file_path(queryid, prev_fingerprint, "dot"), dot_path)));
+		}
+
+		ReleaseCurrentSubTransaction();
+		MemoryContextSwitchTo(tempcontext);
+		CurrentResourceOwner = oldowner;
+	}
+	PG_CATCH();
+	{
+		ErrorData  *edata;
+
+		MemoryContextSwitchTo(tempcontext);
+		edata = CopyErrorData();
+		FlushErrorState();
+
+		RollbackAndReleaseCurrentSubTransaction();
+		MemoryContextSwitchTo(tempcontext);
+		CurrentResourceOwner = oldowner;
+
+		if (edata->sqlerrcode == ERRCODE_QUERY_CANCELED)
+			ReThrowError(edata);
+
+		ereport(WARNING,
+				(errmsg("could not capture the plan of query " UINT64_FORMAT ": %s",
+						queryid, edata->message)));
+
+		written = false;
+	}
+	PG_END_TRY();
+
+	MemoryContextSwitchTo(oldcontext);
+	MemoryContextDelete(tempcontext);
+
+	return written;
+}
+
+static char *
+capture_file_path(uint64 queryid, uint64 fingerprint, const char *suffix)
+{
+	StringInfoData path;
+
+	initStringInfo(&path);
+	appendStringInfo(&path, "%s/" UINT64_FORMAT "_%08x%08x.%s",
+					 capture_directory, queryid,
+					 (uint32) (fingerprint >> 32), (uint32) fingerprint, suffix);
+
+	return path.data;
+}
+
+static bool
+write_capture_file(const char *path, const char *data)
+{
+	FILE *file;
+
+	file = AllocateFile(path, "w");
+	if (file == NULL)
+	{
+		ereport(WARNING,
+				(errcode_for_file_access(),
+				 errmsg("could not create file \"%s\": %m", path)));
+		return false;
+	}
+
+	fputs(data, file);
+
+	if (FreeFile(file) != 0)
+	{
+		ereport(WARNING,
+				(errcode_for_file_access(),
+				 errmsg("could not write file \"%s\": %m", path)));
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Returns the contents of a file, or NULL if it cannot be read.
+ */
+static char *
+read_capture_file(const char *path)
+{
+	StringInfoData	buf;
+	FILE		   *file;
+	char			chunk[8192];
+	size_t			len;
+
+	file = AllocateFile(path, "r");
+	if (file == NULL)
+		return NULL;
+
+	initStringInfo(&buf);
+
+	while ((len = fread(chunk, 1, sizeof(chunk), file)) > 0)
+		appendBinaryStringInfo(&buf, chunk, (int) len);
+
+	FreeFile(file);
+
+	return buf.data;
+}
+
+/*
+ * Splits an outline into its lines, in place.
+ */
+static OutlineNode *
+parse_outline(char *outline, int *num_nodes)
+{
+	OutlineNode	   *nodes;
+	char		   *line, *next;
+	int				n = 0, max = 16;
+
+	nodes = (OutlineNode *) palloc(sizeof(OutlineNode) * max);
+
+	for (line = outline ; *line ; line = next)
+	{
+		char *fields[5];
+		char *p = line;
+		int i;
+
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+		else
+			next = line + strlen(line);
+
+		for (i = 0 ; i < 5 && p ; i++)
+		{
+			fields[i] = p;
+			p = strchr(p, '\t');
+			if (p)
+				*p++ = '\0';
+		}
+
+		if (i < 5)
+			continue;
+
+		if (n >= max)
+		{
+			max *= 2;
+			nodes = (OutlineNode *) repalloc(nodes, sizeof(OutlineNode) * max);
+		}
+
+		nodes[n].path		= fields[0];
+		nodes[n].node_type	= fields[1];
+		nodes[n].relname	= fields[2];
+		nodes[n].total_cost	= strtod(fields[3], NULL);
+		nodes[n].rows		= strtod(fields[4], NULL);
+		nodes[n].matched	= false;
+		n++;
+	}
+
+	*num_nodes = n;
+
+	return nodes;
+}
+
+/*
+ * Appends one line per difference.  Nodes are matched by their path; a node
+ * whose type or relation differs is changed, and so is one whose cost moved
+ * by 1% or more.
+ */
+static void
+append_outline_diff(StringInfo buf, OutlineNode *old_nodes, int num_old, OutlineNode *new_nodes, int num_new)
+{
+	int i, j;
+
+	for (i = 0 ; i < num_new ; i++)
+	{
+		OutlineNode *new_node = &new_nodes[i];
+		OutlineNode *old_node = NULL;
+
+		for (j = 0 ; j < num_old ; j++)
+		{
+			if (!old_nodes[j].matched && strcmp(old_nodes[j].path, new_node->path) == 0)
+			{
+				old_node = &old_nodes[j];
+				old_node->matched = true;
+				break;
+			}
+		}
+
+		if (old_node == NULL)
+		{
+			appendStringInfo(buf, "+ %s ", new_node->path);
+			append_outline_node(buf, new_node);
+			appendStringInfo(buf, " (cost %.2f, rows %.0f)\n", new_node->total_cost, new_node->rows);
+		}
+		else if (strcmp(old_node->node_type, new_node->node_type) != 0 ||
+				 strcmp(old_node->relname, new_node->relname) != 0 ||
+				 fabs(new_node->total_cost - old_node->total_cost) >= 0.01 * Max(old_node->total_cost, 1.0))
+		{
+			appendStringInfo(buf, "~ %s ", new_node->path);
+			append_outline_node(buf, old_node);
+			if (strcmp(old_node->node_type, new_node->node_type) != 0 ||
+				strcmp(old_node->relname, new_node->relname) != 0)
+			{
+				appendStringInfoString(buf, " -> ");
+				append_outline_node(buf, new_node);
+			}
+			appendStringInfo(buf, " (cost %.2f -> %.2f, %+.2f)\n",
+							 old_node->total_cost, new_node->total_cost,
+							 new_node->total_cost - old_node->total_cost);
+		}
+	}
+
+	for (j = 0 ; j < num_old ; j++)
+	{
+		if (old_nodes[j].matched)
+			continue;
+
+		appendStringInfo(buf, "- %s ", old_nodes[j].path);
+		append_outline_node(buf, &old_nodes[j]);
+		appendStringInfo(buf, " (cost %.2f, rows %.0f)\n", old_nodes[j].total_cost, old_nodes[j].rows);
+	}
+}
+
+static void
+append_outline_node(StringInfo buf, const OutlineNode *node)
+{
+	appendStringInfoString(buf, node->node_type);
+
+	if (strcmp(node->relname, "-") != 0)
+		appendStringInfo(buf, " on %s", node->relname);
+}
+
+#endif
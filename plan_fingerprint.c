@@ -0,0 +1,486 @@
+/*-------------------------------------------------------------------------
+ *
+ * plan_fingerprint.c
+ *
+ * Structural fingerprints of plan trees.  Two plans get the same fingerprint
+ * when they have the same node types, scan the same relations through the
+ * same indexes, and use the same join and aggregation strategies; costs and
+ * row estimates are ignored unless asked for.  plan_expr_fingerprint() adds
+ * the expressions of the nodes, down to their constants.
+ *
+ * Copyright (c) 2014-2017 Minoru NAKAMURA <nminoru@nminoru.jp>
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "lib/stringinfo.h"
+#include "nodes/nodeFuncs.h"
+#include "nodes/nodes.h"
+#include "nodes/pg_list.h"
+#include "nodes/plannodes.h"
+#include "parser/parsetree.h"
+#include "utils/datum.h"
+#include "utils/lsyscache.h"
+
+#include "pg_plan_tree_dot.h"
+
+
+#define FNV_OFFSET_BASIS	UINT64CONST(0xcbf29ce484222325)
+#define FNV_PRIME			UINT64CONST(0x100000001b3)
+
+static void append_plan_shape(StringInfo buf, const PlannedStmt *stmt, const Plan *plan, bool with_costs);
+static void append_scan_relation(StringInfo buf, const PlannedStmt *stmt, const Plan *plan);
+static void append_plan_outline(StringInfo buf, const PlannedStmt *stmt, const Plan *plan, const char *path);
+static void hash_plan_exprs(const Plan *plan, uint64 *hash);
+static bool hash_expr_walker(Node *node, uint64 *hash);
+
+/*
+ * Returns a canonical text form of the plan tree and its subplans.  Equal
+ * strings mean equal plans; the format itself is not meant to be read.
+ */
+char *
+plan_shape_string(const struct PlannedStmt *stmt, bool with_costs)
+{
+	StringInfoData	buf;
+	ListCell	   *lc;
+
+	initStringInfo(&buf);
+
+	append_plan_shape(&buf, stmt, stmt->planTree, with_costs);
+
+	foreach(lc, stmt->subplans)
+	{
+		appendStringInfoChar(&buf, ';');
+		append_plan_shape(&buf, stmt, (const Plan *) lfirst(lc), with_costs);
+	}
+
+	return buf.data;
+}
+
+/*
+ * Returns the plans directly below a plan node: its outer and inner plans
+ * followed by the member plans of Append-like nodes.  Init plans and
+ * subplans are not included; they hang off PlannedStmt->subplans.
+ */
+List *
+plan_child_plans(const struct Plan *plan)
+{
+	List *result = NIL;
+
+	if (plan->lefttree)
+		result = lappend(result, plan->lefttree);
+	if (plan->righttree)
+		result = lappend(result, plan->righttree);
+
+	switch (nodeTag(plan))
+	{
+		case T_Append:
+			result = list_concat(result, list_copy(((const Append *) plan)->appendplans));
+			break;
+#if PG_VERSION_NUM >= 90100
+		case T_MergeAppend:
+			result = list_concat(result, list_copy(((const MergeAppend *) plan)->mergeplans));
+			break;
+		case T_ModifyTable:
+			result = list_concat(result, list_copy(((const ModifyTable *) plan)->plans));
+			break;
+#endif
+		case T_BitmapAnd:
+			result = list_concat(result, list_copy(((const BitmapAnd *) plan)->bitmapplans));
+			break;
+		case T_BitmapOr:
+			result = list_concat(result, list_copy(((const BitmapOr *) plan)->bitmapplans));
+			break;
+		case T_SubqueryScan:
+			result = lappend(result, ((const SubqueryScan *) plan)->subplan);
+			break;
+#if PG_VERSION_NUM >= 90500
+		case T_CustomScan:
+			result = list_concat(result, list_copy(((const CustomScan *) plan)->custom_plans));
+			break;
+#endif
+		default:
+			break;
+	}
+
+	return result;
+}
+
+/*
+ * 64-bit FNV-1a hash of plan_shape_string().
+ */
+uint64
+plan_fingerprint(const struct PlannedStmt *stmt, bool with_costs)
+{
+	char		   *shape;
+	uint64			hash;
+
+	shape = plan_shape_string(stmt, with_costs);
+
+	hash = fingerprint_bytes(0, shape, strlen(shape));
+
+	pfree(shape);
+
+	return hash;
+}
+
+/*
+ * Continues a 64-bit FNV-1a hash over len bytes of data.  Start from 0 for
+ * a new hash.
+ */
+uint64
+fingerprint_bytes(uint64 hash, const void *data, Size len)
+{
+	const unsigned char *p = (const unsigned char *) data;
+	Size		i;
+
+	if (hash == 0)
+		hash = FNV_OFFSET_BASIS;
+
+	for (i = 0 ; i < len ; i++)
+	{
+		hash ^= p[i];
+		hash *= FNV_PRIME;
+	}
+
+	return hash;
+}
+
+/*
+ * Continues hash over the quals, target lists and other expressions of the
+ * plan tree and its subplans: the node types, the columns, operators and
+ * functions they refer to, and the values of their constants.  Unlike
+ * nodeToString(), nothing is allocated.
+ */
+uint64
+plan_expr_fingerprint(const struct PlannedStmt *stmt, uint64 hash)
+{
+	ListCell *lc;
+
+	hash_plan_exprs(stmt->planTree, &hash);
+
+	foreach(lc, stmt->subplans)
+		hash_plan_exprs((const Plan *) lfirst(lc), &hash);
+
+	return hash;
+}
+
+static void
+hash_plan_exprs(const Plan *plan, uint64 *hash)
+{
+	ListCell *lc;
+
+	if (plan == NULL)
+		return;
+
+	hash_expr_walker((Node *) plan->targetlist, hash);
+	hash_expr_walker((Node *) plan->qual, hash);
+
+	switch (nodeTag(plan))
+	{
+		case T_Result:
+			hash_expr_walker(((const Result *) plan)->resconstantqual, hash);
+			break;
+		case T_IndexScan:
+			hash_expr_walker((Node *) ((const IndexScan *) plan)->indexqual, hash);
+			hash_expr_walker((Node *) ((const IndexScan *) plan)->indexorderby, hash);
+			break;
+#if PG_VERSION_NUM >= 90200
+		case T_IndexOnlyScan:
+			hash_expr_walker((Node *) ((const IndexOnlyScan *) plan)->indexqual, hash);
+			hash_expr_walker((Node *) ((const IndexOnlyScan *) plan)->indexorderby, hash);
+			break;
+#endif
+		case T_BitmapIndexScan:
+			hash_expr_walker((Node *) ((const BitmapIndexScan *) plan)->indexqual, hash);
+			break;
+		case T_FunctionScan:
+#if PG_VERSION_NUM >= 90400
+			hash_expr_walker((Node *) ((const FunctionScan *) plan)->functions, hash);
+#else
+			hash_expr_walker(((const FunctionScan *) plan)->funcexpr, hash);
+#endif
+			break;
+		case T_ValuesScan:
+			hash_expr_walker((Node *) ((const ValuesScan *) plan)->values_lists, hash);
+			break;
+		case T_NestLoop:
+			hash_expr_walker((Node *) ((const Join *) plan)->joinqual, hash);
+			break;
+		case T_MergeJoin:
+			hash_expr_walker((Node *) ((const Join *) plan)->joinqual, hash);
+			hash_expr_walker((Node *) ((const MergeJoin *) plan)->mergeclauses, hash);
+			break;
+		case T_HashJoin:
+			hash_expr_walker((Node *) ((const Join *) plan)->joinqual, hash);
+			hash_expr_walker((Node *) ((const HashJoin *) plan)->hashclauses, hash);
+			break;
+		case T_Limit:
+			hash_expr_walker(((const Limit *) plan)->limitOffset, hash);
+			hash_expr_walker(((const Limit *) plan)->limitCount, hash);
+			break;
+		default:
+			break;
+	}
+
+	foreach(lc, plan_child_plans(plan))
+		hash_plan_exprs((const Plan *) lfirst(lc), hash);
+}
+
+static bool
+hash_expr_walker(Node *node, uint64 *hash)
+{
+	NodeTag tag;
+
+	if (node == NULL)
+		return false;
+
+	tag = nodeTag(node);
+	*hash = fingerprint_bytes(*hash, &tag, sizeof(tag));
+
+	switch (tag)
+	{
+		case T_Var:
+			{
+				const Var *var = (const Var *) node;
+
+				*hash = fingerprint_bytes(*hash, &var->varno, sizeof(var->varno));
+				*hash = fingerprint_bytes(*hash, &var->varattno, sizeof(var->varattno));
+				*hash = fingerprint_bytes(*hash, &var->varlevelsup, sizeof(var->varlevelsup));
+			}
+			break;
+		case T_Const:
+			{
+				const Const *con = (const Const *) node;
+
+				*hash = fingerprint_bytes(*hash, &con->consttype, sizeof(con->consttype));
+				*hash = fingerprint_bytes(*hash, &con->constisnull, sizeof(con->constisnull));
+
+				if (con->constisnull)
+					break;
+
+				if (con->constbyval)
+					*hash = fingerprint_bytes(*hash, &con->constvalue, sizeof(Datum));
+				else
+					*hash = fingerprint_bytes(*hash, DatumGetPointer(con->constvalue),
+											  datumGetSize(con->constvalue, false, con->constlen));
+			}
+			break;
+		case T_Param:
+			*hash = fingerprint_bytes(*hash, &((const Param *) node)->paramkind, sizeof(ParamKind));
+			*hash = fingerprint_bytes(*hash, &((const Param *) node)->paramid, sizeof(int));
+			break;
+		case T_OpExpr:
+			*hash = fingerprint_bytes(*hash, &((const OpExpr *) node)->opno, sizeof(Oid));
+			break;
+		case T_FuncExpr:
+			*hash = fingerprint_bytes(*hash, &((const FuncExpr *) node)->funcid, sizeof(Oid));
+			break;
+		case T_Aggref:
+			*hash = fingerprint_bytes(*hash, &((const Aggref *) node)->aggfnoid, sizeof(Oid));
+			break;
+		case T_SubPlan:
+			*hash = fingerprint_bytes(*hash, &((const SubPlan *) node)->plan_id, sizeof(int));
+			break;
+		case T_TargetEntry:
+			*hash = fingerprint_bytes(*hash, &((const TargetEntry *) node)->resno, sizeof(AttrNumber));
+			break;
+		default:
+			break;
+	}
+
+	return expression_tree_walker(node, hash_expr_walker, (void *) hash);
+}
+
+/*
+ * Returns one line per plan node, in depth-first order:
+ *
+ *     path <TAB> node type <TAB> relation <TAB> total cost <TAB> rows
+ *
+ * The path gives the child numbers from the root, such as "0.1.0", or from
+ * a subplan, such as "s1.0", so the same position can be found in another
+ * plan of the query.  The relation is "-" for nodes that scan none.
+ */
+char *
+plan_outline_string(const struct PlannedStmt *stmt)
+{
+	StringInfoData	buf;
+	ListCell	   *lc;
+	int				i = 0;
+
+	initStringInfo(&buf);
+
+	append_plan_outline(&buf, stmt, stmt->planTree, "0");
+
+	foreach(lc, stmt->subplans)
+	{
+		char path[32];
+
+		snprintf(path, sizeof(path), "s%d", ++i);
+		append_plan_outline(&buf, stmt, (const Plan *) lfirst(lc), path);
+	}
+
+	return buf.data;
+}
+
+static void
+append_plan_outline(StringInfo buf, const PlannedStmt *stmt, const Plan *plan, const char *path)
+{
+	const char *relname = NULL;
+	ListCell   *lc;
+	int			i = 0;
+
+	if (plan == NULL)
+		return;
+
+	switch (nodeTag(plan))
+	{
+		case T_SeqScan:
+#if PG_VERSION_NUM >= 90500
+		case T_SampleScan:
+#endif
+		case T_IndexScan:
+#if PG_VERSION_NUM >= 90200
+		case T_IndexOnlyScan:
+#endif
+		case T_BitmapHeapScan:
+		case T_TidScan:
+#if PG_VERSION_NUM >= 90100
+		case T_ForeignScan:
+#endif
+			{
+				Index scanrelid = ((const Scan *) plan)->scanrelid;
+
+				if (scanrelid > 0 && scanrelid <= (Index) list_length(stmt->rtable) &&
+					rt_fetch(scanrelid, stmt->rtable)->rtekind == RTE_RELATION)
+					relname = get_rel_name(rt_fetch(scanrelid, stmt->rtable)->relid);
+			}
+			break;
+		default:
+			break;
+	}
+
+	appendStringInfo(buf, "%s\t%s\t%s\t%.2f\t%.0f\n",
+					 path, get_plan_node_type_name(plan), relname ? relname : "-",
+					 plan->total_cost, plan->plan_rows);
+
+	foreach(lc, plan_child_plans(plan))
+	{
+		StringInfoData child_path;
+
+		initStringInfo(&child_path);
+		appendStringInfo(&child_path, "%s.%d", path, i++);
+
+		append_plan_outline(buf, stmt, (const Plan *) lfirst(lc), child_path.data);
+
+		pfree(child_path.data);
+	}
+}
+
+static void
+append_plan_shape(StringInfo buf, const PlannedStmt *stmt, const Plan *plan, bool with_costs)
+{
+	ListCell *lc;
+
+	if (plan == NULL)
+	{
+		appendStringInfoChar(buf, '-');
+		return;
+	}
+
+	appendStringInfo(buf, "(%d", (int) nodeTag(plan));
+
+#if PG_VERSION_NUM >= 90600
+	if (plan->parallel_aware)
+		appendStringInfoString(buf, " par");
+#endif
+
+	switch (nodeTag(plan))
+	{
+		case T_SeqScan:
+#if PG_VERSION_NUM >= 90500
+		case T_SampleScan:
+		case T_CustomScan:
+#endif
+		case T_BitmapHeapScan:
+		case T_TidScan:
+#if PG_VERSION_NUM >= 90100
+		case T_ForeignScan:
+#endif
+			append_scan_relation(buf, stmt, plan);
+			break;
+		case T_IndexScan:
+			append_scan_relation(buf, stmt, plan);
+			appendStringInfo(buf, " i%u d%d",
+							 ((const IndexScan *) plan)->indexid,
+							 (int) ((const IndexScan *) plan)->indexorderdir);
+			break;
+#if PG_VERSION_NUM >= 90200
+		case T_IndexOnlyScan:
+			append_scan_relation(buf, stmt, plan);
+			appendStringInfo(buf, " i%u d%d",
+							 ((const IndexOnlyScan *) plan)->indexid,
+							 (int) ((const IndexOnlyScan *) plan)->indexorderdir);
+			break;
+#endif
+		case T_BitmapIndexScan:
+			appendStringInfo(buf, " i%u", ((const BitmapIndexScan *) plan)->indexid);
+			break;
+		case T_NestLoop:
+		case T_MergeJoin:
+		case T_HashJoin:
+			appendStringInfo(buf, " j%d", (int) ((const Join *) plan)->jointype);
+			break;
+		case T_Agg:
+			appendStringInfo(buf, " a%d", (int) ((const Agg *) plan)->aggstrategy);
+			break;
+		case T_SetOp:
+			appendStringInfo(buf, " s%d", (int) ((const SetOp *) plan)->strategy);
+			break;
+#if PG_VERSION_NUM >= 90600
+		case T_Gather:
+			appendStringInfo(buf, " w%d", ((const Gather *) plan)->num_workers);
+			break;
+#endif
+#if PG_VERSION_NUM >= 100000
+		case T_GatherMerge:
+			appendStringInfo(buf, " w%d", ((const GatherMerge *) plan)->num_workers);
+			break;
+#endif
+		default:
+			break;
+	}
+
+	if (with_costs)
+		appendStringInfo(buf, " %.2f %.2f %.0f",
+						 plan->startup_cost, plan->total_cost, plan->plan_rows);
+
+	foreach(lc, plan_child_plans(plan))
+		append_plan_shape(buf, stmt, (const Plan *) lfirst(lc), with_costs);
+
+	appendStringInfoChar(buf, ')');
+}
+
+/*
+ * Range table indexes differ between otherwise equal plans of different
+ * queries, so scans are identified by the relation OID instead.
+ */
+static void
+append_scan_relation(StringInfo buf, const PlannedStmt *stmt, const Plan *plan)
+{
+	Index		scanrelid = ((const Scan *) plan)->scanrelid;
+
+	if (scanrelid > 0 && scanrelid <= (Index) list_length(stmt->rtable))
+	{
+		RangeTblEntry *rte = rt_fetch(scanrelid, stmt->rtable);
+
+		if (rte->rtekind == RTE_RELATION)
+		{
+			appendStringInfo(buf, " r%u", rte->relid);
+			return;
+		}
+	}
+
+	appendStringInfo(buf, " #%u", scanrelid);
+}
@@ -0,0 +1,1047 @@
+/*-------------------------------------------------------------------------
+ *
+ * plan_history.c
+ *
+ * History of the plans the executor ran.  When pg_plan_tree_dot.plan_history
+ * is on, every distinct plan of a query, identified by the query ID and the
+ * plan fingerprint, gets an entry in shared memory with the time it was
+ * first and last seen, its calls, total time and rows.  The graph of each
+ * plan is rendered once, when it is first seen, and appended compressed to
+ * a file; the entry only holds its offset.  A background worker writes the
+ * entries to disk periodically and at shutdown, and they are loaded again
+ * at startup.  No table is written at any time.
+ *
+ * The library must be in shared_preload_libraries.  PostgreSQL 9.5 or
+ * later is required.  Queries without a query ID, which pg_stat_statements
+ * computes, are not recorded.
+ *
+ * Copyright (c) 2014-2017 Minoru NAKAMURA <nminoru@nminoru.jp>
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#if PG_VERSION_NUM >= 90600
+#include "access/parallel.h"
+#endif
+#include "access/xact.h"
+#if PG_VERSION_NUM >= 90500
+#include "common/pg_lzcompress.h"
+#endif
+#include "executor/executor.h"
+#include "executor/instrument.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "nodes/plannodes.h"
+#include "pgstat.h"
+#include "postmaster/bgworker.h"
+#include "storage/fd.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+#include "utils/resowner.h"
+#include "utils/timestamp.h"
+#include "utils/tuplestore.h"
+
+#include "pg_plan_tree_dot.h"
+
+
+#define PLAN_HISTORY_STATS_FILE		"pg_stat/pg_plan_tree_dot_history.stat"
+#define PLAN_HISTORY_GRAPHS_FILE	"pg_stat/pg_plan_tree_dot_history.graphs"
+
+/* Identifies the format of PLAN_HISTORY_STATS_FILE */
+#define PLAN_HISTORY_FILE_HEADER	0x50544431
+
+/* Percentage of the entries evicted when the history is full */
+#define PLAN_HISTORY_EVICT_PERCENT	5
+
+typedef struct PlanHistoryKey
+{
+	uint64		queryid;
+	uint64		fingerprint;
+} PlanHistoryKey;
+
+/* One plan of a query */
+typedef struct PlanHistoryEntry
+{
+	PlanHistoryKey key;			/* hash table key */
+	slock_t		mutex;			/* protects the counters below */
+	TimestampTz	first_seen;
+	TimestampTz	last_seen;
+	int64		calls;
+	double		total_ms;
+	int64		rows;
+	int64		graph_offset;	/* where the graph is in PLAN_HISTORY_GRAPHS_FILE */
+	int32		graph_len;		/* bytes stored, or 0 if there is no graph */
+	int32		raw_len;		/* length of the graph text */
+	bool		compressed;
+} PlanHistoryEntry;
+
+/* Where the next graph goes in PLAN_HISTORY_GRAPHS_FILE */
+typedef struct PlanHistoryGraphs
+{
+	slock_t		mutex;			/* protects the fields below */
+	int64		end;			/* offset reserved by the last graph */
+	uint32		generation;		/* advanced whenever the file is truncated */
+} PlanHistoryGraphs;
+
+/* pg_plan_tree_dot.plan_history */
+static bool plan_history_enabled = false;
+
+/* pg_plan_tree_dot.plan_history_max */
+static int	plan_history_max = 1000;
+
+/* pg_plan_tree_dot.plan_history_flush_interval, in seconds */
+static int	plan_history_flush_interval = 60;
+
+#if PG_VERSION_NUM >= 90500
+
+static HTAB *plan_history = NULL;
+static LWLock *plan_history_lock = NULL;
+
+/*
+ * Graphs are written to their reserved offsets holding graphs_lock in
+ * shared mode, so neither plan_history_lock nor the other writers wait for
+ * the disk.  A reset takes it in exclusive mode to truncate the file.
+ */
+static PlanHistoryGraphs *plan_history_graphs = NULL;
+static LWLock *graphs_lock = NULL;
+
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+static ExecutorStart_hook_type prev_ExecutorStart = NULL;
+static ExecutorEnd_hook_type prev_ExecutorEnd = NULL;
+
+static volatile sig_atomic_t got_sigterm = false;
+static volatile sig_atomic_t got_sighup = false;
+
+PGDLLEXPORT void plan_history_writer_main(Datum main_arg) pg_attribute_noreturn();
+
+static void plan_history_shmem_startup(void);
+static void history_ExecutorStart(QueryDesc *queryDesc, int eflags);
+static void history_ExecutorEnd(QueryDesc *queryDesc);
+static void record_plan_execution(QueryDesc *queryDesc, double total_ms, int64 rows);
+static bool enter_plan_history(PlanHistoryKey *key, PlannedStmt *stmt);
+static void evict_plan_history(void);
+static int	entry_last_seen_cmp(const void *lhs, const void *rhs);
+static bool append_history_graph(PlanHistoryEntry *stored, const char *graph, uint32 *generation);
+static char *read_history_graph(FILE *file, const PlanHistoryEntry *entry);
+static void flush_plan_history(void);
+static void load_plan_history(void);
+static void plan_history_sigterm(SIGNAL_ARGS);
+static void plan_history_sighup(SIGNAL_ARGS);
+
+#endif
+
+/*
+ * Called from _PG_init().  Nothing is recorded unless the library is in
+ * shared_preload_libraries.
+ */
+void
+init_plan_history(void)
+{
+#if PG_VERSION_NUM >= 90500
+	BackgroundWorker worker;
+#endif
+
+#if PG_VERSION_NUM >= 90100
+	DefineCustomBoolVariable("pg_plan_tree_dot.plan_history",
+							 "Records the plans the executor runs with their statistics.",
+							 "Requires pg_plan_tree_dot in shared_preload_libraries.",
+							 &plan_history_enabled,
+							 false,
+							 PGC_SUSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("pg_plan_tree_dot.plan_history_max",
+							"Sets the number of plans the history keeps.",
+							NULL,
+							&plan_history_max,
+							1000,
+							1,
+							INT_MAX / 2,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("pg_plan_tree_dot.plan_history_flush_interval",
+							"Sets how often the plan history is written to disk.",
+							NULL,
+							&plan_history_flush_interval,
+							60,
+							1,
+							INT_MAX / 1000,
+							PGC_SIGHUP,
+							GUC_UNIT_S,
+							NULL,
+							NULL,
+							NULL);
+#else
+	DefineCustomBoolVariable("pg_plan_tree_dot.plan_history",
+							 "Records the plans the executor runs with their statistics.",
+							 "Requires pg_plan_tree_dot in shared_preload_libraries.",
+							 &plan_history_enabled,
+							 false,
+							 PGC_SUSET,
+							 0,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("pg_plan_tree_dot.plan_history_max",
+							"Sets the number of plans the history keeps.",
+							NULL,
+							&plan_history_max,
+							1000,
+							1,
+							INT_MAX / 2,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("pg_plan_tree_dot.plan_history_flush_interval",
+							"Sets how often the plan history is written to disk.",
+							NULL,
+							&plan_history_flush_interval,
+							60,
+							1,
+							INT_MAX / 1000,
+							PGC_SIGHUP,
+							GUC_UNIT_S,
+							NULL,
+							NULL);
+#endif
+
+#if PG_VERSION_NUM >= 90500
+	if (!process_shared_preload_libraries_in_progress)
+		return;
+
+	RequestAddinShmemSpace(add_size(hash_estimate_size(plan_history_max, sizeof(PlanHistoryEntry)),
+									MAXALIGN(sizeof(PlanHistoryGraphs))));
+#if PG_VERSION_NUM >= 90600
+	RequestNamedLWLockTranche("pg_plan_tree_dot history", 2);
+#else
+	RequestAddinLWLocks(2);
+#endif
+
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = plan_history_shmem_startup;
+
+	prev_ExecutorStart = ExecutorStart_hook;
+	ExecutorStart_hook = history_ExecutorStart;
+
+	prev_ExecutorEnd = ExecutorEnd_hook;
+	ExecutorEnd_hook = history_ExecutorEnd;
+
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags		= BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time	= BgWorkerStart_PostmasterStart;
+	worker.bgw_restart_time	= 10;
+	worker.bgw_main_arg		= (Datum) 0;
+	snprintf(worker.bgw_name, BGW_MAXLEN, "pg_plan_tree_dot history writer");
+	snprintf(worker.bgw_library_name, BGW_MAXLEN, "pg_plan_tree_dot");
+	snprintf(worker.bgw_function_name, BGW_MAXLEN, "plan_history_writer_main");
+
+	RegisterBackgroundWorker(&worker);
+#endif
+}
+
+#if PG_VERSION_NUM >= 90500
+
+static void
+plan_history_shmem_startup(void)
+{
+	HASHCTL		info;
+	bool		found;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	memset(&info, 0, sizeof(info));
+	info.keysize	= sizeof(PlanHistoryKey);
+	info.entrysize	= sizeof(PlanHistoryEntry);
+
+	plan_history = ShmemInitHash("pg_plan_tree_dot plan history",
+								 plan_history_max, plan_history_max,
+								 &info,
+								 HASH_ELEM | HASH_BLOBS);
+
+	plan_history_graphs = (PlanHistoryGraphs *) ShmemInitStruct("pg_plan_tree_dot plan history graphs",
+																sizeof(PlanHistoryGraphs),
+																&found);
+	if (!found)
+	{
+		SpinLockInit(&plan_history_graphs->mutex);
+		plan_history_graphs->end		= 0;
+		plan_history_graphs->generation	= 0;
+	}
+
+#if PG_VERSION_NUM >= 90600
+	plan_history_lock = &(GetNamedLWLockTranche("pg_plan_tree_dot history"))[0].lock;
+	graphs_lock = &(GetNamedLWLockTranche("pg_plan_tree_dot history"))[1].lock;
+#else
+	plan_history_lock = LWLockAssign();
+	graphs_lock = LWLockAssign();
+#endif
+
+	LWLockRelease(AddinShmemInitLock);
+
+	/* The postmaster sets up the table, also after a crash */
+	if (!IsUnderPostmaster)
+	{
+		FILE   *file;
+
+		load_plan_history();
+
+		/* Graphs go after the ones already in the file */
+		file = AllocateFile(PLAN_HISTORY_GRAPHS_FILE, PG_BINARY_A);
+		if (file != NULL)
+		{
+			if (fseeko(file, 0, SEEK_END) == 0)
+				plan_history_graphs->end = Max((int64) ftello(file), 0);
+			FreeFile(file);
+		}
+	}
+}
+
+/*
+ * Measures the query as pg_stat_statements does.  The instrumentation lives
+ * in the query's memory context.  Parallel workers run parts of the plan of
+ * their leader, which records the whole.
+ */
+static void
+history_ExecutorStart(QueryDesc *queryDesc, int eflags)
+{
+	if (prev_ExecutorStart)
+		prev_ExecutorStart(queryDesc, eflags);
+	else
+		standard_ExecutorStart(queryDesc, eflags);
+
+#if PG_VERSION_NUM >= 90600
+	if (IsParallelWorker())
+		return;
+#endif
+
+	if (plan_history_enabled && plan_history != NULL &&
+		queryDesc->plannedstmt->queryId != 0 &&
+		queryDesc->plannedstmt->utilityStmt == NULL &&
+		(eflags & EXEC_FLAG_EXPLAIN_ONLY) == 0 &&
+		queryDesc->totaltime == NULL)
+	{
+		MemoryContext oldcontext;
+
+		oldcontext = MemoryContextSwitchTo(queryDesc->estate->es_query_cxt);
+		queryDesc->totaltime = InstrAlloc(1, INSTRUMENT_TIMER);
+		MemoryContextSwitchTo(oldcontext);
+	}
+}
+
+static void
+history_ExecutorEnd(QueryDesc *queryDesc)
+{
+	if (plan_history_enabled && plan_history != NULL &&
+#if PG_VERSION_NUM >= 90600
+		!IsParallelWorker() &&
+#endif
+		queryDesc->plannedstmt->queryId != 0 &&
+		queryDesc->totaltime != NULL &&
+		queryDesc->plannedstmt->utilityStmt == NULL)
+	{
+		InstrEndLoop(queryDesc->totaltime);
+
+		record_plan_execution(queryDesc,
+							  queryDesc->totaltime->total * 1000.0,
+							  (int64) queryDesc->estate->es_processed);
+	}
+
+	if (prev_ExecutorEnd)
+		prev_ExecutorEnd(queryDesc);
+	else
+		standard_ExecutorEnd(queryDesc);
+}
+
+/*
+ * Adds one execution to the entry of the plan.  A known plan only takes the
+ * shared lock and the entry's spinlock.
+ */
+static void
+record_plan_execution(QueryDesc *queryDesc, double total_ms, int64 rows)
+{
+	PlanHistoryKey		key;
+	PlanHistoryEntry   *entry;
+	TimestampTz			now = GetCurrentTimestamp();
+
+	memset(&key, 0, sizeof(key));
+
+	key.queryid = (uint64) queryDesc->plannedstmt->queryId;
+	key.fingerprint = plan_fingerprint(queryDesc->plannedstmt, false);
+
+	LWLockAcquire(plan_history_lock, LW_SHARED);
+
+	entry = (PlanHistoryEntry *) hash_search(plan_history, &key, HASH_FIND, NULL);
+	if (entry == NULL)
+	{
+		LWLockRelease(plan_history_lock);
+
+		if (!enter_plan_history(&key, queryDesc->plannedstmt))
+			return;
+
+		/* A reset may have removed it again */
+		LWLockAcquire(plan_history_lock, LW_SHARED);
+
+		entry = (PlanHistoryEntry *) hash_search(plan_history, &key, HASH_FIND, NULL);
+		if (entry == NULL)
+		{
+			LWLockRelease(plan_history_lock);
+			return;
+		}
+	}
+
+	SpinLockAcquire(&entry->mutex);
+	if (entry->calls == 0)
+		entry->first_seen = now;
+	entry->last_seen = now;
+	entry->calls++;
+	entry->total_ms += total_ms;
+	entry->rows += rows;
+	SpinLockRelease(&entry->mutex);
+
+	LWLockRelease(plan_history_lock);
+}
+
+/*
+ * Creates the entry of a new plan and stores its graph, which is rendered
+ * and written before the exclusive lock is taken.  This runs in
+ * ExecutorEnd(), so rendering runs in a subtransaction, as
+ * run_alternative_plan() does; a failure is reported as a warning and the
+ * entry has no graph.  No graph is rendered in parallel mode, where no
+ * subtransaction can be started.
+ *
+ * When the history holds pg_plan_tree_dot.plan_history_max plans, the ones
+ * seen least recently are evicted first.  Returns false if no entry could be
+ * made.
+ */
+static bool
+enter_plan_history(PlanHistoryKey *key, PlannedStmt *stmt)
+{
+	MemoryContext		oldcontext = CurrentMemoryContext;
+	ResourceOwner		oldowner = CurrentResourceOwner;
+	PlanHistoryEntry   *entry;
+	PlanHistoryEntry	stored;
+	char			   *volatile graph = NULL;
+	char				title[128];
+	uint32				generation = 0;
+	bool				found;
+
+	snprintf(title, sizeof(title), "Query " UINT64_FORMAT ", plan %08x%08x",
+			 key->queryid, (uint32) (key->fingerprint >> 32), (uint32) key->fingerprint);
+
+#if PG_VERSION_NUM >= 90600
+	if (IsInParallelMode())
+		goto enter;
+#endif
+
+	BeginInternalSubTransaction(NULL);
+	MemoryContextSwitchTo(oldcontext);
+
+	PG_TRY();
+	{
+		graph = get_plan_tree_dot_string(title, stmt, false);
+
+		ReleaseCurrentSubTransaction();
+		MemoryContextSwitchTo(oldcontext);
+		CurrentResourceOwner = oldowner;
+	}
+	PG_CATCH();
+	{
+		ErrorData  *edata;
+
+		MemoryContextSwitchTo(oldcontext);
+		edata = CopyErrorData();
+		FlushErrorState();
+
+		RollbackAndReleaseCurrentSubTransaction();
+		MemoryContextSwitchTo(oldcontext);
+		CurrentResourceOwner = oldowner;
+
+		if (edata->sqlerrcode == ERRCODE_QUERY_CANCELED)
+			ReThrowError(edata);
+
+		ereport(WARNING,
+				(errmsg("could not render the plan of query " UINT64_FORMAT ": %s",
+						key->queryid, edata->message)));
+
+		FreeErrorData(edata);
+		graph = NULL;
+	}
+	PG_END_TRY();
+
+#if PG_VERSION_NUM >= 90600
+enter:
+#endif
+	if (graph == NULL || !append_history_graph(&stored, graph, &generation))
+	{
+		stored.graph_offset	= 0;
+		stored.graph_len	= 0;
+		stored.raw_len		= 0;
+		stored.compressed	= false;
+	}
+
+	LWLockAcquire(plan_history_lock, LW_EXCLUSIVE);
+
+	/* The hash table does not stop at its maximum size by itself */
+	if (hash_search(plan_history, key, HASH_FIND, NULL) == NULL &&
+		hash_get_num_entries(plan_history) >= plan_history_max)
+		evict_plan_history();
+
+	entry = (PlanHistoryEntry *) hash_search(plan_history, key, HASH_ENTER_NULL, &found);
+	if (entry != NULL && !found)
+	{
+		SpinLockInit(&entry->mutex);
+		entry->first_seen	= 0;
+		entry->last_seen	= 0;
+		entry->calls		= 0;
+		entry->total_ms		= 0.0;
+		entry->rows			= 0;
+
+		/* A reset after the graph was written has truncated it away */
+		SpinLockAcquire(&plan_history_graphs->mutex);
+		if (plan_history_graphs->generation != generation)
+			stored.graph_len = 0;
+		SpinLockRelease(&plan_history_graphs->mutex);
+
+		entry->graph_offset	= stored.graph_offset;
+		entry->graph_len	= stored.graph_len;
+		entry->raw_len		= stored.raw_len;
+		entry->compressed	= stored.compressed;
+	}
+
+	LWLockRelease(plan_history_lock);
+
+	if (graph != NULL)
+		pfree(graph);
+
+	return entry != NULL;
+}
+
+/*
+ * Removes the PLAN_HISTORY_EVICT_PERCENT percent of the entries that were
+ * seen least recently, as entry_dealloc() of pg_stat_statements does.  Their
+ * graphs stay in PLAN_HISTORY_GRAPHS_FILE until the history is reset.
+ * Called with the exclusive lock held, so the counters can be read without
+ * the entries' spinlocks.
+ */
+static void
+evict_plan_history(void)
+{
+	HASH_SEQ_STATUS		hash_seq;
+	PlanHistoryEntry  **entries;
+	PlanHistoryEntry   *entry;
+	long				num_entries = 0;
+	long				num_evicted;
+	long				i;
+
+	entries = (PlanHistoryEntry **) palloc(sizeof(PlanHistoryEntry *) *
+										   Max(hash_get_num_entries(plan_history), 1));
+
+	hash_seq_init(&hash_seq, plan_history);
+	while ((entry = (PlanHistoryEntry *) hash_seq_search(&hash_seq)) != NULL)
+		entries[num_entries++] = entry;
+
+	qsort(entries, num_entries, sizeof(PlanHistoryEntry *), entry_last_seen_cmp);
+
+	num_evicted = Max(num_entries * PLAN_HISTORY_EVICT_PERCENT / 100, 1);
+	num_evicted = Min(num_evicted, num_entries);
+
+	for (i = 0 ; i < num_evicted ; i++)
+		hash_search(plan_history, &entries[i]->key, HASH_REMOVE, NULL);
+
+	pfree(entries);
+}
+
+/*
+ * qsort comparator putting the entries seen least recently first.
+ */
+static int
+entry_last_seen_cmp(const void *lhs, const void *rhs)
+{
+	TimestampTz		l = (*(PlanHistoryEntry *const *) lhs)->last_seen;
+	TimestampTz		r = (*(PlanHistoryEntry *const *) rhs)->last_seen;
+
+	if (l < r)
+		return -1;
+	else if (l > r)
+		return +1;
+	else
+		return 0;
+}
+
+/*
+ * Writes the graph to PLAN_HISTORY_GRAPHS_FILE, compressed with pglz
+ * unless that fails to make it smaller, and fills the graph fields of
+ * *stored.  The space is reserved under the spinlock and written under
+ * graphs_lock in shared mode; *generation tells the caller which file it
+ * went to.
+ */
+static bool
+append_history_graph(PlanHistoryEntry *stored, const char *graph, uint32 *generation)
+{
+	int32		raw_len = (int32) strlen(graph);
+	int32		len;
+	char	   *compressed;
+	FILE	   *file;
+
+	compressed = (char *) palloc(PGLZ_MAX_OUTPUT(raw_len));
+	len = pglz_compress(graph, raw_len, compressed, PGLZ_strategy_always);
+
+	stored->raw_len		= raw_len;
+	stored->compressed	= (len >= 0);
+	stored->graph_len	= stored->compressed ? len : raw_len;
+
+	LWLockAcquire(graphs_lock, LW_SHARED);
+
+	SpinLockAcquire(&plan_history_graphs->mutex);
+	stored->graph_offset = plan_history_graphs->end;
+	plan_history_graphs->end += stored->graph_len;
+	*generation = plan_history_graphs->generation;
+	SpinLockRelease(&plan_history_graphs->mutex);
+
+	/*
+	 * Opened for update, as other backends write at other offsets.  The
+	 * postmaster and pg_plan_tree_dot_history_reset() create the file.
+	 */
+	file = AllocateFile(PLAN_HISTORY_GRAPHS_FILE, "r+b");
+
+	if (file == NULL ||
+		fseeko(file, (off_t) stored->graph_offset, SEEK_SET) != 0 ||
+		fwrite(stored->compressed ? compressed : graph, 1, stored->graph_len, file) != (size_t) stored->graph_len)
+	{
+		ereport(WARNING,
+				(errcode_for_file_access(),
+				 errmsg("could not write to file \"%s\": %m", PLAN_HISTORY_GRAPHS_FILE)));
+		if (file)
+			FreeFile(file);
+		LWLockRelease(graphs_lock);
+		pfree(compressed);
+		return false;
+	}
+
+	if (FreeFile(file) != 0)
+	{
+		ereport(WARNING,
+				(errcode_for_file_access(),
+				 errmsg("could not write to file \"%s\": %m", PLAN_HISTORY_GRAPHS_FILE)));
+		LWLockRelease(graphs_lock);
+		pfree(compressed);
+		return false;
+	}
+
+	LWLockRelease(graphs_lock);
+	pfree(compressed);
+
+	return true;
+}
+
+/*
+ * Returns the graph of an entry, or NULL if it cannot be read.
+ */
+static char *
+read_history_graph(FILE *file, const PlanHistoryEntry *entry)
+{
+	char   *stored;
+	char   *graph;
+
+	if (file == NULL || entry->graph_len <= 0)
+		return NULL;
+
+	stored = (char *) palloc(entry->graph_len);
+
+	if (fseeko(file, (off_t) entry->graph_offset, SEEK_SET) != 0 ||
+		fread(stored, 1, entry->graph_len, file) != (size_t) entry->graph_len)
+	{
+		pfree(stored);
+		return NULL;
+	}
+
+	graph = (char *) palloc(entry->raw_len + 1);
+
+	if (!entry->compressed)
+		memcpy(graph, stored, entry->raw_len);
+#if PG_VERSION_NUM >= 120000
+	else if (pglz_decompress(stored, entry->graph_len, graph, entry->raw_len, true) != entry->raw_len)
+#else
+	else if (pglz_decompress(stored, entry->graph_len, graph, entry->raw_len) != entry->raw_len)
+#endif
+	{
+		pfree(stored);
+		pfree(graph);
+		return NULL;
+	}
+
+	graph[entry->raw_len] = '\0';
+
+	pfree(stored);
+
+	return graph;
+}
+
+/*
+ * Writes every entry to PLAN_HISTORY_STATS_FILE, through a temporary file
+ * so a crash leaves the previous copy intact.
+ */
+static void
+flush_plan_history(void)
+{
+	HASH_SEQ_STATUS		hash_seq;
+	PlanHistoryEntry   *entry;
+	FILE			   *file;
+	uint32				header = PLAN_HISTORY_FILE_HEADER;
+	int32				num_entries;
+
+	file = AllocateFile(PLAN_HISTORY_STATS_FILE ".tmp", PG_BINARY_W);
+	if (file == NULL)
+		goto error;
+
+	LWLockAcquire(plan_history_lock, LW_SHARED);
+
+	num_entries = (int32) hash_get_num_entries(plan_history);
+
+	if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+		fwrite(&num_entries, sizeof(num_entries), 1, file) != 1)
+	{
+		LWLockRelease(plan_history_lock);
+		goto error;
+	}
+
+	hash_seq_init(&hash_seq, plan_history);
+	while ((entry = (PlanHistoryEntry *) hash_seq_search(&hash_seq)) != NULL)
+	{
+		PlanHistoryEntry copy;
+
+		SpinLockAcquire(&entry->mutex);
+		copy = *entry;
+		SpinLockRelease(&entry->mutex);
+
+		if (fwrite(&copy, sizeof(copy), 1, file) != 1)
+		{
+			hash_seq_term(&hash_seq);
+			LWLockRelease(plan_history_lock);
+			goto error;
+		}
+	}
+
+	if (FreeFile(file) != 0)
+	{
+		LWLockRelease(plan_history_lock);
+		file = NULL;
+		goto error;
+	}
+
+	/* Renamed under the lock so that a reset cannot come in between */
+	if (rename(PLAN_HISTORY_STATS_FILE ".tmp", PLAN_HISTORY_STATS_FILE) != 0)
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not rename file \"%s\": %m", PLAN_HISTORY_STATS_FILE ".tmp")));
+
+	LWLockRelease(plan_history_lock);
+
+	return;
+
+error:
+	ereport(LOG,
+			(errcode_for_file_access(),
+			 errmsg("could not write file \"%s\": %m", PLAN_HISTORY_STATS_FILE ".tmp")));
+	if (file)
+		FreeFile(file);
+	unlink(PLAN_HISTORY_STATS_FILE ".tmp");
+}
+
+/*
+ * Reads the entries written by flush_plan_history().  Called in the
+ * postmaster at startup.
+ */
+static void
+load_plan_history(void)
+{
+	FILE	   *file;
+	uint32		header;
+	int32		num_entries;
+	int32		i;
+
+	file = AllocateFile(PLAN_HISTORY_STATS_FILE, PG_BINARY_R);
+	if (file == NULL)
+		return;
+
+	if (fread(&header, sizeof(header), 1, file) != 1 ||
+		header != PLAN_HISTORY_FILE_HEADER ||
+		fread(&num_entries, sizeof(num_entries), 1, file) != 1)
+	{
+		ereport(LOG,
+				(errmsg("ignoring invalid file \"%s\"", PLAN_HISTORY_STATS_FILE)));
+		FreeFile(file);
+		return;
+	}
+
+	for (i = 0 ; i < num_entries ; i++)
+	{
+		PlanHistoryEntry	saved;
+		PlanHistoryEntry   *entry;
+		bool				found;
+
+		if (fread(&saved, sizeof(saved), 1, file) != 1)
+			break;
+
+		entry = (PlanHistoryEntry *) hash_search(plan_history, &saved.key, HASH_ENTER_NULL, &found);
+		if (entry == NULL)
+			break;
+
+		*entry = saved;
+		SpinLockInit(&entry->mutex);
+	}
+
+	FreeFile(file);
+}
+
+/*
+ * Main of the background worker that writes the history every
+ * pg_plan_tree_dot.plan_history_flush_interval seconds and at shutdown.
+ */
+void
+plan_history_writer_main(Datum main_arg)
+{
+	pqsignal(SIGTERM, plan_history_sigterm);
+	pqsignal(SIGHUP, plan_history_sighup);
+
+	BackgroundWorkerUnblockSignals();
+
+	while (!got_sigterm)
+	{
+		int rc;
+
+#if PG_VERSION_NUM >= 100000
+		rc = WaitLatch(MyLatch,
+					   WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+					   plan_history_flush_interval * 1000L,
+					   PG_WAIT_EXTENSION);
+#else
+		rc = WaitLatch(MyLatch,
+					   WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+					   plan_history_flush_interval * 1000L);
+#endif
+		ResetLatch(MyLatch);
+
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+
+		if (got_sighup)
+		{
+			got_sighup = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		if (plan_history != NULL)
+			flush_plan_history();
+	}
+
+	proc_exit(0);
+}
+
+static void
+plan_history_sigterm(SIGNAL_ARGS)
+{
+	int save_errno = errno;
+
+	got_sigterm = true;
+	SetLatch(MyLatch);
+
+	errno = save_errno;
+}
+
+static void
+plan_history_sighup(SIGNAL_ARGS)
+{
+	int save_errno = errno;
+
+	got_sighup = true;
+	SetLatch(MyLatch);
+
+	errno = save_errno;
+}
+
+#endif
+
+/*
+ * pg_plan_tree_dot_history()
+ *
+ * Returns one row per recorded plan.  Only superusers see the graphs.
+ */
+PG_FUNCTION_INFO_V1(pg_plan_tree_dot_history);
+Datum
+pg_plan_tree_dot_history(PG_FUNCTION_ARGS)
+{
+#if PG_VERSION_NUM >= 90500
+	ReturnSetInfo	   *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc			tupdesc;
+	Tuplestorestate	   *tupstore;
+	MemoryContext		oldcontext;
+	HASH_SEQ_STATUS		hash_seq;
+	PlanHistoryEntry   *entry;
+	PlanHistoryEntry   *entries;
+	FILE			   *file = NULL;
+	bool				show_graphs = superuser();
+	long				num_entries, n = 0, i;
+
+	if (plan_history == NULL)
+		elog(ERROR, "pg_plan_tree_dot must be loaded via shared_preload_libraries");
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		elog(ERROR, "set-valued function called in context that cannot accept a set");
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		elog(ERROR, "materialize mode required, but it is not allowed in this context");
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+
+	tupdesc = CreateTupleDescCopy(tupdesc);
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Copy the entries so that no file is read under the lock */
+	LWLockAcquire(plan_history_lock, LW_SHARED);
+
+	num_entries = hash_get_num_entries(plan_history);
+	entries = (PlanHistoryEntry *) palloc(sizeof(PlanHistoryEntry) * Max(num_entries, 1));
+
+	hash_seq_init(&hash_seq, plan_history);
+	while ((entry = (PlanHistoryEntry *) hash_seq_search(&hash_seq)) != NULL)
+	{
+		SpinLockAcquire(&entry->mutex);
+		entries[n++] = *entry;
+		SpinLockRelease(&entry->mutex);
+	}
+
+	LWLockRelease(plan_history_lock);
+
+	if (show_graphs)
+		file = AllocateFile(PLAN_HISTORY_GRAPHS_FILE, PG_BINARY_R);
+
+	for (i = 0 ; i < n ; i++)
+	{
+		Datum	values[9];
+		bool	nulls[9];
+		char	fingerprint[17];
+		char   *graph = NULL;
+
+		memset(nulls, 0, sizeof(nulls));
+
+		snprintf(fingerprint, sizeof(fingerprint), "%08x%08x",
+				 (uint32) (entries[i].key.fingerprint >> 32), (uint32) entries[i].key.fingerprint);
+
+		values[0] = Int64GetDatum((int64) entries[i].key.queryid);
+		values[1] = CStringGetTextDatum(fingerprint);
+		values[2] = TimestampTzGetDatum(entries[i].first_seen);
+		values[3] = TimestampTzGetDatum(entries[i].last_seen);
+		values[4] = Int64GetDatum(entries[i].calls);
+		values[5] = Float8GetDatum(entries[i].total_ms);
+		values[6] = Float8GetDatum(entries[i].calls > 0 ? entries[i].total_ms / entries[i].calls : 0.0);
+		values[7] = Int64GetDatum(entries[i].rows);
+
+		if (show_graphs)
+			graph = read_history_graph(file, &entries[i]);
+
+		if (graph)
+			values[8] = CStringGetTextDatum(graph);
+		else
+			nulls[8] = true;
+
+		nulls[2] = nulls[3] = (entries[i].calls == 0);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+
+	if (file)
+		FreeFile(file);
+
+	return (Datum) 0;
+#else
+	elog(ERROR, "pg_plan_tree_dot_history requires PostgreSQL 9.5 or later");
+
+	PG_RETURN_VOID();
+#endif
+}
+
+/*
+ * pg_plan_tree_dot_history_reset()
+ */
+PG_FUNCTION_INFO_V1(pg_plan_tree_dot_history_reset);
+Datum
+pg_plan_tree_dot_history_reset(PG_FUNCTION_ARGS)
+{
+#if PG_VERSION_NUM >= 90500
+	HASH_SEQ_STATUS		hash_seq;
+	PlanHistoryEntry   *entry;
+	FILE			   *file;
+
+	if (plan_history == NULL)
+		elog(ERROR, "pg_plan_tree_dot must be loaded via shared_preload_libraries");
+
+	if (!superuser())
+		elog(ERROR, "must be superuser to reset the plan history");
+
+	LWLockAcquire(plan_history_lock, LW_EXCLUSIVE);
+
+	hash_seq_init(&hash_seq, plan_history);
+	while ((entry = (PlanHistoryEntry *) hash_seq_search(&hash_seq)) != NULL)
+		hash_search(plan_history, &entry->key, HASH_REMOVE, NULL);
+
+	/* Graphs being written now are not entered, as the generation moves on */
+	LWLockAcquire(graphs_lock, LW_EXCLUSIVE);
+
+	SpinLockAcquire(&plan_history_graphs->mutex);
+	plan_history_graphs->end = 0;
+	plan_history_graphs->generation++;
+	SpinLockRelease(&plan_history_graphs->mutex);
+
+	file = AllocateFile(PLAN_HISTORY_GRAPHS_FILE, PG_BINARY_W);
+	if (file)
+		FreeFile(file);
+
+	LWLockRelease(graphs_lock);
+
+	/* The saved entries point into the truncated file */
+	if (unlink(PLAN_HISTORY_STATS_FILE) != 0 && errno != ENOENT)
+		ereport(WARNING,
+				(errcode_for_file_access(),
+				 errmsg("could not remove file \"%s\": %m", PLAN_HISTORY_STATS_FILE)));
+
+	LWLockRelease(plan_history_lock);
+#else
+	elog(ERROR, "pg_plan_tree_dot_history_reset requires PostgreSQL 9.5 or later");
+#endif
+
+	PG_RETURN_VOID();
+}
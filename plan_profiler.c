@@ -0,0 +1,251 @@
+/*-------------------------------------------------------------------------
+ *
+ * plan_profiler.c
+ *
+ * Sampling profiler for plan nodes.  While a query runs, the ExecProcNode
+ * of each of its PlanStates is replaced by a thin wrapper that points a
+ * global at the node's sample counter, and restores the caller's when the
+ * node returns.  An ITIMER_PROF timer raises SIGPROF every
+ * 1/pg_plan_tree_dot.profile_hz seconds of CPU time, and the handler
+ * increments the counter of the node executing at that moment.  This costs
+ * two stores per tuple and node, instead of the clock reads that
+ * INSTRUMENT_TIMER makes.
+ *
+ * Hash, BitmapIndexScan, BitmapAnd and BitmapOr are driven through
+ * MultiExecProcNode, which cannot be wrapped; their samples go to the node
+ * that called them.  Work done in parallel workers is not sampled.
+ *
+ * PostgreSQL 10 or later is required for the ExecProcNode pointers.
+ *
+ * Copyright (c) 2014-2017 Minoru NAKAMURA <nminoru@nminoru.jp>
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <signal.h>
+#ifndef WIN32
+#include <sys/time.h>
+#endif
+
+#include "miscadmin.h"
+#include "nodes/execnodes.h"
+#include "nodes/plannodes.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+
+#include "pg_plan_tree_dot.h"
+
+
+#if PG_VERSION_NUM >= 100000 && !defined(WIN32)
+#define PLAN_PROFILER_SUPPORTED
+#endif
+
+struct PlanProfile
+{
+	int			num_slots;		/* plan_node_id + 1 of the largest node */
+	volatile uint64 *samples;	/* per plan_node_id */
+	volatile uint64 other;		/* in the executor outside any node */
+#ifdef PLAN_PROFILER_SUPPORTED
+	ExecProcNodeMtd *real_procs;	/* per plan_node_id */
+#endif
+};
+
+/* pg_plan_tree_dot.profile_hz */
+static int profile_hz = 1000;
+
+#ifdef PLAN_PROFILER_SUPPORTED
+/* The profile being recorded, and the counter the next sample goes to */
+static PlanProfile *active_profile = NULL;
+static volatile uint64 *volatile current_counter = NULL;
+
+static pqsigfunc prev_sigprof_handler = NULL;
+
+static TupleTableSlot *profile_exec_proc_node(PlanState *node);
+static void profile_sigprof_handler(SIGNAL_ARGS);
+static void set_profile_timer(int hz);
+#endif
+
+/*
+ * Called from _PG_init().
+ */
+void
+init_plan_profiler(void)
+{
+#if PG_VERSION_NUM >= 90100
+	DefineCustomIntVariable("pg_plan_tree_dot.profile_hz",
+							"Sets the sampling rate of plan_tree_profile().",
+							"Samples are taken per second of CPU time of the backend.",
+							&profile_hz,
+							1000,
+							1,
+							10000,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+#else
+	DefineCustomIntVariable("pg_plan_tree_dot.profile_hz",
+							"Sets the sampling rate of plan_tree_profile().",
+							"Samples are taken per second of CPU time of the backend.",
+							&profile_hz,
+							1000,
+							1,
+							10000,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL);
+#endif
+}
+
+/*
+ * Creates an empty profile for the nodes of a plan whose plan_node_ids are
+ * below num_slots.  It is allocated in the current memory context, and can
+ * be started and stopped for several executions of the same plan.
+ */
+PlanProfile *
+create_plan_profile(int num_slots)
+{
+	PlanProfile *profile;
+
+#ifndef PLAN_PROFILER_SUPPORTED
+	elog(ERROR, "plan node profiling requires PostgreSQL 10 or later, on a platform with setitimer()");
+#endif
+
+	profile = (PlanProfile *) palloc0(sizeof(PlanProfile));
+	profile->num_slots	= num_slots;
+	profile->samples	= (volatile uint64 *) palloc0(sizeof(uint64) * (num_slots + 1));
+#ifdef PLAN_PROFILER_SUPPORTED
+	profile->real_procs	= (ExecProcNodeMtd *) palloc0(sizeof(ExecProcNodeMtd) * (num_slots + 1));
+#endif
+
+	return profile;
+}
+
+/*
+ * Wraps the nodes of a started but not yet run executor state, and starts
+ * the timer.  stop_plan_profile() must follow, also on error.
+ */
+void
+start_plan_profile(PlanProfile *profile, const void *planstate)
+{
+#ifdef PLAN_PROFILER_SUPPORTED
+	PlanStateNodeInfo  *nodes;
+	int					num_nodes;
+	int					i;
+
+	if (active_profile != NULL)
+		elog(ERROR, "plan node profiling is already active");
+
+	nodes = get_plan_state_nodes(planstate, &num_nodes);
+
+	for (i = 0 ; i < num_nodes ; i++)
+	{
+		PlanState  *ps = (PlanState *) nodes[i].planstate;
+		int			id = ps->plan->plan_node_id;
+
+		if (id < 0 || id >= profile->num_slots)
+			elog(ERROR, "plan node id %d is out of range", id);
+
+		/*
+		 * ExecProcNode still points to ExecProcNodeFirst, which installs
+		 * ExecProcNodeReal on the first call.
+		 */
+		if (ps->ExecProcNodeReal != profile_exec_proc_node)
+		{
+			profile->real_procs[id] = ps->ExecProcNodeReal;
+			ps->ExecProcNodeReal = profile_exec_proc_node;
+		}
+	}
+
+	pfree(nodes);
+
+	active_profile	= profile;
+	current_counter	= &profile->other;
+
+	prev_sigprof_handler = pqsignal(SIGPROF, profile_sigprof_handler);
+	set_profile_timer(profile_hz);
+#else
+	elog(ERROR, "plan node profiling requires PostgreSQL 10 or later, on a platform with setitimer()");
+#endif
+}
+
+/*
+ * Stops the timer.  The wrapped nodes must not run afterwards.
+ */
+void
+stop_plan_profile(PlanProfile *profile)
+{
+#ifdef PLAN_PROFILER_SUPPORTED
+	if (active_profile != profile)
+		return;
+
+	set_profile_timer(0);
+	pqsignal(SIGPROF, prev_sigprof_handler);
+
+	current_counter	= NULL;
+	active_profile	= NULL;
+#endif
+}
+
+/*
+ * Returns the samples taken in the node with the given plan_node_id, or
+ * with a negative id, those taken outside any node.
+ */
+uint64
+get_plan_profile_samples(const PlanProfile *profile, int plan_node_id)
+{
+	if (plan_node_id < 0)
+		return profile->other;
+	if (plan_node_id >= profile->num_slots)
+		return 0;
+
+	return profile->samples[plan_node_id];
+}
+
+#ifdef PLAN_PROFILER_SUPPORTED
+static TupleTableSlot *
+profile_exec_proc_node(PlanState *node)
+{
+	volatile uint64	   *saved = current_counter;
+	int					id = node->plan->plan_node_id;
+	TupleTableSlot	   *slot;
+
+	current_counter = &active_profile->samples[id];
+	slot = active_profile->real_procs[id](node);
+	current_counter = saved;
+
+	return slot;
+}
+
+static void
+profile_sigprof_handler(SIGNAL_ARGS)
+{
+	volatile uint64 *counter = current_counter;
+
+	if (counter)
+		(*counter)++;
+}
+
+static void
+set_profile_timer(int hz)
+{
+	struct itimerval timer;
+
+	memset(&timer, 0, sizeof(timer));
+
+	if (hz > 0)
+	{
+		long usec = Max(1000000L / hz, 1L);
+
+		timer.it_interval.tv_sec	= usec / 1000000L;
+		timer.it_interval.tv_usec	= usec % 1000000L;
+		timer.it_value				= timer.it_interval;
+	}
+
+	if (setitimer(ITIMER_PROF, &timer, NULL) != 0)
+		elog(ERROR, "setitimer failed: %m");
+}
+#endif
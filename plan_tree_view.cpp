@@ -15,7 +15,12 @@ extern "C" {
 #include "access/xact.h"
 #include "catalog/pg_operator.h"
 #include "catalog/pg_type.h"
+#include "executor/hashjoin.h"
+#include "executor/instrument.h"
+#include "fmgr.h"
 #include "miscadmin.h"
+#include "nodes/execnodes.h"
+#include "nodes/memnodes.h"
 #include "nodes/nodeFuncs.h"
 #include "nodes/bitmapset.h"
 #include "nodes/print.h"
@@ -26,7 +31,14 @@ extern "C" {
 #include "optimizer/planmain.h"
 #include "optimizer/restrictinfo.h"
 #include "optimizer/planner.h"
+#include "parser/parsetree.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
 #include "utils/palloc.h"
+#include "utils/syscache.h"
+#include "utils/tuplesort.h"
+#include "utils/tuplestore.h"
 
 #if PG_VERSION_NUM >= 90500
 #include "nodes/parsenodes.h"
@@ -36,32 +48,17 @@ extern "C" {
 
 #include <stdarg.h>
 #include <inttypes.h>
+#include <algorithm>
 #include <map>
+#include <new>
 #include <set>
 #include <string>
 #include <utility>
 #include <string>
+#include <vector>
 
 #include "pg_plan_tree_dot.h"
 
-#define FIND_NODE(fldname) \
-	do {findNode(env, node, #fldname, node->fldname);} while (0)
-
-#define FIND_NODE_INDEX(fldname, index) \
-	do {if (node->fldname[index] != NULL) { findNodeIndex(env, node, #fldname, index, node->fldname);}} while (0)
-
-#define FIND_PLAN(fldname) \
-	do {findNode(env, node, #fldname, node->fldname);} while (0)
-
-#define FIND_OIDLIST(fldname) \
-	do {env.registerExprTree(node->fldname); findNode(env, node, #fldname, node->fldname);} while (0)
-
-#define FIND_EXPRLIST(fldname) \
-	do {env.registerExprTree(node->fldname); findNode(env, node, #fldname, node->fldname);} while (0)
-
-#define FIND_TARGETLIST(fldname) \
-	do {env.registerTargetList(node->fldname); findNode(env, node, #fldname, node->fldname, true);} while (0)
-
 /* Write an integer field (anything written as ":fldname %d") */
 #define WRITE_INT_FIELD(fldname) \
 	do {env.outputInt(#fldname, node->fldname);} while (0)
@@ -92,6 +89,22 @@ extern "C" {
 #define WRITE_OID_FIELD(fldname) \
 	do {if (node->fldname != 0) {env.outputOid(#fldname, node->fldname);}} while (0)
 
+/* Write an OID field, resolved to the name of the object it refers to */
+#define WRITE_RELOID_FIELD(fldname) \
+	do {if (node->fldname != 0) {env.outputOidName(#fldname, OID_KIND_RELATION, node->fldname);}} while (0)
+
+#define WRITE_TYPEOID_FIELD(fldname) \
+	do {if (node->fldname != 0) {env.outputOidName(#fldname, OID_KIND_TYPE, node->fldname);}} while (0)
+
+#define WRITE_OPEROID_FIELD(fldname) \
+	do {if (node->fldname != 0) {env.outputOidName(#fldname, OID_KIND_OPERATOR, node->fldname);}} while (0)
+
+#define WRITE_FUNCOID_FIELD(fldname) \
+	do {if (node->fldname != 0) {env.outputOidName(#fldname, OID_KIND_FUNCTION, node->fldname);}} while (0)
+
+#define WRITE_COLLOID_FIELD(fldname) \
+	do {if (node->fldname != 0) {env.outputOidName(#fldname, OID_KIND_COLLATION, node->fldname);}} while (0)
+
 /* Write a long-integer field */
 #define WRITE_LONG_FIELD(fldname) \
 	do {env.outputLong(#fldname, node->fldname);} while (0)
@@ -140,20 +153,183 @@ extern "C" {
 #define WRITE_NODE_INDEX_FIELD(fldname, index) \
 	do {if (node->fldname[index] != NULL) {env.outputNodeIndex(#fldname, index, node, node->fldname[index]);}} while (0)
 
-typedef std::map<const void*, unsigned int>		NodeIdMap;
+/*
+ * STL allocator that takes its memory from a PostgreSQL memory context.
+ *
+ * The containers below are built while CurrentMemoryContext is the caller's
+ * short-lived context ("print_plan_tree temporary context" for
+ * generate_plan_tree_dot).  If an ERROR longjmps out of the renderer the
+ * destructors never run, but the memory still goes away when that context
+ * is deleted or reset, instead of leaking from the C++ heap for the life of
+ * the backend.
+ */
+template <typename T>
+class PallocAllocator {
+public:
+	typedef T				value_type;
+	typedef T			   *pointer;
+	typedef const T		   *const_pointer;
+	typedef T			   &reference;
+	typedef const T		   &const_reference;
+	typedef size_t			size_type;
+	typedef ptrdiff_t		difference_type;
+
+	template <typename U>
+	struct rebind {
+		typedef PallocAllocator<U> other;
+	};
+
+	PallocAllocator() : context(CurrentMemoryContext) {}
+
+	explicit PallocAllocator(MemoryContext _context) : context(_context) {}
+
+	template <typename U>
+	PallocAllocator(const PallocAllocator<U>& other) : context(other.memoryContext()) {}
+
+	MemoryContext memoryContext() const
+	{
+		return context;
+	}
+
+	pointer address(reference x) const
+	{
+		return &x;
+	}
+
+	const_pointer address(const_reference x) const
+	{
+		return &x;
+	}
+
+	pointer allocate(size_type n, const void * = 0)
+	{
+		void *ptr;
+
+		if (n > max_size())
+			throw std::bad_alloc();
+
+		/* Report out-of-memory as an exception so that the stack unwinds */
+#if PG_VERSION_NUM >= 90500
+		ptr = MemoryContextAllocExtended(context, n * sizeof(T), MCXT_ALLOC_NO_OOM);
+		if (ptr == NULL)
+			throw std::bad_alloc();
+#else
+		ptr = MemoryContextAlloc(context, n * sizeof(T));
+#endif
+
+		return static_cast<pointer>(ptr);
+	}
+
+	void deallocate(pointer p, size_type)
+	{
+		pfree(p);
+	}
+
+	size_type max_size() const
+	{
+		return MaxAllocSize / sizeof(T);
+	}
+
+	void construct(pointer p, const T& value)
+	{
+		new (static_cast<void *>(p)) T(value);
+	}
+
+	void destroy(pointer p)
+	{
+		p->~T();
+	}
+
+private:
+	MemoryContext	context;
+};
+
+template <typename T, typename U>
+inline bool
+operator==(const PallocAllocator<T>& a, const PallocAllocator<U>& b)
+{
+	return a.memoryContext() == b.memoryContext();
+}
+
+template <typename T, typename U>
+inline bool
+operator!=(const PallocAllocator<T>& a, const PallocAllocator<U>& b)
+{
+	return a.memoryContext() != b.memoryContext();
+}
+
+typedef std::basic_string<char, std::char_traits<char>, PallocAllocator<char> > PString;
+
+typedef std::map<const void*, unsigned int, std::less<const void*>,
+				 PallocAllocator<std::pair<const void* const, unsigned int> > >	NodeIdMap;
 typedef std::pair<const void*, const void*>		EdgeKeyType;
-typedef std::map<EdgeKeyType, std::string>		EdgeMap;
-typedef std::set<const void*>					NodeSet;
-typedef std::map<const void*, const void*>		NodeNodeMap;
-typedef std::map<const void*, NodeSet>			NodeSetMap;
+typedef std::map<EdgeKeyType, PString, std::less<EdgeKeyType>,
+				 PallocAllocator<std::pair<const EdgeKeyType, PString> > >		EdgeMap;
+typedef std::set<const void*, std::less<const void*>,
+				 PallocAllocator<const void*> >									NodeSet;
+typedef std::map<const void*, const void*, std::less<const void*>,
+				 PallocAllocator<std::pair<const void* const, const void*> > >	NodeNodeMap;
+typedef std::map<const void*, NodeSet, std::less<const void*>,
+				 PallocAllocator<std::pair<const void* const, NodeSet> > >		NodeSetMap;
+typedef std::vector<EdgeMap::const_iterator,
+					PallocAllocator<EdgeMap::const_iterator> >					EdgeList;
+typedef std::map<const void*, EdgeList, std::less<const void*>,
+				 PallocAllocator<std::pair<const void* const, EdgeList> > >		EdgeGroupMap;
+typedef std::vector<const void*, PallocAllocator<const void*> >				NodeList;
+
+/* Catalogs that OID fields can be resolved against */
+typedef enum OidKind
+{
+	OID_KIND_NONE,
+	OID_KIND_RELATION,
+	OID_KIND_TYPE,
+	OID_KIND_OPERATOR,
+	OID_KIND_FUNCTION,
+	OID_KIND_COLLATION
+} OidKind;
+
+typedef std::map<const void*, const char*, std::less<const void*>,
+				 PallocAllocator<std::pair<const void* const, const char*> > >	NodeColorMap;
+typedef std::map<const void*, const char*, std::less<const void*>,
+				 PallocAllocator<std::pair<const void* const, const char*> > >	NodeNoteMap;
+
+typedef std::pair<int, Oid>						OidKeyType;
+typedef std::map<OidKeyType, PString, std::less<OidKeyType>,
+				 PallocAllocator<std::pair<const OidKeyType, PString> > >		OidNameMap;
+
+/*
+ * Thrown when a query cancel or termination is pending and would be acted
+ * on.  ereport() must not longjmp across the STL containers, so the
+ * interrupt is serviced after the stack has been unwound in
+ * get_plan_tree_dot_string().  Other interrupts, such as a catchup or a
+ * cancel that is being held off, are left to the next CHECK_FOR_INTERRUPTS()
+ * of the caller.  If servicing the interrupt returns after all, the walk is
+ * started again.
+ */
+class InterruptRequest {
+};
+
+static inline void
+checkInterrupts(void)
+{
+	if (!InterruptPending || InterruptHoldoffCount != 0 || CritSectionCount != 0)
+		return;
+
+#if PG_VERSION_NUM >= 90500
+	if (ProcDiePending || (QueryCancelPending && QueryCancelHoldoffCount == 0))
+#else
+	if (ProcDiePending || QueryCancelPending)
+#endif
+		throw InterruptRequest();
+}
 
 class NodeInfoEnv {
 	NodeIdMap		node_id_map;
 	EdgeMap			edge_map;
 
 	unsigned int	node_id;
-	std::string		label;
-	std::string		buffer;
+	PString			label;
+	PString			buffer;
 
 	NodeSet			tlist_head_set;	/* target list */
 	NodeSet			passthrough_tlist_head_set;	/* passthrough target list */
@@ -162,11 +338,50 @@ class NodeInfoEnv {
 	int				num_subgraph;
 
 	bool			simplify;
+	bool			raw_oids;
+
+	const List	   *rtable;		/* range table of the PlannedStmt, if any */
+	OidNameMap		oid_name_map;	/* names resolved during this render */
+
+	NodeColorMap	node_color_map;	/* fill colors overriding the default */
+	NodeNoteMap		node_note_map;	/* extra label lines given by the caller */
+
+	const char *lookupOidName(OidKind kind, Oid oid);
 
 public:
-	NodeInfoEnv(const char *str, bool _simplify) :
+	NodeInfoEnv(const char *str, const PlanTreeDotOptions& options) :
 		node_id_map(), edge_map(), node_id(0), label(str), buffer(),
-		tlist_head_set(), passthrough_tlist_head_set(), exprtree_head_set(), num_subgraph(0), simplify(_simplify) {}
+		tlist_head_set(), passthrough_tlist_head_set(), exprtree_head_set(), num_subgraph(0),
+		simplify(options.simplify), raw_oids(options.raw_oids), rtable(NULL), oid_name_map(),
+		node_color_map(), node_note_map()
+	{
+		int i;
+
+		for (i = 0 ; i < options.num_relation_names ; i++)
+			oid_name_map[OidKeyType(OID_KIND_RELATION, options.relation_names[i].oid)] =
+				options.relation_names[i].name;
+
+		for (i = 0 ; i < options.num_node_marks ; i++)
+		{
+			const PlanTreeDotNodeMark& mark = options.node_marks[i];
+
+			if (mark.color)
+				node_color_map[mark.node] = mark.color;
+			if (mark.note)
+				node_note_map[mark.node] = mark.note;
+		}
+	}
+
+	/* color must be a static string; it can be set while writing the label */
+	void setNodeColor(const void *node, const char *color)
+	{
+		node_color_map[node] = color;
+	}
+
+	void setRangeTable(const List *_rtable)
+	{
+		rtable = _rtable;
+	}
 
 	bool hasNode(const void *node) const
 	{
@@ -204,7 +419,31 @@ public:
 		return buffer.c_str();
 	} 
 
+	int numNodes() const
+	{
+		return (int) node_id_map.size();
+	}
+
+	int numEdges() const
+	{
+		return (int) edge_map.size();
+	}
+
+	void computeGroups(NodeSetMap& node_group, EdgeGroupMap& edge_group);
 	void outputAllNodes();
+	void outputHtml();
+	void appendNodeLabel(const void *obj);
+	void appendJsonString(const char *str, size_t len);
+	void appendJsonLabel(const PString& label);
+	void appendJsonGroup(const NodeSet& node_set, const EdgeList& edge_list);
+	void appendHtml(const char *str);
+	const char *nodeLabel(const void *obj);
+
+	void collectNodes(NodeList& nodes) const;
+	void collectEdges(const void *from, EdgeList& edges) const;
+	unsigned int nodeId(const void *node) const;
+
+	PlanStateNodeInfo *collectPlanStates(int *num_nodes);
 
 	void pushNode(const void *node, const char* str)
 	{
@@ -316,6 +555,57 @@ public:
 		append("|%s: %u", fldname, value);
 	}
 
+	/* Append a catalog name, escaping the characters special in record labels */
+	void appendName(const char *name)
+	{
+		const char *p;
+
+		for (p = name ; *p ; p++)
+		{
+			switch (*p)
+			{
+				case '<': case '>': case '{': case '}':
+				case '|': case '"': case '\\':
+					buffer.push_back('\\');
+					break;
+				default:
+					break;
+			}
+			buffer.push_back(*p);
+		}
+	}
+
+	void outputOidName(const char *fldname, OidKind kind, Oid value)
+	{
+		const char *name = NULL;
+
+		if (!raw_oids && OidIsValid(value))
+			name = lookupOidName(kind, value);
+
+		if (name == NULL)
+		{
+			outputOid(fldname, value);
+			return;
+		}
+
+		append("|%s: ", fldname);
+		appendName(name);
+	}
+
+	/* Write the relation a range table index refers to */
+	void outputRangeTableRelation(const char *fldname, Index rti)
+	{
+		const RangeTblEntry *rte;
+
+		if (rtable == NULL || rti < 1 || rti > (Index) list_length(rtable))
+			return;
+
+		rte = rt_fetch(rti, const_cast<List *>(rtable));
+
+		if (rte->rtekind == RTE_RELATION)
+			outputOidName(fldname, OID_KIND_RELATION, rte->relid);
+	}
+
 	void outputLong(const char *fldname, long value)
 	{
 		append("|%s: %l", fldname, value);
@@ -1210,12 +1500,25 @@ public:
 	}	
 #endif
 
-	void outputOidArray(const char *fldname, int size, Oid* oidarray)
+	void outputOidArray(const char *fldname, int size, Oid* oidarray, OidKind kind = OID_KIND_NONE)
 	{
 		int i;
 		append("|%s:", fldname);
 		for (i=0 ; i<size ; i++)
-			append(" %u", oidarray[i]);
+		{
+			const char *name = NULL;
+
+			if (kind != OID_KIND_NONE && !raw_oids && OidIsValid(oidarray[i]))
+				name = lookupOidName(kind, oidarray[i]);
+
+			if (name)
+			{
+				append(" ");
+				appendName(name);
+			}
+			else
+				append(" %u", oidarray[i]);
+		}
 	}
 
 	void outputIntArray(const char *fldname, int size, int* intarray)
@@ -1287,168 +1590,6 @@ public:
 
 /* static void _outNode(StringInfo str, const void *obj); */
 static void findNode(NodeInfoEnv& env, const void *parent, const char *fldname, const void *obj, bool from_tlist = false);
-static void findNodeIndex(NodeInfoEnv& env, const void *parent, const char *fldname, int index, const void *obj);
-static void findPlannedStmt(NodeInfoEnv& env, const PlannedStmt *node);
-static void findPlan(NodeInfoEnv& env, const Plan *node);
-static void   findResult(NodeInfoEnv& env, const Result *node);
-#if PG_VERSION_NUM >= 100000
-static void   findProjectSet(NodeInfoEnv& env, const ProjectSet *node);
-#endif
-static void   findModifyTable(NodeInfoEnv& env, const ModifyTable *node);
-static void   findAppend(NodeInfoEnv& env, const Append *node);
-#if PG_VERSION_NUM >= 90100
-static void   findMergeAppend(NodeInfoEnv& env, const MergeAppend *node);
-#endif
-static void   findRecursiveUnion(NodeInfoEnv& env, const RecursiveUnion *node);
-static void   findBitmapAnd(NodeInfoEnv& env, const BitmapAnd *node);
-static void   findBitmapOr(NodeInfoEnv& env, const BitmapOr *node);
-static void   findScan(NodeInfoEnv& env, const Scan *node);
-static void     findSeqScan(NodeInfoEnv& env, const SeqScan *node);
-#if PG_VERSION_NUM >= 90500
-static void     findSampleScan(NodeInfoEnv& env, const SampleScan *node);
-#endif
-static void     findIndexScan(NodeInfoEnv& env, const IndexScan *node);
-#if PG_VERSION_NUM >= 90200
-static void     findIndexOnlyScan(NodeInfoEnv& env, const IndexOnlyScan *node);
-#endif
-static void     findBitmapIndexScan(NodeInfoEnv& env, const BitmapIndexScan *node);
-static void     findBitmapHeapScan(NodeInfoEnv& env, const BitmapHeapScan *node);
-static void     findTidScan(NodeInfoEnv& env, const TidScan *node);
-static void     findSubqueryScan(NodeInfoEnv& env, const SubqueryScan *node);
-static void     findFunctionScan(NodeInfoEnv& env, const FunctionScan *node);
-static void     findValuesScan(NodeInfoEnv& env, const ValuesScan *node);
-#if PG_VERSION_NUM >= 100000
-static void     findTableFuncScan(NodeInfoEnv& env, const TableFuncScan *node);
-#endif
-static void     findCteScan(NodeInfoEnv& env, const CteScan *node);
-#if PG_VERSION_NUM >= 100000
-static void     findNamedTuplestoreScan(NodeInfoEnv& env, const NamedTuplestoreScan *node);
-#endif
-static void     findWorkTableScan(NodeInfoEnv& env, const WorkTableScan *node);
-#if PG_VERSION_NUM >= 90100
-static void     findForeignScan(NodeInfoEnv& env, const ForeignScan *node);
-#endif
-#if PG_VERSION_NUM >= 90500
-static void     findCustomScan(NodeInfoEnv& env, const CustomScan *node);
-#endif
-static void   findJoin(NodeInfoEnv& env, const Join *node);
-static void     findNestLoop(NodeInfoEnv& env, const NestLoop *node);
-static void     findMergeJoin(NodeInfoEnv& env, const MergeJoin *node);
-static void     findHashJoin(NodeInfoEnv& env, const HashJoin *node);
-static void   findAgg(NodeInfoEnv& env, const Agg *node);
-static void   findWindowAgg(NodeInfoEnv& env, const WindowAgg *node);
-static void   findGroup(NodeInfoEnv& env, const Group *node);
-static void   findMaterial(NodeInfoEnv& env, const Material *node);
-static void   findSort(NodeInfoEnv& env, const Sort *node);
-static void   findUnique(NodeInfoEnv& env, const Unique *node);
-#if PG_VERSION_NUM >= 90600
-static void   findGather(NodeInfoEnv& env, const Gather *node);
-#endif
-#if PG_VERSION_NUM >= 100000
-static void   findGatherMerge(NodeInfoEnv& env, const GatherMerge *node);
-#endif
-static void   findHash(NodeInfoEnv& env, const Hash *node);
-static void   findSetOp(NodeInfoEnv& env, const SetOp *node);
-static void   findLockRows(NodeInfoEnv& env, const LockRows *node);
-static void   findLimit(NodeInfoEnv& env, const Limit *node);
-#if PG_VERSION_NUM >= 90100
-static void   findNestLoopParam(NodeInfoEnv& env, const NestLoopParam *node);
-#endif
-static void   findPlanRowMark(NodeInfoEnv& env, const PlanRowMark *node);
-#if PG_VERSION_NUM >= 110000
-static void   findPartitionPruneInfo(NodeInfoEnv& env, const PartitionPruneInfo *node);
-static void   findPartitionedRelPruneInfo(NodeInfoEnv& env, const PartitionedRelPruneInfo *node);
-static void     findPartitionPruneStepOp(NodeInfoEnv& env, const PartitionPruneStepOp *node);
-static void     findPartitionPruneStepCombine(NodeInfoEnv& env, const PartitionPruneStepCombine *node);
-#endif
-static void   findPlanInvalItem(NodeInfoEnv& env, const PlanInvalItem *node);
-static void   findAlias(NodeInfoEnv& env, const Alias *node);
-static void   findRangeVar(NodeInfoEnv& env, const RangeVar *node);
-#if PG_VERSION_NUM >= 100000
-static void   findTableFunc(NodeInfoEnv& env, const TableFunc *node);
-#endif
-static void   findIntoClause(NodeInfoEnv& env, const IntoClause *node);
-/* static void findExpr(NodeInfoEnv& env, const Expr *node); */
-static void   findVar(NodeInfoEnv& env, const Var *node);
-static void   findConst(NodeInfoEnv& env, const Const *node);
-static void   findParam(NodeInfoEnv& env, const Param *node);
-static void   findAggref(NodeInfoEnv& env, const Aggref *node);
-#if PG_VERSION_NUM >= 90500
-static void   findGroupingFunc(NodeInfoEnv& env, const GroupingFunc *node);
-#endif
-static void   findWindowFunc(NodeInfoEnv& env, const WindowFunc *node);
-#if PG_VERSION_NUM >= 120000
-static void   findSubscriptingRef(NodeInfoEnv& env, const SubscriptingRef *node);
-#else
-static void   findArrayRef(NodeInfoEnv& env, const ArrayRef *node);
-#endif
-static void   findFuncExpr(NodeInfoEnv& env, const FuncExpr *node);
-static void   findNamedArgExpr(NodeInfoEnv& env, const NamedArgExpr *node);
-static void   findOpExpr(NodeInfoEnv& env, const OpExpr *node);
-static void   findDistinctExpr(NodeInfoEnv& env, const DistinctExpr *node);
-static void   findNullIfExpr(NodeInfoEnv& env, const NullIfExpr *node);
-static void   findScalarArrayOpExpr(NodeInfoEnv& env, const ScalarArrayOpExpr *node);
-static void   findBoolExpr(NodeInfoEnv& env, const BoolExpr *node);
-static void   findSubLink(NodeInfoEnv& env, const SubLink *node);
-static void   findSubPlan(NodeInfoEnv& env, const SubPlan *node);
-static void   findAlternativeSubPlan(NodeInfoEnv& env, const AlternativeSubPlan *node);
-static void   findFieldSelect(NodeInfoEnv& env, const FieldSelect *node);
-static void   findFieldStore(NodeInfoEnv& env, const FieldStore *node);
-static void   findRelabelType(NodeInfoEnv& env, const RelabelType *node);
-static void   findCoerceViaIO(NodeInfoEnv& env, const CoerceViaIO *node);
-static void   findArrayCoerceExpr(NodeInfoEnv& env, const ArrayCoerceExpr *node);
-static void   findConvertRowtypeExpr(NodeInfoEnv& env, const ConvertRowtypeExpr *node);
-#if PG_VERSION_NUM >= 90100
-static void   findCollateExpr(NodeInfoEnv& env, const CollateExpr *node);
-#endif
-static void   findCaseExpr(NodeInfoEnv& env, const CaseExpr *node);
-static void   findCaseWhen(NodeInfoEnv& env, const CaseWhen *node);
-static void   findCaseTestExpr(NodeInfoEnv& env, const CaseTestExpr *node);
-static void   findArrayExpr(NodeInfoEnv& env, const ArrayExpr *node);
-static void   findRowExpr(NodeInfoEnv& env, const RowExpr *node);
-static void   findRowCompareExpr(NodeInfoEnv& env, const RowCompareExpr *node);
-static void   findCoalesceExpr(NodeInfoEnv& env, const CoalesceExpr *node);
-static void   findMinMaxExpr(NodeInfoEnv& env, const MinMaxExpr *node);
-#if PG_VERSION_NUM >= 100000
-static void   findSQLValueFunction(NodeInfoEnv& env, const SQLValueFunction *node);
-#endif
-static void   findXmlExpr(NodeInfoEnv& env, const XmlExpr *node);
-static void   findNullTest(NodeInfoEnv& env, const NullTest *node);
-static void   findBooleanTest(NodeInfoEnv& env, const BooleanTest *node);
-static void   findCoerceToDomain(NodeInfoEnv& env, const CoerceToDomain *node);
-static void   findCoerceToDomainValue(NodeInfoEnv& env, const CoerceToDomainValue *node);
-static void   findSetToDefault(NodeInfoEnv& env, const SetToDefault *node);
-static void   findCurrentOfExpr(NodeInfoEnv& env, const CurrentOfExpr *node);
-#if PG_VERSION_NUM >= 90500
-static void   findInferenceElem(NodeInfoEnv& env, const InferenceElem *node);
-#endif
-static void   findTargetEntry(NodeInfoEnv& env, const TargetEntry *node);
-static void   findRangeTblRef(NodeInfoEnv& env, const RangeTblRef *node);
-static void   findJoinExpr(NodeInfoEnv& env, const JoinExpr *node);
-static void   findFromExpr(NodeInfoEnv& env, const FromExpr *node);
-#if PG_VERSION_NUM >= 90500
-static void   findOnConflictExpr(NodeInfoEnv& env, const OnConflictExpr *node);
-#endif
-#if PG_VERSION_NUM >= 100000
-static void   findNextValueExpr(NodeInfoEnv& env, const NextValueExpr *node);
-#endif
-static void findPlannerGlobal(NodeInfoEnv& env, const PlannerGlobal *node);
-static void findPlannerInfo(NodeInfoEnv& env, const PlannerInfo *node);
-static void findRelOptInfo(NodeInfoEnv& env, const RelOptInfo *node);
-static void findQuery(NodeInfoEnv& env, const Query *node);
-static void findRangeTblEntry(NodeInfoEnv& env, const RangeTblEntry *node);
-#if PG_VERSION_NUM >= 90400
-static void findRangeTblFunction(NodeInfoEnv& env, const RangeTblFunction *node);
-#endif
-#if PG_VERSION_NUM >= 90500
-static void findTableSampleClause(NodeInfoEnv& env, const TableSampleClause *node);
-#endif
-static void findSortGroupClause(NodeInfoEnv& env, const SortGroupClause *node);
-#if PG_VERSION_NUM >= 90500
-static void findGroupingSet(NodeInfoEnv& env, const GroupingSet *node);
-#endif
-static void findWindowClause(NodeInfoEnv& env, const WindowClause *node);
-
 static void outputNode(NodeInfoEnv& env, const void *obj);
 static void outputValue(NodeInfoEnv& env, const Value *node);
 static void outputPlannedStmt(NodeInfoEnv& env, const PlannedStmt *node);
@@ -1612,1824 +1753,2116 @@ static void outputGroupingSet(NodeInfoEnv& env, const GroupingSet *node);
 #endif
 static void outputWindowClause(NodeInfoEnv& env, const WindowClause *node);
 
-static bool is_passthrough_tlist(List *tlist);
-
-char *
-get_plan_tree_dot_string(const char *title, const void *obj, bool simplify)
-{
-	char *buffer = NULL;
-
-	try
-	{
-		NodeInfoEnv env(title, simplify);
-
-		findNode(env, NULL, NULL, obj);
-		env.outputAllNodes();
-		
-		buffer = pstrdup(env.c_str());
-	}
-	catch (...)
-	{
-		elog(ERROR, "fatal error in _nodeToString");
-	}
-
-	return buffer;
-}
+static void outputPlanState(NodeInfoEnv& env, const PlanState *node);
 
+static bool is_passthrough_tlist(List *tlist);
 
 /****************************************************************************/
-/*                                                                          */
+/* Node descriptors                                                         */
 /****************************************************************************/
-static void
-findNode(NodeInfoEnv& env, const void *parent, const char *fldname, const void *obj, bool from_tlist)
-{
-	if (obj == NULL)
-		return;
 
-	if (env.hasNode(obj))
-		return;
-
-	env.registerNode(obj);
-
-	if (parent)
-		env.registerEdge(parent, obj, fldname);
-
-	if (IsA(obj, Integer)  ||
-		IsA(obj, Float)    ||
-		IsA(obj, String)   ||
-		IsA(obj, BitString)||
-		IsA(obj, IntList)  ||
-		IsA(obj, OidList))
-		return;
-
-	/* elog(LOG, "finNode: %d", (int)nodeTag(obj)); */
-
-	if (IsA(obj, List))
-	{
-		int i = 0;
-		List *node = reinterpret_cast<List*>(const_cast<void*>(obj)); /* const List * にすると 9.1 以前でエラーが出る */
-		ListCell *lc;
+/*
+ * Every node type the walker understands is described by a static table of
+ * its child fields.  findNode() runs one loop over these tables instead of a
+ * hand-written findXxx() per node type, and outputNode() reaches the label
+ * writer through the same descriptor.  Both look the descriptor up in a
+ * NodeTag-indexed array, so dispatch is a single load rather than a switch.
+ *
+ * Version differences are expressed with #if around individual field
+ * entries.  A new node type only needs a field table and a NODE_DESC()
+ * entry; its label writer is optional (see outputGenericNode()).
+ */
+typedef enum FieldKind
+{
+	FIELD_NODE,					/* child node or list */
+	FIELD_EXPRLIST,				/* head of an "Express Tree" cluster */
+	FIELD_TARGETLIST,			/* head of a "Target List" cluster */
+	FIELD_ARRAY					/* array of child nodes with a separate length */
+} FieldKind;
+
+typedef struct FieldDesc
+{
+	FieldKind	kind;
+	size_t		offset;
+	const char *name;
+	size_t		count_offset;	/* FIELD_ARRAY: int field holding the length */
+	int			first_index;	/* FIELD_ARRAY: first element visited */
+} FieldDesc;
+
+typedef void (*NodeFunc)(NodeInfoEnv& env, const void *obj);
+
+typedef struct NodeDesc
+{
+	NodeTag				tag;
+	const char		   *name;
+	const FieldDesc	   *fields;
+	int					num_fields;
+	NodeFunc			output;		/* label writer, or NULL for the generic one */
+} NodeDesc;
+
+#define NODE_FIELD(type, fldname) \
+	{FIELD_NODE, offsetof(type, fldname), #fldname}
+
+#define EXPRLIST_FIELD(type, fldname) \
+	{FIELD_EXPRLIST, offsetof(type, fldname), #fldname}
+
+#define TARGETLIST_FIELD(type, fldname) \
+	{FIELD_TARGETLIST, offsetof(type, fldname), #fldname}
+
+/* Elements first..countfld-1 of an array, with edges named fldname<index> */
+#define ARRAY_FIELD(type, fldname, countfld, first) \
+	{FIELD_ARRAY, offsetof(type, fldname), #fldname, offsetof(type, countfld), first}
+
+/* Fields of a Plan header embedded at byte offset 'base' */
+#define PLAN_FIELDS(base) \
+	{FIELD_TARGETLIST,	(base) + offsetof(Plan, targetlist),	"targetlist"}, \
+	{FIELD_EXPRLIST,	(base) + offsetof(Plan, qual),			"qual"}, \
+	{FIELD_NODE,		(base) + offsetof(Plan, lefttree),		"lefttree"}, \
+	{FIELD_NODE,		(base) + offsetof(Plan, righttree),		"righttree"}, \
+	{FIELD_NODE,		(base) + offsetof(Plan, initPlan),		"initPlan"}
+
+#define SCAN_FIELDS(base) \
+	PLAN_FIELDS((base) + offsetof(Scan, plan))
+
+#define JOIN_FIELDS(base) \
+	PLAN_FIELDS((base) + offsetof(Join, plan)), \
+	{FIELD_EXPRLIST,	(base) + offsetof(Join, joinqual),		"joinqual"}
+
+/*
+ * Adapts a typed outputXxx() to the NodeFunc signature.  A function template
+ * would need external linkage for its argument before C++11, so a macro is
+ * used instead.
+ */
+#define NODE_OUTPUT(type) \
+static void \
+output##type##Desc(NodeInfoEnv& env, const void *obj) \
+{ \
+	output##type(env, reinterpret_cast<const type*>(obj)); \
+}
 
-		if (from_tlist && env.canSimplify() && is_passthrough_tlist(reinterpret_cast<List *>(const_cast<void *>(obj))))
-		{
-			env.registerPassThroughTargetList(obj);
-			return;
-		}
+#define NODE_DESC(type, fields) \
+	{T_##type, #type, fields, lengthof(fields), output##type##Desc}
 
-		foreach(lc, node)
-		{
-			char buffer[256];
-			sprintf(buffer, "%d", i + 1);
-			findNode(env, obj, buffer, lfirst(lc));
-			i++;
-		}
+#define NODE_DESC_LEAF(type) \
+	{T_##type, #type, NULL, 0, output##type##Desc}
 
-		return;
-	}
+static const FieldDesc PlannedStmtFields[] = {
+	NODE_FIELD(PlannedStmt, planTree),
+	NODE_FIELD(PlannedStmt, rtable),
+	NODE_FIELD(PlannedStmt, resultRelations),
+#if PG_VERSION_NUM >= 120000
+	NODE_FIELD(PlannedStmt, rootResultRelations),
+#elif PG_VERSION_NUM >= 100000
+	NODE_FIELD(PlannedStmt, nonleafResultRelations),
+	NODE_FIELD(PlannedStmt, rootResultRelations),
+#else
+	NODE_FIELD(PlannedStmt, utilityStmt),
+#if PG_VERSION_NUM < 90200
+	NODE_FIELD(PlannedStmt, intoClause),
+#endif
+#endif
+	NODE_FIELD(PlannedStmt, subplans),
+	NODE_FIELD(PlannedStmt, rowMarks),
+	NODE_FIELD(PlannedStmt, relationOids),
+	NODE_FIELD(PlannedStmt, invalItems),
+#if PG_VERSION_NUM >= 110000
+	NODE_FIELD(PlannedStmt, utilityStmt),
+#endif
+};
 
-	switch (nodeTag(obj))
-	{
-		case T_Plan:
-			findPlan(env, reinterpret_cast<const Plan*>(obj));
-			break;
+static const FieldDesc PlanFields[] = {
+	PLAN_FIELDS(0),
+};
 
-		case T_Result:
-			findResult(env, reinterpret_cast<const Result*>(obj));
-			break;
+static const FieldDesc ResultFields[] = {
+	PLAN_FIELDS(offsetof(Result, plan)),
+	NODE_FIELD(Result, resconstantqual),
+};
 
 #if PG_VERSION_NUM >= 100000
-		case T_ProjectSet:
-			findProjectSet(env, reinterpret_cast<const ProjectSet*>(obj));
-			break;
+static const FieldDesc ProjectSetFields[] = {
+	PLAN_FIELDS(offsetof(ProjectSet, plan)),
+};
 #endif
 
-#if 0
-		case T_Env:
-			findEnv(env, reinterpret_cast<const Env*>(obj));
-			break;
+static const FieldDesc ModifyTableFields[] = {
+	PLAN_FIELDS(offsetof(ModifyTable, plan)),
+#if PG_VERSION_NUM < 120000 && PG_VERSION_NUM >= 100000
+	NODE_FIELD(ModifyTable, partitioned_rels),
 #endif
-		case T_ModifyTable:
-			findModifyTable(env, reinterpret_cast<const ModifyTable*>(obj));
-			break;
-		case T_Append:
-			findAppend(env, reinterpret_cast<const Append*>(obj));
-			break;
-#if PG_VERSION_NUM >= 90100
-		case T_MergeAppend:
-			findMergeAppend(env, reinterpret_cast<const MergeAppend*>(obj));
-			break;
+	NODE_FIELD(ModifyTable, resultRelations),
+	NODE_FIELD(ModifyTable, plans),
+#if PG_VERSION_NUM >= 90400
+	NODE_FIELD(ModifyTable, withCheckOptionLists),
 #endif
-		case T_RecursiveUnion:
-			findRecursiveUnion(env, reinterpret_cast<const RecursiveUnion*>(obj));
-			break;
-		case T_BitmapAnd:
-			findBitmapAnd(env, reinterpret_cast<const BitmapAnd*>(obj));
-			break;
-		case T_BitmapOr:
-			findBitmapOr(env, reinterpret_cast<const BitmapOr*>(obj));
-			break;
-		case T_Scan:
-			findScan(env, reinterpret_cast<const Scan*>(obj));
-			break;
-		case T_SeqScan:
-			findSeqScan(env, reinterpret_cast<const SeqScan*>(obj));
-			break;
+	NODE_FIELD(ModifyTable, returningLists),
+#if PG_VERSION_NUM >= 90300
+	NODE_FIELD(ModifyTable, fdwPrivLists),
+#endif
+	NODE_FIELD(ModifyTable, rowMarks),
 #if PG_VERSION_NUM >= 90500
-        case T_SampleScan:
-			findSampleScan(env, reinterpret_cast<const SampleScan*>(obj));
-			break;
+	NODE_FIELD(ModifyTable, arbiterIndexes),
+	NODE_FIELD(ModifyTable, onConflictSet),
+	EXPRLIST_FIELD(ModifyTable, onConflictWhere),
+	EXPRLIST_FIELD(ModifyTable, exclRelTlist),
 #endif
-		case T_IndexScan:
-			findIndexScan(env, reinterpret_cast<const IndexScan*>(obj));
-			break;
-#if PG_VERSION_NUM >= 90200
-		case T_IndexOnlyScan:
-			findIndexOnlyScan(env, reinterpret_cast<const IndexOnlyScan*>(obj));
-			break;
+};
+
+static const FieldDesc AppendFields[] = {
+	PLAN_FIELDS(offsetof(Append, plan)),
+	NODE_FIELD(Append, appendplans),
+#if PG_VERSION_NUM < 120000 && PG_VERSION_NUM >= 100000
+	NODE_FIELD(Append, partitioned_rels),
 #endif
-		case T_BitmapIndexScan:
-			findBitmapIndexScan(env, reinterpret_cast<const BitmapIndexScan*>(obj));
-			break;
-		case T_BitmapHeapScan:
-			findBitmapHeapScan(env, reinterpret_cast<const BitmapHeapScan*>(obj));
-			break;
-		case T_TidScan:
-			findTidScan(env, reinterpret_cast<const TidScan*>(obj));
-			break;
-		case T_SubqueryScan:
-			findSubqueryScan(env, reinterpret_cast<const SubqueryScan*>(obj));
-			break;
-		case T_FunctionScan:
-			findFunctionScan(env, reinterpret_cast<const FunctionScan*>(obj));
-			break;
-		case T_ValuesScan:
-			findValuesScan(env, reinterpret_cast<const ValuesScan*>(obj));
-			break;
-#if PG_VERSION_NUM >= 100000
-		case T_TableFuncScan:
-			findTableFuncScan(env, reinterpret_cast<const TableFuncScan*>(obj));
-			break;
-#endif
-		case T_CteScan:
-			findCteScan(env, reinterpret_cast<const CteScan*>(obj));
-			break;
-#if PG_VERSION_NUM >= 100000
-		case T_NamedTuplestoreScan:
-			findNamedTuplestoreScan(env, reinterpret_cast<const NamedTuplestoreScan*>(obj));
-			break;
+#if PG_VERSION_NUM >= 110000
+	NODE_FIELD(Append, part_prune_info),
 #endif
-		case T_WorkTableScan:
-			findWorkTableScan(env, reinterpret_cast<const WorkTableScan*>(obj));
-			break;
+};
+
 #if PG_VERSION_NUM >= 90100
-		case T_ForeignScan:
-			findForeignScan(env, reinterpret_cast<const ForeignScan*>(obj));
-			break;
+static const FieldDesc MergeAppendFields[] = {
+	PLAN_FIELDS(offsetof(MergeAppend, plan)),
+#if PG_VERSION_NUM < 120000 && PG_VERSION_NUM >= 100000
+	NODE_FIELD(MergeAppend, partitioned_rels),
 #endif
-#if PG_VERSION_NUM >= 90500
-		case T_CustomScan:
-			findCustomScan(env, reinterpret_cast<const CustomScan*>(obj));
-			break;
+	NODE_FIELD(MergeAppend, mergeplans),
+#if PG_VERSION_NUM >= 120000
+	NODE_FIELD(MergeAppend, part_prune_info),
 #endif
-		case T_Join:
-			findJoin(env, reinterpret_cast<const Join*>(obj));
-			break;
-		case T_NestLoop:
-			findNestLoop(env, reinterpret_cast<const NestLoop*>(obj));
-			break;
-		case T_MergeJoin:
-			findMergeJoin(env, reinterpret_cast<const MergeJoin*>(obj));
-			break;
-		case T_HashJoin:
-			findHashJoin(env, reinterpret_cast<const HashJoin*>(obj));
-			break;
-		case T_Agg:
-			findAgg(env, reinterpret_cast<const Agg*>(obj));
-			break;
-		case T_WindowAgg:
-			findWindowAgg(env, reinterpret_cast<const WindowAgg*>(obj));
-			break;
-		case T_Group:
-			findGroup(env, reinterpret_cast<const Group*>(obj));
-			break;
-		case T_Material:
-			findMaterial(env, reinterpret_cast<const Material*>(obj));
-			break;
-		case T_Sort:
-			findSort(env, reinterpret_cast<const Sort*>(obj));
-			break;
-		case T_Unique:
-			findUnique(env, reinterpret_cast<const Unique*>(obj));
-			break;
-#if PG_VERSION_NUM >= 90600
-		case T_Gather:
-			findGather(env, reinterpret_cast<const Gather*>(obj));
-			break;
+};
 #endif
-#if PG_VERSION_NUM >= 100000
-		case T_GatherMerge:
-			findGatherMerge(env, reinterpret_cast<const GatherMerge*>(obj));
-			break;
+
+static const FieldDesc RecursiveUnionFields[] = {
+	PLAN_FIELDS(offsetof(RecursiveUnion, plan)),
+};
+
+static const FieldDesc BitmapAndFields[] = {
+	PLAN_FIELDS(offsetof(BitmapAnd, plan)),
+	NODE_FIELD(BitmapAnd, bitmapplans),
+};
+
+static const FieldDesc BitmapOrFields[] = {
+	PLAN_FIELDS(offsetof(BitmapOr, plan)),
+	NODE_FIELD(BitmapOr, bitmapplans),
+};
+
+static const FieldDesc ScanFields[] = {
+	SCAN_FIELDS(0),
+};
+
+static const FieldDesc SeqScanFields[] = {
+	PLAN_FIELDS(offsetof(SeqScan, plan)),
+};
+
+#if PG_VERSION_NUM >= 90500
+static const FieldDesc SampleScanFields[] = {
+	SCAN_FIELDS(offsetof(SampleScan, scan)),
+	NODE_FIELD(SampleScan, tablesample),
+};
 #endif
-		case T_Hash:
-			findHash(env, reinterpret_cast<const Hash*>(obj));
-			break;
-		case T_SetOp:
-			findSetOp(env, reinterpret_cast<const SetOp*>(obj));
-			break;
-		case T_LockRows:
-			findLockRows(env, reinterpret_cast<const LockRows*>(obj));
-			break;
-		case T_Limit:
-			findLimit(env, reinterpret_cast<const Limit*>(obj));
-			break;
+
+static const FieldDesc IndexScanFields[] = {
+	SCAN_FIELDS(offsetof(IndexScan, scan)),
+	EXPRLIST_FIELD(IndexScan, indexqual),
+	EXPRLIST_FIELD(IndexScan, indexqualorig),
 #if PG_VERSION_NUM >= 90100
-		case T_NestLoopParam:
-			findNestLoopParam(env, reinterpret_cast<const NestLoopParam*>(obj));
-			break;
+	EXPRLIST_FIELD(IndexScan, indexorderby),
+	EXPRLIST_FIELD(IndexScan, indexorderbyorig),
 #endif
-		case T_PlanRowMark:
-			findPlanRowMark(env, reinterpret_cast<const PlanRowMark*>(obj));
-			break;
-#if PG_VERSION_NUM >= 110000
-		case T_PartitionPruneInfo:
-			findPartitionPruneInfo(env, reinterpret_cast<const PartitionPruneInfo*>(obj));
-			break;			
-		case T_PartitionedRelPruneInfo:
-			findPartitionedRelPruneInfo(env, reinterpret_cast<const PartitionedRelPruneInfo*>(obj));			
-			break;
-		case T_PartitionPruneStepOp:
-			findPartitionPruneStepOp(env, reinterpret_cast<const PartitionPruneStepOp*>(obj));
-			break;
-		case T_PartitionPruneStepCombine:
-			findPartitionPruneStepCombine(env, reinterpret_cast<const PartitionPruneStepCombine*>(obj));
-			break;
+#if PG_VERSION_NUM >= 90500
+	EXPRLIST_FIELD(IndexScan, indexorderbyops),
 #endif
-		case T_PlanInvalItem:
-			findPlanInvalItem(env, reinterpret_cast<const PlanInvalItem*>(obj));
-			break;
+};
 
-		case T_Alias:
-			findAlias(env, reinterpret_cast<const Alias*>(obj));
-			break;
-		case T_RangeVar:
-			findRangeVar(env, reinterpret_cast<const RangeVar*>(obj));
-			break;
-#if PG_VERSION_NUM >= 100000
-		case T_TableFunc:
-			findTableFunc(env, reinterpret_cast<const TableFunc*>(obj));
-			break;
-#endif
-		case T_IntoClause:
-			findIntoClause(env, reinterpret_cast<const IntoClause*>(obj));
-			break;
-		case T_Var:
-			findVar(env, reinterpret_cast<const Var*>(obj));
-			break;
-		case T_Const:
-			findConst(env, reinterpret_cast<const Const*>(obj));
-			break;
-		case T_Param:
-			findParam(env, reinterpret_cast<const Param*>(obj));
-			break;
-		case T_Aggref:
-			findAggref(env, reinterpret_cast<const Aggref*>(obj));
-			break;
-#if PG_VERSION_NUM >= 90500
-		case T_GroupingFunc:
-			findGroupingFunc(env, reinterpret_cast<const GroupingFunc*>(obj));
-			break;
+#if PG_VERSION_NUM >= 90200
+static const FieldDesc IndexOnlyScanFields[] = {
+	SCAN_FIELDS(offsetof(IndexOnlyScan, scan)),
+	EXPRLIST_FIELD(IndexOnlyScan, indexqual),
+	EXPRLIST_FIELD(IndexOnlyScan, indexorderby),
+	EXPRLIST_FIELD(IndexOnlyScan, indextlist),
+};
 #endif
-		case T_WindowFunc:
-			findWindowFunc(env, reinterpret_cast<const WindowFunc*>(obj));
-			break;
-#if PG_VERSION_NUM >= 120000
-		case T_SubscriptingRef:
-			findSubscriptingRef(env, reinterpret_cast<const SubscriptingRef*>(obj));
-			break;			
+
+static const FieldDesc BitmapIndexScanFields[] = {
+	SCAN_FIELDS(offsetof(BitmapIndexScan, scan)),
+	EXPRLIST_FIELD(BitmapIndexScan, indexqual),
+	EXPRLIST_FIELD(BitmapIndexScan, indexqualorig),
+};
+
+static const FieldDesc BitmapHeapScanFields[] = {
+	SCAN_FIELDS(offsetof(BitmapHeapScan, scan)),
+	EXPRLIST_FIELD(BitmapHeapScan, bitmapqualorig),
+};
+
+static const FieldDesc TidScanFields[] = {
+	SCAN_FIELDS(offsetof(TidScan, scan)),
+	EXPRLIST_FIELD(TidScan, tidquals),
+};
+
+static const FieldDesc SubqueryScanFields[] = {
+	SCAN_FIELDS(offsetof(SubqueryScan, scan)),
+	NODE_FIELD(SubqueryScan, subplan),
+};
+
+static const FieldDesc FunctionScanFields[] = {
+	SCAN_FIELDS(offsetof(FunctionScan, scan)),
+#if PG_VERSION_NUM >= 90400
+	NODE_FIELD(FunctionScan, functions),
 #else
-		case T_ArrayRef:
-			findArrayRef(env, reinterpret_cast<const ArrayRef*>(obj));
-			break;
-#endif
-		case T_FuncExpr:
-			findFuncExpr(env, reinterpret_cast<const FuncExpr*>(obj));
-			break;
-		case T_NamedArgExpr:
-			findNamedArgExpr(env, reinterpret_cast<const NamedArgExpr*>(obj));
-			break;
-		case T_OpExpr:
-			findOpExpr(env, reinterpret_cast<const OpExpr*>(obj));
-			break;
-		case T_DistinctExpr:
-			findDistinctExpr(env, reinterpret_cast<const DistinctExpr*>(obj));
-			break;
-		case T_NullIfExpr:
-			findNullIfExpr(env, reinterpret_cast<const NullIfExpr*>(obj));
-			break;
-		case T_ScalarArrayOpExpr:
-			findScalarArrayOpExpr(env, reinterpret_cast<const ScalarArrayOpExpr*>(obj));
-			break;
-		case T_BoolExpr:
-			findBoolExpr(env, reinterpret_cast<const BoolExpr*>(obj));
-			break;
-		case T_SubLink:
-			findSubLink(env, reinterpret_cast<const SubLink*>(obj));
-			break;
-		case T_SubPlan:
-			findSubPlan(env, reinterpret_cast<const SubPlan*>(obj));
-			break;
-		case T_AlternativeSubPlan:
-			findAlternativeSubPlan(env, reinterpret_cast<const AlternativeSubPlan*>(obj));
-			break;
-		case T_FieldSelect:
-			findFieldSelect(env, reinterpret_cast<const FieldSelect*>(obj));
-			break;
-		case T_FieldStore:
-			findFieldStore(env, reinterpret_cast<const FieldStore*>(obj));
-			break;
-		case T_RelabelType:
-			findRelabelType(env, reinterpret_cast<const RelabelType*>(obj));
-			break;
-		case T_CoerceViaIO:
-			findCoerceViaIO(env, reinterpret_cast<const CoerceViaIO*>(obj));
-			break;
-		case T_ArrayCoerceExpr:
-			findArrayCoerceExpr(env, reinterpret_cast<const ArrayCoerceExpr*>(obj));
-			break;
-		case T_ConvertRowtypeExpr:
-			findConvertRowtypeExpr(env, reinterpret_cast<const ConvertRowtypeExpr*>(obj));
-			break;
+	NODE_FIELD(FunctionScan, funcexpr),
+	NODE_FIELD(FunctionScan, funccolnames),
+	NODE_FIELD(FunctionScan, funccoltypes),
+	NODE_FIELD(FunctionScan, funccoltypmods),
 #if PG_VERSION_NUM >= 90100
-		case T_CollateExpr:
-			findCollateExpr(env, reinterpret_cast<const CollateExpr*>(obj));
-			break;
-#endif
-		case T_CaseExpr:
-			findCaseExpr(env, reinterpret_cast<const CaseExpr*>(obj));
-			break;
-		case T_CaseWhen:
-			findCaseWhen(env, reinterpret_cast<const CaseWhen*>(obj));
-			break;
-		case T_CaseTestExpr:
-			findCaseTestExpr(env, reinterpret_cast<const CaseTestExpr*>(obj));
-			break;
-		case T_ArrayExpr:
-			findArrayExpr(env, reinterpret_cast<const ArrayExpr*>(obj));
-			break;
-		case T_RowExpr:
-			findRowExpr(env, reinterpret_cast<const RowExpr*>(obj));
-			break;
-		case T_RowCompareExpr:
-			findRowCompareExpr(env, reinterpret_cast<const RowCompareExpr*>(obj));
-			break;
-		case T_CoalesceExpr:
-			findCoalesceExpr(env, reinterpret_cast<const CoalesceExpr*>(obj));
-			break;
-		case T_MinMaxExpr:
-			findMinMaxExpr(env, reinterpret_cast<const MinMaxExpr*>(obj));
-			break;
-#if PG_VERSION_NUM >= 100000
-		case T_SQLValueFunction:
-			findSQLValueFunction(env, reinterpret_cast<const SQLValueFunction*>(obj));
-			break;
+	NODE_FIELD(FunctionScan, funccolcollations),
 #endif
-		case T_XmlExpr:
-			findXmlExpr(env, reinterpret_cast<const XmlExpr*>(obj));
-			break;
-		case T_NullTest:
-			findNullTest(env, reinterpret_cast<const NullTest*>(obj));
-			break;
-		case T_BooleanTest:
-			findBooleanTest(env, reinterpret_cast<const BooleanTest*>(obj));
-			break;
-		case T_CoerceToDomain:
-			findCoerceToDomain(env, reinterpret_cast<const CoerceToDomain*>(obj));
-			break;
-		case T_CoerceToDomainValue:
-			findCoerceToDomainValue(env, reinterpret_cast<const CoerceToDomainValue*>(obj));
-			break;
-		case T_SetToDefault:
-			findSetToDefault(env, reinterpret_cast<const SetToDefault*>(obj));
-			break;
-		case T_CurrentOfExpr:
-			findCurrentOfExpr(env, reinterpret_cast<const CurrentOfExpr*>(obj));
-			break;
-#if PG_VERSION_NUM >= 90500
-		case T_InferenceElem:
-			findInferenceElem(env, reinterpret_cast<const InferenceElem*>(obj));
-			break;
-#endif
-		case T_TargetEntry:
-			findTargetEntry(env, reinterpret_cast<const TargetEntry*>(obj));
-			break;
-		case T_RangeTblRef:
-			findRangeTblRef(env, reinterpret_cast<const RangeTblRef*>(obj));
-			break;
-		case T_JoinExpr:
-			findJoinExpr(env, reinterpret_cast<const JoinExpr*>(obj));
-			break;
-		case T_FromExpr:
-			findFromExpr(env, reinterpret_cast<const FromExpr*>(obj));
-			break;
-#if PG_VERSION_NUM >= 90500
-		case T_OnConflictExpr:
-			findOnConflictExpr(env, reinterpret_cast<const OnConflictExpr*>(obj));
-			break;
 #endif
+};
+
+static const FieldDesc ValuesScanFields[] = {
+	SCAN_FIELDS(offsetof(ValuesScan, scan)),
+	NODE_FIELD(ValuesScan, values_lists),
+};
+
 #if PG_VERSION_NUM >= 100000
-		case T_NextValueExpr:
-			findNextValueExpr(env, reinterpret_cast<const NextValueExpr*>(obj));
-			break;
-#endif
-#if 0
-		case T_Path:
-			findPath(env, obj);
-			break;
-		case T_IndexPath:
-			findIndexPath(env, obj);
-			break;
-		case T_BitmapHeapPath:
-			findBitmapHeapPath(env, obj);
-			break;
-		case T_BitmapAndPath:
-			findBitmapAndPath(env, obj);
-			break;
-		case T_BitmapOrPath:
-			findBitmapOrPath(env, obj);
-			break;
-		case T_TidPath:
-			findTidPath(env, obj);
-			break;
-		case T_ForeignPath:
-			findForeignPath(env, obj);
-			break;
-		case T_AppendPath:
-			findAppendPath(env, obj);
-			break;
-		case T_MergeAppendPath:
-			findMergeAppendPath(env, obj);
-			break;
-		case T_EnvPath:
-			findEnvPath(env, obj);
-			break;
-		case T_MaterialPath:
-			findMaterialPath(env, obj);
-			break;
-		case T_UniquePath:
-			findUniquePath(env, obj);
-			break;
-		case T_NestPath:
-			findNestPath(env, obj);
-			break;
-		case T_MergePath:
-			findMergePath(env, obj);
-			break;
-		case T_HashPath:
-			findHashPath(env, obj);
-			break;
+static const FieldDesc TableFuncScanFields[] = {
+	SCAN_FIELDS(offsetof(TableFuncScan, scan)),
+	NODE_FIELD(TableFuncScan, tablefunc),
+};
 #endif
-		case T_PlannerGlobal:
-			findPlannerGlobal(env, reinterpret_cast<const PlannerGlobal*>(obj));
-			break;
-		case T_PlannerInfo:
-			findPlannerInfo(env, reinterpret_cast<const PlannerInfo*>(obj));
-			break;
-		case T_RelOptInfo:
-			findRelOptInfo(env, reinterpret_cast<const RelOptInfo*>(obj));
-			break;
-#if 0
-		case T_IndexOptInfo:
-			findIndexOptInfo(env, obj);
-			break;
-		case T_EquivalenceClass:
-			findEquivalenceClass(env, obj);
-			break;
-		case T_EquivalenceMember:
-			findEquivalenceMember(env, obj);
-			break;
-		case T_PathKey:
-			findPathKey(env, obj);
-			break;
-		case T_ParamPathInfo:
-			findParamPathInfo(env, obj);
-			break;
-		case T_RestrictInfo:
-			findRestrictInfo(env, obj);
-			break;
-		case T_PlaceHolderVar:
-			findPlaceHolderVar(env, obj);
-			break;
-		case T_SpecialJoinInfo:
-			findSpecialJoinInfo(env, obj);
-			break;
-		case T_AppendRelInfo:
-			findAppendRelInfo(env, obj);
-			break;
-		case T_PlaceHolderInfo:
-			findPlaceHolderInfo(env, obj);
-			break;
-		case T_MinMaxAggInfo:
-			findMinMaxAggInfo(env, obj);
-			break;
-		case T_PlannerParamItem:
-			findPlannerParamItem(env, obj);
-			break;
 
-		case T_CreateStmt:
-			findCreateStmt(env, obj);
-			break;
-		case T_CreateForeignTableStmt:
-			findCreateForeignTableStmt(env, obj);
-			break;
-		case T_IndexStmt:
-			findIndexStmt(env, obj);
-			break;
-		case T_NotifyStmt:
-			findNotifyStmt(env, obj);
-			break;
-		case T_DeclareCursorStmt:
-			findDeclareCursorStmt(env, obj);
-			break;
-		case T_SelectStmt:
-			findSelectStmt(env, obj);
-			break;
-		case T_ColumnDef:
-			findColumnDef(env, obj);
-			break;
-		case T_TypeName:
-			findTypeName(env, obj);
-			break;
-		case T_TypeCast:
-			findTypeCast(env, obj);
-			break;
-		case T_CollateClause:
-			findCollateClause(env, obj);
-			break;
-		case T_IndexElem:
-			findIndexElem(env, obj);
-			break;
+static const FieldDesc CteScanFields[] = {
+	SCAN_FIELDS(offsetof(CteScan, scan)),
+};
+
+#if PG_VERSION_NUM >= 100000
+static const FieldDesc NamedTuplestoreScanFields[] = {
+	SCAN_FIELDS(offsetof(NamedTuplestoreScan, scan)),
+};
 #endif
 
-		case T_RangeTblEntry:
-			findRangeTblEntry(env, reinterpret_cast<const RangeTblEntry*>(obj));
-			break;
-#if PG_VERSION_NUM >= 90400
-		case T_RangeTblFunction:
-			findRangeTblFunction(env, reinterpret_cast<const RangeTblFunction*>(obj));
-			break;
+static const FieldDesc WorkTableScanFields[] = {
+	SCAN_FIELDS(offsetof(WorkTableScan, scan)),
+};
+
+#if PG_VERSION_NUM >= 90100
+static const FieldDesc ForeignScanFields[] = {
+	SCAN_FIELDS(offsetof(ForeignScan, scan)),
+#if PG_VERSION_NUM >= 90200
+	NODE_FIELD(ForeignScan, fdw_exprs),
+	NODE_FIELD(ForeignScan, fdw_private),
 #endif
 #if PG_VERSION_NUM >= 90500
-		case T_TableSampleClause: 
-			findTableSampleClause(env, reinterpret_cast<const TableSampleClause*>(obj));
-			break;
+	EXPRLIST_FIELD(ForeignScan, fdw_scan_tlist),
+	EXPRLIST_FIELD(ForeignScan, fdw_recheck_quals),
 #endif
-		case T_SortGroupClause:
-			findSortGroupClause(env, reinterpret_cast<const SortGroupClause*>(obj));
-			break;
+};
+#endif
+
 #if PG_VERSION_NUM >= 90500
-		case T_GroupingSet:
-			findGroupingSet(env, reinterpret_cast<const GroupingSet*>(obj));
-			break;
+static const FieldDesc CustomScanFields[] = {
+	SCAN_FIELDS(offsetof(CustomScan, scan)),
+	NODE_FIELD(CustomScan, custom_plans),
+	EXPRLIST_FIELD(CustomScan, custom_exprs),
+	NODE_FIELD(CustomScan, custom_private),
+	EXPRLIST_FIELD(CustomScan, custom_scan_tlist),
+};
 #endif
-		case T_WindowClause:
-			findWindowClause(env, reinterpret_cast<const WindowClause*>(obj));
-			break;
-#if 0
-		case T_RowMarkClause:
-			findRowMarkClause(env, obj);
-			break;
-		case T_WithClause:
-			findWithClause(env, obj);
-			break;
-		case T_CommonTableExpr:
-			findCommonTableExpr(env, obj);
-			break;
-		case T_SetOperationStmt:
-			findSetOperationStmt(env, obj);
-			break;
+
+static const FieldDesc JoinFields[] = {
+	JOIN_FIELDS(0),
+};
+
+static const FieldDesc NestLoopFields[] = {
+	JOIN_FIELDS(offsetof(NestLoop, join)),
+#if PG_VERSION_NUM >= 90100
+	NODE_FIELD(NestLoop, nestParams),
 #endif
-#if 0
-		case T_A_Expr:
-			findAExpr(env, obj);
-			break;
-		case T_ColumnRef:
-			findColumnRef(env, obj);
-			break;
-		case T_ParamRef:
-			findParamRef(env, obj);
-			break;
-		case T_A_Const:
-			findAConst(env, obj);
-			break;
-		case T_A_Star:
-			findA_Star(env, obj);
-			break;
-		case T_A_Indices:
-			findA_Indices(env, obj);
-			break;
-		case T_A_Indirection:
-			findA_Indirection(env, obj);
-			break;
-		case T_A_ArrayExpr:
-			findA_ArrayExpr(env, obj);
-			break;
-		case T_ResTarget:
-			findResTarget(env, obj);
-			break;
-		case T_SortBy:
-			findSortBy(env, obj);
-			break;
-		case T_WindowDef:
-			findWindowDef(env, obj);
-			break;
-		case T_RangeSubselect:
-			findRangeSubselect(env, obj);
-			break;
-		case T_RangeFunction:
-			findRangeFunction(env, obj);
-			break;
-		case T_Constraint:
-			findConstraint(env, obj);
-			break;
-		case T_FuncCall:
-			findFuncCall(env, obj);
-			break;
-		case T_DefElem:
-			findDefElem(env, obj);
-			break;
-		case T_TableLikeClause:
-			findTableLikeClause(env, obj);
-			break;
-		case T_LockingClause:
-			findLockingClause(env, obj);
-			break;
-		case T_XmlSerialize:
-			findXmlSerialize(env, obj);
-			break;
+};
+
+static const FieldDesc MergeJoinFields[] = {
+	JOIN_FIELDS(offsetof(MergeJoin, join)),
+	EXPRLIST_FIELD(MergeJoin, mergeclauses),
+};
+
+static const FieldDesc HashJoinFields[] = {
+	JOIN_FIELDS(offsetof(HashJoin, join)),
+	EXPRLIST_FIELD(HashJoin, hashclauses),
+#if PG_VERSION_NUM >= 120000
+	EXPRLIST_FIELD(HashJoin, hashoperators),
+	EXPRLIST_FIELD(HashJoin, hashcollations),
+	EXPRLIST_FIELD(HashJoin, hashkeys),
 #endif
-			/* Statement Nodes */
-		case T_Query:
-			findQuery(env, reinterpret_cast<const Query*>(obj));
-			break;
-		case T_PlannedStmt:
-			findPlannedStmt(env, reinterpret_cast<const PlannedStmt*>(obj));
-			break;
+};
 
-		default:
-			elog(WARNING, "could not dump unrecognized node type: %d",
-				 (int) nodeTag(obj));
-			break;
-	}
-}
+static const FieldDesc AggFields[] = {
+	PLAN_FIELDS(offsetof(Agg, plan)),
+#if PG_VERSION_NUM >= 90500
+	NODE_FIELD(Agg, groupingSets),
+	NODE_FIELD(Agg, chain),
+#endif
+};
 
-static void
-findNodeIndex(NodeInfoEnv& env, const void *parent, const char *fldname, int index, const void *obj)
-{
-	char buffer[256];
-	sprintf(buffer, "%s%d", fldname, index);
-	findNode(env, parent, fldname, obj);
-}
+static const FieldDesc WindowAggFields[] = {
+	PLAN_FIELDS(offsetof(WindowAgg, plan)),
+	EXPRLIST_FIELD(WindowAgg, startOffset),
+	EXPRLIST_FIELD(WindowAgg, endOffset),
+};
+
+static const FieldDesc GroupFields[] = {
+	PLAN_FIELDS(offsetof(Group, plan)),
+};
+
+static const FieldDesc MaterialFields[] = {
+	PLAN_FIELDS(offsetof(Material, plan)),
+};
+
+static const FieldDesc SortFields[] = {
+	PLAN_FIELDS(offsetof(Sort, plan)),
+};
+
+static const FieldDesc UniqueFields[] = {
+	PLAN_FIELDS(offsetof(Unique, plan)),
+};
+
+#if PG_VERSION_NUM >= 90600
+static const FieldDesc GatherFields[] = {
+	PLAN_FIELDS(offsetof(Gather, plan)),
+};
+#endif
+
+#if PG_VERSION_NUM >= 100000
+static const FieldDesc GatherMergeFields[] = {
+	PLAN_FIELDS(offsetof(GatherMerge, plan)),
+};
+#endif
 
-static void
-findPlannedStmt(NodeInfoEnv& env, const PlannedStmt *node)
-{
-	FIND_NODE(planTree);
-	FIND_NODE(rtable);
-	FIND_NODE(resultRelations);
+static const FieldDesc HashFields[] = {
+	PLAN_FIELDS(offsetof(Hash, plan)),
 #if PG_VERSION_NUM >= 120000
-	FIND_NODE(rootResultRelations);	
-#elif PG_VERSION_NUM >= 100000
-	FIND_NODE(nonleafResultRelations);
-	FIND_NODE(rootResultRelations);
-#else
-	FIND_NODE(utilityStmt);
-#if PG_VERSION_NUM < 90200
-	FIND_NODE(intoClause);
+	EXPRLIST_FIELD(Hash, hashkeys),
 #endif
+};
+
+static const FieldDesc SetOpFields[] = {
+	PLAN_FIELDS(offsetof(SetOp, plan)),
+};
+
+static const FieldDesc LockRowsFields[] = {
+	PLAN_FIELDS(offsetof(LockRows, plan)),
+	NODE_FIELD(LockRows, rowMarks),
+};
+
+static const FieldDesc LimitFields[] = {
+	PLAN_FIELDS(offsetof(Limit, plan)),
+	EXPRLIST_FIELD(Limit, limitOffset),
+	EXPRLIST_FIELD(Limit, limitCount),
+};
+
+#if PG_VERSION_NUM >= 90100
+static const FieldDesc NestLoopParamFields[] = {
+	NODE_FIELD(NestLoopParam, paramval),
+};
 #endif
-	FIND_NODE(subplans);
-	FIND_NODE(rowMarks);
-	FIND_NODE(relationOids);
-	FIND_NODE(invalItems);
+
 #if PG_VERSION_NUM >= 110000
-	FIND_NODE(utilityStmt);
+static const FieldDesc PartitionPruneInfoFields[] = {
+	NODE_FIELD(PartitionPruneInfo, prune_infos),
+};
+
+static const FieldDesc PartitionedRelPruneInfoFields[] = {
+#if PG_VERSION_NUM >= 120000
+	NODE_FIELD(PartitionedRelPruneInfo, initial_pruning_steps),
+	NODE_FIELD(PartitionedRelPruneInfo, exec_pruning_steps),
+#else
+	NODE_FIELD(PartitionedRelPruneInfo, pruning_steps),
 #endif
-}
+};
 
-static void
-findPlan(NodeInfoEnv& env, const Plan *node)
-{
-	FIND_TARGETLIST(targetlist);
-	FIND_EXPRLIST(qual);
-	FIND_PLAN(lefttree);
-	FIND_PLAN(righttree);
-	FIND_NODE(initPlan); /* list of plans */
-}
+static const FieldDesc PartitionPruneStepOpFields[] = {
+	NODE_FIELD(PartitionPruneStepOp, exprs),
+	NODE_FIELD(PartitionPruneStepOp, cmpfns),
+};
+#endif
 
-static void
-findResult(NodeInfoEnv& env, const Result *node)
-{
-	findPlan(env, &node->plan);
-	FIND_NODE(resconstantqual);
-}
+static const FieldDesc AliasFields[] = {
+	NODE_FIELD(Alias, colnames),
+};
 
 #if PG_VERSION_NUM >= 100000
-static void
-findProjectSet(NodeInfoEnv& env, const ProjectSet *node)
-{
-	findPlan(env, &node->plan);
-}
+static const FieldDesc TableFuncFields[] = {
+	NODE_FIELD(TableFunc, ns_uris),
+	NODE_FIELD(TableFunc, ns_names),
+	NODE_FIELD(TableFunc, docexpr),
+	NODE_FIELD(TableFunc, rowexpr),
+	NODE_FIELD(TableFunc, colnames),
+	NODE_FIELD(TableFunc, coltypes),
+	NODE_FIELD(TableFunc, coltypmods),
+	NODE_FIELD(TableFunc, colcollations),
+	NODE_FIELD(TableFunc, colexprs),
+	NODE_FIELD(TableFunc, coldefexprs),
+};
 #endif
 
-static void
-findModifyTable(NodeInfoEnv& env, const ModifyTable *node)
-{
-	findPlan(env, &node->plan);
-#if PG_VERSION_NUM < 120000 && PG_VERSION_NUM >= 100000
-	FIND_NODE(partitioned_rels);
+static const FieldDesc IntoClauseFields[] = {
+	NODE_FIELD(IntoClause, rel),
+	NODE_FIELD(IntoClause, colNames),
+	NODE_FIELD(IntoClause, options),
+#if PG_VERSION_NUM >= 90300
+	NODE_FIELD(IntoClause, viewQuery),
 #endif
-	FIND_NODE(resultRelations);
-	FIND_NODE(plans);
+};
+
+static const FieldDesc AggrefFields[] = {
 #if PG_VERSION_NUM >= 90400
-	FIND_NODE(withCheckOptionLists);
+	NODE_FIELD(Aggref, aggdirectargs),
 #endif
-	FIND_NODE(returningLists);
-#if PG_VERSION_NUM >= 90300
-	FIND_NODE(fdwPrivLists);
+	NODE_FIELD(Aggref, args),
+	NODE_FIELD(Aggref, aggorder),
+	NODE_FIELD(Aggref, aggdistinct),
+#if PG_VERSION_NUM >= 90400
+	NODE_FIELD(Aggref, aggfilter),
 #endif
-	FIND_NODE(rowMarks);
+};
+
 #if PG_VERSION_NUM >= 90500
-	FIND_NODE(arbiterIndexes);
-	FIND_NODE(onConflictSet);
-	FIND_EXPRLIST(onConflictWhere);
-	FIND_EXPRLIST(exclRelTlist);
+static const FieldDesc GroupingFuncFields[] = {
+	NODE_FIELD(GroupingFunc, args),
+	NODE_FIELD(GroupingFunc, refs),
+	NODE_FIELD(GroupingFunc, cols),
+};
 #endif
-}
 
-static void
-findAppend(NodeInfoEnv& env, const Append *node)
-{
-	findPlan(env, &node->plan);
-	FIND_NODE(appendplans);	
-#if PG_VERSION_NUM < 120000 && PG_VERSION_NUM >= 100000
-	FIND_NODE(partitioned_rels);
+static const FieldDesc WindowFuncFields[] = {
+	NODE_FIELD(WindowFunc, args),
+};
+
+#if PG_VERSION_NUM >= 120000
+static const FieldDesc SubscriptingRefFields[] = {
+	NODE_FIELD(SubscriptingRef, refupperindexpr),
+	NODE_FIELD(SubscriptingRef, reflowerindexpr),
+	NODE_FIELD(SubscriptingRef, refexpr),
+	NODE_FIELD(SubscriptingRef, refassgnexpr),
+};
+#else
+static const FieldDesc ArrayRefFields[] = {
+	NODE_FIELD(ArrayRef, refupperindexpr),
+	NODE_FIELD(ArrayRef, reflowerindexpr),
+	NODE_FIELD(ArrayRef, refexpr),
+	NODE_FIELD(ArrayRef, refassgnexpr),
+};
 #endif
+
+static const FieldDesc FuncExprFields[] = {
+	NODE_FIELD(FuncExpr, args),
+};
+
+static const FieldDesc NamedArgExprFields[] = {
+	NODE_FIELD(NamedArgExpr, arg),
+};
+
+static const FieldDesc OpExprFields[] = {
+	NODE_FIELD(OpExpr, args),
+};
+
+static const FieldDesc DistinctExprFields[] = {
+	NODE_FIELD(DistinctExpr, args),
+};
+
+static const FieldDesc NullIfExprFields[] = {
+	NODE_FIELD(NullIfExpr, args),
+};
+
+static const FieldDesc ScalarArrayOpExprFields[] = {
+	NODE_FIELD(ScalarArrayOpExpr, args),
+};
+
+static const FieldDesc BoolExprFields[] = {
+	NODE_FIELD(BoolExpr, args),
+};
+
+static const FieldDesc SubLinkFields[] = {
+	NODE_FIELD(SubLink, testexpr),
+	NODE_FIELD(SubLink, operName),
+	NODE_FIELD(SubLink, subselect),
+};
+
+static const FieldDesc SubPlanFields[] = {
+	NODE_FIELD(SubPlan, testexpr),
+	NODE_FIELD(SubPlan, paramIds),
+	NODE_FIELD(SubPlan, setParam),
+	NODE_FIELD(SubPlan, parParam),
+	NODE_FIELD(SubPlan, args),
+};
+
+static const FieldDesc AlternativeSubPlanFields[] = {
+	NODE_FIELD(AlternativeSubPlan, subplans),
+};
+
+static const FieldDesc FieldSelectFields[] = {
+	NODE_FIELD(FieldSelect, arg),
+};
+
+static const FieldDesc FieldStoreFields[] = {
+	NODE_FIELD(FieldStore, arg),
+	NODE_FIELD(FieldStore, newvals),
+	NODE_FIELD(FieldStore, fieldnums),
+};
+
+static const FieldDesc RelabelTypeFields[] = {
+	NODE_FIELD(RelabelType, arg),
+};
+
+static const FieldDesc CoerceViaIOFields[] = {
+	NODE_FIELD(CoerceViaIO, arg),
+};
+
+static const FieldDesc ArrayCoerceExprFields[] = {
+	NODE_FIELD(ArrayCoerceExpr, arg),
 #if PG_VERSION_NUM >= 110000
-	FIND_NODE(part_prune_info);
+	NODE_FIELD(ArrayCoerceExpr, elemexpr),
 #endif
-}
+};
+
+static const FieldDesc ConvertRowtypeExprFields[] = {
+	NODE_FIELD(ConvertRowtypeExpr, arg),
+};
 
 #if PG_VERSION_NUM >= 90100
-static void
-findMergeAppend(NodeInfoEnv& env, const MergeAppend *node)
-{
-	findPlan(env, &node->plan);
-#if PG_VERSION_NUM < 120000 && PG_VERSION_NUM >= 100000
-	FIND_NODE(partitioned_rels);
+static const FieldDesc CollateExprFields[] = {
+	NODE_FIELD(CollateExpr, arg),
+};
 #endif
-	FIND_NODE(mergeplans); /* list of plans */
-#if PG_VERSION_NUM >= 120000
-	FIND_NODE(part_prune_info);
-#endif			
-}
+
+static const FieldDesc CaseExprFields[] = {
+	NODE_FIELD(CaseExpr, arg),
+	NODE_FIELD(CaseExpr, args),
+	NODE_FIELD(CaseExpr, defresult),
+};
+
+static const FieldDesc CaseWhenFields[] = {
+	NODE_FIELD(CaseWhen, expr),
+	NODE_FIELD(CaseWhen, result),
+};
+
+static const FieldDesc ArrayExprFields[] = {
+	NODE_FIELD(ArrayExpr, elements),
+};
+
+static const FieldDesc RowExprFields[] = {
+	NODE_FIELD(RowExpr, args),
+	NODE_FIELD(RowExpr, colnames),
+};
+
+static const FieldDesc RowCompareExprFields[] = {
+	NODE_FIELD(RowCompareExpr, opnos),
+	NODE_FIELD(RowCompareExpr, opfamilies),
+#if PG_VERSION_NUM >= 90100
+	NODE_FIELD(RowCompareExpr, inputcollids),
 #endif
+	NODE_FIELD(RowCompareExpr, largs),
+	NODE_FIELD(RowCompareExpr, rargs),
+};
 
-static void
-findRecursiveUnion(NodeInfoEnv& env, const RecursiveUnion *node)
-{
-	findPlan(env, &node->plan);
-}
+static const FieldDesc CoalesceExprFields[] = {
+	NODE_FIELD(CoalesceExpr, args),
+};
 
-static void
-findBitmapAnd(NodeInfoEnv& env, const BitmapAnd *node)
-{
-	findPlan(env, &node->plan);
-	FIND_NODE(bitmapplans); /* list of plans */
-}
+static const FieldDesc MinMaxExprFields[] = {
+	NODE_FIELD(MinMaxExpr, args),
+};
 
-static void
-findBitmapOr(NodeInfoEnv& env, const BitmapOr *node)
-{
-	findPlan(env, &node->plan);
-	FIND_NODE(bitmapplans); /* list of plans */
-}
+static const FieldDesc XmlExprFields[] = {
+	NODE_FIELD(XmlExpr, named_args),
+	NODE_FIELD(XmlExpr, arg_names),
+	NODE_FIELD(XmlExpr, args),
+};
 
-static void
-findScan(NodeInfoEnv& env, const Scan *node)
-{
-	findPlan(env, &node->plan);
-}
+static const FieldDesc NullTestFields[] = {
+	NODE_FIELD(NullTest, arg),
+};
 
-static void
-findSeqScan(NodeInfoEnv& env, const SeqScan *node)
-{
-	findPlan(env, &node->plan);
-}
+static const FieldDesc BooleanTestFields[] = {
+	NODE_FIELD(BooleanTest, arg),
+};
+
+static const FieldDesc CoerceToDomainFields[] = {
+	NODE_FIELD(CoerceToDomain, arg),
+};
 
 #if PG_VERSION_NUM >= 90500
-static void
-findSampleScan(NodeInfoEnv& env, const SampleScan *node)
-{
-	findScan(env, &node->scan);
-	FIND_NODE(tablesample);
-}
+static const FieldDesc InferenceElemFields[] = {
+	NODE_FIELD(InferenceElem, expr),
+};
 #endif
 
-static void
-findIndexScan(NodeInfoEnv& env, const IndexScan *node)
-{
-	findScan(env, &node->scan);
-	FIND_EXPRLIST(indexqual);
-	FIND_EXPRLIST(indexqualorig);
+static const FieldDesc TargetEntryFields[] = {
+	NODE_FIELD(TargetEntry, expr),
+};
+
+static const FieldDesc JoinExprFields[] = {
+	NODE_FIELD(JoinExpr, larg),
+	NODE_FIELD(JoinExpr, rarg),
+	NODE_FIELD(JoinExpr, usingClause),
+	NODE_FIELD(JoinExpr, quals),
+	NODE_FIELD(JoinExpr, alias),
+};
+
+static const FieldDesc FromExprFields[] = {
+	NODE_FIELD(FromExpr, fromlist),
+	NODE_FIELD(FromExpr, quals),
+};
+
+#if PG_VERSION_NUM >= 90500
+static const FieldDesc OnConflictExprFields[] = {
+	NODE_FIELD(OnConflictExpr, arbiterElems),
+	NODE_FIELD(OnConflictExpr, arbiterWhere),
+	NODE_FIELD(OnConflictExpr, onConflictSet),
+	NODE_FIELD(OnConflictExpr, onConflictWhere),
+	NODE_FIELD(OnConflictExpr, exclRelTlist),
+};
+#endif
+
+static const FieldDesc PlannerGlobalFields[] = {
+#if PG_VERSION_NUM < 90300
+	NODE_FIELD(PlannerGlobal, paramlist),
+#endif
+	NODE_FIELD(PlannerGlobal, subplans),
+#if PG_VERSION_NUM >= 90200
+	NODE_FIELD(PlannerGlobal, subroots),
+#else
+	NODE_FIELD(PlannerGlobal, subrtables),
+	NODE_FIELD(PlannerGlobal, subrowmarks),
+#endif
+	NODE_FIELD(PlannerGlobal, finalrtable),
+	NODE_FIELD(PlannerGlobal, finalrowmarks),
 #if PG_VERSION_NUM >= 90100
-	FIND_EXPRLIST(indexorderby);
-	FIND_EXPRLIST(indexorderbyorig);
+	NODE_FIELD(PlannerGlobal, resultRelations),
+#endif
+	NODE_FIELD(PlannerGlobal, relationOids),
+	NODE_FIELD(PlannerGlobal, invalItems),
+};
+
+static const FieldDesc PlannerInfoFields[] = {
+	NODE_FIELD(PlannerInfo, parse),
+	NODE_FIELD(PlannerInfo, glob),
+	NODE_FIELD(PlannerInfo, parent_root),
+	NODE_FIELD(PlannerInfo, plan_params),
+	ARRAY_FIELD(PlannerInfo, simple_rel_array, simple_rel_array_size, 1),
+	ARRAY_FIELD(PlannerInfo, simple_rte_array, simple_rel_array_size, 1),
+	NODE_FIELD(PlannerInfo, join_rel_list),
+	ARRAY_FIELD(PlannerInfo, join_rel_level, join_cur_level, 0),
+#if PG_VERSION_NUM < 90100
+	NODE_FIELD(PlannerInfo, resultRelations),
 #endif
+	NODE_FIELD(PlannerInfo, init_plans),
+	NODE_FIELD(PlannerInfo, cte_plan_ids),
 #if PG_VERSION_NUM >= 90500
-	FIND_EXPRLIST(indexorderbyops);
+	NODE_FIELD(PlannerInfo, multiexpr_params),
+#endif
+	NODE_FIELD(PlannerInfo, eq_classes),
+	NODE_FIELD(PlannerInfo, canon_pathkeys),
+	NODE_FIELD(PlannerInfo, left_join_clauses),
+	NODE_FIELD(PlannerInfo, right_join_clauses),
+	NODE_FIELD(PlannerInfo, full_join_clauses),
+	NODE_FIELD(PlannerInfo, join_info_list),
+#if PG_VERSION_NUM < 90500 && PG_VERSION_NUM >= 90300
+	NODE_FIELD(PlannerInfo, lateral_info_list),
 #endif
-}
+	NODE_FIELD(PlannerInfo, append_rel_list),
+	NODE_FIELD(PlannerInfo, rowMarks),
+	NODE_FIELD(PlannerInfo, placeholder_list),
+#if PG_VERSION_NUM >= 90600
+	NODE_FIELD(PlannerInfo, fkey_list),
+#endif
+	NODE_FIELD(PlannerInfo, query_pathkeys),
+	NODE_FIELD(PlannerInfo, group_pathkeys),
+	NODE_FIELD(PlannerInfo, window_pathkeys),
+#if PG_VERSION_NUM >= 90500
+	NODE_FIELD(PlannerInfo, distinct_pathkeys),
+#endif
+	NODE_FIELD(PlannerInfo, sort_pathkeys),
+#if PG_VERSION_NUM >= 90100
+	NODE_FIELD(PlannerInfo, minmax_aggs),
+#endif
+	NODE_FIELD(PlannerInfo, initial_rels),
+#if PG_VERSION_NUM >= 90600
+	NODE_FIELD(PlannerInfo, processed_tlist),
+	/* @todo */
+	/* struct Path *non_recursive_path; */
+#else
+	NODE_FIELD(PlannerInfo, non_recursive_plan),
+#endif
+#if PG_VERSION_NUM >= 90100
+	NODE_FIELD(PlannerInfo, curOuterParams),
+#endif
+};
 
+static const FieldDesc RelOptInfoFields[] = {
+#if PG_VERSION_NUM >= 90600
+	/* @todo */
+	/* struct PathTarget *reltarget; */
+#else
+	NODE_FIELD(RelOptInfo, reltargetlist),
+#endif
+	NODE_FIELD(RelOptInfo, pathlist),
 #if PG_VERSION_NUM >= 90200
-static void
-findIndexOnlyScan(NodeInfoEnv& env, const IndexOnlyScan *node)
-{
-	findScan(env, &node->scan);
-	FIND_EXPRLIST(indexqual);
-	FIND_EXPRLIST(indexorderby);
-	FIND_EXPRLIST(indextlist);
-}
+	NODE_FIELD(RelOptInfo, ppilist),
+#endif
+	NODE_FIELD(RelOptInfo, cheapest_startup_path),
+	NODE_FIELD(RelOptInfo, cheapest_total_path),
+	NODE_FIELD(RelOptInfo, cheapest_unique_path),
+#if PG_VERSION_NUM >= 90200
+	NODE_FIELD(RelOptInfo, cheapest_parameterized_paths),
+#endif
+#if PG_VERSION_NUM >= 90300
+	NODE_FIELD(RelOptInfo, lateral_vars),
+#endif
+	NODE_FIELD(RelOptInfo, indexlist),
+#if PG_VERSION_NUM < 90600
+	NODE_FIELD(RelOptInfo, subplan),
+#endif
+#if PG_VERSION_NUM >= 90300
+	NODE_FIELD(RelOptInfo, subroot),
+	NODE_FIELD(RelOptInfo, subplan_params),
+#elif PG_VERSION_NUM >= 90200
+	NODE_FIELD(RelOptInfo, subroot),
+#else
+	NODE_FIELD(RelOptInfo, subrtable),
+	NODE_FIELD(RelOptInfo, subrowmark),
+#endif
+#if PG_VERSION_NUM >= 90200
+	NODE_FIELD(RelOptInfo, fdwroutine),
+#endif
+	NODE_FIELD(RelOptInfo, baserestrictinfo),
+	NODE_FIELD(RelOptInfo, joininfo),
+#if PG_VERSION_NUM < 90200
+	NODE_FIELD(RelOptInfo, index_inner_paths),
 #endif
+};
 
-static void
-findBitmapIndexScan(NodeInfoEnv& env, const BitmapIndexScan *node)
-{
-	findScan(env, &node->scan);
-	FIND_EXPRLIST(indexqual);
-	FIND_EXPRLIST(indexqualorig);
-}
+static const FieldDesc QueryFields[] = {
+#if PG_VERSION_NUM < 90200
+	NODE_FIELD(Query, intoClause),
+#endif
+	NODE_FIELD(Query, cteList),
+	NODE_FIELD(Query, rtable),
+	NODE_FIELD(Query, jointree),
+	NODE_FIELD(Query, targetList),
+	NODE_FIELD(Query, returningList),
+	NODE_FIELD(Query, groupClause),
+#if PG_VERSION_NUM >= 90500
+	NODE_FIELD(Query, groupingSets),
+#endif
+	NODE_FIELD(Query, havingQual),
+	NODE_FIELD(Query, windowClause),
+	NODE_FIELD(Query, distinctClause),
+	NODE_FIELD(Query, sortClause),
+	NODE_FIELD(Query, limitOffset),
+	NODE_FIELD(Query, limitCount),
+	NODE_FIELD(Query, rowMarks),
+	NODE_FIELD(Query, setOperations),
+#if PG_VERSION_NUM >= 90100
+	NODE_FIELD(Query, constraintDeps),
+#endif
+};
 
-static void
-findBitmapHeapScan(NodeInfoEnv& env, const BitmapHeapScan *node)
-{
-	findScan(env, &node->scan);
-	FIND_EXPRLIST(bitmapqualorig);
-}
+static const FieldDesc RangeTblEntryFields[] = {
+	NODE_FIELD(RangeTblEntry, subquery),
+	NODE_FIELD(RangeTblEntry, joinaliasvars),
+#if PG_VERSION_NUM >= 90400
+	NODE_FIELD(RangeTblEntry, functions),
+#else
+	NODE_FIELD(RangeTblEntry, funcexpr),
+	NODE_FIELD(RangeTblEntry, funccoltypes),
+	NODE_FIELD(RangeTblEntry, funccoltypmods),
+#if PG_VERSION_NUM >= 90100
+	NODE_FIELD(RangeTblEntry, funccolcollations),
+#endif
+#endif
+#if PG_VERSION_NUM >= 100000
+	NODE_FIELD(RangeTblEntry, tablefunc),
+#endif
+	NODE_FIELD(RangeTblEntry, values_lists),
+#if PG_VERSION_NUM >= 90100 && PG_VERSION_NUM < 100000
+	NODE_FIELD(RangeTblEntry, values_collations),
+#endif
+#if PG_VERSION_NUM >= 100000
+	NODE_FIELD(RangeTblEntry, coltypes),
+	NODE_FIELD(RangeTblEntry, coltypmods),
+	NODE_FIELD(RangeTblEntry, colcollations),
+#else
+	NODE_FIELD(RangeTblEntry, ctecoltypes),
+	NODE_FIELD(RangeTblEntry, ctecoltypmods),
+#if PG_VERSION_NUM >= 90100
+	NODE_FIELD(RangeTblEntry, ctecolcollations),
+#endif
+#endif
+	NODE_FIELD(RangeTblEntry, alias),
+	NODE_FIELD(RangeTblEntry, eref),
+#if PG_VERSION_NUM >= 90400
+	NODE_FIELD(RangeTblEntry, securityQuals),
+#endif
+};
 
-static void
-findTidScan(NodeInfoEnv& env, const TidScan *node)
-{
-	findScan(env, &node->scan);
-	FIND_EXPRLIST(tidquals);
-}
+#if PG_VERSION_NUM >= 90400
+static const FieldDesc RangeTblFunctionFields[] = {
+	NODE_FIELD(RangeTblFunction, funcexpr),
+	NODE_FIELD(RangeTblFunction, funccolnames),
+	NODE_FIELD(RangeTblFunction, funccoltypes),
+	NODE_FIELD(RangeTblFunction, funccoltypmods),
+	NODE_FIELD(RangeTblFunction, funccolcollations),
+};
+#endif
 
-static void
-findSubqueryScan(NodeInfoEnv& env, const SubqueryScan *node)
-{
-	findScan(env, &node->scan);
-	FIND_PLAN(subplan);
-}
+#if PG_VERSION_NUM >= 90500
+static const FieldDesc TableSampleClauseFields[] = {
+	NODE_FIELD(TableSampleClause, args),
+	NODE_FIELD(TableSampleClause, repeatable),
+};
 
-static void
-findFunctionScan(NodeInfoEnv& env, const FunctionScan *node)
-{
-	findScan(env, &node->scan);
+static const FieldDesc GroupingSetFields[] = {
+	NODE_FIELD(GroupingSet, content),
+};
+#endif
+
+static const FieldDesc WindowClauseFields[] = {
+	NODE_FIELD(WindowClause, partitionClause),
+	NODE_FIELD(WindowClause, orderClause),
+	NODE_FIELD(WindowClause, startOffset),
+	NODE_FIELD(WindowClause, endOffset),
+};
+
+/*
+ * Executor state nodes.  Every PlanState subtype embeds its PlanState (via
+ * ScanState or JoinState) at offset zero, so most of them share one table.
+ * The Plan a state node was made from is summarized in its label rather
+ * than drawn, as it would duplicate the whole plan tree.  On 9.6 and earlier
+ * expressions are trees of ExprState subtypes, which aren't walked.
+ */
+#define PLANSTATE_FIELDS(base) \
+	{FIELD_NODE,		(base) + offsetof(PlanState, lefttree),	"lefttree"}, \
+	{FIELD_NODE,		(base) + offsetof(PlanState, righttree),	"righttree"}, \
+	{FIELD_NODE,		(base) + offsetof(PlanState, initPlan),	"initPlan"}, \
+	{FIELD_NODE,		(base) + offsetof(PlanState, subPlan),	"subPlan"}
+
+static const FieldDesc PlanStateFields[] = {
+	PLANSTATE_FIELDS(0),
+#if PG_VERSION_NUM >= 100000
+	EXPRLIST_FIELD(PlanState, qual),
+#endif
+};
+
+static const FieldDesc JoinStateFields[] = {
+	PLANSTATE_FIELDS(offsetof(JoinState, ps)),
+#if PG_VERSION_NUM >= 100000
+	{FIELD_EXPRLIST,	offsetof(JoinState, ps) + offsetof(PlanState, qual),	"qual"},
+	EXPRLIST_FIELD(JoinState, joinqual),
+#endif
+};
+
+static const FieldDesc SubqueryScanStateFields[] = {
+	PLANSTATE_FIELDS(offsetof(SubqueryScanState, ss) + offsetof(ScanState, ps)),
+#if PG_VERSION_NUM >= 100000
+	{FIELD_EXPRLIST,	offsetof(SubqueryScanState, ss) + offsetof(ScanState, ps) + offsetof(PlanState, qual),	"qual"},
+#endif
+	NODE_FIELD(SubqueryScanState, subplan),
+};
+
+#if PG_VERSION_NUM >= 90500
+static const FieldDesc CustomScanStateFields[] = {
+	PLANSTATE_FIELDS(offsetof(CustomScanState, ss) + offsetof(ScanState, ps)),
+#if PG_VERSION_NUM >= 100000
+	{FIELD_EXPRLIST,	offsetof(CustomScanState, ss) + offsetof(ScanState, ps) + offsetof(PlanState, qual),	"qual"},
+#endif
+	NODE_FIELD(CustomScanState, custom_ps),
+};
+#endif
 
-#if PG_VERSION_NUM >= 90400
-	FIND_NODE(functions);
+static const FieldDesc SubPlanStateFields[] = {
+#if PG_VERSION_NUM >= 100000
+	NODE_FIELD(SubPlanState, subplan),
+	NODE_FIELD(SubPlanState, planstate),
+	EXPRLIST_FIELD(SubPlanState, testexpr),
 #else
-	FIND_NODE(funcexpr);
-	FIND_NODE(funccolnames);
-	FIND_NODE(funccoltypes);
-	FIND_NODE(funccoltypmods);
-#if PG_VERSION_NUM >= 90100
-	FIND_NODE(funccolcollations);
-#endif
+	{FIELD_NODE,		offsetof(SubPlanState, xprstate) + offsetof(ExprState, expr),	"expr"},
+	NODE_FIELD(SubPlanState, planstate),
 #endif
-}
+};
 
-static void
-findValuesScan(NodeInfoEnv& env, const ValuesScan *node)
-{
-	findScan(env, &node->scan);
-	FIND_NODE(values_lists);
-}
+#if PG_VERSION_NUM >= 100000
+static const FieldDesc ExprStateFields[] = {
+	NODE_FIELD(ExprState, expr),
+};
+#endif
 
+/*
+ * Child state nodes kept in arrays, with the length in another field.
+ */
 #if PG_VERSION_NUM >= 100000
-static void
-findTableFuncScan(NodeInfoEnv& env, const TableFuncScan *node)
-{
-	findScan(env, &node->scan);
-	FIND_NODE(tablefunc);
-}
+#define PLANSTATE_ARRAY_FIELDS(type, fldname, countfld) \
+	PLANSTATE_FIELDS(0), \
+	EXPRLIST_FIELD(PlanState, qual), \
+	ARRAY_FIELD(type, fldname, countfld, 0)
+#else
+#define PLANSTATE_ARRAY_FIELDS(type, fldname, countfld) \
+	PLANSTATE_FIELDS(0), \
+	ARRAY_FIELD(type, fldname, countfld, 0)
 #endif
 
-static void
-findCteScan(NodeInfoEnv& env, const CteScan *node)
-{
-	findScan(env, &node->scan);
-}
+static const FieldDesc ModifyTableStateFields[] = {
+	PLANSTATE_ARRAY_FIELDS(ModifyTableState, mt_plans, mt_nplans),
+};
 
-#if PG_VERSION_NUM >= 100000
-static void
-findNamedTuplestoreScan(NodeInfoEnv& env, const NamedTuplestoreScan *node)
-{
-	findScan(env, &node->scan);
-}
+static const FieldDesc AppendStateFields[] = {
+	PLANSTATE_ARRAY_FIELDS(AppendState, appendplans, as_nplans),
+};
+
+#if PG_VERSION_NUM >= 90100
+static const FieldDesc MergeAppendStateFields[] = {
+	PLANSTATE_ARRAY_FIELDS(MergeAppendState, mergeplans, ms_nplans),
+};
 #endif
 
-static void
-findWorkTableScan(NodeInfoEnv& env, const WorkTableScan *node)
-{
-	findScan(env, &node->scan);
-}
+static const FieldDesc BitmapAndStateFields[] = {
+	PLANSTATE_ARRAY_FIELDS(BitmapAndState, bitmapplans, nplans),
+};
+
+static const FieldDesc BitmapOrStateFields[] = {
+	PLANSTATE_ARRAY_FIELDS(BitmapOrState, bitmapplans, nplans),
+};
 
+NODE_OUTPUT(PlannedStmt)
+NODE_OUTPUT(Plan)
+NODE_OUTPUT(Result)
+#if PG_VERSION_NUM >= 100000
+NODE_OUTPUT(ProjectSet)
+#endif
+NODE_OUTPUT(ModifyTable)
+NODE_OUTPUT(Append)
 #if PG_VERSION_NUM >= 90100
-static void
-findForeignScan(NodeInfoEnv& env, const ForeignScan *node)
-{
-	findScan(env, &node->scan);
-#if PG_VERSION_NUM >= 90200
-	FIND_NODE(fdw_exprs);
-	FIND_NODE(fdw_private);
+NODE_OUTPUT(MergeAppend)
 #endif
+NODE_OUTPUT(RecursiveUnion)
+NODE_OUTPUT(BitmapAnd)
+NODE_OUTPUT(BitmapOr)
+NODE_OUTPUT(Scan)
+NODE_OUTPUT(SeqScan)
 #if PG_VERSION_NUM >= 90500
-	FIND_EXPRLIST(fdw_scan_tlist);
-	FIND_EXPRLIST(fdw_recheck_quals);
+NODE_OUTPUT(SampleScan)
 #endif
-}
+NODE_OUTPUT(IndexScan)
+#if PG_VERSION_NUM >= 90200
+NODE_OUTPUT(IndexOnlyScan)
+#endif
+NODE_OUTPUT(BitmapIndexScan)
+NODE_OUTPUT(BitmapHeapScan)
+NODE_OUTPUT(TidScan)
+NODE_OUTPUT(SubqueryScan)
+NODE_OUTPUT(FunctionScan)
+NODE_OUTPUT(ValuesScan)
+#if PG_VERSION_NUM >= 100000
+NODE_OUTPUT(TableFuncScan)
+#endif
+NODE_OUTPUT(CteScan)
+#if PG_VERSION_NUM >= 100000
+NODE_OUTPUT(NamedTuplestoreScan)
+#endif
+NODE_OUTPUT(WorkTableScan)
+#if PG_VERSION_NUM >= 90100
+NODE_OUTPUT(ForeignScan)
 #endif
-
 #if PG_VERSION_NUM >= 90500
-static void
-findCustomScan(NodeInfoEnv& env, const CustomScan *node)
-{
-	findScan(env, &node->scan);
-	FIND_NODE(custom_plans);
-	FIND_EXPRLIST(custom_exprs);
-	FIND_NODE(custom_private);
-	FIND_EXPRLIST(custom_scan_tlist);
-}
+NODE_OUTPUT(CustomScan)
+#endif
+NODE_OUTPUT(Join)
+NODE_OUTPUT(NestLoop)
+NODE_OUTPUT(MergeJoin)
+NODE_OUTPUT(HashJoin)
+NODE_OUTPUT(Agg)
+NODE_OUTPUT(WindowAgg)
+NODE_OUTPUT(Group)
+NODE_OUTPUT(Material)
+NODE_OUTPUT(Sort)
+NODE_OUTPUT(Unique)
+#if PG_VERSION_NUM >= 90600
+NODE_OUTPUT(Gather)
 #endif
-
-static void
-findJoin(NodeInfoEnv& env, const Join *node)
-{
-	findPlan(env, &node->plan);
-	FIND_EXPRLIST(joinqual);
-}
-
-static void
-findNestLoop(NodeInfoEnv& env, const NestLoop *node)
-{
-	findJoin(env, &node->join);
+#if PG_VERSION_NUM >= 100000
+NODE_OUTPUT(GatherMerge)
+#endif
+NODE_OUTPUT(Hash)
+NODE_OUTPUT(SetOp)
+NODE_OUTPUT(LockRows)
+NODE_OUTPUT(Limit)
 #if PG_VERSION_NUM >= 90100
-	FIND_NODE(nestParams); /* list of NestLoopParam */
+NODE_OUTPUT(NestLoopParam)
 #endif
-}
-
-static void
-findMergeJoin(NodeInfoEnv& env, const MergeJoin *node)
-{
-	findJoin(env, &node->join);
-	FIND_EXPRLIST(mergeclauses); /* list of OpExr */
-}
-
-static void
-findHashJoin(NodeInfoEnv& env, const HashJoin *node)
-{
-	findJoin(env, &node->join);
-	FIND_EXPRLIST(hashclauses);
+NODE_OUTPUT(PlanRowMark)
+#if PG_VERSION_NUM >= 110000
+NODE_OUTPUT(PartitionPruneInfo)
+NODE_OUTPUT(PartitionedRelPruneInfo)
+NODE_OUTPUT(PartitionPruneStepOp)
+NODE_OUTPUT(PartitionPruneStepCombine)
+#endif
+NODE_OUTPUT(PlanInvalItem)
+NODE_OUTPUT(Alias)
+NODE_OUTPUT(RangeVar)
+#if PG_VERSION_NUM >= 100000
+NODE_OUTPUT(TableFunc)
+#endif
+NODE_OUTPUT(IntoClause)
+NODE_OUTPUT(Var)
+NODE_OUTPUT(Const)
+NODE_OUTPUT(Param)
+NODE_OUTPUT(Aggref)
+#if PG_VERSION_NUM >= 90500
+NODE_OUTPUT(GroupingFunc)
+#endif
+NODE_OUTPUT(WindowFunc)
 #if PG_VERSION_NUM >= 120000
-	FIND_OIDLIST(hashoperators);
-	FIND_OIDLIST(hashcollations);
-	FIND_EXPRLIST(hashkeys);
-#endif	
-}
-
-static void
-findAgg(NodeInfoEnv& env, const Agg *node)
-{
-	findPlan(env, &node->plan);
+NODE_OUTPUT(SubscriptingRef)
+#else
+NODE_OUTPUT(ArrayRef)
+#endif
+NODE_OUTPUT(FuncExpr)
+NODE_OUTPUT(NamedArgExpr)
+NODE_OUTPUT(OpExpr)
+NODE_OUTPUT(DistinctExpr)
+NODE_OUTPUT(NullIfExpr)
+NODE_OUTPUT(ScalarArrayOpExpr)
+NODE_OUTPUT(BoolExpr)
+NODE_OUTPUT(SubLink)
+NODE_OUTPUT(SubPlan)
+NODE_OUTPUT(AlternativeSubPlan)
+NODE_OUTPUT(FieldSelect)
+NODE_OUTPUT(FieldStore)
+NODE_OUTPUT(RelabelType)
+NODE_OUTPUT(CoerceViaIO)
+NODE_OUTPUT(ArrayCoerceExpr)
+NODE_OUTPUT(ConvertRowtypeExpr)
+#if PG_VERSION_NUM >= 90100
+NODE_OUTPUT(CollateExpr)
+#endif
+NODE_OUTPUT(CaseExpr)
+NODE_OUTPUT(CaseWhen)
+NODE_OUTPUT(CaseTestExpr)
+NODE_OUTPUT(ArrayExpr)
+NODE_OUTPUT(RowExpr)
+NODE_OUTPUT(RowCompareExpr)
+NODE_OUTPUT(CoalesceExpr)
+NODE_OUTPUT(MinMaxExpr)
+#if PG_VERSION_NUM >= 100000
+NODE_OUTPUT(SQLValueFunction)
+#endif
+NODE_OUTPUT(XmlExpr)
+NODE_OUTPUT(NullTest)
+NODE_OUTPUT(BooleanTest)
+NODE_OUTPUT(CoerceToDomain)
+NODE_OUTPUT(CoerceToDomainValue)
+NODE_OUTPUT(SetToDefault)
+NODE_OUTPUT(CurrentOfExpr)
 #if PG_VERSION_NUM >= 90500
-	FIND_NODE(groupingSets);
-	FIND_NODE(chain);
+NODE_OUTPUT(InferenceElem)
 #endif
-}
-
-static void
-findWindowAgg(NodeInfoEnv& env, const WindowAgg *node)
-{
-	findPlan(env, &node->plan);
-	FIND_EXPRLIST(startOffset);
-	FIND_EXPRLIST(endOffset);
-}
-
-static void
-findGroup(NodeInfoEnv& env, const Group *node)
-{
-	findPlan(env, &node->plan);
-}
-
-static void
-findMaterial(NodeInfoEnv& env, const Material *node)
-{
-	findPlan(env, &node->plan);	
-}
+NODE_OUTPUT(TargetEntry)
+NODE_OUTPUT(RangeTblRef)
+NODE_OUTPUT(JoinExpr)
+NODE_OUTPUT(FromExpr)
+#if PG_VERSION_NUM >= 90500
+NODE_OUTPUT(OnConflictExpr)
+#endif
+#if PG_VERSION_NUM >= 100000
+NODE_OUTPUT(NextValueExpr)
+#endif
+NODE_OUTPUT(PlannerGlobal)
+NODE_OUTPUT(PlannerInfo)
+NODE_OUTPUT(RelOptInfo)
+NODE_OUTPUT(Query)
+NODE_OUTPUT(RangeTblEntry)
+#if PG_VERSION_NUM >= 90400
+NODE_OUTPUT(RangeTblFunction)
+#endif
+#if PG_VERSION_NUM >= 90500
+NODE_OUTPUT(TableSampleClause)
+#endif
+NODE_OUTPUT(SortGroupClause)
+#if PG_VERSION_NUM >= 90500
+NODE_OUTPUT(GroupingSet)
+#endif
+NODE_OUTPUT(WindowClause)
+NODE_OUTPUT(PlanState)
 
-static void
-findSort(NodeInfoEnv& env, const Sort *node)
-{
-	findPlan(env, &node->plan);	
-}
+/* All PlanState subtypes share outputPlanState() */
+#define NODE_DESC_STATE(type, fields) \
+	{T_##type, #type, fields, lengthof(fields), outputPlanStateDesc}
 
-static void
-findUnique(NodeInfoEnv& env, const Unique *node)
-{
-	findPlan(env, &node->plan);
-}
+/* Described by the field table alone, drawn by outputGenericNode() */
+#define NODE_DESC_GENERIC(type, fields) \
+	{T_##type, #type, fields, lengthof(fields), NULL}
 
+static const NodeDesc node_descs[] = {
+	/* Plan nodes */
+	NODE_DESC(PlannedStmt, PlannedStmtFields),
+	NODE_DESC(Plan, PlanFields),
+	NODE_DESC(Result, ResultFields),
+#if PG_VERSION_NUM >= 100000
+	NODE_DESC(ProjectSet, ProjectSetFields),
+#endif
+	NODE_DESC(ModifyTable, ModifyTableFields),
+	NODE_DESC(Append, AppendFields),
+#if PG_VERSION_NUM >= 90100
+	NODE_DESC(MergeAppend, MergeAppendFields),
+#endif
+	NODE_DESC(RecursiveUnion, RecursiveUnionFields),
+	NODE_DESC(BitmapAnd, BitmapAndFields),
+	NODE_DESC(BitmapOr, BitmapOrFields),
+	NODE_DESC(Scan, ScanFields),
+	NODE_DESC(SeqScan, SeqScanFields),
+#if PG_VERSION_NUM >= 90500
+	NODE_DESC(SampleScan, SampleScanFields),
+#endif
+	NODE_DESC(IndexScan, IndexScanFields),
+#if PG_VERSION_NUM >= 90200
+	NODE_DESC(IndexOnlyScan, IndexOnlyScanFields),
+#endif
+	NODE_DESC(BitmapIndexScan, BitmapIndexScanFields),
+	NODE_DESC(BitmapHeapScan, BitmapHeapScanFields),
+	NODE_DESC(TidScan, TidScanFields),
+	NODE_DESC(SubqueryScan, SubqueryScanFields),
+	NODE_DESC(FunctionScan, FunctionScanFields),
+	NODE_DESC(ValuesScan, ValuesScanFields),
+#if PG_VERSION_NUM >= 100000
+	NODE_DESC(TableFuncScan, TableFuncScanFields),
+#endif
+	NODE_DESC(CteScan, CteScanFields),
+#if PG_VERSION_NUM >= 100000
+	NODE_DESC(NamedTuplestoreScan, NamedTuplestoreScanFields),
+#endif
+	NODE_DESC(WorkTableScan, WorkTableScanFields),
+#if PG_VERSION_NUM >= 90100
+	NODE_DESC(ForeignScan, ForeignScanFields),
+#endif
+#if PG_VERSION_NUM >= 90500
+	NODE_DESC(CustomScan, CustomScanFields),
+#endif
+	NODE_DESC(Join, JoinFields),
+	NODE_DESC(NestLoop, NestLoopFields),
+	NODE_DESC(MergeJoin, MergeJoinFields),
+	NODE_DESC(HashJoin, HashJoinFields),
+	NODE_DESC(Agg, AggFields),
+	NODE_DESC(WindowAgg, WindowAggFields),
+	NODE_DESC(Group, GroupFields),
+	NODE_DESC(Material, MaterialFields),
+	NODE_DESC(Sort, SortFields),
+	NODE_DESC(Unique, UniqueFields),
 #if PG_VERSION_NUM >= 90600
-static void
-findGather(NodeInfoEnv& env, const Gather *node)
-{
-	findPlan(env, &node->plan);
-}
+	NODE_DESC(Gather, GatherFields),
 #endif
-
 #if PG_VERSION_NUM >= 100000
-static void
-findGatherMerge(NodeInfoEnv& env, const GatherMerge *node)
-{
-	findPlan(env, &node->plan);
-}
+	NODE_DESC(GatherMerge, GatherMergeFields),
 #endif
-
-static void
-findHash(NodeInfoEnv& env, const Hash *node)
-{
-	findPlan(env, &node->plan);
-
-#if PG_VERSION_NUM >= 120000
-	FIND_EXPRLIST(hashkeys);
-#endif		
-}
-
-static void
-findSetOp(NodeInfoEnv& env, const SetOp *node)
-{
-	findPlan(env, &node->plan);
-}
-
-static void
-findLockRows(NodeInfoEnv& env, const LockRows *node)
-{
-	findPlan(env, &node->plan);
-	FIND_NODE(rowMarks);
-}
-
-static void
-findLimit(NodeInfoEnv& env, const Limit *node)
-{
-	findPlan(env, &node->plan);
-	FIND_EXPRLIST(limitOffset);
-	FIND_EXPRLIST(limitCount);
-}
-
+	NODE_DESC(Hash, HashFields),
+	NODE_DESC(SetOp, SetOpFields),
+	NODE_DESC(LockRows, LockRowsFields),
+	NODE_DESC(Limit, LimitFields),
 #if PG_VERSION_NUM >= 90100
-static void
-findNestLoopParam(NodeInfoEnv& env, const NestLoopParam *node)
-{
-	FIND_NODE(paramval);
-}
+	NODE_DESC(NestLoopParam, NestLoopParamFields),
 #endif
-
-static void
-findPlanRowMark(NodeInfoEnv& env, const PlanRowMark *node)
-{
-	/* nothing */
-}
-
+	NODE_DESC_LEAF(PlanRowMark),
 #if PG_VERSION_NUM >= 110000
-static void
-findPartitionPruneInfo(NodeInfoEnv& env, const PartitionPruneInfo *node)
-{
-	FIND_NODE(prune_infos);
-}
+	NODE_DESC(PartitionPruneInfo, PartitionPruneInfoFields),
+	NODE_DESC(PartitionedRelPruneInfo, PartitionedRelPruneInfoFields),
+	NODE_DESC(PartitionPruneStepOp, PartitionPruneStepOpFields),
+	NODE_DESC_LEAF(PartitionPruneStepCombine),
+#endif
+	NODE_DESC_LEAF(PlanInvalItem),
 
-static void
-findPartitionedRelPruneInfo(NodeInfoEnv& env, const PartitionedRelPruneInfo *node)
-{
+	/* Primitive nodes */
+	NODE_DESC(Alias, AliasFields),
+	NODE_DESC_LEAF(RangeVar),
+#if PG_VERSION_NUM >= 100000
+	NODE_DESC(TableFunc, TableFuncFields),
+#endif
+	NODE_DESC(IntoClause, IntoClauseFields),
+	NODE_DESC_LEAF(Var),
+	NODE_DESC_LEAF(Const),
+	NODE_DESC_LEAF(Param),
+	NODE_DESC(Aggref, AggrefFields),
+#if PG_VERSION_NUM >= 90500
+	NODE_DESC(GroupingFunc, GroupingFuncFields),
+#endif
+	NODE_DESC(WindowFunc, WindowFuncFields),
 #if PG_VERSION_NUM >= 120000
+	NODE_DESC(SubscriptingRef, SubscriptingRefFields),
 #else
-	FIND_NODE(pruning_steps);
+	NODE_DESC(ArrayRef, ArrayRefFields),
+#endif
+	NODE_DESC(FuncExpr, FuncExprFields),
+	NODE_DESC(NamedArgExpr, NamedArgExprFields),
+	NODE_DESC(OpExpr, OpExprFields),
+	NODE_DESC(DistinctExpr, DistinctExprFields),
+	NODE_DESC(NullIfExpr, NullIfExprFields),
+	NODE_DESC(ScalarArrayOpExpr, ScalarArrayOpExprFields),
+	NODE_DESC(BoolExpr, BoolExprFields),
+	NODE_DESC(SubLink, SubLinkFields),
+	NODE_DESC(SubPlan, SubPlanFields),
+	NODE_DESC(AlternativeSubPlan, AlternativeSubPlanFields),
+	NODE_DESC(FieldSelect, FieldSelectFields),
+	NODE_DESC(FieldStore, FieldStoreFields),
+	NODE_DESC(RelabelType, RelabelTypeFields),
+	NODE_DESC(CoerceViaIO, CoerceViaIOFields),
+	NODE_DESC(ArrayCoerceExpr, ArrayCoerceExprFields),
+	NODE_DESC(ConvertRowtypeExpr, ConvertRowtypeExprFields),
+#if PG_VERSION_NUM >= 90100
+	NODE_DESC(CollateExpr, CollateExprFields),
+#endif
+	NODE_DESC(CaseExpr, CaseExprFields),
+	NODE_DESC(CaseWhen, CaseWhenFields),
+	NODE_DESC_LEAF(CaseTestExpr),
+	NODE_DESC(ArrayExpr, ArrayExprFields),
+	NODE_DESC(RowExpr, RowExprFields),
+	NODE_DESC(RowCompareExpr, RowCompareExprFields),
+	NODE_DESC(CoalesceExpr, CoalesceExprFields),
+	NODE_DESC(MinMaxExpr, MinMaxExprFields),
+#if PG_VERSION_NUM >= 100000
+	NODE_DESC_LEAF(SQLValueFunction),
+#endif
+	NODE_DESC(XmlExpr, XmlExprFields),
+	NODE_DESC(NullTest, NullTestFields),
+	NODE_DESC(BooleanTest, BooleanTestFields),
+	NODE_DESC(CoerceToDomain, CoerceToDomainFields),
+	NODE_DESC_LEAF(CoerceToDomainValue),
+	NODE_DESC_LEAF(SetToDefault),
+	NODE_DESC_LEAF(CurrentOfExpr),
+#if PG_VERSION_NUM >= 90500
+	NODE_DESC(InferenceElem, InferenceElemFields),
 #endif
-
-#if PG_VERSION_NUM >= 120000
-	FIND_NODE(initial_pruning_steps);
-	FIND_NODE(exec_pruning_steps);
+	NODE_DESC(TargetEntry, TargetEntryFields),
+	NODE_DESC_LEAF(RangeTblRef),
+	NODE_DESC(JoinExpr, JoinExprFields),
+	NODE_DESC(FromExpr, FromExprFields),
+#if PG_VERSION_NUM >= 90500
+	NODE_DESC(OnConflictExpr, OnConflictExprFields),
 #endif
-}
-
-static void
-findPartitionPruneStepOp(NodeInfoEnv& env, const PartitionPruneStepOp *node)
-{
-	FIND_NODE(exprs);
-	FIND_NODE(cmpfns);
-}
-
-static void
-findPartitionPruneStepCombine(NodeInfoEnv& env, const PartitionPruneStepCombine *node)
-{
-	/* nothing */	
-}
+#if PG_VERSION_NUM >= 100000
+	NODE_DESC_LEAF(NextValueExpr),
 #endif
 
-static void
-findPlanInvalItem(NodeInfoEnv& env, const PlanInvalItem *node)
-{
-	/* nothing */
-}
-
-static void
-findAlias(NodeInfoEnv& env, const Alias *node)
-{
-	FIND_NODE(colnames);
-}
+	/* Planner nodes */
+	NODE_DESC(PlannerGlobal, PlannerGlobalFields),
+	NODE_DESC(PlannerInfo, PlannerInfoFields),
+	NODE_DESC(RelOptInfo, RelOptInfoFields),
 
-static void
-findIntoClause(NodeInfoEnv& env, const IntoClause *node)
-{
-	FIND_NODE(rel);
-	FIND_NODE(colNames);
-	FIND_NODE(options);
-#if PG_VERSION_NUM >= 90300
-	FIND_NODE(viewQuery);
+	/* Parse tree nodes */
+	NODE_DESC(Query, QueryFields),
+	NODE_DESC(RangeTblEntry, RangeTblEntryFields),
+#if PG_VERSION_NUM >= 90400
+	NODE_DESC(RangeTblFunction, RangeTblFunctionFields),
 #endif
-}
-
-static void
-findRangeVar(NodeInfoEnv& env, const RangeVar *node)
-{
-	/* nothing */
-}
+#if PG_VERSION_NUM >= 90500
+	NODE_DESC(TableSampleClause, TableSampleClauseFields),
+#endif
+	NODE_DESC_LEAF(SortGroupClause),
+#if PG_VERSION_NUM >= 90500
+	NODE_DESC(GroupingSet, GroupingSetFields),
+#endif
+	NODE_DESC(WindowClause, WindowClauseFields),
 
+	/* Executor state nodes */
+	NODE_DESC_STATE(ResultState, PlanStateFields),
 #if PG_VERSION_NUM >= 100000
-static void
-findTableFunc(NodeInfoEnv& env, const TableFunc *node)
-{
-	FIND_NODE(ns_uris);
-	FIND_NODE(ns_names);
-	FIND_NODE(docexpr);
-	FIND_NODE(rowexpr);
-	FIND_NODE(colnames);
-	FIND_NODE(coltypes);
-	FIND_NODE(coltypmods);
-	FIND_NODE(colcollations);
-	FIND_NODE(colexprs);
-	FIND_NODE(coldefexprs);
-}
+	NODE_DESC_STATE(ProjectSetState, PlanStateFields),
+#endif
+	NODE_DESC_STATE(ModifyTableState, ModifyTableStateFields),
+	NODE_DESC_STATE(AppendState, AppendStateFields),
+#if PG_VERSION_NUM >= 90100
+	NODE_DESC_STATE(MergeAppendState, MergeAppendStateFields),
+#endif
+	NODE_DESC_STATE(RecursiveUnionState, PlanStateFields),
+	NODE_DESC_STATE(BitmapAndState, BitmapAndStateFields),
+	NODE_DESC_STATE(BitmapOrState, BitmapOrStateFields),
+	NODE_DESC_STATE(SeqScanState, PlanStateFields),
+#if PG_VERSION_NUM >= 90500
+	NODE_DESC_STATE(SampleScanState, PlanStateFields),
+#endif
+	NODE_DESC_STATE(IndexScanState, PlanStateFields),
+#if PG_VERSION_NUM >= 90200
+	NODE_DESC_STATE(IndexOnlyScanState, PlanStateFields),
+#endif
+	NODE_DESC_STATE(BitmapIndexScanState, PlanStateFields),
+	NODE_DESC_STATE(BitmapHeapScanState, PlanStateFields),
+	NODE_DESC_STATE(TidScanState, PlanStateFields),
+	NODE_DESC_STATE(SubqueryScanState, SubqueryScanStateFields),
+	NODE_DESC_STATE(FunctionScanState, PlanStateFields),
+#if PG_VERSION_NUM >= 100000
+	NODE_DESC_STATE(TableFuncScanState, PlanStateFields),
+#endif
+	NODE_DESC_STATE(ValuesScanState, PlanStateFields),
+	NODE_DESC_STATE(CteScanState, PlanStateFields),
+#if PG_VERSION_NUM >= 100000
+	NODE_DESC_STATE(NamedTuplestoreScanState, PlanStateFields),
+#endif
+	NODE_DESC_STATE(WorkTableScanState, PlanStateFields),
+#if PG_VERSION_NUM >= 90100
+	NODE_DESC_STATE(ForeignScanState, PlanStateFields),
+#endif
+#if PG_VERSION_NUM >= 90500
+	NODE_DESC_STATE(CustomScanState, CustomScanStateFields),
+#endif
+	NODE_DESC_STATE(NestLoopState, JoinStateFields),
+	NODE_DESC_STATE(MergeJoinState, JoinStateFields),
+	NODE_DESC_STATE(HashJoinState, JoinStateFields),
+	NODE_DESC_STATE(MaterialState, PlanStateFields),
+	NODE_DESC_STATE(SortState, PlanStateFields),
+	NODE_DESC_STATE(GroupState, PlanStateFields),
+	NODE_DESC_STATE(AggState, PlanStateFields),
+	NODE_DESC_STATE(WindowAggState, PlanStateFields),
+	NODE_DESC_STATE(UniqueState, PlanStateFields),
+#if PG_VERSION_NUM >= 90600
+	NODE_DESC_STATE(GatherState, PlanStateFields),
+#endif
+#if PG_VERSION_NUM >= 100000
+	NODE_DESC_STATE(GatherMergeState, PlanStateFields),
 #endif
+	NODE_DESC_STATE(HashState, PlanStateFields),
+	NODE_DESC_STATE(SetOpState, PlanStateFields),
+	NODE_DESC_STATE(LockRowsState, PlanStateFields),
+	NODE_DESC_STATE(LimitState, PlanStateFields),
+	NODE_DESC_GENERIC(SubPlanState, SubPlanStateFields),
+#if PG_VERSION_NUM >= 100000
+	NODE_DESC_GENERIC(ExprState, ExprStateFields),
+#endif
+};
 
-static void
-findVar(NodeInfoEnv& env, const Var *node)
-{
-	/* nothing */
-}
+static const NodeDesc **node_desc_index = NULL;
+static int				node_desc_index_size = 0;
 
-static void
-findConst(NodeInfoEnv& env, const Const *node)
+/*
+ * Returns the descriptor of the given node tag, or NULL if the walker
+ * doesn't know the node type.  The tag-indexed array is built on first use
+ * and lives for the life of the backend.
+ */
+static const NodeDesc *
+lookupNodeDesc(NodeTag tag)
 {
-	/* nothing */
-}
+	if (node_desc_index == NULL)
+	{
+		const NodeDesc **index;
+		int		size = 0;
+		int		i;
 
-static void
-findParam(NodeInfoEnv& env, const Param *node)
-{
-	/* nothing */
-}
+		for (i = 0 ; i < (int) lengthof(node_descs) ; i++)
+			if ((int) node_descs[i].tag >= size)
+				size = (int) node_descs[i].tag + 1;
 
-static void
-findAggref(NodeInfoEnv& env, const Aggref *node)
-{
-#if PG_VERSION_NUM >= 90400
-	FIND_NODE(aggdirectargs);
-#endif
-	FIND_NODE(args);
-	FIND_NODE(aggorder);
-	FIND_NODE(aggdistinct);
-#if PG_VERSION_NUM >= 90400
-	FIND_NODE(aggfilter);
-#endif
-}
+		index = (const NodeDesc **) MemoryContextAllocZero(TopMemoryContext,
+														   sizeof(NodeDesc *) * size);
 
-#if PG_VERSION_NUM >= 90500
-static void
-findGroupingFunc(NodeInfoEnv& env, const GroupingFunc *node)
-{
-	FIND_NODE(args);
-	FIND_NODE(refs);
-	FIND_NODE(cols);
-}
-#endif
+		for (i = 0 ; i < (int) lengthof(node_descs) ; i++)
+			index[node_descs[i].tag] = &node_descs[i];
+
+		node_desc_index_size = size;
+		node_desc_index = index;
+	}
+
+	if ((int) tag < 0 || (int) tag >= node_desc_index_size)
+		return NULL;
 
-static void
-findWindowFunc(NodeInfoEnv& env, const WindowFunc *node)
-{
-	FIND_NODE(args);
+	return node_desc_index[tag];
 }
 
-#if PG_VERSION_NUM >= 120000
-
+/*
+ * Writes a port for every child field of obj that is set, and for every
+ * element of its array fields.
+ */
 static void
-findSubscriptingRef(NodeInfoEnv& env, const SubscriptingRef *node)
+outputFieldPorts(NodeInfoEnv& env, const NodeDesc *desc, const void *obj)
 {
-	FIND_NODE(refupperindexpr);
-	FIND_NODE(reflowerindexpr);
-	FIND_NODE(refexpr);
-	FIND_NODE(refassgnexpr);
-}
+	int i, j;
 
-#else
+	for (i = 0 ; i < desc->num_fields ; i++)
+	{
+		const FieldDesc *field = &desc->fields[i];
+		const void *child = *reinterpret_cast<void * const *>(reinterpret_cast<const char *>(obj) + field->offset);
 
-static void
-findArrayRef(NodeInfoEnv& env, const ArrayRef *node)
-{
-	FIND_NODE(refupperindexpr);
-	FIND_NODE(reflowerindexpr);
-	FIND_NODE(refexpr);
-	FIND_NODE(refassgnexpr);
-}
+		if (child == NULL)
+			continue;
 
-#endif
+		if (field->kind == FIELD_ARRAY)
+		{
+			const void * const *array = reinterpret_cast<const void * const *>(child);
+			int count = *reinterpret_cast<const int *>(reinterpret_cast<const char *>(obj) + field->count_offset);
 
-static void
-findFuncExpr(NodeInfoEnv& env, const FuncExpr *node)
-{
-	FIND_NODE(args);
+			for (j = field->first_index ; j < count ; j++)
+				env.outputNodeIndex(field->name, j, obj, array[j]);
+		}
+		else
+			env.outputNode(field->name, obj, child);
+	}
 }
 
+/*
+ * Label writer for node types that have a descriptor but no outputXxx():
+ * shows the node name and a port for every child field.
+ */
 static void
-findNamedArgExpr(NodeInfoEnv& env, const NamedArgExpr *node)
+outputGenericNode(NodeInfoEnv& env, const NodeDesc *desc, const void *obj)
 {
-	FIND_NODE(arg);
+	env.pushNode(obj, desc->name);
+	outputFieldPorts(env, desc, obj);
+	env.popNode();
 }
 
-static void
-findOpExpr(NodeInfoEnv& env, const OpExpr *node)
+char *
+get_plan_tree_dot_string(const char *title, const void *obj, bool simplify)
 {
-	FIND_NODE(args);
-}
+	PlanTreeDotOptions options;
 
-static void 
-findDistinctExpr(NodeInfoEnv& env, const DistinctExpr *node)
-{
-	FIND_NODE(args);
-}
+	memset(&options, 0, sizeof(options));
+	options.simplify = simplify;
 
-static void
-findNullIfExpr(NodeInfoEnv& env, const NullIfExpr *node)
-{
-	FIND_NODE(args);
+	return get_plan_tree_dot_string_ext(title, obj, &options);
 }
 
-static void
-findScalarArrayOpExpr(NodeInfoEnv& env, const ScalarArrayOpExpr *node)
+char *
+get_plan_tree_dot_string_ext(const char *title, const void *obj, const PlanTreeDotOptions *options)
 {
-	FIND_NODE(args);
-}
+	char *buffer = NULL;
+	bool interrupted = false;
+	PlanTreeDotStats *stats = options->stats;
+	MemoryContext callercontext = CurrentMemoryContext;
+	MemoryContext rendercontext;
 
-static void
-findBoolExpr(NodeInfoEnv& env, const BoolExpr *node)
-{
-	FIND_NODE(args);
-}
+retry:
 
-static void
-findSubLink(NodeInfoEnv& env, const SubLink *node)
-{
-	FIND_NODE(testexpr);
-	FIND_NODE(operName);
-	FIND_NODE(subselect);
-}
+	/*
+	 * The containers are allocated in a context of their own, so that they
+	 * are freed at once and the memory they take can be measured.
+	 */
+	rendercontext = AllocSetContextCreate(callercontext,
+										  "plan tree rendering context",
+										  ALLOCSET_DEFAULT_MINSIZE,
+										  ALLOCSET_DEFAULT_INITSIZE,
+										  ALLOCSET_DEFAULT_MAXSIZE);
 
-static void
-findSubPlan(NodeInfoEnv& env, const SubPlan *node)
-{
-	FIND_NODE(testexpr);
-	FIND_NODE(paramIds);
-	FIND_NODE(setParam);
-	FIND_NODE(parParam);
-	FIND_NODE(args);
-}
+	MemoryContextSwitchTo(rendercontext);
 
-static void
-findAlternativeSubPlan(NodeInfoEnv& env, const AlternativeSubPlan *node)
-{
-	FIND_NODE(subplans); /* list of plans */
-}
+	try
+	{
+		NodeInfoEnv env(title, *options);
+		instr_time starttime, duration;
 
-static void
-findFieldSelect(NodeInfoEnv& env, const FieldSelect *node)
-{
-	FIND_NODE(arg);
-}
+		if (obj != NULL && IsA(obj, PlannedStmt))
+			env.setRangeTable(reinterpret_cast<const PlannedStmt *>(obj)->rtable);
 
-static void
-findFieldStore(NodeInfoEnv& env, const FieldStore *node)
-{
-	FIND_NODE(arg);
-	FIND_NODE(newvals);
-	FIND_NODE(fieldnums);
-}
+		INSTR_TIME_SET_CURRENT(starttime);
+		findNode(env, NULL, NULL, obj);
+		INSTR_TIME_SET_CURRENT(duration);
+		INSTR_TIME_SUBTRACT(duration, starttime);
 
-static void
-findRelabelType(NodeInfoEnv& env, const RelabelType *node)
-{
-	FIND_NODE(arg);
-}
+		if (stats)
+		{
+			stats->walk_ms		= INSTR_TIME_GET_MILLISEC(duration);
+			stats->walk_bytes	= memory_context_total_space(rendercontext);
+		}
 
-static void
-findCoerceViaIO(NodeInfoEnv& env, const CoerceViaIO *node)
-{
-	FIND_NODE(arg);
-}
+		INSTR_TIME_SET_CURRENT(starttime);
+		if (options->format == PLAN_TREE_FORMAT_HTML)
+			env.outputHtml();
+		else
+			env.outputAllNodes();
+		INSTR_TIME_SET_CURRENT(duration);
+		INSTR_TIME_SUBTRACT(duration, starttime);
 
-static void
-findArrayCoerceExpr(NodeInfoEnv& env, const ArrayCoerceExpr *node)
-{
-	FIND_NODE(arg);
-	
-#if PG_VERSION_NUM >= 110000
-	FIND_NODE(elemexpr);
-#endif
-}
+		if (stats)
+		{
+			stats->label_ms		= INSTR_TIME_GET_MILLISEC(duration);
+			stats->peak_bytes	= Max(stats->walk_bytes, memory_context_total_space(rendercontext));
+			stats->num_nodes	= env.numNodes();
+			stats->num_edges	= env.numEdges();
+			stats->output_bytes	= strlen(env.c_str());
+		}
+		
+		buffer = MemoryContextStrdup(callercontext, env.c_str());
+	}
+	catch (const InterruptRequest&)
+	{
+		interrupted = true;
+	}
+	catch (...)
+	{
+		elog(ERROR, "fatal error in _nodeToString");
+	}
 
-static void
-findConvertRowtypeExpr(NodeInfoEnv& env, const ConvertRowtypeExpr *node)
-{
-	FIND_NODE(arg);
-}
+	MemoryContextSwitchTo(callercontext);
+	MemoryContextDelete(rendercontext);
 
-#if PG_VERSION_NUM >= 90100
-static void
-findCollateExpr(NodeInfoEnv& env, const CollateExpr *node)
-{
-	FIND_NODE(arg);
-}
-#endif
+	/*
+	 * Service the pending interrupt only after the C++ objects above have
+	 * been destroyed, since ereport() longjmps over destructors.
+	 */
+	if (interrupted)
+	{
+		CHECK_FOR_INTERRUPTS();
+		interrupted = false;
+		goto retry;
+	}
 
-static void
-findCaseExpr(NodeInfoEnv& env, const CaseExpr *node)
-{
-	FIND_NODE(arg);
-	FIND_NODE(args);
-	FIND_NODE(defresult);
+	return buffer;
 }
 
-static void
-findCaseWhen(NodeInfoEnv& env, const CaseWhen *node)
+/*
+ * A walked plan tree whose labels are written on request.
+ */
+struct PlanTreeIndex
 {
-	FIND_NODE(expr);
-	FIND_NODE(result);
-}
+	NodeInfoEnv	   *env;
+	NodeList	   *nodes;		/* the node with id n is at n - 1 */
+};
 
-static void
-findCaseTestExpr(NodeInfoEnv& env, const CaseTestExpr *node)
+/*
+ * Walks obj and returns its index, allocated in CurrentMemoryContext.  obj
+ * must live as long as that context, and the index is freed with it; the
+ * destructors never need to run.
+ */
+PlanTreeIndex *
+open_plan_tree_index(const void *obj, const PlanTreeDotOptions *options)
 {
-	/* nothing */
-}
+	PlanTreeIndex *index;
+	bool interrupted = false;
 
-static void
-findArrayExpr(NodeInfoEnv& env, const ArrayExpr *node)
-{
-	FIND_NODE(elements);
-}
+	index = (PlanTreeIndex *) palloc0(sizeof(PlanTreeIndex));
 
-static void
-findRowExpr(NodeInfoEnv& env, const RowExpr *node)
-{
-	FIND_NODE(args);
-	FIND_NODE(colnames);
-}
+retry:
+	try
+	{
+		index->env = new (palloc(sizeof(NodeInfoEnv))) NodeInfoEnv("", *options);
 
-static void
-findRowCompareExpr(NodeInfoEnv& env, const RowCompareExpr *node)
-{
-	FIND_NODE(opnos);
-	FIND_NODE(opfamilies);
-#if PG_VERSION_NUM >= 90100
-	FIND_NODE(inputcollids);
-#endif
-	FIND_NODE(largs);
-	FIND_NODE(rargs);
-}
+		if (obj != NULL && IsA(obj, PlannedStmt))
+			index->env->setRangeTable(reinterpret_cast<const PlannedStmt *>(obj)->rtable);
 
-static void
-findCoalesceExpr(NodeInfoEnv& env, const CoalesceExpr *node)
-{
-	FIND_NODE(args);
-}
+		findNode(*index->env, NULL, NULL, obj);
 
-static void
-findMinMaxExpr(NodeInfoEnv& env, const MinMaxExpr *node)
-{
-	FIND_NODE(args);
-}
+		index->nodes = new (palloc(sizeof(NodeList))) NodeList();
+		index->env->collectNodes(*index->nodes);
+	}
+	catch (const InterruptRequest&)
+	{
+		interrupted = true;
+	}
+	catch (...)
+	{
+		elog(ERROR, "fatal error in open_plan_tree_index");
+	}
 
-#if PG_VERSION_NUM >= 100000
-static void
-findSQLValueFunction(NodeInfoEnv& env, const SQLValueFunction *node)
-{
-	/* nothing */
-}
-#endif
+	if (interrupted)
+	{
+		/* What the interrupted walk allocated is freed with the context */
+		CHECK_FOR_INTERRUPTS();
+		interrupted = false;
+		goto retry;
+	}
 
-static void
-findXmlExpr(NodeInfoEnv& env, const XmlExpr *node)
-{
-	FIND_NODE(named_args);
-	FIND_NODE(arg_names);
-	FIND_NODE(args);
+	return index;
 }
 
-static void
-findNullTest(NodeInfoEnv& env, const NullTest *node)
+int
+get_plan_tree_index_size(const PlanTreeIndex *index)
 {
-	FIND_NODE(arg);
+	return (int) index->nodes->size();
 }
 
-static void
-findBooleanTest(NodeInfoEnv& env, const BooleanTest *node)
+/*
+ * Returns the record label of a node in CurrentMemoryContext, or NULL if
+ * there is no node with that id.
+ */
+char *
+get_plan_tree_node_label(PlanTreeIndex *index, int node_id)
 {
-	FIND_NODE(arg);
-}
+	char *result = NULL;
+	bool interrupted = false;
 
-static void
-findCoerceToDomain(NodeInfoEnv& env, const CoerceToDomain *node)
-{
-	FIND_NODE(arg);
-}
+	if (node_id < 1 || node_id > (int) index->nodes->size())
+		return NULL;
 
-static void
-findCoerceToDomainValue(NodeInfoEnv& env, const CoerceToDomainValue *node)
-{
-	/* nothing */
-}
+retry:
+	try
+	{
+		result = pstrdup(index->env->nodeLabel((*index->nodes)[node_id - 1]));
+	}
+	catch (const InterruptRequest&)
+	{
+		interrupted = true;
+	}
+	catch (...)
+	{
+		elog(ERROR, "fatal error in get_plan_tree_node_label");
+	}
 
-static void
-findSetToDefault(NodeInfoEnv& env, const SetToDefault *node)
-{
-	/* nothing */
-}
+	if (interrupted)
+	{
+		CHECK_FOR_INTERRUPTS();
+		interrupted = false;
+		goto retry;
+	}
 
-static void
-findCurrentOfExpr(NodeInfoEnv& env, const CurrentOfExpr *node)
-{
-	/* nothing */
+	return result;
 }
 
-#if PG_VERSION_NUM >= 90500
-static void
-findInferenceElem(NodeInfoEnv& env, const InferenceElem *node)
+/*
+ * Returns the edges leaving a node in CurrentMemoryContext, or NULL if there
+ * is no node with that id.
+ */
+PlanTreeDotEdge *
+get_plan_tree_node_edges(PlanTreeIndex *index, int node_id, int *num_edges)
 {
-	FIND_NODE(expr);
-}
-#endif
+	PlanTreeDotEdge *result = NULL;
 
-static void
-findTargetEntry(NodeInfoEnv& env, const TargetEntry *node)
-{
-	FIND_NODE(expr);
-}
+	*num_edges = 0;
 
-static void
-findRangeTblRef(NodeInfoEnv& env, const RangeTblRef *node)
-{
-	/* nothing */
-}
+	if (node_id < 1 || node_id > (int) index->nodes->size())
+		return NULL;
 
-static void
-findJoinExpr(NodeInfoEnv& env, const JoinExpr *node)
-{
-	FIND_NODE(larg);
-	FIND_NODE(rarg);
-	FIND_NODE(larg);
-	FIND_NODE(usingClause);
-	FIND_NODE(quals);
-	FIND_NODE(alias);
+	try
+	{
+		EdgeList edges;
+		EdgeList::const_iterator edge_it;
+		int n = 0;
+
+		index->env->collectEdges((*index->nodes)[node_id - 1], edges);
+
+		result = (PlanTreeDotEdge *) palloc0(sizeof(PlanTreeDotEdge) * (edges.size() + 1));
+
+		for (edge_it = edges.begin() ; edge_it != edges.end() ; edge_it++)
+		{
+			result[n].from	= node_id;
+			result[n].to	= (int) index->env->nodeId((**edge_it).first.second);
+			result[n].field	= pstrdup((**edge_it).second.c_str());
+			n++;
+		}
+
+		*num_edges = n;
+	}
+	catch (...)
+	{
+		elog(ERROR, "fatal error in get_plan_tree_node_edges");
+	}
+
+	return result;
 }
 
-static void
-findFromExpr(NodeInfoEnv& env, const FromExpr *node)
+/*
+ * Returns the type name the graph uses for a node, such as "SeqScan".
+ */
+const char *
+get_plan_node_type_name(const void *node)
 {
-	FIND_NODE(fromlist);
-	FIND_NODE(quals);
+	const NodeDesc *desc = lookupNodeDesc(nodeTag(node));
+
+	return desc ? desc->name : "Unknown";
 }
 
-#if PG_VERSION_NUM >= 90500
-static void
-findOnConflictExpr(NodeInfoEnv& env, const OnConflictExpr *node)
+/*
+ * Returns the PlanState nodes reachable from planstate, in the order the
+ * walker visits them (the root first), each with the index of the nearest
+ * PlanState above it.  Subplans and init plans are reached through their
+ * SubPlanState, just as in the graph.
+ */
+PlanStateNodeInfo *
+get_plan_state_nodes(const void *planstate, int *num_nodes)
 {
-	FIND_NODE(arbiterElems);
-	FIND_NODE(arbiterWhere);
-	FIND_NODE(onConflictSet);
-	FIND_NODE(onConflictWhere);
-	FIND_NODE(exclRelTlist);
+	PlanStateNodeInfo *result = NULL;
+	bool interrupted = false;
+
+	*num_nodes = 0;
+
+retry:
+	try
+	{
+		PlanTreeDotOptions options;
+
+		memset(&options, 0, sizeof(options));
+
+		NodeInfoEnv env("", options);
+
+		findNode(env, NULL, NULL, planstate);
+		result = env.collectPlanStates(num_nodes);
+	}
+	catch (const InterruptRequest&)
+	{
+		interrupted = true;
+	}
+	catch (...)
+	{
+		elog(ERROR, "fatal error in get_plan_state_nodes");
+	}
+
+	if (interrupted)
+	{
+		CHECK_FOR_INTERRUPTS();
+		interrupted = false;
+		goto retry;
+	}
+
+	return result;
 }
-#endif
 
-#if PG_VERSION_NUM >= 100000
-static void
-findNextValueExpr(NodeInfoEnv& env, const NextValueExpr *node)
+
+/****************************************************************************/
+/*                                                                          */
+/****************************************************************************/
+/*
+ * The walker keeps pending visits on an explicit stack rather than the C
+ * stack, so that long lists (e.g. IN (...) with 100k elements) and deeply
+ * nested expressions (long OR chains) can't overflow it.  Children are
+ * pushed in reverse order, which makes the visiting order, and therefore
+ * the node numbering, the same as a recursive depth-first walk.
+ */
+typedef struct FindItem
 {
-	/* nothing */	
-}
-#endif
+	const void *parent;
+	const char *fldname;		/* NULL for List members */
+	int			list_index;		/* 1-based position of a List member, index
+								 * of an array element, or -1 */
+	const void *obj;
+	bool		from_tlist;
+} FindItem;
+
+typedef std::vector<FindItem, PallocAllocator<FindItem> > FindStack;
+
+/* Check for query cancel once per this many visited nodes */
+#define INTERRUPT_CHECK_INTERVAL	1024
 
 static void
-findPlannerGlobal(NodeInfoEnv& env, const PlannerGlobal *node)
+pushFindItem(FindStack& stack, const void *parent, const char *fldname, int list_index, const void *obj, bool from_tlist)
 {
-#if PG_VERSION_NUM < 90300
-	FIND_NODE(paramlist);
-#endif
-	FIND_NODE(subplans);
-#if PG_VERSION_NUM >= 90200
-	FIND_NODE(subroots);
-#else
-	FIND_NODE(subrtables);
-	FIND_NODE(subrowmarks);
-#endif
-	FIND_NODE(finalrtable);
-	FIND_NODE(finalrowmarks);
-#if PG_VERSION_NUM >= 90100
-	FIND_NODE(resultRelations);
-#endif
-	FIND_NODE(relationOids);
-	FIND_NODE(invalItems);
+	FindItem item;
+
+	item.parent		= parent;
+	item.fldname	= fldname;
+	item.list_index	= list_index;
+	item.obj		= obj;
+	item.from_tlist	= from_tlist;
+
+	stack.push_back(item);
 }
 
 static void
-findPlannerInfo(NodeInfoEnv& env, const PlannerInfo *node)
+findNode(NodeInfoEnv& env, const void *parent, const char *fldname, const void *obj, bool from_tlist)
 {
-	int i;
+	FindStack	stack;
+	uint32		visits = 0;
+
+	pushFindItem(stack, parent, fldname, -1, obj, from_tlist);
+
+	while (!stack.empty())
+	{
+		FindItem	item = stack.back();
+		const void *cur = item.obj;
+		const NodeDesc *desc;
+		size_t		base;
+		int			i;
+
+		stack.pop_back();
+
+		if ((++visits % INTERRUPT_CHECK_INTERVAL) == 0)
+			checkInterrupts();
+
+		if (cur == NULL)
+			continue;
+
+		if (env.hasNode(cur))
+			continue;
+
+		env.registerNode(cur);
+
+		if (item.parent)
+		{
+			if (item.fldname && item.list_index < 0)
+				env.registerEdge(item.parent, cur, item.fldname);
+			else if (item.fldname)
+			{
+				char buffer[256];
+				snprintf(buffer, sizeof(buffer), "%s%d", item.fldname, item.list_index);
+				env.registerEdge(item.parent, cur, buffer);
+			}
+			else
+			{
+				char buffer[32];
+				sprintf(buffer, "%d", item.list_index);
+				env.registerEdge(item.parent, cur, buffer);
+			}
+		}
+
+		if (IsA(cur, Integer)  ||
+			IsA(cur, Float)    ||
+			IsA(cur, String)   ||
+			IsA(cur, BitString)||
+			IsA(cur, IntList)  ||
+			IsA(cur, OidList))
+			continue;
+
+		base = stack.size();
+
+		if (IsA(cur, List))
+		{
+			List *node = reinterpret_cast<List*>(const_cast<void*>(cur)); /* const List * にすると 9.1 以前でエラーが出る */
+			ListCell *lc;
+
+			if (item.from_tlist && env.canSimplify() && is_passthrough_tlist(node))
+			{
+				env.registerPassThroughTargetList(cur);
+				continue;
+			}
 
-	FIND_NODE(parse);
-	FIND_NODE(glob);
-	FIND_NODE(parent_root);
-	FIND_NODE(plan_params);
+			i = 0;
+			foreach(lc, node)
+			{
+				pushFindItem(stack, cur, NULL, i + 1, lfirst(lc), false);
+				i++;
+			}
 
-	for (i=1 ; i<node->simple_rel_array_size; i++)
-		FIND_NODE_INDEX(simple_rel_array, i);
+			std::reverse(stack.begin() + base, stack.end());
+			continue;
+		}
 
-	for (i=1 ; i<node->simple_rel_array_size; i++)
-		FIND_NODE_INDEX(simple_rte_array, i);
+		desc = lookupNodeDesc(nodeTag(cur));
 
-	FIND_NODE(join_rel_list);
+		if (desc == NULL)
+		{
+			elog(WARNING, "could not dump unrecognized node type: %d",
+				 (int) nodeTag(cur));
+			continue;
+		}
 
-	for (i=0 ; i<node->join_cur_level; i++)
-		FIND_NODE_INDEX(join_rel_level, i);
+		for (i = 0 ; i < desc->num_fields ; i++)
+		{
+			const FieldDesc *field = &desc->fields[i];
+			const void *child = *reinterpret_cast<void * const *>(reinterpret_cast<const char *>(cur) + field->offset);
 
-#if PG_VERSION_NUM < 90100
-	FIND_NODE(resultRelations);
-#endif
-	FIND_NODE(init_plans);
-	FIND_NODE(cte_plan_ids);
-#if PG_VERSION_NUM >= 90500
-	FIND_NODE(multiexpr_params);
-#endif
-	FIND_NODE(eq_classes);
-	FIND_NODE(canon_pathkeys);
-	FIND_NODE(left_join_clauses);
-	FIND_NODE(right_join_clauses);
-	FIND_NODE(full_join_clauses);
-	FIND_NODE(join_info_list);
-#if PG_VERSION_NUM < 90500 && PG_VERSION_NUM >= 90300
-	FIND_NODE(lateral_info_list);
-#endif
-	FIND_NODE(append_rel_list);
-	FIND_NODE(rowMarks);
-	FIND_NODE(placeholder_list);
-#if PG_VERSION_NUM >= 90600
-	FIND_NODE(fkey_list);
-#endif
-	FIND_NODE(query_pathkeys);
-	FIND_NODE(group_pathkeys);
-	FIND_NODE(window_pathkeys);
-#if PG_VERSION_NUM >= 90500
-	FIND_NODE(distinct_pathkeys);
-#endif
-	FIND_NODE(sort_pathkeys);
-#if PG_VERSION_NUM >= 90100
-	FIND_NODE(minmax_aggs);
-#endif
-	FIND_NODE(initial_rels);
+			if (child == NULL)
+				continue;
 
-#if PG_VERSION_NUM >= 90600
-	FIND_NODE(processed_tlist);
-#endif
+			switch (field->kind)
+			{
+				case FIELD_EXPRLIST:
+					env.registerExprTree(child);
+					pushFindItem(stack, cur, field->name, -1, child, false);
+					break;
+				case FIELD_TARGETLIST:
+					env.registerTargetList(child);
+					pushFindItem(stack, cur, field->name, -1, child, true);
+					break;
+				case FIELD_ARRAY:
+				{
+					const void * const *array = reinterpret_cast<const void * const *>(child);
+					int count = *reinterpret_cast<const int *>(reinterpret_cast<const char *>(cur) + field->count_offset);
+					int j;
+
+					for (j = field->first_index ; j < count ; j++)
+						pushFindItem(stack, cur, field->name, j, array[j], false);
+					break;
+				}
+				default:
+					pushFindItem(stack, cur, field->name, -1, child, false);
+					break;
+			}
+		}
 
-#if PG_VERSION_NUM >= 90600
-	/* @todo */
-	/* struct Path *non_recursive_path; */
-#else
-	FIND_NODE(non_recursive_plan);
-#endif
-#if PG_VERSION_NUM >= 90100
-	FIND_NODE(curOuterParams);
-#endif
-	FIND_NODE(plan_params);
+		std::reverse(stack.begin() + base, stack.end());
+	}
 }
 
-static void
-findRelOptInfo(NodeInfoEnv& env, const RelOptInfo *node)
+/****************************************************************************/
+/*                                                                          */
+/****************************************************************************/
+/*
+ * Returns the name of the catalog object, or NULL if it no longer exists.
+ * Each OID is looked up at most once per render, however many nodes refer
+ * to it.
+ */
+const char *
+NodeInfoEnv::lookupOidName(OidKind kind, Oid oid)
 {
-#if PG_VERSION_NUM >= 90600
-	/* @todo */
-	/* struct PathTarget *reltarget; */
-#else
-	FIND_NODE(reltargetlist);
-#endif
+	OidKeyType key(kind, oid);
+	OidNameMap::const_iterator it;
+	char *name = NULL;
 
-	FIND_NODE(pathlist);
-#if PG_VERSION_NUM >= 90200
-	FIND_NODE(ppilist);
-#endif
-	FIND_NODE(cheapest_startup_path);
-	FIND_NODE(cheapest_total_path);
-	FIND_NODE(cheapest_unique_path);
-#if PG_VERSION_NUM >= 90200
-	FIND_NODE(cheapest_parameterized_paths);
-#endif
-#if PG_VERSION_NUM >= 90300
-	FIND_NODE(lateral_vars);
-#endif
-	FIND_NODE(indexlist);
+	it = oid_name_map.find(key);
+	if (it != oid_name_map.end())
+		return (*it).second.empty() ? NULL : (*it).second.c_str();
 
-#if PG_VERSION_NUM < 90600
-	FIND_NODE(subplan);
+	switch (kind)
+	{
+		case OID_KIND_RELATION:
+			name = get_rel_name(oid);
+			break;
+		case OID_KIND_TYPE:
+			/* format_type_be() raises an error for a missing type */
+			if (SearchSysCacheExists1(TYPEOID, ObjectIdGetDatum(oid)))
+				name = format_type_be(oid);
+			break;
+		case OID_KIND_OPERATOR:
+			name = get_opname(oid);
+			break;
+		case OID_KIND_FUNCTION:
+			name = get_func_name(oid);
+			break;
+		case OID_KIND_COLLATION:
+#if PG_VERSION_NUM >= 90100
+			name = get_collation_name(oid);
 #endif
+			break;
+		default:
+			break;
+	}
 
-#if PG_VERSION_NUM >= 90300
-	FIND_NODE(subroot);
-	FIND_NODE(subplan_params);
-#elif PG_VERSION_NUM >= 90200
-	FIND_NODE(subroot);
-#else
-	FIND_NODE(subrtable);
-	FIND_NODE(subrowmark);
-#endif
+	/* An empty entry remembers that the lookup failed */
+	PString& entry = oid_name_map[key];
 
-#if PG_VERSION_NUM >= 90200
-	FIND_NODE(fdwroutine);
-#endif
+	if (name)
+	{
+		entry = name;
+		pfree(name);
+	}
 
-	FIND_NODE(baserestrictinfo);
-	FIND_NODE(joininfo);
-#if PG_VERSION_NUM < 90200
-	FIND_NODE(index_inner_paths);
-#endif
+	return entry.empty() ? NULL : entry.c_str();
 }
 
-static void
-findQuery(NodeInfoEnv& env, const Query *node)
+static bool
+isPlanStateNode(const void *obj)
 {
-#if 0
-	if (node->utilityStmt)
-		switch (nodeTag(node->utilityStmt))
+	const NodeDesc *desc = lookupNodeDesc(nodeTag(obj));
+
+	return desc != NULL && desc->output == outputPlanStateDesc;
+}
+
+PlanStateNodeInfo *
+NodeInfoEnv::collectPlanStates(int *num_nodes)
+{
+	typedef std::map<unsigned int, const void*, std::less<unsigned int>,
+					 PallocAllocator<std::pair<const unsigned int, const void*> > > IdNodeMap;
+	typedef std::map<const void*, int, std::less<const void*>,
+					 PallocAllocator<std::pair<const void* const, int> > > NodeIndexMap;
+
+	IdNodeMap		plan_states;
+	NodeNodeMap		parent_map;
+	NodeIndexMap	index_map;
+	PlanStateNodeInfo *result;
+	int				n = 0;
+
+	NodeIdMap::const_iterator node_it;
+	for (node_it = node_id_map.begin() ; node_it != node_id_map.end() ; node_it++)
+		if (isPlanStateNode((*node_it).first))
+			plan_states[(*node_it).second] = (*node_it).first;
+
+	/* Every node but the root is entered through exactly one edge */
+	EdgeMap::const_iterator edge_it;
+	for (edge_it = edge_map.begin() ; edge_it != edge_map.end() ; edge_it++)
+		parent_map[(*edge_it).first.second] = (*edge_it).first.first;
+
+	result = (PlanStateNodeInfo *) palloc0(sizeof(PlanStateNodeInfo) * (plan_states.size() + 1));
+
+	IdNodeMap::const_iterator ps_it;
+	for (ps_it = plan_states.begin() ; ps_it != plan_states.end() ; ps_it++)
+	{
+		const PlanState *ps = reinterpret_cast<const PlanState *>((*ps_it).second);
+		const NodeDesc *plan_desc = ps->plan ? lookupNodeDesc(nodeTag(ps->plan)) : NULL;
+		const void *up = (*ps_it).second;
+		NodeNodeMap::const_iterator parent_it;
+
+		result[n].planstate	= ps;
+		result[n].node_type	= plan_desc ? plan_desc->name : "Unknown";
+		result[n].parent	= -1;
+
+		/* Parents are visited first, so they already have an index */
+		while ((parent_it = parent_map.find(up)) != parent_map.end())
 		{
-			case T_CreateStmt:
-			case T_IndexStmt:
-			case T_NotifyStmt:
-			case T_DeclareCursorStmt:
-				FIND_NODE(utilityStmt);
-				break;
-			default:
+			up = (*parent_it).second;
+			if (index_map.find(up) != index_map.end())
+			{
+				result[n].parent = index_map[up];
 				break;
+			}
 		}
-#endif
 
-#if PG_VERSION_NUM < 90200
-	FIND_NODE(intoClause);
-#endif
-	FIND_NODE(cteList);
-	FIND_NODE(rtable);
-	FIND_NODE(jointree);
-	FIND_NODE(targetList);
-	FIND_NODE(returningList);
-	FIND_NODE(groupClause);
-#if PG_VERSION_NUM >= 90500
-	FIND_NODE(groupingSets);
-#endif
-	FIND_NODE(havingQual);
-	FIND_NODE(windowClause);
-	FIND_NODE(distinctClause);
-	FIND_NODE(sortClause);
-	FIND_NODE(limitOffset);
-	FIND_NODE(limitCount);
-	FIND_NODE(rowMarks);
-	FIND_NODE(setOperations);
-#if PG_VERSION_NUM >= 90100
-	FIND_NODE(constraintDeps);
-#endif
-} 
+		index_map[ps] = n;
+		n++;
+	}
 
-#if PG_VERSION_NUM >= 90500
-static void
-findTableSampleClause(NodeInfoEnv& env, const TableSampleClause *node)
-{
-	FIND_NODE(args);
-	FIND_NODE(repeatable);
-}
-#endif
+	*num_nodes = n;
 
-static void
-findSortGroupClause(NodeInfoEnv& env, const SortGroupClause *node)
-{
-	/* nothing */
+	return result;
 }
 
-#if PG_VERSION_NUM >= 90500
-static void
-findGroupingSet(NodeInfoEnv& env, const GroupingSet *node)
+/*
+ * Appends the record label of a node, followed by the caller's note.
+ */
+void NodeInfoEnv::appendNodeLabel(const void *obj)
 {
-	FIND_NODE(content);
+	::outputNode(*this, obj);
+
+	NodeNoteMap::const_iterator note_it = node_note_map.find(obj);
+	if (note_it != node_note_map.end())
+	{
+		append("|");
+		appendName((*note_it).second);
+	}
 }
-#endif
 
-static void
-findWindowClause(NodeInfoEnv& env, const WindowClause *node)
+/*
+ * Returns the label of one node.  The text is valid until the next call.
+ */
+const char *
+NodeInfoEnv::nodeLabel(const void *obj)
 {
-	FIND_NODE(partitionClause);
-	FIND_NODE(orderClause);
-	FIND_NODE(startOffset);
-	FIND_NODE(endOffset);
+	buffer.clear();
+	appendNodeLabel(obj);
+
+	return buffer.c_str();
 }
 
-static void
-findRangeTblEntry(NodeInfoEnv& env, const RangeTblEntry *node)
+/*
+ * Fills nodes with every node, the one with id n at index n - 1.
+ */
+void NodeInfoEnv::collectNodes(NodeList& nodes) const
 {
-	FIND_NODE(subquery);
-	FIND_NODE(joinaliasvars);
-
-#if PG_VERSION_NUM >= 90400
-	FIND_NODE(functions);
-#else
-	FIND_NODE(funcexpr);
-	FIND_NODE(funccoltypes);
-	FIND_NODE(funccoltypmods);
-#if PG_VERSION_NUM >= 90100
-	FIND_NODE(funccolcollations);
-#endif
-#endif
+	NodeIdMap::const_iterator node_it;
 
-#if PG_VERSION_NUM >= 100000
-	FIND_NODE(tablefunc);
-#endif
+	nodes.resize(node_id_map.size(), NULL);
 
-	FIND_NODE(values_lists);
-#if PG_VERSION_NUM >= 90100 && PG_VERSION_NUM < 100000
-	FIND_NODE(values_collations);
-#endif
+	for (node_it = node_id_map.begin() ; node_it != node_id_map.end() ; node_it++)
+		nodes[(*node_it).second - 1] = (*node_it).first;
+}
 
-#if PG_VERSION_NUM >= 100000
-	FIND_NODE(coltypes);
-	FIND_NODE(coltypmods);
-	FIND_NODE(colcollations);
-#else
-	FIND_NODE(ctecoltypes);
-	FIND_NODE(ctecoltypmods);
-#if PG_VERSION_NUM >= 90100
-	FIND_NODE(ctecolcollations);
-#endif
-#endif
+/*
+ * Fills edges with the edges leaving a node.
+ */
+void NodeInfoEnv::collectEdges(const void *from, EdgeList& edges) const
+{
+	EdgeMap::const_iterator edge_it;
 
-	FIND_NODE(alias);
-	FIND_NODE(eref);
-#if PG_VERSION_NUM >= 90400
-	FIND_NODE(securityQuals);
-#endif
+	for (edge_it = edge_map.lower_bound(EdgeKeyType(from, NULL)) ;
+		 edge_it != edge_map.end() && (*edge_it).first.first == from ;
+		 edge_it++)
+		edges.push_back(edge_it);
 }
 
-#if PG_VERSION_NUM >= 90400
-static void
-findRangeTblFunction(NodeInfoEnv& env, const RangeTblFunction *node)
+unsigned int NodeInfoEnv::nodeId(const void *node) const
 {
-	FIND_NODE(funcexpr);
-	FIND_NODE(funccolnames);
-	FIND_NODE(funccoltypes);
-	FIND_NODE(funccoltypmods);
-	FIND_NODE(funccolcollations);
+	NodeIdMap::const_iterator node_it = node_id_map.find(node);
+
+	return (node_it != node_id_map.end()) ? (*node_it).second : 0;
 }
-#endif
 
-/****************************************************************************/
-/*                                                                          */
-/****************************************************************************/
-void NodeInfoEnv::outputAllNodes()
+/*
+ * Sorts the nodes and edges into the groups they are drawn in: node_group
+ * and edge_group map the head of each target list or expression tree to
+ * its members, and NULL to everything outside them.
+ */
+void NodeInfoEnv::computeGroups(NodeSetMap& node_group, EdgeGroupMap& edge_group)
 {
-	NodeSetMap node_group;
 	NodeNodeMap head_node_map;
 
 	NodeSet::const_iterator head_node_it;
@@ -3440,28 +3873,40 @@ void NodeInfoEnv::outputAllNodes()
 	for (head_node_it = exprtree_head_set.begin() ; head_node_it != exprtree_head_set.end() ; head_node_it++)
 		head_node_map[*head_node_it] = *head_node_it;
 
-	bool changed;
-	do
+	/*
+	 * Propagate each head to the nodes reachable from it.  Every node other
+	 * than the root is entered through exactly one edge, so a worklist gives
+	 * the same assignment as iterating over all edges to a fixpoint, in time
+	 * linear in the number of edges.
+	 */
+	NodeList	worklist;
+	NodeNodeMap::const_iterator head_it;
+
+	for (head_it = head_node_map.begin() ; head_it != head_node_map.end() ; head_it++)
+		worklist.push_back((*head_it).first);
+
+	while (!worklist.empty())
 	{
-		changed = false;
+		const void *from = worklist.back();
+		const void *head = head_node_map[from];
 
-		EdgeMap::const_reverse_iterator edge_it;
-		for (edge_it = edge_map.rbegin() ; edge_it != edge_map.rend() ; edge_it++)
+		worklist.pop_back();
+		checkInterrupts();
+
+		EdgeMap::const_iterator edge_it;
+		for (edge_it = edge_map.lower_bound(EdgeKeyType(from, NULL)) ;
+			 edge_it != edge_map.end() && (*edge_it).first.first == from ;
+			 edge_it++)
 		{
-			const void * from = (*edge_it).first.first;
-			const void * to = (*edge_it).first.second;
+			const void *to = (*edge_it).first.second;
 
 			if (head_node_map.find(to) != head_node_map.end())
 				continue;
 
-			if (head_node_map.find(from) != head_node_map.end())
-			{
-				head_node_map[to] = head_node_map[from];
-				changed = true;
-			}
+			head_node_map[to] = head;
+			worklist.push_back(to);
 		}
 	}
-	while (changed);
 
 	NodeIdMap::const_iterator node_it;
 	for (node_it = node_id_map.begin() ; node_it != node_id_map.end() ; node_it++)
@@ -3475,6 +3920,36 @@ void NodeInfoEnv::outputAllNodes()
 		node_group[head].insert(obj);
 	}
 
+	/*
+	 * Bucket the edges by the cluster they are drawn in, so that each group
+	 * only looks at its own edges when it is written.  An edge belongs to a
+	 * cluster when both of its ends do, otherwise it is drawn at the top
+	 * level.
+	 */
+	EdgeMap::const_iterator edge_it;
+
+	for (edge_it = edge_map.begin() ; edge_it != edge_map.end() ; edge_it++)
+	{
+		const void *from_head = head_node_map[(*edge_it).first.first];
+		const void *to_head   = head_node_map[(*edge_it).first.second];
+
+		if ((from_head == to_head) && (from_head != NULL))
+			edge_group[from_head].push_back(edge_it);
+		else
+			edge_group[NULL].push_back(edge_it);
+	}
+}
+
+/*
+ * Writes the graph in DOT.
+ */
+void NodeInfoEnv::outputAllNodes()
+{
+	NodeSetMap node_group;
+	EdgeGroupMap edge_group;
+
+	computeGroups(node_group, edge_group);
+
 	/*
 	 *
 	 */
@@ -3508,12 +3983,19 @@ void NodeInfoEnv::outputAllNodes()
 			const void *obj = *member_it;
 			unsigned int node_id = node_id_map[obj];
 
+			checkInterrupts();
+
 			if (head != NULL)
 				append("\t");
 
 			append("%d[label = \"", node_id);
-			::outputNode(*this, obj);
-			append("\"]\n");
+			appendNodeLabel(obj);
+
+			NodeColorMap::const_iterator color_it = node_color_map.find(obj);
+			if (color_it != node_color_map.end())
+				append("\", fillcolor = \"%s\"]\n", (*color_it).second);
+			else
+				append("\"]\n");
 		}
 
 		append("\n");
@@ -3521,68 +4003,334 @@ void NodeInfoEnv::outputAllNodes()
 		/*
 		 * Edges
 		 */
+		const EdgeList& edge_list = edge_group[head];
+		EdgeList::const_iterator list_it;
+		for (list_it = edge_list.begin() ; list_it != edge_list.end() ; list_it++)
+		{
+			const void *from, *to; 
+			unsigned int from_node_id, to_node_id;
+
+			from = (**list_it).first.first;
+			to   = (**list_it).first.second;
+
+			from_node_id = node_id_map[from];
+			to_node_id   = node_id_map[to];
+
+			append("%s%d:%s -> %d:head [headlabel = \"%d\", taillabel = \"%d\"]\n",
+				   (head != NULL) ? "\t" : "",
+				   from_node_id, (**list_it).second.c_str(), to_node_id,
+				   from_node_id, to_node_id);
+		}
+
 		if (head != NULL)
+			append("}\n");
+
+		append("\n");
+	}
+
+	append("}\n");
+}
+
+/*
+ * Appends a string as a JSON string literal.  '<' is escaped too, so that
+ * the text cannot close the script element it is embedded in.
+ */
+void NodeInfoEnv::appendJsonString(const char *str, size_t len)
+{
+	size_t i;
+
+	buffer.push_back('"');
+
+	for (i = 0 ; i < len ; i++)
+	{
+		unsigned char c = (unsigned char) str[i];
+
+		switch (c)
 		{
-			EdgeMap::const_iterator edge_it;
-			for (edge_it = edge_map.begin() ; edge_it != edge_map.end() ; edge_it++)
-			{
-				const void *from, *to; 
-				unsigned int from_node_id, to_node_id;
+			case '"':
+				buffer.append("\\\"");
+				break;
+			case '\\':
+				buffer.append("\\\\");
+				break;
+			case '<':
+				buffer.append("\\u003c");
+				break;
+			default:
+				if (c < 0x20)
+					append("\\u%04x", c);
+				else
+					buffer.push_back(c);
+				break;
+		}
+	}
 
-				from = (*edge_it).first.first;
-				to   = (*edge_it).first.second;
+	buffer.push_back('"');
+}
 
-				if (head != head_node_map[from] || head != head_node_map[to])
-					continue;
+/*
+ * Appends a record label as a JSON array of its fields, undoing the record
+ * escapes.  A field with a port is written as [port, text].
+ */
+void NodeInfoEnv::appendJsonLabel(const PString& label)
+{
+	PString text(buffer.get_allocator());
+	PString port(buffer.get_allocator());
+	size_t i = 0;
+	bool first = true;
 
-				from_node_id = node_id_map[from];
-				to_node_id   = node_id_map[to];
+	buffer.push_back('[');
 
-				append("\t%d:%s -> %d:head [headlabel = \"%d\", taillabel = \"%d\"]\n",
-					   from_node_id, (*edge_it).second.c_str(), to_node_id,
-					   from_node_id, to_node_id);
-			}
+	while (i <= label.size())
+	{
+		text.clear();
+		port.clear();
+
+		if (i < label.size() && label[i] == '<')
+		{
+			for (i++ ; i < label.size() && label[i] != '>' ; i++)
+				port.push_back(label[i]);
+			i++;
+			if (i < label.size() && label[i] == ' ')
+				i++;
+		}
+
+		for ( ; i < label.size() && label[i] != '|' ; i++)
+		{
+			if (label[i] == '\\' && i + 1 < label.size())
+				i++;
+			text.push_back(label[i]);
 		}
+		i++;
+
+		if (!first)
+			buffer.push_back(',');
+		first = false;
+
+		if (port.empty())
+			appendJsonString(text.data(), text.size());
 		else
 		{
-			EdgeMap::const_iterator edge_it;
-			for (edge_it = edge_map.begin() ; edge_it != edge_map.end() ; edge_it++)
-			{
-				const void *from, *to; 
-				const void *from_head, *to_head; 
-				unsigned int from_node_id, to_node_id;
+			buffer.push_back('[');
+			appendJsonString(port.data(), port.size());
+			buffer.push_back(',');
+			appendJsonString(text.data(), text.size());
+			buffer.push_back(']');
+		}
+	}
 
-				from = (*edge_it).first.first;
-				to   = (*edge_it).first.second;
+	buffer.push_back(']');
+}
 
-				from_head = head_node_map[from];
-				to_head   = head_node_map[to];
+/*
+ * Appends the members of a group as JSON object members:
+ * "nodes": [[id, label], ...], "edges": [[from, port, to], ...]
+ */
+void NodeInfoEnv::appendJsonGroup(const NodeSet& node_set, const EdgeList& edge_list)
+{
+	NodeSet::const_iterator member_it;
+	EdgeList::const_iterator list_it;
 
-				if ((from_head == to_head) && (from_head != NULL))
-					continue;
+	append("\"nodes\":[");
 
-				from_node_id = node_id_map[from];
-				to_node_id   = node_id_map[to];
+	for (member_it = node_set.begin() ; member_it != node_set.end() ; member_it++)
+	{
+		const void *obj = *member_it;
+		size_t mark;
 
-				append("%d:%s -> %d:head [headlabel = \"%d\", taillabel = \"%d\"]\n",
-					   from_node_id, (*edge_it).second.c_str(), to_node_id,
-					   from_node_id, to_node_id);
-			}
-		}
+		checkInterrupts();
 
-		if (head != NULL)
-			append("}\n");
+		if (member_it != node_set.begin())
+			buffer.push_back(',');
 
-		append("\n");
+		/* The label is written after the buffer and then taken back out */
+		mark = buffer.size();
+		appendNodeLabel(obj);
+		PString label(buffer, mark, PString::npos, buffer.get_allocator());
+		buffer.resize(mark);
+
+		append("[%d,", node_id_map[obj]);
+		appendJsonLabel(label);
+		buffer.push_back(']');
+	}
+
+	append("],\"edges\":[");
+
+	for (list_it = edge_list.begin() ; list_it != edge_list.end() ; list_it++)
+	{
+		if (list_it != edge_list.begin())
+			buffer.push_back(',');
+
+		append("[%d,", node_id_map[(**list_it).first.first]);
+		appendJsonString((**list_it).second.data(), (**list_it).second.size());
+		append(",%d]", node_id_map[(**list_it).first.second]);
+	}
+
+	append("]");
+}
+
+/*
+ * Writes the graph as a self-contained HTML page.  The nodes outside the
+ * target lists and expression trees are drawn as a collapsible tree; each
+ * cluster is embedded as a JSON blob of its own that is parsed only when
+ * it is first expanded, so the page opens without touching them.
+ */
+void NodeInfoEnv::outputHtml()
+{
+	NodeSetMap node_group;
+	EdgeGroupMap edge_group;
+	NodeSetMap::const_iterator group_it;
+	int cluster_no;
+
+	computeGroups(node_group, edge_group);
+
+	append("<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n<title>");
+	appendHtml(label.c_str());
+	append("</title>\n");
+	buffer.append("<style>\n"
+				  "body { font-family: sans-serif; font-size: 13px; }\n"
+				  "details { margin-left: 1em; }\n"
+				  "summary { cursor: pointer; background: #f2f2f2; }\n"
+				  "ul { list-style: none; margin: 0; padding-left: 1em; }\n"
+				  "button { font-size: 11px; }\n"
+				  "</style>\n</head>\n<body>\n<h1>");
+	appendHtml(label.c_str());
+	append("</h1>\n<div id=\"plan\"></div>\n");
+
+	/* The plan skeleton, with the heads of the clusters */
+	append("<script type=\"application/json\" id=\"skeleton\">{");
+	appendJsonGroup(node_group[NULL], edge_group[NULL]);
+	append(",\"clusters\":[");
+
+	cluster_no = 0;
+	for (group_it = node_group.begin() ; group_it != node_group.end() ; group_it++)
+	{
+		const void *head = (*group_it).first;
+
+		if (head == NULL)
+			continue;
+
+		if (cluster_no > 0)
+			buffer.push_back(',');
+
+		append("{\"id\":%d,\"head\":%d,\"label\":\"%s\"}",
+			   cluster_no++, node_id_map[head],
+			   (tlist_head_set.find(head) != tlist_head_set.end()) ? "Target List" : "Express Tree");
+	}
+
+	append("]}</script>\n");
+
+	/* One blob per cluster, numbered as above */
+	cluster_no = 0;
+	for (group_it = node_group.begin() ; group_it != node_group.end() ; group_it++)
+	{
+		const void *head = (*group_it).first;
+
+		if (head == NULL)
+			continue;
+
+		append("<script type=\"application/json\" id=\"cluster_%d\">{", cluster_no++);
+		appendJsonGroup((*group_it).second, edge_group[head]);
+		append("}</script>\n");
 	}
 
-	append("}\n");
+	buffer.append("<script>\n"
+				  "(function () {\n"
+				  "  var nodes = {}, edges = {}, heads = {}, loaded = {};\n"
+				  "  function load(data) {\n"
+				  "    data.nodes.forEach(function (n) { nodes[n[0]] = n[1]; });\n"
+				  "    data.edges.forEach(function (e) {\n"
+				  "      var ports = edges[e[0]] = edges[e[0]] || {};\n"
+				  "      (ports[e[1]] = ports[e[1]] || []).push(e[2]);\n"
+				  "    });\n"
+				  "  }\n"
+				  "  function text(s) { return document.createTextNode(s); }\n"
+				  "  function child(to) {\n"
+				  "    if (nodes[to]) return render(to);\n"
+				  "    var c = heads[to];\n"
+				  "    if (c === undefined) return text('(' + to + ')');\n"
+				  "    var button = document.createElement('button');\n"
+				  "    button.appendChild(text(c.label + ' (' + to + ')'));\n"
+				  "    button.onclick = function () {\n"
+				  "      if (!loaded[c.id]) {\n"
+				  "        load(JSON.parse(document.getElementById('cluster_' + c.id).textContent));\n"
+				  "        loaded[c.id] = true;\n"
+				  "      }\n"
+				  "      var box = render(to);\n"
+				  "      button.parentNode.replaceChild(box, button);\n"
+				  "      box.open = true;\n"
+				  "      expand(box, to);\n"
+				  "    };\n"
+				  "    return button;\n"
+				  "  }\n"
+				  "  function expand(box, id) {\n"
+				  "    if (!box.open || box.expanded) return;\n"
+				  "    box.expanded = true;\n"
+				  "    var fields = nodes[id], list = document.createElement('ul');\n"
+				  "    for (var i = 1; i < fields.length; i++) {\n"
+				  "      var item = document.createElement('li'), f = fields[i];\n"
+				  "      if (typeof f === 'string') {\n"
+				  "        item.appendChild(text(f));\n"
+				  "      } else {\n"
+				  "        item.appendChild(text(f[1]));\n"
+				  "        ((edges[id] || {})[f[0]] || []).forEach(function (to) { item.appendChild(child(to)); });\n"
+				  "      }\n"
+				  "      list.appendChild(item);\n"
+				  "    }\n"
+				  "    box.appendChild(list);\n"
+				  "  }\n"
+				  "  function render(id) {\n"
+				  "    var fields = nodes[id], box = document.createElement('details');\n"
+				  "    var summary = document.createElement('summary');\n"
+				  "    summary.appendChild(text(typeof fields[0] === 'string' ? fields[0] : fields[0][1]));\n"
+				  "    box.appendChild(summary);\n"
+				  "    box.addEventListener('toggle', function () { expand(box, id); });\n"
+				  "    return box;\n"
+				  "  }\n"
+				  "  var skeleton = JSON.parse(document.getElementById('skeleton').textContent);\n"
+				  "  load(skeleton);\n"
+				  "  skeleton.clusters.forEach(function (c) { heads[c.head] = c; });\n"
+				  "  if (nodes[1]) document.getElementById('plan').appendChild(child(1));\n"
+				  "})();\n"
+				  "</script>\n</body>\n</html>\n");
+}
+
+/*
+ * Appends text with the characters special in HTML escaped.
+ */
+void NodeInfoEnv::appendHtml(const char *str)
+{
+	const char *p;
+
+	for (p = str ; *p ; p++)
+	{
+		switch (*p)
+		{
+			case '<':
+				buffer.append("&lt;");
+				break;
+			case '>':
+				buffer.append("&gt;");
+				break;
+			case '&':
+				buffer.append("&amp;");
+				break;
+			case '"':
+				buffer.append("&quot;");
+				break;
+			default:
+				buffer.push_back(*p);
+				break;
+		}
+	}
 }
 
 
 static void
 outputNode(NodeInfoEnv& env, const void *obj)
 {
+	const NodeDesc *desc;
+
 	if (IsA(obj, Integer)   ||
 		IsA(obj, Float)     ||
 		IsA(obj, String)    ||
@@ -3616,605 +4364,23 @@ outputNode(NodeInfoEnv& env, const void *obj)
 		{
 			env.append("|<%d> [%d]", i + 1, i);
 			i++;
-		}
-
-		env.popNode();
-		return;
-	}
-
-	switch (nodeTag(obj))
-	{
-		case T_PlannedStmt:
-			outputPlannedStmt(env, reinterpret_cast<const PlannedStmt*>(obj));
-			break;
-		
-		case T_Plan:
-			outputPlan(env, reinterpret_cast<const Plan*>(obj));
-			break;
-
-		case T_Result:
-			outputResult(env, reinterpret_cast<const Result*>(obj));
-			break;
-
-#if PG_VERSION_NUM >= 100000
-			outputProjectSet(env, reinterpret_cast<const ProjectSet*>(obj));
-			break;
-#endif
-
-#if 0
-		case T_Env:
-			outputEnv(env, reinterpret_cast<const Env*>(obj));
-			break;
-#endif 
-		case T_ModifyTable:
-			outputModifyTable(env, reinterpret_cast<const ModifyTable*>(obj));
-			break;
-		case T_Append:
-			outputAppend(env, reinterpret_cast<const Append*>(obj));
-			break;
-#if PG_VERSION_NUM >= 90100
-		case T_MergeAppend:
-			outputMergeAppend(env, reinterpret_cast<const MergeAppend*>(obj));
-			break;
-#endif
-		case T_RecursiveUnion:
-			outputRecursiveUnion(env, reinterpret_cast<const RecursiveUnion*>(obj));
-			break;
-		case T_BitmapAnd:
-			outputBitmapAnd(env, reinterpret_cast<const BitmapAnd*>(obj));
-			break;
-		case T_BitmapOr:
-			outputBitmapOr(env, reinterpret_cast<const BitmapOr*>(obj));
-			break;
-		case T_Scan:
-			outputScan(env, reinterpret_cast<const Scan*>(obj));
-			break;
-		case T_SeqScan:
-			outputSeqScan(env, reinterpret_cast<const SeqScan*>(obj));
-			break;
-#if PG_VERSION_NUM >= 90500
-        case T_SampleScan:
-			outputSampleScan(env, reinterpret_cast<const SampleScan*>(obj));
-			break;
-#endif
-		case T_IndexScan:
-			outputIndexScan(env, reinterpret_cast<const IndexScan*>(obj));
-			break;
-#if PG_VERSION_NUM >= 90200
-		case T_IndexOnlyScan:
-			outputIndexOnlyScan(env, reinterpret_cast<const IndexOnlyScan*>(obj));
-			break;
-#endif
-		case T_BitmapIndexScan:
-			outputBitmapIndexScan(env, reinterpret_cast<const BitmapIndexScan*>(obj));
-			break;
-		case T_BitmapHeapScan:
-			outputBitmapHeapScan(env, reinterpret_cast<const BitmapHeapScan*>(obj));
-			break;
-		case T_TidScan:
-			outputTidScan(env, reinterpret_cast<const TidScan*>(obj));
-			break;
-		case T_SubqueryScan:
-			outputSubqueryScan(env, reinterpret_cast<const SubqueryScan*>(obj));
-			break;
-		case T_FunctionScan:
-			outputFunctionScan(env, reinterpret_cast<const FunctionScan*>(obj));
-			break;
-		case T_ValuesScan:
-			outputValuesScan(env, reinterpret_cast<const ValuesScan*>(obj));
-			break;
-#if PG_VERSION_NUM >= 100000
-		case T_TableFuncScan:
-			outputTableFuncScan(env, reinterpret_cast<const TableFuncScan*>(obj));
-			break;
-#endif
-		case T_CteScan:
-			outputCteScan(env, reinterpret_cast<const CteScan*>(obj));
-			break;
-#if PG_VERSION_NUM >= 100000
-		case T_NamedTuplestoreScan:
-			outputNamedTuplestoreScan(env, reinterpret_cast<const NamedTuplestoreScan*>(obj));
-			break;
-#endif
-		case T_WorkTableScan:
-			outputWorkTableScan(env, reinterpret_cast<const WorkTableScan*>(obj));
-			break;
-#if PG_VERSION_NUM >= 90100
-		case T_ForeignScan:
-			outputForeignScan(env, reinterpret_cast<const ForeignScan*>(obj));
-			break;
-#endif
-#if PG_VERSION_NUM >= 90500
-		case T_CustomScan:
-			outputCustomScan(env, reinterpret_cast<const CustomScan*>(obj));
-			break;
-#endif
-		case T_Join:
-			outputJoin(env, reinterpret_cast<const Join*>(obj));
-			break;
-		case T_NestLoop:
-			outputNestLoop(env, reinterpret_cast<const NestLoop*>(obj));
-			break;
-		case T_MergeJoin:
-			outputMergeJoin(env, reinterpret_cast<const MergeJoin*>(obj));
-			break;
-		case T_HashJoin:
-			outputHashJoin(env, reinterpret_cast<const HashJoin*>(obj));
-			break;
-		case T_Agg:
-			outputAgg(env, reinterpret_cast<const Agg*>(obj));
-			break;
-		case T_WindowAgg:
-			outputWindowAgg(env, reinterpret_cast<const WindowAgg*>(obj));
-			break;
-		case T_Group:
-			outputGroup(env, reinterpret_cast<const Group*>(obj));
-			break;
-		case T_Material:
-			outputMaterial(env, reinterpret_cast<const Material*>(obj));
-			break;
-		case T_Sort:
-			outputSort(env, reinterpret_cast<const Sort*>(obj));
-			break;
-		case T_Unique:
-			outputUnique(env, reinterpret_cast<const Unique*>(obj));
-			break;
-#if PG_VERSION_NUM >= 90600
-		case T_Gather:
-			outputGather(env, reinterpret_cast<const Gather*>(obj));
-			break;
-#endif
-#if PG_VERSION_NUM >= 100000
-		case T_GatherMerge:
-			outputGatherMerge(env, reinterpret_cast<const GatherMerge*>(obj));
-			break;
-#endif
-		case T_Hash:
-			outputHash(env, reinterpret_cast<const Hash*>(obj));
-			break;
-		case T_SetOp:
-			outputSetOp(env, reinterpret_cast<const SetOp*>(obj));
-			break;
-		case T_LockRows:
-			outputLockRows(env, reinterpret_cast<const LockRows*>(obj));
-			break;
-		case T_Limit:
-			outputLimit(env, reinterpret_cast<const Limit*>(obj));
-			break;
-#if PG_VERSION_NUM >= 90100
-		case T_NestLoopParam:
-			outputNestLoopParam(env, reinterpret_cast<const NestLoopParam*>(obj));
-			break;
-#endif
-		case T_PlanRowMark:
-			outputPlanRowMark(env, reinterpret_cast<const PlanRowMark*>(obj));
-			break;
-#if PG_VERSION_NUM >= 110000
-		case T_PartitionPruneInfo:
-			outputPartitionPruneInfo(env, reinterpret_cast<const PartitionPruneInfo*>(obj));
-			break;			
-		case T_PartitionedRelPruneInfo:
-			outputPartitionedRelPruneInfo(env, reinterpret_cast<const PartitionedRelPruneInfo*>(obj));			
-			break;
-		case T_PartitionPruneStepOp:
-			outputPartitionPruneStepOp(env, reinterpret_cast<const PartitionPruneStepOp*>(obj));
-			break;			
-		case T_PartitionPruneStepCombine:
-			outputPartitionPruneStepCombine(env, reinterpret_cast<const PartitionPruneStepCombine*>(obj));
-			break;
-#endif			
-		case T_PlanInvalItem:
-			outputPlanInvalItem(env, reinterpret_cast<const PlanInvalItem*>(obj));
-			break;
-		case T_Alias:
-			outputAlias(env, reinterpret_cast<const Alias*>(obj));
-			break;
-		case T_RangeVar:
-			outputRangeVar(env, reinterpret_cast<const RangeVar*>(obj));
-			break;
-#if PG_VERSION_NUM >= 100000
-		case T_TableFunc:
-			outputTableFunc(env, reinterpret_cast<const TableFunc*>(obj));
-			break;
-#endif
-		case T_IntoClause:
-			outputIntoClause(env, reinterpret_cast<const IntoClause*>(obj));
-			break;
-		case T_Var:
-			outputVar(env, reinterpret_cast<const Var*>(obj));
-			break;
-		case T_Const:
-			outputConst(env, reinterpret_cast<const Const*>(obj));
-			break;
-		case T_Param:
-			outputParam(env, reinterpret_cast<const Param*>(obj));
-			break;
-		case T_Aggref:
-			outputAggref(env, reinterpret_cast<const Aggref*>(obj));
-			break;
-#if PG_VERSION_NUM >= 90500
-		case T_GroupingFunc:
-			outputGroupingFunc(env, reinterpret_cast<const GroupingFunc*>(obj));
-			break;
-#endif
-		case T_WindowFunc:
-			outputWindowFunc(env, reinterpret_cast<const WindowFunc*>(obj));
-			break;
-#if PG_VERSION_NUM >= 120000
-		case T_SubscriptingRef:
-			outputSubscriptingRef(env, reinterpret_cast<const SubscriptingRef*>(obj));
-			break;			
-#else
-		case T_ArrayRef:
-			outputArrayRef(env, reinterpret_cast<const ArrayRef*>(obj));
-			break;
-#endif
-		case T_FuncExpr:
-			outputFuncExpr(env, reinterpret_cast<const FuncExpr*>(obj));
-			break;
-		case T_NamedArgExpr:
-			outputNamedArgExpr(env, reinterpret_cast<const NamedArgExpr*>(obj));
-			break;
-		case T_OpExpr:
-			outputOpExpr(env, reinterpret_cast<const OpExpr*>(obj));
-			break;
-		case T_DistinctExpr:
-			outputDistinctExpr(env, reinterpret_cast<const DistinctExpr*>(obj));
-			break;
-		case T_NullIfExpr:
-			outputNullIfExpr(env, reinterpret_cast<const NullIfExpr*>(obj));
-			break;
-		case T_ScalarArrayOpExpr:
-			outputScalarArrayOpExpr(env, reinterpret_cast<const ScalarArrayOpExpr*>(obj));
-			break;
-		case T_BoolExpr:
-			outputBoolExpr(env, reinterpret_cast<const BoolExpr*>(obj));
-			break;
-		case T_SubLink:
-			outputSubLink(env, reinterpret_cast<const SubLink*>(obj));
-			break;
-		case T_SubPlan:
-			outputSubPlan(env, reinterpret_cast<const SubPlan*>(obj));
-			break;
-		case T_AlternativeSubPlan:
-			outputAlternativeSubPlan(env, reinterpret_cast<const AlternativeSubPlan*>(obj));
-			break;
-		case T_FieldSelect:
-			outputFieldSelect(env, reinterpret_cast<const FieldSelect*>(obj));
-			break;
-		case T_FieldStore:
-			outputFieldStore(env, reinterpret_cast<const FieldStore*>(obj));
-			break;
-		case T_RelabelType:
-			outputRelabelType(env, reinterpret_cast<const RelabelType*>(obj));
-			break;
-		case T_CoerceViaIO:
-			outputCoerceViaIO(env, reinterpret_cast<const CoerceViaIO*>(obj));
-			break;
-		case T_ArrayCoerceExpr:
-			outputArrayCoerceExpr(env, reinterpret_cast<const ArrayCoerceExpr*>(obj));
-			break;
-		case T_ConvertRowtypeExpr:
-			outputConvertRowtypeExpr(env, reinterpret_cast<const ConvertRowtypeExpr*>(obj));
-			break;
-#if PG_VERSION_NUM >= 90100
-		case T_CollateExpr:
-			outputCollateExpr(env, reinterpret_cast<const CollateExpr*>(obj));
-			break;
-#endif
-		case T_CaseExpr:
-			outputCaseExpr(env, reinterpret_cast<const CaseExpr*>(obj));
-			break;
-		case T_CaseWhen:
-			outputCaseWhen(env, reinterpret_cast<const CaseWhen*>(obj));
-			break;
-		case T_CaseTestExpr:
-			outputCaseTestExpr(env, reinterpret_cast<const CaseTestExpr*>(obj));
-			break;
-		case T_ArrayExpr:
-			outputArrayExpr(env, reinterpret_cast<const ArrayExpr*>(obj));
-			break;
-		case T_RowExpr:
-			outputRowExpr(env, reinterpret_cast<const RowExpr*>(obj));
-			break;
-		case T_RowCompareExpr:
-			outputRowCompareExpr(env, reinterpret_cast<const RowCompareExpr*>(obj));
-			break;
-		case T_CoalesceExpr:
-			outputCoalesceExpr(env, reinterpret_cast<const CoalesceExpr*>(obj));
-			break;
-		case T_MinMaxExpr:
-			outputMinMaxExpr(env, reinterpret_cast<const MinMaxExpr*>(obj));
-			break;
-#if PG_VERSION_NUM >= 100000
-		case T_SQLValueFunction:
-			outputSQLValueFunction(env, reinterpret_cast<const SQLValueFunction*>(obj));
-			break;
-#endif
-		case T_XmlExpr:
-			outputXmlExpr(env, reinterpret_cast<const XmlExpr*>(obj));
-			break;
-		case T_NullTest:
-			outputNullTest(env, reinterpret_cast<const NullTest*>(obj));
-			break;
-		case T_BooleanTest:
-			outputBooleanTest(env, reinterpret_cast<const BooleanTest*>(obj));
-			break;
-		case T_CoerceToDomain:
-			outputCoerceToDomain(env, reinterpret_cast<const CoerceToDomain*>(obj));
-			break;
-		case T_CoerceToDomainValue:
-			outputCoerceToDomainValue(env, reinterpret_cast<const CoerceToDomainValue*>(obj));
-			break;
-		case T_SetToDefault:
-			outputSetToDefault(env, reinterpret_cast<const SetToDefault*>(obj));
-			break;
-		case T_CurrentOfExpr:
-			outputCurrentOfExpr(env, reinterpret_cast<const CurrentOfExpr*>(obj));
-			break;
-#if PG_VERSION_NUM >= 90500
-		case T_InferenceElem:
-			outputInferenceElem(env, reinterpret_cast<const InferenceElem*>(obj));
-			break;
-#endif
-		case T_TargetEntry:
-			outputTargetEntry(env, reinterpret_cast<const TargetEntry*>(obj));
-			break;
-		case T_RangeTblRef:
-			outputRangeTblRef(env, reinterpret_cast<const RangeTblRef*>(obj));
-			break;
-		case T_JoinExpr:
-			outputJoinExpr(env, reinterpret_cast<const JoinExpr*>(obj));
-			break;
-		case T_FromExpr:
-			outputFromExpr(env, reinterpret_cast<const FromExpr*>(obj));
-			break;
-#if PG_VERSION_NUM >= 90500
-		case T_OnConflictExpr:
-			outputOnConflictExpr(env, reinterpret_cast<const OnConflictExpr*>(obj));
-			break;
-#endif
-#if PG_VERSION_NUM >= 100000
-		case T_NextValueExpr:
-			outputNextValueExpr(env, reinterpret_cast<const NextValueExpr*>(obj));
-			break;
-#endif
-#if 0
-		case T_Path:
-			outputPath(env, obj);
-			break;
-		case T_IndexPath:
-			outputIndexPath(env, obj);
-			break;
-		case T_BitmapHeapPath:
-			outputBitmapHeapPath(env, obj);
-			break;
-		case T_BitmapAndPath:
-			outputBitmapAndPath(env, obj);
-			break;
-		case T_BitmapOrPath:
-			outputBitmapOrPath(env, obj);
-			break;
-		case T_TidPath:
-			outputTidPath(env, obj);
-			break;
-		case T_ForeignPath:
-			outputForeignPath(env, obj);
-			break;
-		case T_AppendPath:
-			outputAppendPath(env, obj);
-			break;
-		case T_MergeAppendPath:
-			outputMergeAppendPath(env, obj);
-			break;
-		case T_EnvPath:
-			outputEnvPath(env, obj);
-			break;
-		case T_MaterialPath:
-			outputMaterialPath(env, obj);
-			break;
-		case T_UniquePath:
-			outputUniquePath(env, obj);
-			break;
-		case T_NestPath:
-			outputNestPath(env, obj);
-			break;
-		case T_MergePath:
-			outputMergePath(env, obj);
-			break;
-		case T_HashPath:
-			outputHashPath(env, obj);
-			break;
-#endif
-		case T_PlannerGlobal:
-			outputPlannerGlobal(env, reinterpret_cast<const PlannerGlobal*>(obj));
-			break;
-		case T_PlannerInfo:
-			outputPlannerInfo(env, reinterpret_cast<const PlannerInfo*>(obj));
-			break;
-		case T_RelOptInfo:
-			outputRelOptInfo(env, reinterpret_cast<const RelOptInfo*>(obj));
-			break;
-#if 0
-		case T_IndexOptInfo:
-			outputIndexOptInfo(env, obj);
-			break;
-		case T_EquivalenceClass:
-			outputEquivalenceClass(env, obj);
-			break;
-		case T_EquivalenceMember:
-			outputEquivalenceMember(env, obj);
-			break;
-		case T_PathKey:
-			outputPathKey(env, obj);
-			break;
-		case T_ParamPathInfo:
-			outputParamPathInfo(env, obj);
-			break;
-		case T_RestrictInfo:
-			outputRestrictInfo(env, obj);
-			break;
-		case T_PlaceHolderVar:
-			outputPlaceHolderVar(env, obj);
-			break;
-		case T_SpecialJoinInfo:
-			outputSpecialJoinInfo(env, obj);
-			break;
-		case T_AppendRelInfo:
-			outputAppendRelInfo(env, obj);
-			break;
-		case T_PlaceHolderInfo:
-			outputPlaceHolderInfo(env, obj);
-			break;
-		case T_MinMaxAggInfo:
-			outputMinMaxAggInfo(env, obj);
-			break;
-		case T_PlannerParamItem:
-			outputPlannerParamItem(env, obj);
-			break;
-
-		case T_CreateStmt:
-			outputCreateStmt(env, obj);
-			break;
-		case T_CreateForeignTableStmt:
-			outputCreateForeignTableStmt(env, obj);
-			break;
-		case T_IndexStmt:
-			outputIndexStmt(env, obj);
-			break;
-		case T_NotifyStmt:
-			outputNotifyStmt(env, obj);
-			break;
-		case T_DeclareCursorStmt:
-			outputDeclareCursorStmt(env, obj);
-			break;
-		case T_SelectStmt:
-			outputSelectStmt(env, obj);
-			break;
-		case T_ColumnDef:
-			outputColumnDef(env, obj);
-			break;
-		case T_TypeName:
-			outputTypeName(env, obj);
-			break;
-		case T_TypeCast:
-			outputTypeCast(env, obj);
-			break;
-		case T_CollateClause:
-			outputCollateClause(env, obj);
-			break;
-		case T_IndexElem:
-			outputIndexElem(env, obj);
-			break;
-#endif
-		case T_Query:
-			outputQuery(env, reinterpret_cast<const Query*>(obj));
-			break;
-#if 0
-		case T_RowMarkClause:
-			outputRowMarkClause(env, obj);
-			break;
-		case T_WithClause:
-			outputWithClause(env, obj);
-			break;
-		case T_CommonTableExpr:
-			outputCommonTableExpr(env, obj);
-			break;
-		case T_SetOperationStmt:
-			outputSetOperationStmt(env, obj);
-			break;
-#endif
-
-		case T_RangeTblEntry:
-			outputRangeTblEntry(env, reinterpret_cast<const RangeTblEntry*>(obj));
-			break;
-#if PG_VERSION_NUM >= 90400
-		case T_RangeTblFunction:
-			outputRangeTblFunction(env, reinterpret_cast<const RangeTblFunction*>(obj));
-			break;
-#endif
-#if PG_VERSION_NUM >= 90500
-		case T_TableSampleClause: 
-			outputTableSampleClause(env, reinterpret_cast<const TableSampleClause*>(obj));
-			break;
-#endif
-		case T_SortGroupClause:
-			outputSortGroupClause(env, reinterpret_cast<const SortGroupClause*>(obj));
-			break;
-#if PG_VERSION_NUM >= 90500
-		case T_GroupingSet:
-			outputGroupingSet(env, reinterpret_cast<const GroupingSet*>(obj));
-			break;
-#endif
-		case T_WindowClause:
-			outputWindowClause(env, reinterpret_cast<const WindowClause*>(obj));
-			break;
-
-#if 0
-		case T_A_Expr:
-			outputAExpr(env, obj);
-			break;
-		case T_ColumnRef:
-			outputColumnRef(env, obj);
-			break;
-		case T_ParamRef:
-			outputParamRef(env, obj);
-			break;
-		case T_A_Const:
-			outputAConst(env, obj);
-			break;
-		case T_A_Star:
-			outputA_Star(env, obj);
-			break;
-		case T_A_Indices:
-			outputA_Indices(env, obj);
-			break;
-		case T_A_Indirection:
-			outputA_Indirection(env, obj);
-			break;
-		case T_A_ArrayExpr:
-			outputA_ArrayExpr(env, obj);
-			break;
-		case T_ResTarget:
-			outputResTarget(env, obj);
-			break;
-		case T_SortBy:
-			outputSortBy(env, obj);
-			break;
-		case T_WindowDef:
-			outputWindowDef(env, obj);
-			break;
-		case T_RangeSubselect:
-			outputRangeSubselect(env, obj);
-			break;
-		case T_RangeFunction:
-			outputRangeFunction(env, obj);
-			break;
-		case T_Constraint:
-			outputConstraint(env, obj);
-			break;
-		case T_FuncCall:
-			outputFuncCall(env, obj);
-			break;
-		case T_DefElem:
-			outputDefElem(env, obj);
-			break;
-		case T_TableLikeClause:
-			outputTableLikeClause(env, obj);
-			break;
-		case T_LockingClause:
-			outputLockingClause(env, obj);
-			break;
-		case T_XmlSerialize:
-			outputXmlSerialize(env, obj);
-			break;
-#endif
+		}
 
-		default:
-			env.pushNode(obj, "Unknown");
-			env.popNode();
-			break;
+		env.popNode();
+		return;
+	}
+
+	desc = lookupNodeDesc(nodeTag(obj));
+
+	if (desc == NULL)
+	{
+		env.pushNode(obj, "Unknown");
+		env.popNode();
 	}
+	else if (desc->output)
+		desc->output(env, obj);
+	else
+		outputGenericNode(env, desc, obj);
 }
 
 static void
@@ -4247,6 +4413,7 @@ _outputScan(NodeInfoEnv& env, const Scan *node)
 {
 	_outputPlan(env, &node->plan);
 	WRITE_INDEX_FIELD(scanrelid);
+	env.outputRangeTableRelation("relation", node->scanrelid);
 }
 
 static void
@@ -4263,13 +4430,13 @@ _outputJoin(NodeInfoEnv& env, const Join *node)
 static void
 _outputOpExpr(NodeInfoEnv& env, const OpExpr *node)
 {
-	WRITE_OID_FIELD(opno);
-	WRITE_OID_FIELD(opfuncid);
-	WRITE_OID_FIELD(opresulttype);
+	WRITE_OPEROID_FIELD(opno);
+	WRITE_FUNCOID_FIELD(opfuncid);
+	WRITE_TYPEOID_FIELD(opresulttype);
 	WRITE_BOOL_FIELD(opretset);
 #if PG_VERSION_NUM >= 90100
-	WRITE_OID_FIELD(opcollid);
-	WRITE_OID_FIELD(inputcollid);
+	WRITE_COLLOID_FIELD(opcollid);
+	WRITE_COLLOID_FIELD(inputcollid);
 #endif
 	WRITE_NODE_FIELD(args);
 	WRITE_LOCATION_FIELD(location);
@@ -4491,6 +4658,61 @@ outputModifyTable(NodeInfoEnv& env, const ModifyTable *node)
 	env.popNode();
 }
 
+#if PG_VERSION_NUM >= 110000
+/*
+ * Counts the partitions of one partitioned table that were kept or pruned
+ * when the plan was made.  subplan_map says which partitions kept a subplan;
+ * entries that are neither a subplan nor a sub-partitioned table
+ * (subpart_map) were pruned.
+ */
+static void
+countPlanTimePruning(const PartitionedRelPruneInfo *pinfo, int *total, int *pruned)
+{
+	int i;
+
+	for (i = 0 ; i < pinfo->nparts ; i++)
+	{
+		if (pinfo->subpart_map[i] >= 0)
+			continue;
+
+		(*total)++;
+		if (pinfo->subplan_map[i] < 0)
+			(*pruned)++;
+	}
+}
+
+/*
+ * Writes how many leaf partitions the run-time pruning information covers
+ * and how many of them the planner already removed.
+ */
+static void
+outputPlanTimePruning(NodeInfoEnv& env, const PartitionPruneInfo *prune_info)
+{
+	ListCell *lc1, *lc2;
+	int total = 0;
+	int pruned = 0;
+
+	if (prune_info == NULL)
+		return;
+
+	/* prune_infos has one sublist per partitioning hierarchy */
+	foreach(lc1, prune_info->prune_infos)
+	{
+		const Node *item = reinterpret_cast<const Node *>(lfirst(lc1));
+
+		if (IsA(item, List))
+		{
+			foreach(lc2, reinterpret_cast<List *>(const_cast<Node *>(item)))
+				countPlanTimePruning(reinterpret_cast<const PartitionedRelPruneInfo *>(lfirst(lc2)), &total, &pruned);
+		}
+		else
+			countPlanTimePruning(reinterpret_cast<const PartitionedRelPruneInfo *>(item), &total, &pruned);
+	}
+
+	env.append("|partitions: %d, plan-time pruned: %d", total, pruned);
+}
+#endif
+
 static void
 outputAppend(NodeInfoEnv& env, const Append *node)
 {
@@ -4508,6 +4730,7 @@ outputAppend(NodeInfoEnv& env, const Append *node)
 #endif
 #if PG_VERSION_NUM >= 110000
 	WRITE_NODE_FIELD(part_prune_info);
+	outputPlanTimePruning(env, node->part_prune_info);
 #endif	
 
 	env.popNode();
@@ -4526,12 +4749,13 @@ outputMergeAppend(NodeInfoEnv& env, const MergeAppend *node)
 	WRITE_NODE_FIELD(mergeplans);
 	WRITE_INT_FIELD(numCols);
 	env.outputAttrNumberArray("sortColIdx", node->numCols, node->sortColIdx);
-	env.outputOidArray("sortOperators", node->numCols, node->sortOperators);
-	env.outputOidArray("collations", node->numCols, node->collations);
+	env.outputOidArray("sortOperators", node->numCols, node->sortOperators, OID_KIND_OPERATOR);
+	env.outputOidArray("collations", node->numCols, node->collations, OID_KIND_COLLATION);
 	env.outputBoolArray("nullsFirst", node->numCols, node->nullsFirst);
 	
 #if PG_VERSION_NUM >= 120000
 	WRITE_NODE_FIELD(part_prune_info);
+	outputPlanTimePruning(env, node->part_prune_info);
 #endif		
 
 	env.popNode();
@@ -4547,9 +4771,9 @@ outputRecursiveUnion(NodeInfoEnv& env, const RecursiveUnion *node)
 	WRITE_INT_FIELD(wtParam);
 	WRITE_INT_FIELD(numCols);
 	env.outputAttrNumberArray("dupColIdx", node->numCols, node->dupColIdx);
-	env.outputOidArray("dupOperators", node->numCols, node->dupOperators);
+	env.outputOidArray("dupOperators", node->numCols, node->dupOperators, OID_KIND_OPERATOR);
 #if PG_VERSION_NUM >= 120000
-	env.outputOidArray("dupCollations", node->numCols, node->dupCollations);
+	env.outputOidArray("dupCollations", node->numCols, node->dupCollations, OID_KIND_COLLATION);
 #endif
 	WRITE_LONG_FIELD(numGroups);
 
@@ -4622,7 +4846,7 @@ outputIndexScan(NodeInfoEnv& env, const IndexScan *node)
 
 	_outputScan(env, &node->scan);
 
-	WRITE_OID_FIELD(indexid);
+	WRITE_RELOID_FIELD(indexid);
 	WRITE_NODE_FIELD(indexqual);
 	WRITE_NODE_FIELD(indexqualorig);
 #if PG_VERSION_NUM >= 90100
@@ -4645,7 +4869,7 @@ outputIndexOnlyScan(NodeInfoEnv& env, const IndexOnlyScan *node)
 
 	_outputScan(env, &node->scan);
 
-	WRITE_OID_FIELD(indexid);
+	WRITE_RELOID_FIELD(indexid);
 	WRITE_NODE_FIELD(indexqual);
 	WRITE_NODE_FIELD(indexorderby);
 	WRITE_NODE_FIELD(indextlist);
@@ -4662,7 +4886,7 @@ outputBitmapIndexScan(NodeInfoEnv& env, const BitmapIndexScan *node)
 
 	_outputScan(env, &node->scan);
 
-	WRITE_OID_FIELD(indexid);
+	WRITE_RELOID_FIELD(indexid);
 #if PG_VERSION_NUM >= 100000
 	WRITE_BOOL_FIELD(isshared);
 #endif
@@ -4890,7 +5114,7 @@ outputMergeJoin(NodeInfoEnv& env, const MergeJoin *node)
 	
 	env.outputOidArray("mergeFamilies", numCols, node->mergeFamilies);
 #if PG_VERSION_NUM >= 90100
-	env.outputOidArray("mergeCollations", numCols, node->mergeCollations);
+	env.outputOidArray("mergeCollations", numCols, node->mergeCollations, OID_KIND_COLLATION);
 #endif
 	env.outputIntArray("mergeStrategies", numCols, node->mergeStrategies);
 	env.outputBoolArray("mergeNullsFirst", numCols, node->mergeNullsFirst);
@@ -4935,9 +5159,9 @@ outputSort(NodeInfoEnv& env, const Sort *node)
 	WRITE_INT_FIELD(numCols);
 
 	env.outputAttrNumberArray("sortColIdx", node->numCols, node->sortColIdx);
-	env.outputOidArray("sortOperators", node->numCols, node->sortOperators);
+	env.outputOidArray("sortOperators", node->numCols, node->sortOperators, OID_KIND_OPERATOR);
 #if PG_VERSION_NUM >= 90100
-	env.outputOidArray("collations", node->numCols, node->collations);
+	env.outputOidArray("collations", node->numCols, node->collations, OID_KIND_COLLATION);
 #endif
 	env.outputBoolArray("nullsFirst", node->numCols, node->nullsFirst);
 
@@ -4954,9 +5178,9 @@ outputGroup(NodeInfoEnv& env, const Group *node)
 	WRITE_INT_FIELD(numCols);
 
 	env.outputAttrNumberArray("grpColIdx", node->numCols, node->grpColIdx);
-	env.outputOidArray("grpOperators", node->numCols, node->grpOperators);
+	env.outputOidArray("grpOperators", node->numCols, node->grpOperators, OID_KIND_OPERATOR);
 #if PG_VERSION_NUM >= 120000
-	env.outputOidArray("grpCollations", node->numCols, node->grpCollations);
+	env.outputOidArray("grpCollations", node->numCols, node->grpCollations, OID_KIND_COLLATION);
 #endif
 
 	env.popNode();
@@ -4976,9 +5200,9 @@ outputAgg(NodeInfoEnv& env, const Agg *node)
 	WRITE_INT_FIELD(numCols);
 
 	env.outputAttrNumberArray("grpColIdx", node->numCols, node->grpColIdx);
-	env.outputOidArray("grpOperators", node->numCols, node->grpOperators);
+	env.outputOidArray("grpOperators", node->numCols, node->grpOperators, OID_KIND_OPERATOR);
 #if PG_VERSION_NUM >= 120000
-	env.outputOidArray("grpCollations", node->numCols, node->grpCollations);
+	env.outputOidArray("grpCollations", node->numCols, node->grpCollations, OID_KIND_COLLATION);
 #endif	
 
 	WRITE_LONG_FIELD(numGroups);
@@ -5006,26 +5230,26 @@ outputWindowAgg(NodeInfoEnv& env, const WindowAgg *node)
 	WRITE_INT_FIELD(partNumCols);
 
 	env.outputAttrNumberArray("partColIdx", node->partNumCols, node->partColIdx);
-	env.outputOidArray("partOperators", node->partNumCols, node->partOperators);
+	env.outputOidArray("partOperators", node->partNumCols, node->partOperators, OID_KIND_OPERATOR);
 #if PG_VERSION_NUM >= 120000
-	env.outputOidArray("partCollations", node->partNumCols, node->partCollations);
+	env.outputOidArray("partCollations", node->partNumCols, node->partCollations, OID_KIND_COLLATION);
 #endif		
 
 	WRITE_INT_FIELD(ordNumCols);
 
 	env.outputAttrNumberArray("ordColIdx", node->ordNumCols, node->ordColIdx);
-	env.outputOidArray("ordOperators", node->ordNumCols, node->ordOperators);
+	env.outputOidArray("ordOperators", node->ordNumCols, node->ordOperators, OID_KIND_OPERATOR);
 #if PG_VERSION_NUM >= 120000
-	env.outputOidArray("ordCollations", node->ordNumCols, node->ordCollations);
+	env.outputOidArray("ordCollations", node->ordNumCols, node->ordCollations, OID_KIND_COLLATION);
 #endif			
 
 	WRITE_INT_FIELD(frameOptions);
 	WRITE_NODE_FIELD(startOffset);
 	WRITE_NODE_FIELD(endOffset);
 #if PG_VERSION_NUM >= 110000
-	WRITE_OID_FIELD(startInRangeFunc);
-	WRITE_OID_FIELD(endInRangeFunc);
-	WRITE_OID_FIELD(inRangeColl);
+	WRITE_FUNCOID_FIELD(startInRangeFunc);
+	WRITE_FUNCOID_FIELD(endInRangeFunc);
+	WRITE_COLLOID_FIELD(inRangeColl);
 	WRITE_BOOL_FIELD(inRangeAsc);
 	WRITE_BOOL_FIELD(inRangeNullsFirst);
 #endif
@@ -5043,9 +5267,9 @@ outputUnique(NodeInfoEnv& env, const Unique *node)
 	WRITE_INT_FIELD(numCols);
 
 	env.outputAttrNumberArray("uniqColIdx", node->numCols, node->uniqColIdx);
-	env.outputOidArray("uniqOperators", node->numCols, node->uniqOperators);
+	env.outputOidArray("uniqOperators", node->numCols, node->uniqOperators, OID_KIND_OPERATOR);
 #if PG_VERSION_NUM >= 120000
-	env.outputOidArray("uniqCollations", node->numCols, node->uniqCollations);
+	env.outputOidArray("uniqCollations", node->numCols, node->uniqCollations, OID_KIND_COLLATION);
 #endif				
 
 	env.popNode();
@@ -5088,8 +5312,8 @@ outputGatherMerge(NodeInfoEnv& env, const GatherMerge *node)
 #endif
 	
 	env.outputAttrNumberArray("sortColIdx", node->numCols, node->sortColIdx);
-	env.outputOidArray("sortOperators", node->numCols, node->sortOperators);
-	env.outputOidArray("collations", node->numCols, node->collations);
+	env.outputOidArray("sortOperators", node->numCols, node->sortOperators, OID_KIND_OPERATOR);
+	env.outputOidArray("collations", node->numCols, node->collations, OID_KIND_COLLATION);
 	env.outputBoolArray("nullsFirst", node->numCols, node->nullsFirst);
 
 #if PG_VERSION_NUM >= 110000
@@ -5110,11 +5334,11 @@ outputHash(NodeInfoEnv& env, const Hash *node)
 #if PG_VERSION_NUM >= 120000
 	WRITE_NODE_FIELD(hashkeys);
 #endif
-	WRITE_OID_FIELD(skewTable);
+	WRITE_RELOID_FIELD(skewTable);
 	WRITE_ATTRNUMBER_FIELD(skewColumn);
 	WRITE_BOOL_FIELD(skewInherit);
 #if PG_VERSION_NUM < 100000
-	WRITE_OID_FIELD(skewColType);
+	WRITE_TYPEOID_FIELD(skewColType);
 	WRITE_INT_FIELD(skewColTypmod);
 #endif
 #if PG_VERSION_NUM >= 110000
@@ -5136,9 +5360,9 @@ outputSetOp(NodeInfoEnv& env, const SetOp *node)
 	WRITE_INT_FIELD(numCols);
 
 	env.outputAttrNumberArray("dupColIdx", node->numCols, node->dupColIdx);
-	env.outputOidArray("dupOperators", node->numCols, node->dupOperators);
+	env.outputOidArray("dupOperators", node->numCols, node->dupOperators, OID_KIND_OPERATOR);
 #if PG_VERSION_NUM >= 120000
-	env.outputOidArray("dupCollations", node->numCols, node->dupCollations);
+	env.outputOidArray("dupCollations", node->numCols, node->dupCollations, OID_KIND_COLLATION);
 #endif
 
 	WRITE_ATTRNUMBER_FIELD(flagColIdx);
@@ -5228,7 +5452,7 @@ outputPartitionedRelPruneInfo(NodeInfoEnv& env, const PartitionedRelPruneInfo *n
 #if PG_VERSION_NUM >= 120000
 	WRITE_INDEX_FIELD(rtindex);
 #else
-	WRITE_OID_FIELD(reloid);
+	WRITE_RELOID_FIELD(reloid);
 	WRITE_NODE_FIELD(pruning_steps);
 #endif
 	WRITE_BITMAPSET_FIELD(present_parts);
@@ -5240,7 +5464,7 @@ outputPartitionedRelPruneInfo(NodeInfoEnv& env, const PartitionedRelPruneInfo *n
 	env.outputIntArray("subplan_map", node->nparts, node->subplan_map);
 	env.outputIntArray("subpart_map", node->nparts, node->subpart_map);
 #if PG_VERSION_NUM >= 120000
-	env.outputOidArray("relid_map", node->nparts, node->relid_map);
+	env.outputOidArray("relid_map", node->nparts, node->relid_map, OID_KIND_RELATION);
 #else
 	if (node->hasexecparam)
 		env.outputBool("hasexecparam", *node->hasexecparam);
@@ -5263,6 +5487,94 @@ _outputPartitionPruneStep(NodeInfoEnv& env, const PartitionPruneStep *node)
 	WRITE_INT_FIELD(step_id);	
 }
 
+/*
+ * Writes a pruning expression briefly: constants by value, parameters by
+ * number, anything else by node type.
+ */
+static void
+outputPruneExpr(NodeInfoEnv& env, const Node *expr)
+{
+	if (IsA(expr, Const))
+	{
+		const Const *con = reinterpret_cast<const Const *>(expr);
+		Oid		typoutput;
+		bool	typisvarlena;
+		char   *str;
+
+		if (con->constisnull)
+		{
+			env.append("NULL");
+			return;
+		}
+
+		getTypeOutputInfo(con->consttype, &typoutput, &typisvarlena);
+		str = OidOutputFunctionCall(typoutput, con->constvalue);
+		env.append("'");
+		env.appendName(str);
+		env.append("'");
+		pfree(str);
+	}
+	else if (IsA(expr, Param))
+		env.append("$%d", reinterpret_cast<const Param *>(expr)->paramid);
+	else
+	{
+		const NodeDesc *desc = lookupNodeDesc(nodeTag(expr));
+		env.append("(%s)", desc ? desc->name : "expr");
+	}
+}
+
+/*
+ * Writes the step as a predicate over the partition key, such as
+ * "(key0, key1) >= ('2020-01-01', $1)".  For hash partitioning the strategy
+ * is always equality.
+ */
+static void
+outputPruneStepPredicate(NodeInfoEnv& env, const PartitionPruneStepOp *node)
+{
+	static const char *const strategy_names[] = {"?", "<", "<=", "=", ">=", ">"};
+	int nexprs = list_length(node->exprs);
+	int keyno = 0;
+	bool first = true;
+	ListCell *lc;
+	int x;
+
+	env.append("|predicate: ");
+
+	if (nexprs > 0)
+	{
+		env.append(nexprs > 1 ? "(" : "");
+		for (keyno = 0 ; keyno < nexprs ; keyno++)
+			env.append(keyno > 0 ? ", key%d" : "key%d", keyno);
+		env.append(nexprs > 1 ? ") " : " ");
+
+		if (node->opstrategy < lengthof(strategy_names))
+			env.appendName(strategy_names[node->opstrategy]);
+		else
+			env.append("op%u", node->opstrategy);
+
+		env.append(nexprs > 1 ? " (" : " ");
+		keyno = 0;
+		foreach(lc, node->exprs)
+		{
+			if (keyno++ > 0)
+				env.append(", ");
+			outputPruneExpr(env, reinterpret_cast<const Node *>(lfirst(lc)));
+		}
+		env.append(nexprs > 1 ? ")" : "");
+		first = false;
+	}
+
+	x = -1;
+	while ((x = bms_next_member(node->nullkeys, x)) >= 0)
+	{
+		env.append(first ? "key%d IS NULL" : " AND key%d IS NULL", x);
+		first = false;
+	}
+
+	if (first)
+		env.append("all partitions");
+}
+
 static void
 outputPartitionPruneStepOp(NodeInfoEnv& env, const PartitionPruneStepOp *node)
 {
@@ -5270,6 +5582,7 @@ outputPartitionPruneStepOp(NodeInfoEnv& env, const PartitionPruneStepOp *node)
 
 	_outputPartitionPruneStep(env, &node->step);
 
+	outputPruneStepPredicate(env, node);
 	WRITE_UINT_FIELD(opstrategy);
 	WRITE_NODE_FIELD(exprs);
 	WRITE_NODE_FIELD(cmpfns);
@@ -5285,6 +5598,19 @@ outputPartitionPruneStepCombine(NodeInfoEnv& env, const PartitionPruneStepCombin
 
 	_outputPartitionPruneStep(env, &node->step);
 
+	{
+		ListCell *lc;
+		bool first = true;
+
+		env.append("|predicate: ");
+		foreach(lc, node->source_stepids)
+		{
+			if (!first)
+				env.append(node->combineOp == PARTPRUNE_COMBINE_UNION ? " OR " : " AND ");
+			env.append("step%d", lfirst_int(lc));
+			first = false;
+		}
+	}
 	WRITE_ENUM_FIELD(combineOp, PartitionPruneCombineOp);
 	WRITE_NODE_FIELD(source_stepids);
 	
@@ -5392,10 +5718,10 @@ outputVar(NodeInfoEnv& env, const Var *node)
 
 	WRITE_INDEX_FIELD(varno); /* index of this var's relation in the range table, or INNER_VAR/OUTER_VAR/INDEX_VAR */
 	WRITE_ATTRNUMBER_FIELD(varattno);
-	WRITE_OID_FIELD(vartype);
+	WRITE_TYPEOID_FIELD(vartype);
 	WRITE_INT_FIELD(vartypmod);
 #if PG_VERSION_NUM >= 90100
-	WRITE_OID_FIELD(varcollid);
+	WRITE_COLLOID_FIELD(varcollid);
 #endif
 	WRITE_INDEX_FIELD(varlevelsup); /* for subquery variables referencing outer
 									   relations; 0 in a normal var, >0 means N
@@ -5412,10 +5738,10 @@ outputConst(NodeInfoEnv& env, const Const *node)
 {
 	env.pushNode(node, "Const");
 
-	WRITE_OID_FIELD(consttype);
+	WRITE_TYPEOID_FIELD(consttype);
 	WRITE_INT_FIELD(consttypmod);
 #if PG_VERSION_NUM >= 90100
-	WRITE_OID_FIELD(constcollid);
+	WRITE_COLLOID_FIELD(constcollid);
 #endif
 	WRITE_INT_FIELD(constlen);
 	WRITE_BOOL_FIELD(constbyval);
@@ -5445,10 +5771,10 @@ outputParam(NodeInfoEnv& env, const Param *node)
 
 	WRITE_ENUM_FIELD(paramkind, ParamKind);
 	WRITE_INT_FIELD(paramid);
-	WRITE_OID_FIELD(paramtype);
+	WRITE_TYPEOID_FIELD(paramtype);
 	WRITE_INT_FIELD(paramtypmod);
 #if PG_VERSION_NUM >= 90100
-	WRITE_OID_FIELD(paramcollid);
+	WRITE_COLLOID_FIELD(paramcollid);
 #endif
 	WRITE_LOCATION_FIELD(location);
 
@@ -5460,14 +5786,14 @@ outputAggref(NodeInfoEnv& env, const Aggref *node)
 {
 	env.pushNode(node, "Aggref");
 
-	WRITE_OID_FIELD(aggfnoid);
-	WRITE_OID_FIELD(aggtype);
+	WRITE_FUNCOID_FIELD(aggfnoid);
+	WRITE_TYPEOID_FIELD(aggtype);
 #if PG_VERSION_NUM >= 90100
-	WRITE_OID_FIELD(aggcollid);
-	WRITE_OID_FIELD(inputcollid);
+	WRITE_COLLOID_FIELD(aggcollid);
+	WRITE_COLLOID_FIELD(inputcollid);
 #endif
 #if PG_VERSION_NUM >= 90600
-	WRITE_OID_FIELD(aggtranstype);
+	WRITE_TYPEOID_FIELD(aggtranstype);
 #endif
 #if PG_VERSION_NUM >= 90600	
 	WRITE_NODE_FIELD(aggargtypes);
@@ -5516,11 +5842,11 @@ outputWindowFunc(NodeInfoEnv& env, const WindowFunc *node)
 {
 	env.pushNode(node, "WindowFunc");
 
-	WRITE_OID_FIELD(winfnoid);
-	WRITE_OID_FIELD(wintype);
+	WRITE_FUNCOID_FIELD(winfnoid);
+	WRITE_TYPEOID_FIELD(wintype);
 #if PG_VERSION_NUM >= 90100
-	WRITE_OID_FIELD(wincollid);
-	WRITE_OID_FIELD(inputcollid);
+	WRITE_COLLOID_FIELD(wincollid);
+	WRITE_COLLOID_FIELD(inputcollid);
 #endif
 	WRITE_NODE_FIELD(args);
 #if PG_VERSION_NUM >= 90400
@@ -5541,10 +5867,10 @@ outputSubscriptingRef(NodeInfoEnv& env, const SubscriptingRef *node)
 {
 	env.pushNode(node, "SubscriptingRef");
 
-	WRITE_OID_FIELD(refcontainertype);
-	WRITE_OID_FIELD(refelemtype);
+	WRITE_TYPEOID_FIELD(refcontainertype);
+	WRITE_TYPEOID_FIELD(refelemtype);
 	WRITE_INT32_FIELD(reftypmod);
-	WRITE_OID_FIELD(refcollid);
+	WRITE_COLLOID_FIELD(refcollid);
 	WRITE_NODE_FIELD(refupperindexpr);
 	WRITE_NODE_FIELD(reflowerindexpr);
 	WRITE_NODE_FIELD(refexpr);
@@ -5560,11 +5886,11 @@ outputArrayRef(NodeInfoEnv& env, const ArrayRef *node)
 {
 	env.pushNode(node, "ArrayRef");
 
-	WRITE_OID_FIELD(refarraytype);
-	WRITE_OID_FIELD(refelemtype);
+	WRITE_TYPEOID_FIELD(refarraytype);
+	WRITE_TYPEOID_FIELD(refelemtype);
 	WRITE_INT_FIELD(reftypmod);
 #if PG_VERSION_NUM >= 90100
-	WRITE_OID_FIELD(refcollid);
+	WRITE_COLLOID_FIELD(refcollid);
 #endif
 	WRITE_NODE_FIELD(refupperindexpr);
 	WRITE_NODE_FIELD(reflowerindexpr);
@@ -5581,16 +5907,16 @@ outputFuncExpr(NodeInfoEnv& env, const FuncExpr *node)
 {
 	env.pushNode(node, "FuncExpr");
 
-	WRITE_OID_FIELD(funcid);
-	WRITE_OID_FIELD(funcresulttype);
+	WRITE_FUNCOID_FIELD(funcid);
+	WRITE_TYPEOID_FIELD(funcresulttype);
 	WRITE_BOOL_FIELD(funcretset);
 #if PG_VERSION_NUM >= 90400
 	WRITE_BOOL_FIELD(funcvariadic);
 #endif
 	WRITE_ENUM_FIELD(funcformat, CoercionForm);
 #if PG_VERSION_NUM >= 90100
-	WRITE_OID_FIELD(funccollid);
-	WRITE_OID_FIELD(inputcollid);
+	WRITE_COLLOID_FIELD(funccollid);
+	WRITE_COLLOID_FIELD(inputcollid);
 #endif
 	WRITE_NODE_FIELD(args);
 	WRITE_LOCATION_FIELD(location);
@@ -5646,11 +5972,11 @@ outputScalarArrayOpExpr(NodeInfoEnv& env, const ScalarArrayOpExpr *node)
 {
 	env.pushNode(node, "ScalarArrayOpExpr");
 
-	WRITE_OID_FIELD(opno);
-	WRITE_OID_FIELD(opfuncid);
+	WRITE_OPEROID_FIELD(opno);
+	WRITE_FUNCOID_FIELD(opfuncid);
 	WRITE_BOOL_FIELD(useOr);
 #if PG_VERSION_NUM >= 90100
-	WRITE_OID_FIELD(inputcollid);
+	WRITE_COLLOID_FIELD(inputcollid);
 #endif
 	WRITE_NODE_FIELD(args);
 	WRITE_LOCATION_FIELD(location);
@@ -5697,10 +6023,10 @@ outputSubPlan(NodeInfoEnv& env, const SubPlan *node)
 	WRITE_NODE_FIELD(paramIds);
 	WRITE_INT_FIELD(plan_id);
 	WRITE_STRING_FIELD(plan_name);
-	WRITE_OID_FIELD(firstColType);
+	WRITE_TYPEOID_FIELD(firstColType);
 	WRITE_INT_FIELD(firstColTypmod);
 #if PG_VERSION_NUM >= 90100
-	WRITE_OID_FIELD(firstColCollation);
+	WRITE_COLLOID_FIELD(firstColCollation);
 #endif
 	WRITE_BOOL_FIELD(useHashTable);
 	WRITE_BOOL_FIELD(unknownEqFalse);
@@ -5733,10 +6059,10 @@ outputFieldSelect(NodeInfoEnv& env, const FieldSelect *node)
 
 	WRITE_NODE_FIELD(arg);
 	WRITE_ATTRNUMBER_FIELD(fieldnum);
-	WRITE_OID_FIELD(resulttype);
+	WRITE_TYPEOID_FIELD(resulttype);
 	WRITE_INT32_FIELD(resulttypmod);
 #if PG_VERSION_NUM >= 90100
-	WRITE_OID_FIELD(resultcollid);
+	WRITE_COLLOID_FIELD(resultcollid);
 #endif
 
 	env.popNode();
@@ -5750,7 +6076,7 @@ outputFieldStore(NodeInfoEnv& env, const FieldStore *node)
 	WRITE_NODE_FIELD(arg);
 	WRITE_NODE_FIELD(newvals);
 	WRITE_NODE_FIELD(fieldnums);
-	WRITE_OID_FIELD(resulttype);
+	WRITE_TYPEOID_FIELD(resulttype);
 	
 	env.popNode();
 }
@@ -5761,10 +6087,10 @@ outputRelabelType(NodeInfoEnv& env, const RelabelType *node)
 	env.pushNode(node, "RelabelType");
 
 	WRITE_NODE_FIELD(arg);
-	WRITE_OID_FIELD(resulttype);
+	WRITE_TYPEOID_FIELD(resulttype);
 	WRITE_INT32_FIELD(resulttypmod);
 #if PG_VERSION_NUM >= 90100	
-	WRITE_OID_FIELD(resultcollid);
+	WRITE_COLLOID_FIELD(resultcollid);
 #endif
 	WRITE_ENUM_FIELD(relabelformat, CoercionForm);
 	WRITE_LOCATION_FIELD(location);
@@ -5778,9 +6104,9 @@ outputCoerceViaIO(NodeInfoEnv& env, const CoerceViaIO *node)
 	env.pushNode(node, "CoerceViaIO");
 
 	WRITE_NODE_FIELD(arg);
-	WRITE_OID_FIELD(resulttype);
+	WRITE_TYPEOID_FIELD(resulttype);
 #if PG_VERSION_NUM >= 90100
-	WRITE_OID_FIELD(resultcollid);
+	WRITE_COLLOID_FIELD(resultcollid);
 #endif
 	WRITE_ENUM_FIELD(coerceformat, CoercionForm);
 	WRITE_LOCATION_FIELD(location);
@@ -5797,12 +6123,12 @@ outputArrayCoerceExpr(NodeInfoEnv& env, const ArrayCoerceExpr *node)
 #if PG_VERSION_NUM >= 110000
 	WRITE_NODE_FIELD(elemexpr);
 #else	
-	WRITE_OID_FIELD(elemfuncid);
+	WRITE_FUNCOID_FIELD(elemfuncid);
 #endif	
-	WRITE_OID_FIELD(resulttype);
+	WRITE_TYPEOID_FIELD(resulttype);
 	WRITE_INT32_FIELD(resulttypmod);
 #if PG_VERSION_NUM >= 90100
-	WRITE_OID_FIELD(resultcollid);
+	WRITE_COLLOID_FIELD(resultcollid);
 #endif
 #if PG_VERSION_NUM < 110000	
 	WRITE_BOOL_FIELD(isExplicit);
@@ -5819,7 +6145,7 @@ outputConvertRowtypeExpr(NodeInfoEnv& env, const ConvertRowtypeExpr *node)
 	env.pushNode(node, "ConvertRowtypeExpr");
 
 	WRITE_NODE_FIELD(arg);
-	WRITE_OID_FIELD(resulttype);
+	WRITE_TYPEOID_FIELD(resulttype);
 	WRITE_ENUM_FIELD(convertformat, CoercionForm);
 	WRITE_LOCATION_FIELD(location);
 
@@ -5833,7 +6159,7 @@ outputCollateExpr(NodeInfoEnv& env, const CollateExpr *node)
 	env.pushNode(node, "CollateExpr");
 
 	WRITE_NODE_FIELD(arg);
-	WRITE_OID_FIELD(collOid);
+	WRITE_COLLOID_FIELD(collOid);
 	WRITE_LOCATION_FIELD(location);
 
 	env.popNode();
@@ -5845,9 +6171,9 @@ outputCaseExpr(NodeInfoEnv& env, const CaseExpr *node)
 {
 	env.pushNode(node, "CaseExpr");
 
-	WRITE_OID_FIELD(casetype);
+	WRITE_TYPEOID_FIELD(casetype);
 #if PG_VERSION_NUM >= 90100
-	WRITE_OID_FIELD(casecollid);
+	WRITE_COLLOID_FIELD(casecollid);
 #endif
 	WRITE_NODE_FIELD(arg);
 	WRITE_NODE_FIELD(args);
@@ -5874,10 +6200,10 @@ outputCaseTestExpr(NodeInfoEnv& env, const CaseTestExpr *node)
 {
 	env.pushNode(node, "CaseTestExpr");
 
-	WRITE_OID_FIELD(typeId);
+	WRITE_TYPEOID_FIELD(typeId);
 	WRITE_INT_FIELD(typeMod);
 #if PG_VERSION_NUM >= 90100
-	WRITE_OID_FIELD(collation);
+	WRITE_COLLOID_FIELD(collation);
 #endif
 
 	env.popNode();
@@ -5888,11 +6214,11 @@ outputArrayExpr(NodeInfoEnv& env, const ArrayExpr *node)
 {
 	env.pushNode(node, "ArrayExpr");
 
-	WRITE_OID_FIELD(array_typeid);
+	WRITE_TYPEOID_FIELD(array_typeid);
 #if PG_VERSION_NUM >= 90100
-	WRITE_OID_FIELD(array_collid);
+	WRITE_COLLOID_FIELD(array_collid);
 #endif
-	WRITE_OID_FIELD(element_typeid);
+	WRITE_TYPEOID_FIELD(element_typeid);
 	WRITE_NODE_FIELD(elements);
 	WRITE_BOOL_FIELD(multidims);
 	WRITE_LOCATION_FIELD(location);
@@ -5906,7 +6232,7 @@ outputRowExpr(NodeInfoEnv& env, const RowExpr *node)
 	env.pushNode(node, "RowExpr");
 
 	WRITE_NODE_FIELD(args);
-	WRITE_OID_FIELD(row_typeid);
+	WRITE_TYPEOID_FIELD(row_typeid);
 	WRITE_ENUM_FIELD(row_format, CoercionForm);
 	WRITE_NODE_FIELD(colnames);
 	WRITE_LOCATION_FIELD(location);
@@ -5936,9 +6262,9 @@ outputCoalesceExpr(NodeInfoEnv& env, const CoalesceExpr *node)
 {
 	env.pushNode(node, "CoalesceExpr");
 
-	WRITE_OID_FIELD(coalescetype);
+	WRITE_TYPEOID_FIELD(coalescetype);
 #if PG_VERSION_NUM >= 90100
-	WRITE_OID_FIELD(coalescecollid);
+	WRITE_COLLOID_FIELD(coalescecollid);
 #endif
 	WRITE_NODE_FIELD(args);
 	WRITE_LOCATION_FIELD(location);
@@ -5951,10 +6277,10 @@ outputMinMaxExpr(NodeInfoEnv& env, const MinMaxExpr *node)
 {
 	env.pushNode(node, "MinMaxExpr");
 
-	WRITE_OID_FIELD(minmaxtype);
+	WRITE_TYPEOID_FIELD(minmaxtype);
 #if PG_VERSION_NUM >= 90100
-	WRITE_OID_FIELD(minmaxcollid);
-	WRITE_OID_FIELD(inputcollid);
+	WRITE_COLLOID_FIELD(minmaxcollid);
+	WRITE_COLLOID_FIELD(inputcollid);
 #endif
 	WRITE_ENUM_FIELD(op, MinMaxOp);
 	WRITE_NODE_FIELD(args);
@@ -5970,7 +6296,7 @@ outputSQLValueFunction(NodeInfoEnv& env, const SQLValueFunction *node)
 	env.pushNode(node, "SQLValueFunction");
 
 	WRITE_ENUM_FIELD(op, SQLValueFunctionOp);
-	WRITE_OID_FIELD(type);
+	WRITE_TYPEOID_FIELD(type);
 	WRITE_INT32_FIELD(typmod);
 	WRITE_LOCATION_FIELD(location);
 
@@ -5989,7 +6315,7 @@ outputXmlExpr(NodeInfoEnv& env, const XmlExpr *node)
 	WRITE_NODE_FIELD(arg_names);
 	WRITE_NODE_FIELD(args);
 	WRITE_ENUM_FIELD(xmloption, XmlOptionType);
-	WRITE_OID_FIELD(type);
+	WRITE_TYPEOID_FIELD(type);
 	WRITE_INT32_FIELD(typmod);
 	WRITE_LOCATION_FIELD(location);
 
@@ -6031,10 +6357,10 @@ outputCoerceToDomain(NodeInfoEnv& env, const CoerceToDomain *node)
 	env.pushNode(node, "CoerceToDomain");
 
 	WRITE_NODE_FIELD(arg);
-	WRITE_OID_FIELD(resulttype);
+	WRITE_TYPEOID_FIELD(resulttype);
 	WRITE_INT32_FIELD(resulttypmod);
 #if PG_VERSION_NUM >= 90100
-	WRITE_OID_FIELD(resultcollid);
+	WRITE_COLLOID_FIELD(resultcollid);
 #endif
 	WRITE_ENUM_FIELD(coercionformat, CoercionForm);
 	WRITE_LOCATION_FIELD(location);
@@ -6047,10 +6373,10 @@ outputCoerceToDomainValue(NodeInfoEnv& env, const CoerceToDomainValue *node)
 {
 	env.pushNode(node, "CoerceToDomainValue");
 
-	WRITE_OID_FIELD(typeId);
+	WRITE_TYPEOID_FIELD(typeId);
 	WRITE_INT32_FIELD(typeMod);
 #if PG_VERSION_NUM >= 90100
-	WRITE_OID_FIELD(collation);
+	WRITE_COLLOID_FIELD(collation);
 #endif
 	WRITE_LOCATION_FIELD(location);
 
@@ -6062,10 +6388,10 @@ outputSetToDefault(NodeInfoEnv& env, const SetToDefault *node)
 {
 	env.pushNode(node, "SetToDefault");
 
-	WRITE_OID_FIELD(typeId);
+	WRITE_TYPEOID_FIELD(typeId);
 	WRITE_INT_FIELD(typeMod);
 #if PG_VERSION_NUM >= 90100
-	WRITE_OID_FIELD(collation);
+	WRITE_COLLOID_FIELD(collation);
 #endif
 	WRITE_LOCATION_FIELD(location);
 
@@ -6091,7 +6417,7 @@ outputInferenceElem(NodeInfoEnv& env, const InferenceElem *node)
 	env.pushNode(node, "InferenceElem");
 
 	WRITE_NODE_FIELD(expr);
-	WRITE_OID_FIELD(infercollid);
+	WRITE_COLLOID_FIELD(infercollid);
 	WRITE_OID_FIELD(inferopclass);
 
 	env.popNode();
@@ -6108,7 +6434,7 @@ outputTargetEntry(NodeInfoEnv& env, const TargetEntry *node)
 	WRITE_STRING_FIELD(resname);
 	if (node->ressortgroupref)
 		WRITE_INDEX_FIELD(ressortgroupref); /* sort/group clause */
-	WRITE_OID_FIELD(resorigtbl);
+	WRITE_RELOID_FIELD(resorigtbl);
 	if (node->resorigcol)
 		WRITE_ATTRNUMBER_FIELD(resorigcol);
 	WRITE_BOOL_FIELD(resjunk);
@@ -6179,8 +6505,8 @@ outputNextValueExpr(NodeInfoEnv& env, const NextValueExpr *node)
 {
 	env.pushNode(node, "NextValueExpr");
 	
-	WRITE_OID_FIELD(seqid);
-	WRITE_OID_FIELD(typeId);
+	WRITE_RELOID_FIELD(seqid);
+	WRITE_TYPEOID_FIELD(typeId);
 
 	env.popNode();
 }
@@ -6592,8 +6918,8 @@ outputSortGroupClause(NodeInfoEnv& env, const SortGroupClause *node)
 	env.pushNode(node, "SortGroupClause");
 
 	WRITE_INDEX_FIELD(tleSortGroupRef); /* reference into targetlist */
-	WRITE_OID_FIELD(eqop);
-	WRITE_OID_FIELD(sortop);
+	WRITE_OPEROID_FIELD(eqop);
+	WRITE_OPEROID_FIELD(sortop);
 	WRITE_BOOL_FIELD(nulls_first);
 #if PG_VERSION_NUM >= 90100
 	WRITE_BOOL_FIELD(hashable);
@@ -6645,7 +6971,7 @@ outputRangeTblEntry(NodeInfoEnv& env, const RangeTblEntry *node)
 	switch (node->rtekind)
 	{
 		case RTE_RELATION:
-			WRITE_OID_FIELD(relid);
+			WRITE_RELOID_FIELD(relid);
 #if PG_VERSION_NUM >= 90100
 			WRITE_CHAR_FIELD(relkind);
 #endif
@@ -6756,6 +7082,378 @@ outputRangeTblFunction(NodeInfoEnv& env, const RangeTblFunction *node)
 #endif
 
 
+/****************************************************************************/
+/* Executor state nodes                                                     */
+/****************************************************************************/
+
+#if PG_VERSION_NUM >= 90600
+/*
+ * Returns the bytes allocated by a memory context and its children.
+ */
+static Size
+memoryContextTotalSpace(MemoryContext context)
+{
+#if PG_VERSION_NUM >= 130000
+	return MemoryContextMemAllocated(context, true);
+#else
+	MemoryContextCounters counters;
+	MemoryContext child;
+	Size total;
+
+	memset(&counters, 0, sizeof(counters));
+#if PG_VERSION_NUM >= 110000
+	context->methods->stats(context, NULL, NULL, &counters);
+#else
+	context->methods->stats(context, 0, false, &counters);
+#endif
+	total = counters.totalspace;
+
+	for (child = context->firstchild ; child != NULL ; child = child->nextchild)
+		total += memoryContextTotalSpace(child);
+
+	return total;
+#endif
+}
+#endif
+
+/*
+ * Returns the bytes allocated by a memory context and its children, or 0
+ * where the context statistics interface cannot report them.
+ */
+Size
+memory_context_total_space(MemoryContext context)
+{
+#if PG_VERSION_NUM >= 90600
+	return memoryContextTotalSpace(context);
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Writes the per-node counters collected in EXPLAIN ANALYZE style.
+ */
+static void
+outputInstrumentation(NodeInfoEnv& env, Instrumentation *instr)
+{
+	double nloops;
+
+	/* Fold the current loop into the totals, as ExplainNode() does */
+	InstrEndLoop(instr);
+
+	nloops = instr->nloops;
+	env.outputFloat("loops", nloops, "%.0f");
+
+	if (nloops <= 0)
+	{
+		env.append("|never executed");
+		return;
+	}
+
+	env.outputFloat("actual rows", instr->ntuples / nloops, "%.0f");
+
+#if PG_VERSION_NUM >= 90200
+	if (instr->need_timer)
+#endif
+	{
+		env.outputFloat("actual startup ms", 1000.0 * instr->startup / nloops, "%.3f");
+		env.outputFloat("actual total ms", 1000.0 * instr->total / nloops, "%.3f");
+	}
+
+#if PG_VERSION_NUM >= 90200
+	if (instr->nfiltered1 > 0)
+		env.outputFloat("rows removed by filter", instr->nfiltered1 / nloops, "%.0f");
+	if (instr->nfiltered2 > 0)
+		env.outputFloat("rows removed by join filter", instr->nfiltered2 / nloops, "%.0f");
+#endif
+
+#if PG_VERSION_NUM >= 90200
+	if (instr->need_bufusage)
+	{
+		const BufferUsage *usage = &instr->bufusage;
+
+		env.append("|buffers: shared hit=%ld read=%ld dirtied=%ld written=%ld",
+				   (long) usage->shared_blks_hit, (long) usage->shared_blks_read,
+				   (long) usage->shared_blks_dirtied, (long) usage->shared_blks_written);
+		if (usage->temp_blks_read > 0 || usage->temp_blks_written > 0)
+			env.append("|temp buffers: read=%ld written=%ld",
+					   (long) usage->temp_blks_read, (long) usage->temp_blks_written);
+	}
+#endif
+}
+
+static void
+outputHashStateDetails(NodeInfoEnv& env, const HashState *node)
+{
+	const HashJoinTableData *hashtable = node->hashtable;
+
+	if (hashtable == NULL)
+		return;
+
+#if PG_VERSION_NUM >= 90500
+	env.append("|buckets: %d (originally %d)", hashtable->nbuckets, hashtable->nbuckets_original);
+#else
+	env.append("|buckets: %d", hashtable->nbuckets);
+#endif
+	env.append("|batches: %d (originally %d)", hashtable->nbatch, hashtable->nbatch_original);
+	env.append("|peak memory: %ld kB", (long) ((hashtable->spacePeak + 1023) / 1024));
+}
+
+static void
+outputSortStateDetails(NodeInfoEnv& env, const SortState *node)
+{
+	Tuplesortstate *state = reinterpret_cast<Tuplesortstate *>(node->tuplesortstate);
+
+	if (!node->sort_Done || state == NULL)
+		return;
+
+#if PG_VERSION_NUM >= 110000
+	TuplesortInstrumentation stats;
+
+	tuplesort_get_stats(state, &stats);
+
+	env.outputString("sort method", tuplesort_method_name(stats.sortMethod));
+	env.append("|%s space used: %ld kB", tuplesort_space_type_name(stats.spaceType), stats.spaceUsed);
+#else
+	const char *sortMethod;
+	const char *spaceType;
+	long		spaceUsed;
+
+	tuplesort_get_stats(state, &sortMethod, &spaceType, &spaceUsed);
+
+	env.outputString("sort method", sortMethod);
+	env.append("|%s space used: %ld kB", spaceType, spaceUsed);
+#endif
+}
+
+static void
+outputAggStateDetails(NodeInfoEnv& env, const AggState *node)
+{
+	env.outputEnum("strategy", reinterpret_cast<const Agg *>(node->ss.ps.plan)->aggstrategy);
+
+#if PG_VERSION_NUM >= 100000
+	/* Hash table entries live in the per-tuple memory of hashcontext */
+	if (node->hashcontext != NULL)
+		env.append("|hash table memory: %ld kB",
+				   (long) ((memoryContextTotalSpace(node->hashcontext->ecxt_per_tuple_memory) + 1023) / 1024));
+#endif
+}
+
+static void
+outputMaterialStateDetails(NodeInfoEnv& env, const MaterialState *node)
+{
+	Tuplestorestate *state = node->tuplestorestate;
+
+	if (state == NULL)
+		return;
+
+	env.outputString("tuplestore", tuplestore_in_memory(state) ? "memory" : "disk");
+}
+
+#if PG_VERSION_NUM >= 90600
+/* A worker this much slower than the average of all workers is a straggler */
+#define WORKER_SKEW_RATIO		1.5
+
+/* ... provided it took at least this long, to ignore noise on tiny nodes */
+#define WORKER_SKEW_MIN_SECS	0.001
+
+#define WORKER_SKEW_COLOR		"lightpink"
+#define WORKERS_MISSING_COLOR	"khaki"
+
+/*
+ * Writes the rows, time and buffers of each parallel worker, and colors the
+ * node if one worker took much longer than the others: a parallel node runs
+ * only as fast as its slowest worker.
+ */
+static void
+outputWorkerInstrumentation(NodeInfoEnv& env, const PlanState *node, const WorkerInstrumentation *winstr)
+{
+	double	total = 0.0;
+	int		nworkers = 0;
+	int		i;
+
+	for (i = 0 ; i < winstr->num_workers ; i++)
+	{
+		if (winstr->instrument[i].nloops > 0)
+		{
+			total += winstr->instrument[i].total;
+			nworkers++;
+		}
+	}
+
+	for (i = 0 ; i < winstr->num_workers ; i++)
+	{
+		const Instrumentation *instr = &winstr->instrument[i];
+		double	nloops = instr->nloops;
+		bool	straggler;
+
+		if (nloops <= 0)
+			continue;
+
+		straggler = (nworkers > 1 &&
+					 instr->total >= WORKER_SKEW_MIN_SECS &&
+					 instr->total > WORKER_SKEW_RATIO * (total / nworkers));
+
+		env.append("|worker %d: rows=%.0f loops=%.0f", i, instr->ntuples / nloops, nloops);
+		if (instr->need_timer)
+			env.append(" time=%.3f ms", 1000.0 * instr->total / nloops);
+		if (instr->need_bufusage)
+			env.append(" shared hit=%ld read=%ld",
+					   (long) instr->bufusage.shared_blks_hit,
+					   (long) instr->bufusage.shared_blks_read);
+
+		if (straggler)
+		{
+			env.append(" (straggler)");
+			env.setNodeColor(node, WORKER_SKEW_COLOR);
+		}
+	}
+}
+#endif
+
+#if PG_VERSION_NUM >= 100000
+/*
+ * Workers are only launched once the Gather is first executed, and fewer
+ * than planned when max_parallel_workers is exhausted.
+ */
+static void
+outputWorkersLaunched(NodeInfoEnv& env, const PlanState *node, int planned, int launched)
+{
+	if (node->instrument == NULL || node->instrument->nloops <= 0)
+		return;
+
+	env.append("|workers launched: %d of %d", launched, planned);
+
+	if (launched < planned)
+		env.setNodeColor(node, WORKERS_MISSING_COLOR);
+}
+#endif
+
+#if PG_VERSION_NUM >= 110000
+/*
+ * Subplans removed by pruning at executor startup never get a PlanState, so
+ * they are the difference from the planned count.  Pruning during execution
+ * leaves the PlanState in place but never runs it; with instrumentation
+ * such subplans show up as never executed (though a LIMIT above can cause
+ * the same).
+ */
+static void
+outputRunTimePruning(NodeInfoEnv& env, const PlanState *node, int nplanned, int nplans, PlanState **subplans)
+{
+	int i;
+
+	env.append("|subplans: %d, init-pruned: %d", nplanned, nplanned - nplans);
+
+	if (node->instrument && node->instrument->nloops > 0)
+	{
+		int never_executed = 0;
+
+		for (i = 0 ; i < nplans ; i++)
+		{
+			Instrumentation *instr = subplans[i]->instrument;
+
+			if (instr)
+			{
+				InstrEndLoop(instr);
+				if (instr->nloops == 0)
+					never_executed++;
+			}
+		}
+
+		env.append("|exec-pruned (never executed): %d", never_executed);
+	}
+}
+#endif
+
+/*
+ * Label writer shared by all PlanState subtypes: the Plan it was made from,
+ * the instrumentation when the query was run, the child ports, and what
+ * the executor built at run time for hash, sort, aggregate and material
+ * nodes.
+ */
+static void
+outputPlanState(NodeInfoEnv& env, const PlanState *node)
+{
+	const NodeDesc *desc = lookupNodeDesc(nodeTag(node));
+	const Plan *plan = node->plan;
+
+	env.pushNode(node, desc ? desc->name : "PlanState");
+
+	if (plan != NULL)
+	{
+		const NodeDesc *plan_desc = lookupNodeDesc(nodeTag(plan));
+
+		env.outputString("plan", plan_desc ? plan_desc->name : "Unknown");
+		env.outputCost("startup_cost", plan->startup_cost);
+		env.outputCost("total_cost", plan->total_cost);
+		env.outputFloat("plan_rows", plan->plan_rows, "%.0f");
+#if PG_VERSION_NUM >= 90600
+		env.outputInt("plan_node_id", plan->plan_node_id);
+#endif
+	}
+
+	if (node->instrument)
+		outputInstrumentation(env, node->instrument);
+
+#if PG_VERSION_NUM >= 90600
+	if (node->worker_instrument)
+		outputWorkerInstrumentation(env, node, node->worker_instrument);
+#endif
+
+	if (desc)
+		outputFieldPorts(env, desc, node);
+
+	switch (nodeTag(node))
+	{
+#if PG_VERSION_NUM >= 110000
+		case T_AppendState:
+		{
+			const AppendState *state = reinterpret_cast<const AppendState *>(node);
+			outputRunTimePruning(env, node, list_length(reinterpret_cast<const Append *>(plan)->appendplans),
+								 state->as_nplans, state->appendplans);
+			break;
+		}
+#endif
+#if PG_VERSION_NUM >= 120000
+		case T_MergeAppendState:
+		{
+			const MergeAppendState *state = reinterpret_cast<const MergeAppendState *>(node);
+			outputRunTimePruning(env, node, list_length(reinterpret_cast<const MergeAppend *>(plan)->mergeplans),
+								 state->ms_nplans, state->mergeplans);
+			break;
+		}
+#endif
+		case T_HashState:
+			outputHashStateDetails(env, reinterpret_cast<const HashState *>(node));
+			break;
+		case T_SortState:
+			outputSortStateDetails(env, reinterpret_cast<const SortState *>(node));
+			break;
+		case T_AggState:
+			outputAggStateDetails(env, reinterpret_cast<const AggState *>(node));
+			break;
+		case T_MaterialState:
+			outputMaterialStateDetails(env, reinterpret_cast<const MaterialState *>(node));
+			break;
+#if PG_VERSION_NUM >= 100000
+		case T_GatherState:
+			outputWorkersLaunched(env, node,
+								  reinterpret_cast<const Gather *>(plan)->num_workers,
+								  reinterpret_cast<const GatherState *>(node)->nworkers_launched);
+			break;
+		case T_GatherMergeState:
+			outputWorkersLaunched(env, node,
+								  reinterpret_cast<const GatherMerge *>(plan)->num_workers,
+								  reinterpret_cast<const GatherMergeState *>(node)->nworkers_launched);
+			break;
+#endif
+		default:
+			break;
+	}
+
+	env.popNode();
+}
+
 /****************************************************************************/
 /*                                                                          */
 /****************************************************************************/
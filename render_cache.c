@@ -0,0 +1,416 @@
+/*-------------------------------------------------------------------------
+ *
+ * render_cache.c
+ *
+ * Backend-local LRU cache of rendered graphs.  Graphs of PlannedStmts are
+ * kept under a 64-bit hash of the render options, the title, the query
+ * text and a fingerprint of the plan that covers its shape, its costs and
+ * its expressions down to the constants bound for parameters, so a plan
+ * that has not changed is returned without walking it again.  The lookup
+ * comes after the query is planned, since planner settings change plans
+ * without any invalidation.  The cache is bounded by
+ * pg_plan_tree_dot.render_cache_size, and entries are dropped when a
+ * relation they use, a function, a type or a schema changes.
+ *
+ * Copyright (c) 2014-2017 Minoru NAKAMURA <nminoru@nminoru.jp>
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "nodes/nodes.h"
+#include "nodes/pg_list.h"
+#include "nodes/plannodes.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
+#include "utils/memutils.h"
+#include "utils/syscache.h"
+
+#include "pg_plan_tree_dot.h"
+
+
+/* A cached graph */
+typedef struct RenderCacheEntry
+{
+	uint64		key;			/* from render_cache_key(), the hash table key */
+	char	   *graph;
+	PlanTreeDotStats stats;		/* node and edge counts of the graph */
+	Oid		   *relids;			/* relations and indexes the plan uses */
+	int			num_relids;
+	Size		size;			/* bytes charged to the cache */
+	struct RenderCacheEntry *prev;	/* more recently used */
+	struct RenderCacheEntry *next;	/* less recently used */
+} RenderCacheEntry;
+
+/* pg_plan_tree_dot.render_cache_size, in kB */
+static int	render_cache_size = 1024;
+
+static MemoryContext cache_context = NULL;
+static HTAB *cache_table = NULL;
+static RenderCacheEntry *lru_head = NULL;
+static RenderCacheEntry *lru_tail = NULL;
+static Size cache_bytes = 0;
+
+static void create_render_cache(void);
+static void reset_render_cache(void);
+static void remove_cache_entry(RenderCacheEntry *entry);
+static void unlink_cache_entry(RenderCacheEntry *entry);
+static void link_cache_entry(RenderCacheEntry *entry);
+static void evict_cache_entries(Size limit);
+static void collect_plan_indexes(const Plan *plan, List **indexids);
+static void render_cache_relcache_callback(Datum arg, Oid relid);
+#if PG_VERSION_NUM >= 90200
+static void render_cache_syscache_callback(Datum arg, int cacheid, uint32 hashvalue);
+#else
+static void render_cache_syscache_callback(Datum arg, int cacheid, ItemPointer tuplePtr);
+#endif
+
+/*
+ * Called from _PG_init().
+ */
+void
+init_render_cache(void)
+{
+#if PG_VERSION_NUM >= 90100
+	DefineCustomIntVariable("pg_plan_tree_dot.render_cache_size",
+							"Sets the memory used to cache rendered graphs in each session.",
+							"Zero disables the cache.",
+							&render_cache_size,
+							1024,
+							0,
+							MAX_KILOBYTES,
+							PGC_USERSET,
+							GUC_UNIT_KB,
+							NULL,
+							NULL,
+							NULL);
+#else
+	DefineCustomIntVariable("pg_plan_tree_dot.render_cache_size",
+							"Sets the memory used to cache rendered graphs in each session.",
+							"Zero disables the cache.",
+							&render_cache_size,
+							1024,
+							0,
+							MAX_KILOBYTES,
+							PGC_USERSET,
+							GUC_UNIT_KB,
+							NULL,
+							NULL);
+#endif
+
+	/* The same catalogs whose changes invalidate cached plans */
+	CacheRegisterRelcacheCallback(render_cache_relcache_callback, (Datum) 0);
+	CacheRegisterSyscacheCallback(PROCOID, render_cache_syscache_callback, (Datum) 0);
+	CacheRegisterSyscacheCallback(TYPEOID, render_cache_syscache_callback, (Datum) 0);
+	CacheRegisterSyscacheCallback(NAMESPACEOID, render_cache_syscache_callback, (Datum) 0);
+	CacheRegisterSyscacheCallback(OPEROID, render_cache_syscache_callback, (Datum) 0);
+}
+
+/*
+ * Sets *key to the cache key of the graph of obj and returns true, or
+ * returns false if it cannot be cached.  Only PlannedStmts rendered without
+ * per-call relation names or node marks are cached; PlanStates carry
+ * run-time figures.  The expressions are part of the key because a custom
+ * plan differs from another one of the same query only in the constants
+ * bound for its parameters.
+ */
+bool
+render_cache_key(const char *title, const char *sql, const void *obj, const PlanTreeDotOptions *options, uint64 *key)
+{
+	uint64	hash;
+	int		flags[3];
+
+	if (render_cache_size <= 0 || obj == NULL || !IsA(obj, PlannedStmt))
+		return false;
+
+	if (options->num_relation_names > 0 || options->num_node_marks > 0)
+		return false;
+
+	flags[0] = (int) options->simplify;
+	flags[1] = (int) options->raw_oids;
+	flags[2] = (int) options->format;
+
+	hash = plan_fingerprint((const PlannedStmt *) obj, true);
+	hash = plan_expr_fingerprint((const PlannedStmt *) obj, hash);
+	hash = fingerprint_bytes(hash, flags, sizeof(flags));
+
+	/* The terminators keep the title and the text apart */
+	hash = fingerprint_bytes(hash, title, strlen(title) + 1);
+	if (sql)
+		hash = fingerprint_bytes(hash, sql, strlen(sql) + 1);
+
+	*key = hash;
+
+	return true;
+}
+
+/*
+ * Returns a copy of the cached graph for key in the current memory context
+ * and fills stats, or returns NULL.
+ */
+char *
+render_cache_lookup(uint64 key, PlanTreeDotStats *stats)
+{
+	RenderCacheEntry   *entry;
+
+	if (cache_table == NULL || render_cache_size <= 0)
+		return NULL;
+
+	entry = (RenderCacheEntry *) hash_search(cache_table, &key, HASH_FIND, NULL);
+	if (entry == NULL)
+		return NULL;
+
+	unlink_cache_entry(entry);
+	link_cache_entry(entry);
+
+	if (stats)
+	{
+		memset(stats, 0, sizeof(PlanTreeDotStats));
+		stats->num_nodes	= entry->stats.num_nodes;
+		stats->num_edges	= entry->stats.num_edges;
+		stats->output_bytes	= entry->stats.output_bytes;
+	}
+
+	return pstrdup(entry->graph);
+}
+
+/*
+ * Stores the graph of stmt under key, evicting the least recently used
+ * graphs to stay within pg_plan_tree_dot.render_cache_size.
+ */
+void
+render_cache_store(uint64 key, const struct PlannedStmt *stmt, const char *graph, const PlanTreeDotStats *stats)
+{
+	RenderCacheEntry   *entry;
+	MemoryContext		oldcontext;
+	List			   *relids;
+	ListCell		   *lc;
+	Size				size;
+	bool				found;
+	int					i;
+
+	if (render_cache_size <= 0)
+		return;
+
+	relids = list_copy(stmt->relationOids);
+	collect_plan_indexes(stmt->planTree, &relids);
+	foreach(lc, stmt->subplans)
+		collect_plan_indexes((const Plan *) lfirst(lc), &relids);
+
+	size = sizeof(RenderCacheEntry) + strlen(graph) + 1 + list_length(relids) * sizeof(Oid);
+
+	if (size > (Size) render_cache_size * 1024)
+		return;
+
+	if (cache_table == NULL)
+		create_render_cache();
+
+	evict_cache_entries((Size) render_cache_size * 1024 - size);
+
+	/* A graph stored under the key already is replaced */
+	entry = (RenderCacheEntry *) hash_search(cache_table, &key, HASH_FIND, NULL);
+	if (entry)
+		remove_cache_entry(entry);
+
+	entry = (RenderCacheEntry *) hash_search(cache_table, &key, HASH_ENTER, &found);
+
+	oldcontext = MemoryContextSwitchTo(cache_context);
+
+	entry->graph		= pstrdup(graph);
+	entry->num_relids	= list_length(relids);
+	entry->relids		= (Oid *) palloc(Max(entry->num_relids, 1) * sizeof(Oid));
+	entry->size			= size;
+
+	i = 0;
+	foreach(lc, relids)
+		entry->relids[i++] = lfirst_oid(lc);
+
+	MemoryContextSwitchTo(oldcontext);
+
+	if (stats)
+		entry->stats = *stats;
+	else
+		memset(&entry->stats, 0, sizeof(PlanTreeDotStats));
+
+	link_cache_entry(entry);
+	cache_bytes += size;
+
+	list_free(relids);
+}
+
+static void
+create_render_cache(void)
+{
+	HASHCTL		ctl;
+
+	cache_context = AllocSetContextCreate(TopMemoryContext,
+										  "plan tree render cache",
+										  ALLOCSET_DEFAULT_MINSIZE,
+										  ALLOCSET_DEFAULT_INITSIZE,
+										  ALLOCSET_DEFAULT_MAXSIZE);
+
+	memset(&ctl, 0, sizeof(ctl));
+	ctl.keysize		= sizeof(uint64);
+	ctl.entrysize	= sizeof(RenderCacheEntry);
+	ctl.hash		= tag_hash;
+	ctl.hcxt		= cache_context;
+
+	cache_table = hash_create("plan tree render cache", 64, &ctl,
+							  HASH_ELEM | HASH_FUNCTION | HASH_CONTEXT);
+}
+
+/*
+ * Drops every entry.  The table is rebuilt on the next store.
+ */
+static void
+reset_render_cache(void)
+{
+	if (cache_context == NULL)
+		return;
+
+	MemoryContextDelete(cache_context);
+
+	cache_context	= NULL;
+	cache_table		= NULL;
+	lru_head		= NULL;
+	lru_tail		= NULL;
+	cache_bytes		= 0;
+}
+
+static void
+remove_cache_entry(RenderCacheEntry *entry)
+{
+	uint64 key = entry->key;
+
+	unlink_cache_entry(entry);
+	cache_bytes -= entry->size;
+
+	pfree(entry->graph);
+	pfree(entry->relids);
+
+	hash_search(cache_table, &key, HASH_REMOVE, NULL);
+}
+
+static void
+unlink_cache_entry(RenderCacheEntry *entry)
+{
+	if (entry->prev)
+		entry->prev->next = entry->next;
+	else
+		lru_head = entry->next;
+
+	if (entry->next)
+		entry->next->prev = entry->prev;
+	else
+		lru_tail = entry->prev;
+
+	entry->prev = entry->next = NULL;
+}
+
+static void
+link_cache_entry(RenderCacheEntry *entry)
+{
+	entry->prev = NULL;
+	entry->next = lru_head;
+
+	if (lru_head)
+		lru_head->prev = entry;
+	else
+		lru_tail = entry;
+
+	lru_head = entry;
+}
+
+/*
+ * Evicts the least recently used entries until at most limit bytes are used.
+ */
+static void
+evict_cache_entries(Size limit)
+{
+	while (lru_tail && cache_bytes > limit)
+		remove_cache_entry(lru_tail);
+}
+
+/*
+ * relationOids has the tables but not the indexes, whose names appear in the
+ * graph too.
+ */
+static void
+collect_plan_indexes(const Plan *plan, List **indexids)
+{
+	ListCell *lc;
+
+	if (plan == NULL)
+		return;
+
+	switch (nodeTag(plan))
+	{
+		case T_IndexScan:
+			*indexids = lappend_oid(*indexids, ((const IndexScan *) plan)->indexid);
+			break;
+#if PG_VERSION_NUM >= 90200
+		case T_IndexOnlyScan:
+			*indexids = lappend_oid(*indexids, ((const IndexOnlyScan *) plan)->indexid);
+			break;
+#endif
+		case T_BitmapIndexScan:
+			*indexids = lappend_oid(*indexids, ((const BitmapIndexScan *) plan)->indexid);
+			break;
+		default:
+			break;
+	}
+
+	foreach(lc, plan_child_plans(plan))
+		collect_plan_indexes((const Plan *) lfirst(lc), indexids);
+}
+
+/*
+ * Drops the graphs that use relid, or all graphs if relid is InvalidOid.
+ */
+static void
+render_cache_relcache_callback(Datum arg, Oid relid)
+{
+	RenderCacheEntry *entry;
+	RenderCacheEntry *next;
+
+	if (cache_table == NULL)
+		return;
+
+	if (!OidIsValid(relid))
+	{
+		reset_render_cache();
+		return;
+	}
+
+	for (entry = lru_head ; entry ; entry = next)
+	{
+		int i;
+
+		next = entry->next;
+
+		for (i = 0 ; i < entry->num_relids ; i++)
+		{
+			if (entry->relids[i] == relid)
+			{
+				remove_cache_entry(entry);
+				break;
+			}
+		}
+	}
+}
+
+/*
+ * Function, type, schema and operator names appear in the labels, and the
+ * graphs do not record which ones, so any change drops them all.
+ */
+#if PG_VERSION_NUM >= 90200
+static void
+render_cache_syscache_callback(Datum arg, int cacheid, uint32 hashvalue)
+#else
+static void
+render_cache_syscache_callback(Datum arg, int cacheid, ItemPointer tuplePtr)
+#endif
+{
+	reset_render_cache();
+}
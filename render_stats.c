@@ -0,0 +1,364 @@
+/*-------------------------------------------------------------------------
+ *
+ * render_stats.c
+ *
+ * Self-instrumentation of the renderer.  Each rendering call records the
+ * time spent parsing, planning, finding the graph nodes, writing the labels
+ * and writing the file, with node and edge counts and the peak size of its
+ * temporary memory context.  The last call is kept per backend, and the
+ * totals accumulate in shared memory when the library is preloaded, or in
+ * the backend otherwise.
+ *
+ * Copyright (c) 2014-2017 Minoru NAKAMURA <nminoru@nminoru.jp>
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#if PG_VERSION_NUM >= 90300
+#include "access/htup_details.h"
+#else
+#include "access/htup.h"
+#endif
+#include "access/xact.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+
+#include "pg_plan_tree_dot.h"
+
+
+/* Totals in shared memory */
+typedef struct SharedRenderStats
+{
+	slock_t		mutex;
+	RenderStats	totals;
+} SharedRenderStats;
+
+const char *const render_phase_names[NUM_RENDER_PHASES] = {
+	"parse",
+	"plan",
+	"walk",
+	"label",
+	"write",
+};
+
+/* pg_plan_tree_dot.render_stats */
+static bool render_stats_notice = false;
+
+static SharedRenderStats *shared_stats = NULL;
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+static RenderStats local_totals;	/* used when not preloaded */
+static RenderStats last_stats;		/* the current or last call */
+static MemoryContext render_context = NULL;
+static bool render_active = false;
+static SubTransactionId render_subid = InvalidSubTransactionId;
+
+static void render_stats_shmem_startup(void);
+static void render_stats_xact_callback(XactEvent event, void *arg);
+static void render_stats_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
+										  SubTransactionId parentSubid, void *arg);
+static void accumulate_render_stats(RenderStats *totals, const RenderStats *stats);
+static Datum render_stats_datum(FunctionCallInfo fcinfo, const RenderStats *stats);
+
+/*
+ * Called from _PG_init().  Shared memory for the totals is requested only
+ * when the library is in shared_preload_libraries.
+ */
+void
+init_render_stats(void)
+{
+#if PG_VERSION_NUM >= 90100
+	DefineCustomBoolVariable("pg_plan_tree_dot.render_stats",
+							 "Reports the time and memory each rendering took.",
+							 "Adds a comment to every graph and raises a NOTICE per call.",
+							 &render_stats_notice,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+#else
+	DefineCustomBoolVariable("pg_plan_tree_dot.render_stats",
+							 "Reports the time and memory each rendering took.",
+							 "Adds a comment to every graph and raises a NOTICE per call.",
+							 &render_stats_notice,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL);
+#endif
+
+	RegisterXactCallback(render_stats_xact_callback, NULL);
+	RegisterSubXactCallback(render_stats_subxact_callback, NULL);
+
+	if (!process_shared_preload_libraries_in_progress)
+		return;
+
+	RequestAddinShmemSpace(MAXALIGN(sizeof(SharedRenderStats)));
+
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = render_stats_shmem_startup;
+}
+
+static void
+render_stats_shmem_startup(void)
+{
+	bool found;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	shared_stats = (SharedRenderStats *) ShmemInitStruct("pg_plan_tree_dot render stats",
+														 sizeof(SharedRenderStats),
+														 &found);
+	if (!found)
+	{
+		SpinLockInit(&shared_stats->mutex);
+		memset(&shared_stats->totals, 0, sizeof(RenderStats));
+	}
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * A call that fails never reaches render_stats_end(), and its context is
+ * gone after the abort.  Forget the call when the transaction, or the
+ * subtransaction it started in, aborts.
+ */
+static void
+render_stats_xact_callback(XactEvent event, void *arg)
+{
+	if (event == XACT_EVENT_ABORT)
+	{
+		render_active	= false;
+		render_context	= NULL;
+	}
+}
+
+static void
+render_stats_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
+							  SubTransactionId parentSubid, void *arg)
+{
+	if (event == SUBXACT_EVENT_ABORT_SUB && render_active && mySubid == render_subid)
+	{
+		render_active	= false;
+		render_context	= NULL;
+	}
+}
+
+/*
+ * Starts recording a rendering call.  context is the call's temporary
+ * memory context, whose size is tracked as the peak.
+ */
+void
+render_stats_begin(MemoryContext context)
+{
+	memset(&last_stats, 0, sizeof(last_stats));
+	last_stats.calls = 1;
+
+	render_context	= context;
+	render_active	= true;
+	render_subid	= GetCurrentSubTransactionId();
+}
+
+/*
+ * Adds time to a phase of the current call.  Outside a call this does
+ * nothing, so the shared helpers can report unconditionally.
+ */
+void
+render_stats_add(RenderPhase phase, double ms)
+{
+	if (render_active)
+		last_stats.phase_ms[phase] += ms;
+}
+
+/*
+ * Adds one rendered graph.  The renderer's own context was a child of the
+ * call's context, so the two together are the peak while it ran.
+ */
+void
+render_stats_add_graph(const PlanTreeDotStats *stats)
+{
+	Size bytes;
+
+	if (!render_active)
+		return;
+
+	last_stats.graphs++;
+	last_stats.nodes += stats->num_nodes;
+	last_stats.edges += stats->num_edges;
+	last_stats.phase_ms[RENDER_WALK]	+= stats->walk_ms;
+	last_stats.phase_ms[RENDER_LABEL]	+= stats->label_ms;
+
+	bytes = memory_context_total_space(render_context) + stats->peak_bytes;
+	if (bytes > last_stats.peak_bytes)
+		last_stats.peak_bytes = bytes;
+}
+
+/*
+ * Finishes the current call: adds it to the totals and, if
+ * pg_plan_tree_dot.render_stats is on, reports it.
+ */
+void
+render_stats_end(void)
+{
+	Size bytes;
+
+	if (!render_active)
+		return;
+
+	bytes = memory_context_total_space(render_context);
+	if (bytes > last_stats.peak_bytes)
+		last_stats.peak_bytes = bytes;
+
+	render_active	= false;
+	render_context	= NULL;
+
+	if (shared_stats)
+	{
+		SpinLockAcquire(&shared_stats->mutex);
+		accumulate_render_stats(&shared_stats->totals, &last_stats);
+		SpinLockRelease(&shared_stats->mutex);
+	}
+	else
+		accumulate_render_stats(&local_totals, &last_stats);
+
+	if (render_stats_notice)
+		elog(NOTICE, "plan tree rendering: %ld graphs, %ld nodes, %ld edges, "
+			 "parse %.3f ms, plan %.3f ms, walk %.3f ms, label %.3f ms, write %.3f ms, peak %ld kB",
+			 (long) last_stats.graphs, (long) last_stats.nodes, (long) last_stats.edges,
+			 last_stats.phase_ms[RENDER_PARSE], last_stats.phase_ms[RENDER_PLAN],
+			 last_stats.phase_ms[RENDER_WALK], last_stats.phase_ms[RENDER_LABEL],
+			 last_stats.phase_ms[RENDER_WRITE],
+			 (long) ((last_stats.peak_bytes + 1023) / 1024));
+}
+
+/*
+ * Whether each graph should be followed by a comment with its statistics.
+ */
+bool
+render_stats_comment_enabled(void)
+{
+	return render_stats_notice;
+}
+
+/*
+ * Returns the statistics of the current or last call.
+ */
+const RenderStats *
+render_stats_last(void)
+{
+	return &last_stats;
+}
+
+static void
+accumulate_render_stats(RenderStats *totals, const RenderStats *stats)
+{
+	int i;
+
+	totals->calls	+= stats->calls;
+	totals->graphs	+= stats->graphs;
+	totals->nodes	+= stats->nodes;
+	totals->edges	+= stats->edges;
+
+	for (i = 0 ; i < NUM_RENDER_PHASES ; i++)
+		totals->phase_ms[i] += stats->phase_ms[i];
+
+	if (stats->peak_bytes > totals->peak_bytes)
+		totals->peak_bytes = stats->peak_bytes;
+}
+
+static Datum
+render_stats_datum(FunctionCallInfo fcinfo, const RenderStats *stats)
+{
+	TupleDesc	tupdesc;
+	Datum		values[NUM_RENDER_PHASES + 5];
+	bool		nulls[NUM_RENDER_PHASES + 5];
+	int			i = 0;
+	int			phase;
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	memset(nulls, 0, sizeof(nulls));
+
+	values[i++] = Int64GetDatum(stats->calls);
+	values[i++] = Int64GetDatum(stats->graphs);
+	values[i++] = Int64GetDatum(stats->nodes);
+	values[i++] = Int64GetDatum(stats->edges);
+	for (phase = 0 ; phase < NUM_RENDER_PHASES ; phase++)
+		values[i++] = Float8GetDatum(stats->phase_ms[phase]);
+	values[i++] = Int64GetDatum((int64) stats->peak_bytes);
+
+	return HeapTupleGetDatum(heap_form_tuple(BlessTupleDesc(tupdesc), values, nulls));
+}
+
+/*
+ * plan_tree_dot_last_stats()
+ *
+ * Returns the statistics of the last rendering call in this backend.
+ */
+PG_FUNCTION_INFO_V1(plan_tree_dot_last_stats);
+Datum
+plan_tree_dot_last_stats(PG_FUNCTION_ARGS)
+{
+	return render_stats_datum(fcinfo, &last_stats);
+}
+
+/*
+ * pg_plan_tree_dot_stats()
+ *
+ * Returns the accumulated statistics of all rendering calls: cluster-wide
+ * if the library is preloaded, otherwise of this backend.
+ */
+PG_FUNCTION_INFO_V1(pg_plan_tree_dot_stats);
+Datum
+pg_plan_tree_dot_stats(PG_FUNCTION_ARGS)
+{
+	RenderStats totals;
+
+	if (shared_stats)
+	{
+		SpinLockAcquire(&shared_stats->mutex);
+		totals = shared_stats->totals;
+		SpinLockRelease(&shared_stats->mutex);
+	}
+	else
+		totals = local_totals;
+
+	return render_stats_datum(fcinfo, &totals);
+}
+
+/*
+ * pg_plan_tree_dot_stats_reset()
+ */
+PG_FUNCTION_INFO_V1(pg_plan_tree_dot_stats_reset);
+Datum
+pg_plan_tree_dot_stats_reset(PG_FUNCTION_ARGS)
+{
+	if (shared_stats)
+	{
+		if (!superuser())
+			elog(ERROR, "must be superuser to reset pg_plan_tree_dot statistics");
+
+		SpinLockAcquire(&shared_stats->mutex);
+		memset(&shared_stats->totals, 0, sizeof(RenderStats));
+		SpinLockRelease(&shared_stats->mutex);
+	}
+	else
+		memset(&local_totals, 0, sizeof(RenderStats));
+
+	PG_RETURN_VOID();
+}
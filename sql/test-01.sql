@@ -28,4 +28,13 @@ SELECT generate_plan_tree_dot('SELECT region FROM employee GROUP BY region;', 't
 -- test-01-2
 SELECT generate_plan_tree_dot('SELECT region FROM employee ORDER BY ID;',     'test-01-2.dot');
 
+-- test-01-3
+SELECT generate_plan_tree_dot('SELECT region FROM employee WHERE ID = $1;', 'test-01-3.dot', ARRAY['int4']::regtype[], ARRAY['3']);
+
+-- test-01-4: custom plans for different parameter values are not confused
+ANALYZE employee;
+SELECT generate_plan_tree_dot('SELECT region FROM employee WHERE ID < $1;', 'test-01-4.dot', ARRAY['int4']::regtype[], ARRAY['2']);
+SELECT generate_plan_tree_dot('SELECT region FROM employee WHERE ID < $1;', 'test-01-5.dot', ARRAY['int4']::regtype[], ARRAY['9']);
+SELECT pg_read_file('test-01-4.dot') = pg_read_file('test-01-5.dot') AS same_graph;
+
 DROP TABLE employee;
@@ -0,0 +1,25 @@
+SET client_min_messages TO 'warning';
+
+CREATE EXTENSION IF NOT EXISTS pg_plan_tree_dot;
+
+CREATE TABLE names_test (
+       a          int,
+       b          text);
+
+-- test-02-1: OIDs are resolved to names
+SELECT generate_plan_tree_dot('SELECT a FROM names_test;', 'test-02-1.dot');
+
+SELECT position('digraph {' in g) = 1              AS digraph,
+       position('relation: names_test' in g) > 0 AS relation,
+       position('vartype: integer' in g) > 0     AS type
+  FROM pg_read_file('test-02-1.dot') AS g;
+
+-- test-02-2: raw_oids keeps the OIDs
+SELECT generate_plan_tree_dot('SELECT a FROM names_test;', 'test-02-2.dot', false, true);
+
+SELECT position('relation: ' || 'names_test'::regclass::oid in g) > 0 AS relation,
+       position('relation: names_test' in g) = 0                     AS no_relation_name,
+       position('vartype: 23' in g) > 0                              AS type
+  FROM pg_read_file('test-02-2.dot') AS g;
+
+DROP TABLE names_test;
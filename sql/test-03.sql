@@ -0,0 +1,15 @@
+SET client_min_messages TO 'warning';
+
+CREATE EXTENSION IF NOT EXISTS pg_plan_tree_dot;
+
+CREATE TABLE misestimate_test (
+       a          int);
+
+INSERT INTO misestimate_test SELECT generate_series(1, 100);
+ANALYZE misestimate_test;
+
+-- test-03-1: the planner cannot estimate the modulo, and guesses one row
+SELECT node_id, node_type, relation, plan_rows, actual_rows, loops, q_error
+  FROM plan_tree_misestimates('SELECT * FROM misestimate_test WHERE a % 2 = 0');
+
+DROP TABLE misestimate_test;
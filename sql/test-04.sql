@@ -0,0 +1,20 @@
+SET client_min_messages TO 'warning';
+
+CREATE EXTENSION IF NOT EXISTS pg_plan_tree_dot;
+
+CREATE TABLE sweep_test (
+       a          int);
+
+INSERT INTO sweep_test SELECT generate_series(1, 100);
+CREATE INDEX sweep_test_a_idx ON sweep_test (a);
+ANALYZE sweep_test;
+
+-- test-04-1: the plan changes when sequential scans are allowed
+SELECT plan_no, range_from, range_to
+  FROM plan_tree_sweep('SELECT * FROM sweep_test WHERE a = 5', 'enable_seqscan', 0, 1, 2);
+
+-- test-04-2: a parameter the plan does not depend on gives one range
+SELECT plan_no, range_from, range_to
+  FROM plan_tree_sweep('SELECT * FROM sweep_test', 'work_mem', 64, 1024, 4);
+
+DROP TABLE sweep_test;
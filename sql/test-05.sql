@@ -0,0 +1,19 @@
+SET client_min_messages TO 'warning';
+
+CREATE EXTENSION IF NOT EXISTS pg_plan_tree_dot;
+
+CREATE TABLE alternatives_test (
+       a          int,
+       b          int);
+
+INSERT INTO alternatives_test SELECT i, i FROM generate_series(1, 10000) AS i;
+CREATE INDEX alternatives_test_a_idx ON alternatives_test (a);
+ANALYZE alternatives_test;
+
+-- test-05-1: index scan, then bitmap scan, then sequential scan
+SELECT plan_no, disabled
+  FROM plan_tree_alternatives('SELECT * FROM alternatives_test WHERE a = 5',
+                              ARRAY['enable_indexscan', 'enable_bitmapscan'])
+ ORDER BY plan_no;
+
+DROP TABLE alternatives_test;
@@ -0,0 +1,23 @@
+SET client_min_messages TO 'warning';
+
+CREATE EXTENSION IF NOT EXISTS pg_plan_tree_dot;
+
+CREATE TABLE whatif_test (
+       a          int,
+       b          int);
+
+INSERT INTO whatif_test SELECT i, i FROM generate_series(1, 10000) AS i;
+ANALYZE whatif_test;
+
+-- test-06-1: the hypothetical index is used, and is not created
+SELECT plan_tree_dot_whatif('SELECT * FROM whatif_test WHERE a = 5',
+                            ARRAY['CREATE INDEX whatif_a_idx ON whatif_test (a)'], 'test-06-1.dot');
+
+SELECT position('Baseline Plan' in g) > 0                      AS baseline,
+       position('What-if Plan' in g) > 0                       AS whatif,
+       position('indexid: whatif_a_idx (hypothetical)' in g) > 0 AS hypothetical
+  FROM pg_read_file('test-06-1.dot') AS g;
+
+SELECT count(*) FROM pg_class WHERE relname = 'whatif_a_idx';
+
+DROP TABLE whatif_test;
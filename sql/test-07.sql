@@ -0,0 +1,21 @@
+SET client_min_messages TO 'warning';
+
+CREATE EXTENSION IF NOT EXISTS pg_plan_tree_dot;
+
+CREATE TABLE open_test (
+       a          int,
+       b          text);
+
+-- test-07-1: nodes are numbered in the order of the graph
+SELECT plan_tree_open('SELECT a FROM open_test') AS h \gset
+
+SELECT split_part(plan_tree_node(:h, 1), '|', 1) AS node1,
+       split_part(plan_tree_node(:h, 2), '|', 1) AS node2;
+
+SELECT * FROM plan_tree_children(:h, 1) WHERE field = 'planTree';
+
+SELECT * FROM plan_tree_children(:h, 2);
+
+SELECT plan_tree_close(:h);
+
+DROP TABLE open_test;
@@ -0,0 +1,21 @@
+SET client_min_messages TO 'warning';
+
+CREATE EXTENSION IF NOT EXISTS pg_plan_tree_dot;
+
+CREATE TABLE calibration_test (
+       a          int);
+
+INSERT INTO calibration_test SELECT generate_series(1, 100);
+ANALYZE calibration_test;
+
+-- test-08-1: one sample per executed node and run
+SELECT plan_tree_calibration_reset();
+
+SELECT plan_tree_calibration_sample('SELECT count(*) FROM calibration_test', 3);
+
+-- test-08-2: the overall fit first, then each node type in the order sampled
+SELECT node_type, samples FROM plan_tree_calibrate();
+
+SELECT plan_tree_calibration_reset();
+
+DROP TABLE calibration_test;
@@ -0,0 +1,35 @@
+SET client_min_messages TO 'warning';
+
+CREATE EXTENSION IF NOT EXISTS pg_plan_tree_dot;
+
+CREATE TABLE advice_test (
+       a          int,
+       b          int);
+
+INSERT INTO advice_test SELECT i % 100, i % 100 FROM generate_series(1, 10000) AS i;
+ANALYZE advice_test;
+
+-- test-09-1: a and b are correlated, but estimated as independent
+SELECT relation, columns, node_type, plan_rows, actual_rows, q_error, statement
+  FROM plan_tree_statistics_advice('SELECT * FROM advice_test WHERE a = 1 AND b = 1');
+
+-- test-09-2: nothing to suggest once the statistics exist
+CREATE STATISTICS advice_test_a_b_stat (dependencies, ndistinct) ON a, b FROM public.advice_test;
+ANALYZE advice_test;
+
+SELECT count(*)
+  FROM plan_tree_statistics_advice('SELECT * FROM advice_test WHERE a = 1 AND b = 1');
+
+-- test-09-3: suggested names are clipped to NAMEDATALEN
+CREATE TABLE advice_test_with_a_rather_long_name_for_statistics (
+       first_long_column  int,
+       second_long_column int);
+
+INSERT INTO advice_test_with_a_rather_long_name_for_statistics SELECT i % 100, i % 100 FROM generate_series(1, 10000) AS i;
+ANALYZE advice_test_with_a_rather_long_name_for_statistics;
+
+SELECT statement
+  FROM plan_tree_statistics_advice('SELECT * FROM advice_test_with_a_rather_long_name_for_statistics WHERE first_long_column = 1 AND second_long_column = 1');
+
+DROP TABLE advice_test;
+DROP TABLE advice_test_with_a_rather_long_name_for_statistics;
@@ -0,0 +1,14 @@
+SET client_min_messages TO 'warning';
+
+CREATE EXTENSION IF NOT EXISTS pg_plan_tree_dot;
+
+CREATE TABLE folded_test (
+       a          int);
+
+INSERT INTO folded_test SELECT generate_series(1, 1000);
+ANALYZE folded_test;
+
+-- test-10-1: one stack per node, from the root down, weighted by exclusive cost
+SELECT stack FROM plan_tree_folded('SELECT count(*) FROM folded_test', 'cost');
+
+DROP TABLE folded_test;
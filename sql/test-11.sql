@@ -0,0 +1,42 @@
+SET client_min_messages TO 'warning';
+
+CREATE EXTENSION IF NOT EXISTS pg_plan_tree_dot;
+
+CREATE TABLE prepared_test (
+       a          int);
+
+INSERT INTO prepared_test SELECT generate_series(1, 100);
+ANALYZE prepared_test;
+
+PREPARE prepared_q(int) AS SELECT a FROM prepared_test WHERE a = $1;
+
+-- the first executions use custom plans
+EXECUTE prepared_q(1);
+EXECUTE prepared_q(2);
+
+-- test-11-1: without values only the generic plan is written
+SELECT plan_tree_dot_prepared('prepared_q', 'test-11-1.dot');
+
+SELECT position('Generic Plan (cost=' in g) > 0  AS generic,
+       position('custom plans=2,' in g) > 0      AS custom_plans,
+       position('Custom Plan (cost=' in g) > 0   AS custom
+  FROM pg_read_file('test-11-1.dot') AS g;
+
+-- test-11-2: with values the custom plan follows
+SELECT plan_tree_dot_prepared('prepared_q', 'test-11-2.dot', ARRAY['3']);
+
+SELECT position('Generic Plan (cost=' in g) > 0  AS generic,
+       position('custom plans=2,' in g) > 0      AS custom_plans,
+       position('Custom Plan (cost=' in g) > 0   AS custom
+  FROM pg_read_file('test-11-2.dot') AS g;
+
+-- test-11-3: building the custom plan did not count as an execution
+SELECT plan_tree_dot_prepared('prepared_q', 'test-11-3.dot');
+
+SELECT position('Generic Plan (cost=' in g) > 0  AS generic,
+       position('custom plans=2,' in g) > 0      AS custom_plans,
+       position('Custom Plan (cost=' in g) > 0   AS custom
+  FROM pg_read_file('test-11-3.dot') AS g;
+
+DEALLOCATE prepared_q;
+DROP TABLE prepared_test;
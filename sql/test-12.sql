@@ -0,0 +1,29 @@
+SET client_min_messages TO 'warning';
+
+CREATE EXTENSION IF NOT EXISTS pg_plan_tree_dot;
+
+CREATE TABLE plan_state_test (
+       a          int);
+
+INSERT INTO plan_state_test SELECT generate_series(1, 100);
+ANALYZE plan_state_test;
+
+-- test-12-1: without do_analyze there is no instrumentation
+SELECT generate_plan_state_tree_dot('SELECT count(*) FROM plan_state_test WHERE a > 50', 'test-12-1.dot');
+
+SELECT position('PlanState Tree' in g) > 0 AS title,
+       position('|loops: ' in g) = 0        AS no_loops
+  FROM pg_read_file('test-12-1.dot') AS g;
+
+-- test-12-2: with do_analyze the rows, loops, time and buffers of each node
+SELECT generate_plan_state_tree_dot('SELECT count(*) FROM plan_state_test WHERE a > 50', 'test-12-2.dot', true);
+
+SELECT position('PlanState Tree (analyzed)' in g) > 0            AS title,
+       position('|loops: 1|actual rows: 50|' in g) > 0           AS scan_rows,
+       position('|loops: 1|actual rows: 1|' in g) > 0            AS agg_rows,
+       position('|actual total ms: ' in g) > 0                   AS timed,
+       position('|rows removed by filter: 50|' in g) > 0         AS filtered,
+       position('|buffers: shared hit=' in g) > 0                AS buffers
+  FROM pg_read_file('test-12-2.dot') AS g;
+
+DROP TABLE plan_state_test;
@@ -0,0 +1,30 @@
+SET client_min_messages TO 'warning';
+
+CREATE EXTENSION IF NOT EXISTS pg_plan_tree_dot;
+
+CREATE TABLE parallel_test (
+       a          int);
+
+INSERT INTO parallel_test SELECT generate_series(1, 10000);
+ANALYZE parallel_test;
+
+SET parallel_setup_cost = 0;
+SET parallel_tuple_cost = 0;
+SET min_parallel_table_scan_size = 0;
+SET max_parallel_workers_per_gather = 2;
+
+-- test-13-1: the workers launched, and each worker's rows and time, however
+-- many workers the server could spare
+SELECT generate_plan_state_tree_dot('SELECT count(*) FROM parallel_test', 'test-13-1.dot', true);
+
+SELECT g ~ '\|workers launched: [0-2] of 2'                   AS launched,
+       g ~ '\|workers launched: 0 of 2' OR
+       g ~ '\|worker 0: rows=[0-9]+ loops=[0-9]+ time=[0-9.]+ ms' AS worker_rows
+  FROM pg_read_file('test-13-1.dot') AS g;
+
+RESET parallel_setup_cost;
+RESET parallel_tuple_cost;
+RESET min_parallel_table_scan_size;
+RESET max_parallel_workers_per_gather;
+
+DROP TABLE parallel_test;
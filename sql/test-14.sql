@@ -0,0 +1,35 @@
+SET client_min_messages TO 'warning';
+
+CREATE EXTENSION IF NOT EXISTS pg_plan_tree_dot;
+
+CREATE TABLE pruning_test (
+       a          int) PARTITION BY LIST (a);
+
+CREATE TABLE pruning_test_1 PARTITION OF pruning_test FOR VALUES IN (1);
+CREATE TABLE pruning_test_2 PARTITION OF pruning_test FOR VALUES IN (2);
+CREATE TABLE pruning_test_3 PARTITION OF pruning_test FOR VALUES IN (3);
+
+INSERT INTO pruning_test SELECT i % 3 + 1 FROM generate_series(1, 300) AS i;
+ANALYZE pruning_test;
+
+SET pruning_test.key = '2';
+
+-- test-14-1: a stable expression prunes at executor startup
+SELECT generate_plan_state_tree_dot('SELECT count(*) FROM pruning_test WHERE a = current_setting(''pruning_test.key'')::int',
+                                    'test-14-1.dot', true);
+
+SELECT position('|subplans: 3, init-pruned: 2|' in g) > 0 AS init_pruned,
+       position('|exec-pruned (never executed): 0' in g) > 0 AS exec_pruned
+  FROM pg_read_file('test-14-1.dot') AS g;
+
+-- test-14-2: an init plan's value prunes during execution
+SELECT generate_plan_state_tree_dot('SELECT count(*) FROM pruning_test WHERE a = (SELECT 2)',
+                                    'test-14-2.dot', true);
+
+SELECT position('|subplans: 3, init-pruned: 0|' in g) > 0 AS init_pruned,
+       position('|exec-pruned (never executed): 2' in g) > 0 AS exec_pruned
+  FROM pg_read_file('test-14-2.dot') AS g;
+
+RESET pruning_test.key;
+
+DROP TABLE pruning_test;
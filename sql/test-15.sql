@@ -0,0 +1,11 @@
+SET client_min_messages TO 'warning';
+
+CREATE EXTENSION IF NOT EXISTS pg_plan_tree_dot;
+
+-- test-15-1: text from the query cannot close the script element
+SELECT generate_plan_tree_html('SELECT 1 AS "</script><b>x"', 'test-15-1.html');
+
+SELECT position('<!DOCTYPE html>' in g) = 1                  AS html,
+       position('</script><b>x' in g) = 0                    AS not_closed,
+       position('\u003c/script>\u003cb>x' in g) > 0          AS escaped
+  FROM pg_read_file('test-15-1.html') AS g;
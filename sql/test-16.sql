@@ -0,0 +1,21 @@
+SET client_min_messages TO 'warning';
+
+CREATE EXTENSION IF NOT EXISTS pg_plan_tree_dot;
+
+CREATE TABLE stats_test (
+       a          int);
+
+CREATE TEMP TABLE stats_before AS SELECT calls, graphs FROM pg_plan_tree_dot_stats;
+
+-- test-16-1: the last call rendered one graph
+SELECT generate_plan_tree_dot('SELECT a FROM stats_test WHERE a = 1', 'test-16-1.dot');
+
+SELECT calls, graphs, nodes > 0 AS nodes, edges > 0 AS edges
+  FROM plan_tree_dot_last_stats();
+
+-- test-16-2: and was added to the totals
+SELECT s.calls - b.calls AS calls, s.graphs - b.graphs AS graphs
+  FROM pg_plan_tree_dot_stats AS s, stats_before AS b;
+
+DROP TABLE stats_before;
+DROP TABLE stats_test;